@@ -66,6 +66,8 @@ int tl_ch_cg_presteps,
   ,tl_preconditioner_type
   ,reflective_boundary
   ,tl_ppcg_inner_steps
+  ,tl_chain_iterations
+  ,tl_blocking_reductions
   ,tl_use_chebyshev
   ,tl_use_cg
   ,tl_use_ppcg
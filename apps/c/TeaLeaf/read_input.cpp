@@ -96,6 +96,8 @@ void read_input()
   tl_preconditioner_type = TL_PREC_NONE;
   reflective_boundary = 0;
   tl_ppcg_inner_steps = -1;
+  tl_chain_iterations = 1;
+  tl_blocking_reductions = 0;
   tl_use_chebyshev = 0;
   tl_use_cg = 0;
   tl_use_ppcg = 0;
@@ -188,6 +190,16 @@ void read_input()
                 tl_ppcg_inner_steps = atoi(token);
                 ops_fprintf(g_out," %20s: %d\n", "tl_ppcg_inner_steps",tl_ppcg_inner_steps);
               }
+              else if(strcmp(trimwhitespace(token),"tl_chain_iterations") == 0) {
+                token = strtok(NULL, " =");
+                tl_chain_iterations = atoi(token);
+                ops_fprintf(g_out," %20s: %d\n", "tl_chain_iterations",tl_chain_iterations);
+              }
+              else if(strcmp(trimwhitespace(token),"tl_blocking_reductions") == 0) {
+                token = strtok(NULL, " =");
+                tl_blocking_reductions = atoi(token);
+                ops_fprintf(g_out," %20s: %d\n", "tl_blocking_reductions",tl_blocking_reductions);
+              }
               else if(strcmp(trimwhitespace(token),"tl_ch_cg_epslim") == 0) {
                 token = strtok(NULL, " =");
                 tl_ch_cg_epslim = atof(token);
@@ -155,6 +155,11 @@ void tea_leaf_jacobi_solve(
 	ops_dat u1,
 	ops_dat un);
 
+void tea_leaf_jacobi_error(
+  double *error,
+	ops_dat u1,
+	ops_dat un);
+
 void tea_leaf_ppcg_init_sd(
   ops_dat r,
   ops_dat rtemp,
@@ -50,6 +50,15 @@ void tea_leaf_recip_kernel(double * u, const double * p);
 void tea_leaf_recip2_kernel(double *z, const double *x, const double *y);
 void tea_leaf_norm2_kernel(const double *x, double * norm);
 
+// The dot products are requested without waiting for their global sums,
+// which overlap with the loops issued until the caller waits on red_temp
+static void tea_leaf_cg_result(double *result) {
+  if (tl_blocking_reductions)
+    ops_reduction_result(red_temp, result);
+  else
+    ops_reduction_result_deferred(red_temp, result);
+}
+
 void tea_leaf_cg_init(
 	ops_dat p,
 	ops_dat r,
@@ -97,7 +106,7 @@ void tea_leaf_cg_init(
       ops_arg_dat(p, 1, S2D_00, "double", OPS_READ),
       ops_arg_reduce(red_temp, 1, "double", OPS_INC));
 
-  ops_reduction_result(red_temp,rro);
+  tea_leaf_cg_result(rro);
 }
 
 void tea_leaf_cg_calc_w(
@@ -123,7 +132,7 @@ void tea_leaf_cg_calc_w(
       ops_arg_gbl(&ry, 1, "double", OPS_READ),
       ops_arg_reduce(red_temp, 1, "double", OPS_INC));
 
-  ops_reduction_result(red_temp,pw);
+  tea_leaf_cg_result(pw);
 }
 
 void tea_leaf_cg_calc_ur(
@@ -181,7 +190,7 @@ void tea_leaf_cg_calc_ur(
         ops_arg_gbl(&alpha, 1, "double", OPS_READ),
         ops_arg_reduce(red_temp, 1, "double", OPS_INC));
   }
-  ops_reduction_result(red_temp,rnn);
+  tea_leaf_cg_result(rnn);
 }
 
 
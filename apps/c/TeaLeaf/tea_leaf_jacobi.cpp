@@ -65,12 +65,25 @@ void tea_leaf_jacobi_solve(
 
   int rangexy[] = {x_min,x_max,y_min,y_max};
 
-  *error = 0.0;
-
   ops_par_loop(tea_leaf_yeqx_kernel, "tea_leaf_yeqx_kernel", tea_grid, 2, rangexy,
       ops_arg_dat(un, 1, S2D_00, "double", OPS_WRITE),
       ops_arg_dat(u1, 1, S2D_00, "double", OPS_READ));
 
+  // without the error, e.g. within a loop chain
+  if (error == NULL) {
+    ops_par_loop(tea_leaf_jacobi_sweep_kernel, "tea_leaf_jacobi_sweep_kernel", tea_grid, 2, rangexy,
+        ops_arg_dat(u1, 1, S2D_00, "double", OPS_WRITE),
+        ops_arg_dat(Kx, 1, S2D_00_P10, "double", OPS_READ),
+        ops_arg_dat(Ky, 1, S2D_00_0P1, "double", OPS_READ),
+        ops_arg_dat(un, 1, S2D_00_0M1_M10_P10_0P1, "double", OPS_READ),
+        ops_arg_dat(u0, 1, S2D_00, "double", OPS_READ),
+        ops_arg_gbl(&rx, 1, "double", OPS_READ),
+        ops_arg_gbl(&ry, 1, "double", OPS_READ));
+    return;
+  }
+
+  *error = 0.0;
+
   ops_par_loop(tea_leaf_jacobi_kernel, "tea_leaf_jacobi_kernel", tea_grid, 2, rangexy,
       ops_arg_dat(u1, 1, S2D_00, "double", OPS_WRITE),
       ops_arg_dat(Kx, 1, S2D_00_P10, "double", OPS_READ),
@@ -84,3 +97,24 @@ void tea_leaf_jacobi_solve(
   ops_reduction_result(red_temp,error);
 
 }
+
+// Error of the last sweep, from the iterate before it left in un
+void tea_leaf_jacobi_error(
+  double *error,
+	ops_dat u1,
+	ops_dat un)
+{
+  int x_min = field.x_min;
+  int x_max = field.x_max;
+  int y_min = field.y_min;
+  int y_max = field.y_max;
+
+  int rangexy[] = {x_min,x_max,y_min,y_max};
+
+  ops_par_loop(tea_leaf_jacobi_error_kernel, "tea_leaf_jacobi_error_kernel", tea_grid, 2, rangexy,
+      ops_arg_dat(u1, 1, S2D_00, "double", OPS_READ),
+      ops_arg_dat(un, 1, S2D_00, "double", OPS_READ),
+      ops_arg_reduce(red_temp, 1, "double", OPS_INC));
+
+  ops_reduction_result(red_temp,error);
+}
@@ -16,4 +16,18 @@ void tea_leaf_jacobi_kernel(double *u1, const double *Kx, const double *Ky,
     *error = *error + fabs(u1[OPS_ACC0(0,0)] - un[OPS_ACC3(0,0)]);
 }
 
+void tea_leaf_jacobi_sweep_kernel(double *u1, const double *Kx, const double *Ky,
+		const double *un,const double *u0,const double *rx,const double *ry) {
+	u1[OPS_ACC0(0,0)] = (u0[OPS_ACC4(0,0)] 
+		+ (*rx)*(Kx[OPS_ACC1(1, 0)] *un[OPS_ACC3(1, 0)] + Kx[OPS_ACC1(0,0)]*un[OPS_ACC3(-1, 0)])
+		+ (*ry)*(Ky[OPS_ACC2(0, 1)] *un[OPS_ACC3(0, 1)] + Ky[OPS_ACC2(0,0)]*un[OPS_ACC3(0, -1)]))
+			/(1.0
+				+ (*rx)*(Kx[OPS_ACC1(1, 0)] + Kx[OPS_ACC1(0,0)])
+				+ (*ry)*(Ky[OPS_ACC2(0, 1)] + Ky[OPS_ACC2(0,0)]));
+}
+
+void tea_leaf_jacobi_error_kernel(const double *u1, const double *un, double *error) {
+    *error = *error + fabs(u1[OPS_ACC0(0,0)] - un[OPS_ACC1(0,0)]);
+}
+
 #endif
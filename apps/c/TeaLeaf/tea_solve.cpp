@@ -56,6 +56,9 @@ void tea_leaf() {
 
   int cg_calc_steps;
 
+  // last iteration of the loop chain being issued, 0 if none
+  int chain_last = 0, check_residual;
+
   double cg_time, ch_time, total_solve_time, ch_per_it, cg_per_it, iteration_time;
 
 	int halo_exchange_depth = 1;
@@ -124,6 +127,9 @@ void tea_leaf() {
     update_halo(fields,1);
     //if (profiler_on) init_time=init_time+(timer()-halo_time)
 
+    // rro was summed up while the halos were updated
+    ops_reduction_wait(red_temp);
+
     fields[0]=0;fields[1]=0;fields[2]=0;fields[3]=0;fields[4]=0;fields[5]=0;fields[6]=0;
     fields[FIELD_P] = 1;
      
@@ -156,6 +162,18 @@ void tea_leaf() {
       }
     }
 
+    // Jacobi and Chebyshev iterations are issued tl_chain_iterations at a time
+    // as a loop chain, ending at the next check of the residual, which is only
+    // read after the chain
+    if (tl_chain_iterations > 1 && chain_last == 0 &&
+        (tl_use_jacobi || (tl_use_chebyshev && ch_switch_check && cheby_calc_steps > 0))) {
+      chain_last = MIN(n + tl_chain_iterations - 1, max_iters);
+      for (int m = n; tl_use_chebyshev && m < chain_last; m++)
+        if ((m >= est_itc) && (m%10 == 0)) chain_last = m;
+      ops_loop_chain_begin(chain_last - n + 1);
+    }
+    check_residual = 0;
+
     if ((tl_use_chebyshev || tl_use_ppcg) && ch_switch_check) {
       // on the first chebyshev steps, find the eigenvalues, coefficients,
       // and expected number of iterations
@@ -251,7 +269,8 @@ void tea_leaf() {
           // chebyshev is typically O(300+)) but will greatly reduce global
           // synchronisations needed
           if ((n >= est_itc) && (n%10 == 0)) {
-            tea_leaf_calc_2norm(1, &error);
+            if (chain_last) check_residual = 1;
+            else tea_leaf_calc_2norm(1, &error);
           }
         }
         
@@ -270,6 +289,7 @@ void tea_leaf() {
      
         // Now compute r.z for alpha
         tea_leaf_ppcg_calc_zrnorm(vector_z, vector_r, tl_preconditioner_type, &rro);
+        ops_reduction_wait(red_temp);
   
         // alpha = z.r / (pw)
         alpha = rro/pw;
@@ -309,6 +329,7 @@ void tea_leaf() {
       // w = Ap
       // pw = p.w
       tea_leaf_cg_calc_w(vector_p, vector_w, vector_Kx,vector_Ky,rx,ry,&pw);
+      ops_reduction_wait(red_temp);
 
       alpha = rro/pw;
       cg_alphas[n] = alpha;
@@ -316,6 +337,7 @@ void tea_leaf() {
       // u = u + a*p
       // r = r - a*w
       tea_leaf_cg_calc_ur(u,vector_p, vector_r, vector_Mi, vector_w, vector_z, tri_cp, tri_bfp, vector_Kx, vector_Ky, rx,ry,alpha, &rrn,tl_preconditioner_type);
+      ops_reduction_wait(red_temp);
 
       beta = rrn/rro;
       cg_betas[n] = beta;
@@ -328,7 +350,7 @@ void tea_leaf() {
     
     // Jacobi iteration
     } else if (tl_use_jacobi) {
-      tea_leaf_jacobi_solve(rx,ry,vector_Kx, vector_Ky, &error, u0, u, vector_r);
+      tea_leaf_jacobi_solve(rx,ry,vector_Kx, vector_Ky, chain_last ? NULL : &error, u0, u, vector_r);
     }
 
     // updates u and possibly p
@@ -336,6 +358,16 @@ void tea_leaf() {
     update_halo(fields,1);
     // if (profiler_on) solve_time = solve_time + (timer()-halo_time)
 
+    if (chain_last == n) {
+      ops_loop_chain_end();
+      chain_last = 0;
+      if (tl_use_chebyshev) {
+        if (check_residual) tea_leaf_calc_2norm(1, &error);
+      } else {
+        tea_leaf_jacobi_error(&error, u, vector_r);
+      }
+    }
+
     if (profiler_on) {
       double t;
       ops_timers_core(&c,&t);
@@ -346,6 +378,9 @@ void tea_leaf() {
       }
     }
 
+    // the residual is only known at the end of a chain
+    if (chain_last) continue;
+
     error=sqrt(fabs(error));
 //		printf("%-10.15E\n",error);
     if (verbose_on) {
@@ -104,6 +104,34 @@ grep "PASSED" tea.out
 rc=$?; if [[ $rc != 0 ]]; then echo "TEST FAILED";exit $rc; fi
 rm -f tea.out
 
+echo '============> Running MPI_Tiled with loop chains'
+#five Jacobi sweeps at a time are issued as a loop chain, for which the halos are
+#deepened and exchanged once, the results have to match the plain MPI run (on a
+#single thread each, for the reductions to be summed in the same order)
+mkdir -p chain; sed 's/ tl_use_jacobi/ tl_use_jacobi\n tl_chain_iterations=5/' tea.in > chain/tea.in; cd chain
+export OMP_NUM_THREADS=1;$MPI_INSTALL_PATH/bin/mpirun -np 2 ../tealeaf_mpi > perf_out
+grep -v "Wall clock\|time per cell\|Wall time" tea.out > tea_ref.out
+$MPI_INSTALL_PATH/bin/mpirun -np 2 ../tealeaf_mpi_tiled OPS_TILING -OPS_DIAGS=4 > perf_out
+grep "MPI halos deepened" perf_out
+grep -m1 "Executing loop chain of 2 loops, 5 repetitions in groups of 5" perf_out
+grep "PASSED" tea.out
+diff <(grep -v "Wall clock\|time per cell\|Wall time" tea.out) tea_ref.out
+rc=$?; if [[ $rc != 0 ]]; then echo "TEST FAILED";exit $rc; fi
+cd ..; rm -rf chain
+
+echo '============> Running MPI with deferred CG reductions'
+#the CG dot products are summed up without waiting, the results have to match
+#reading them with ops_reduction_result
+mkdir -p cg; sed 's/ tl_use_jacobi/ tl_use_cg/' tea.in > cg/tea.in; cd cg
+$MPI_INSTALL_PATH/bin/mpirun -np 2 ../tealeaf_mpi > perf_out
+grep -v "Wall clock\|time per cell\|Wall time" tea.out > tea_deferred.out
+sed -i 's/ tl_use_cg/ tl_use_cg\n tl_blocking_reductions=1/' tea.in
+$MPI_INSTALL_PATH/bin/mpirun -np 2 ../tealeaf_mpi > perf_out
+grep "PASSED" tea.out
+diff <(grep -v "Wall clock\|time per cell\|Wall time\|tl_blocking_reductions" tea.out) tea_deferred.out
+rc=$?; if [[ $rc != 0 ]]; then echo "TEST FAILED";exit $rc; fi
+cd ..; rm -rf cg
+
 
 #echo '============> Running MPI_Inline'
 #export OMP_NUM_THREADS=1;$MPI_INSTALL_PATH/bin/mpirun -np 20 ./tealeaf_mpi_inline > perf_out
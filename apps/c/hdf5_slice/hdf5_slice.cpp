@@ -62,12 +62,12 @@ double h{(xyzRange[1] - xyzRange[0]) / (nx - 1)};
 void copy_double_single(const ops_dat src_double, ops_dat desc_single) {
   ops_block block{src_double->block};
   const int space_dim{block->dims};
-  int* local{new int(space_dim)};
+  int local[OPS_MAX_DIM];
   for (int d = 0; d < space_dim; d++) {
     local[d] = 0;
   }
   ops_stencil local_stencil{ops_decl_stencil(space_dim, 1, local, "local")};
-  int* iter_range{new int(2 * space_dim)};
+  int iter_range[2 * OPS_MAX_DIM];
 #ifdef OPS_MPI
   const sub_dat *sd = OPS_sub_dat_list[src_double->index];
   for (int d = 0; d < space_dim; d++) {
@@ -85,9 +85,6 @@ void copy_double_single(const ops_dat src_double, ops_dat desc_single) {
                ops_arg_dat(src_double, 1, local_stencil, "double", OPS_READ),
                ops_arg_dat(desc_single, 1, local_stencil, "float", OPS_WRITE));
 #endif
-
-  delete local;
-  delete iter_range;
 }
 
 int main(int argc, char *argv[]) {
@@ -191,6 +188,13 @@ int main(int argc, char *argv[]) {
   ops_timers(&ct1, &et1);
   total4 += et1 - et0;
   ops_printf("The time write slab is %f\n", total4);
+  // The same plane and slab through an in-situ output pipeline, written to
+  // the group of step 0 of insitu.h5
+  ops_insitu_hdf5 insitu{ops_decl_insitu_hdf5("insitu.h5", 1, 2)};
+  ops_insitu_add_plane_hdf5(insitu, u, 1, 16, "u");
+  ops_insitu_add_slab_hdf5(insitu, v, range, "vslab");
+  ops_insitu_step_hdf5(insitu, 0);
+  ops_free_insitu_hdf5(insitu);
   ops_fetch_block_hdf5_file(slice3Du, "slice3Du.h5");
   ops_fetch_dat_hdf5_file(u, "slice3Du.h5");
   ops_fetch_dat_hdf5_file(buffer_single, "slice3Du.h5");
@@ -0,0 +1,39 @@
+#!/bin/bash
+set -e
+
+cd $OPS_INSTALL_PATH/c
+source ../../scripts/$SOURCE_INTEL
+make -j -B
+cd $OPS_INSTALL_PATH/../apps/c/hdf5_slice
+
+make clean
+rm -f .generated
+make IEEE=1 -j
+
+
+#============================ Test hdf5_slice with Intel Compilers ==========================================
+# The in-situ pipeline writes the same plane and slab as ops_write_plane_hdf5
+# and ops_write_data_slab_hdf5
+echo '============> Running OpenMP'
+rm -rf *.h5;
+KMP_AFFINITY=compact OMP_NUM_THREADS=20 ./hdf5_slice_openmp
+$HDF5_INSTALL_PATH/bin/h5diff double.h5 insitu.h5 slice3Du/0/u 0/u
+$HDF5_INSTALL_PATH/bin/h5diff slab.h5 insitu.h5 vslab 0/vslab
+rc=$?; if [[ $rc != 0 ]]; then echo "TEST FAILED";exit $rc; else echo "TEST PASSED"; fi
+
+echo '============> Running MPI'
+rm -rf *.h5;
+$MPI_INSTALL_PATH/bin/mpirun -np 4 ./hdf5_slice_mpi
+$HDF5_INSTALL_PATH/bin/h5diff double.h5 insitu.h5 slice3Du/0/u 0/u
+$HDF5_INSTALL_PATH/bin/h5diff slab.h5 insitu.h5 vslab 0/vslab
+rc=$?; if [[ $rc != 0 ]]; then echo "TEST FAILED";exit $rc; else echo "TEST PASSED"; fi
+
+echo '============> Running MPI with asynchronous output'
+rm -rf *.h5;
+$MPI_INSTALL_PATH/bin/mpirun -np 4 ./hdf5_slice_mpi OPS_IO_ASYNC
+$HDF5_INSTALL_PATH/bin/h5diff double.h5 insitu.h5 slice3Du/0/u 0/u
+$HDF5_INSTALL_PATH/bin/h5diff slab.h5 insitu.h5 vslab 0/vslab
+rc=$?; if [[ $rc != 0 ]]; then echo "TEST FAILED";exit $rc; else echo "TEST PASSED"; fi
+
+rm -rf *.h5;
+echo "All Intel complied applications PASSED"
@@ -157,11 +157,18 @@ int main(int argc, char **argv)
     halos4 = ops_decl_halo_group(2,grp);
   }
 
-  int use_demo = 0;
+  int use_demo = 0, use_weights = 0;
   for (int i = 1; i < argc; i++) {
     if (!strcmp(argv[i], "demo")) use_demo = 1;
+    if (!strcmp(argv[i], "weights")) use_weights = 1;
   }
-  if (use_demo) {
+  if (use_weights) {
+    // grid1 costs more per point, so gets more processes
+    double weights[] = {1.0, 2.5};
+    std::map<std::string, void*> opts;
+    opts["block_weights"] = (void*)weights;
+    ops_partition_opts("", opts);
+  } else if (use_demo) {
     int procs[] = {4,2};
     std::map<std::string, void*> opts;
     opts["processes_per_block"] = (void*)&procs[0];
@@ -202,11 +209,26 @@ int main(int argc, char **argv)
   ops_fetch_dat_hdf5_file(data0, "mblocktest0.h5");
   ops_fetch_dat_hdf5_file(data1, "mblocktest1.h5");
 
-  ops_halo_transfer(halos0);
-  ops_halo_transfer(halos1);
-  ops_halo_transfer(halos2);
-  ops_halo_transfer(halos3);
-  ops_halo_transfer(halos4);
+  ops_reduction sum0 = ops_decl_reduction_handle(sizeof(double), "double", "sum0");
+  ops_reduction sum1 = ops_decl_reduction_handle(sizeof(double), "double", "sum1");
+  ops_halo_group halos[] = {halos0, halos1, halos2, halos3, halos4};
+  int full_range[] = {-2,22,-2,22};
+  for (int h = 0; h < 5; h++) {
+    ops_halo_transfer(halos[h]);
+    // checksums independent of the decomposition, compared across runs
+    ops_par_loop(mblock_checksum_kernel, "mblock_checksum_kernel", grid0, 2, full_range,
+                 ops_arg_dat(data0, 1, S2D_00, "double", OPS_READ),
+                 ops_arg_idx(),
+                 ops_arg_reduce(sum0, 1, "double", OPS_INC));
+    ops_par_loop(mblock_checksum_kernel, "mblock_checksum_kernel", grid1, 2, full_range,
+                 ops_arg_dat(data1, 1, S2D_00, "double", OPS_READ),
+                 ops_arg_idx(),
+                 ops_arg_reduce(sum1, 1, "double", OPS_INC));
+    double s0 = 0.0, s1 = 0.0;
+    ops_reduction_result(sum0, &s0);
+    ops_reduction_result(sum1, &s1);
+    ops_printf("halos%d checksum %.0lf %.0lf\n", h, s0, s1);
+  }
   ops_print_dat_to_txtfile(data0, "data0.txt");
   ops_print_dat_to_txtfile(data1, "data1.txt");
 
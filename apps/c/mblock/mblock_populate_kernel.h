@@ -5,5 +5,11 @@ void mblock_populate_kernel(ACC<double> &val, int *idx) {
   val(0,0) = (double)(idx[0]+20*idx[1]);
 }
 
+// sum of the values (halos included) weighted by their position, exact in
+// double precision, so that any misplaced halo point changes the result
+void mblock_checksum_kernel(const ACC<double> &val, int *idx, double *sum) {
+  *sum += val(0,0) * (double)(1 + (idx[0]+2) + 25*(idx[1]+2));
+}
+
 
 #endif //MBLOCK_KERNEL_H
@@ -61,6 +61,28 @@ grep "PASSED" mblock.out
 rc=$?; if [[ $rc != 0 ]]; then echo "TEST FAILED";exit $rc; fi
 rm -f mblock.out *.h5 data*
 
+echo '============> Running MPI with reversed and rotated halos against a single process'
+$MPI_INSTALL_PATH/bin/mpirun -np 1 ./mblock_mpi > mblock.out
+grep "^halos.* checksum" mblock.out > checksum_ref.out
+rm -f mblock.out *.h5 data*
+$MPI_INSTALL_PATH/bin/mpirun -np 6 ./mblock_mpi > mblock.out
+grep "PASSED" mblock.out
+grep "^halos.* checksum" mblock.out | diff - checksum_ref.out
+rc=$?; if [[ $rc != 0 ]]; then echo "TEST FAILED";exit $rc; fi
+rm -f mblock.out *.h5 data*
+
+echo '============> Running MPI with weighted blocks against a single process'
+for np in 3 5; do
+  $MPI_INSTALL_PATH/bin/mpirun -np $np ./mblock_mpi weights > mblock.out
+  grep "PASSED" mblock.out
+  #all processes are used, most of them on grid1
+  grep "\"grid1\" decomposed on to a processor grid of 1 x $((np/2+1))" mblock.out
+  grep "^halos.* checksum" mblock.out | diff - checksum_ref.out
+  rc=$?; if [[ $rc != 0 ]]; then echo "TEST FAILED";exit $rc; fi
+  rm -f mblock.out *.h5 data*
+done
+rm -f checksum_ref.out
+
 #echo '============> Running MPI_Tiled'
 #export OMP_NUM_THREADS=10;$MPI_INSTALL_PATH/bin/mpirun -np 2 numawrap2 ./mblock_mpi_tiled OPS_TILING OPS_TILING_MAXDEPTH=6 > mblock.out
 #grep "Total Wall time" mblock.out
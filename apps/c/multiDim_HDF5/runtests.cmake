@@ -22,4 +22,8 @@ execute_process(COMMAND "${H5D}" write_data_seq.h5 read_data.h5 OUTPUT_FILE diff
 if(RES)
     message(FATAL_ERROR "h5diff fails when comparing with sequential data")
 endif()
-FILE(REMOVE write_data.h5 read_data.h5 write_data_seq.h5)
+execute_process(COMMAND "${H5D}" write_data.h5 write_session.h5 OUTPUT_FILE diff.out RESULT_VARIABLE RES)
+if(RES)
+    message(FATAL_ERROR "h5diff fails when comparing with the output session")
+endif()
+FILE(REMOVE write_data.h5 read_data.h5 write_data_seq.h5 write_session.h5)
@@ -63,6 +63,26 @@ KMP_AFFINITY=compact OMP_NUM_THREADS=20 ./read_openmp
 $HDF5_INSTALL_PATH/bin/h5diff write_data.h5 read_data.h5
 rc=$?; if [[ $rc != 0 ]]; then echo "TEST FAILED";exit $rc; else echo "TEST PASSED"; fi
 
+echo '============> Running OpenMP with compressed output'
+rm -rf write_data.h5 read_data.h5 write_data_ref.h5;
+KMP_AFFINITY=compact OMP_NUM_THREADS=20 ./write_openmp
+mv write_data.h5 write_data_ref.h5
+for opts in "OPS_HDF5_DEFLATE" "OPS_HDF5_SHUFFLE OPS_HDF5_DEFLATE=4" "OPS_HDF5_LOSSY=3"; do
+  echo "============> Running OpenMP with $opts"
+  rm -rf write_data.h5 read_data.h5;
+  KMP_AFFINITY=compact OMP_NUM_THREADS=20 ./write_openmp $opts
+  KMP_AFFINITY=compact OMP_NUM_THREADS=20 ./read_openmp
+  $HDF5_INSTALL_PATH/bin/h5diff write_data.h5 read_data.h5
+  #only the lossy filter may change the values, by at most 0.5e-3
+  if [[ $opts == OPS_HDF5_LOSSY=3 ]]; then
+    $HDF5_INSTALL_PATH/bin/h5diff -d 0.5e-3 write_data_ref.h5 write_data.h5
+  else
+    $HDF5_INSTALL_PATH/bin/h5diff write_data_ref.h5 write_data.h5
+  fi
+  rc=$?; if [[ $rc != 0 ]]; then echo "TEST FAILED";exit $rc; else echo "TEST PASSED"; fi
+done
+rm -f write_data_ref.h5
+
 echo '============> Running MPI+OpenMP'
 rm -rf write_data.h5 read_data.h5;
 export OMP_NUM_THREADS=2;$MPI_INSTALL_PATH/bin/mpirun -np 10 ./write_mpi_openmp
@@ -85,6 +105,35 @@ $MPI_INSTALL_PATH/bin/mpirun -np 20 ./read_mpi
 $HDF5_INSTALL_PATH/bin/h5diff write_data.h5 read_data.h5
 rc=$?; if [[ $rc != 0 ]]; then echo "TEST FAILED";exit $rc; else echo "TEST PASSED"; fi
 
+echo '============> Running MPI and OpenMP with SoA against AoS'
+make -f Makefile.write IEEE=1 write_dev_mpi_aos
+rm -rf write_data.h5 write_data_aos.h5;
+$MPI_INSTALL_PATH/bin/mpirun -np 4 ./write_dev_mpi_aos
+mv write_data.h5 write_data_aos.h5
+$MPI_INSTALL_PATH/bin/mpirun -np 4 ./write_mpi
+$HDF5_INSTALL_PATH/bin/h5diff write_data_aos.h5 write_data.h5
+rm -f write_data.h5
+KMP_AFFINITY=compact OMP_NUM_THREADS=20 ./write_openmp
+$HDF5_INSTALL_PATH/bin/h5diff write_data_aos.h5 write_data.h5
+rc=$?; if [[ $rc != 0 ]]; then echo "TEST FAILED";exit $rc; else echo "TEST PASSED"; fi
+rm -f write_data_aos.h5
+
+echo '============> Running MPI with an output session'
+rm -rf write_data.h5 write_session.h5;
+$MPI_INSTALL_PATH/bin/mpirun -np 20 ./write_mpi
+$HDF5_INSTALL_PATH/bin/h5diff write_data.h5 write_session.h5
+rc=$?; if [[ $rc != 0 ]]; then echo "TEST FAILED";exit $rc; else echo "TEST PASSED"; fi
+rm -f write_session.h5
+
+echo '============> Running MPI with asynchronous output'
+rm -rf write_data.h5 write_data_sync.h5;
+$MPI_INSTALL_PATH/bin/mpirun -np 20 ./write_mpi
+mv write_data.h5 write_data_sync.h5
+$MPI_INSTALL_PATH/bin/mpirun -np 20 ./write_mpi OPS_IO_ASYNC
+$HDF5_INSTALL_PATH/bin/h5diff write_data_sync.h5 write_data.h5
+rc=$?; if [[ $rc != 0 ]]; then echo "TEST FAILED";exit $rc; else echo "TEST PASSED"; fi
+rm -f write_data_sync.h5
+
 
 echo '============> Running CUDA'
 rm -rf write_data.h5 read_data.h5;
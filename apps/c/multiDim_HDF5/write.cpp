@@ -35,7 +35,10 @@
   */
 
 #define OPS_3D
+// built with -DOPS_AOS to write the reference for the SoA layout
+#ifndef OPS_AOS
 #define OPS_SOA
+#endif
 #include "ops_seq_v2.h"
 
 #include <math.h>
@@ -127,6 +130,20 @@ int main(int argc, char **argv) {
   const char *my_text = "fourty-two";
   ops_write_const_hdf5("my_text", 11, "char", (char*)my_text, "write_data.h5");
 
+  // The same file written through an output session
+  ops_fetch_block_hdf5_file(grid0, "write_session.h5");
+  ops_hdf5_session session = ops_hdf5_session_open("write_session.h5");
+  ops_hdf5_session_add_dat(session, multi);
+  ops_hdf5_session_add_dat(session, single);
+  ops_hdf5_session_add_dat(session, integ);
+  ops_hdf5_session_add_dat(session, dat_char);
+  ops_hdf5_session_add_dat(session, dat_short);
+  ops_hdf5_session_add_dat(session, dat_long);
+  ops_hdf5_session_add_dat(session, dat_ll);
+  ops_hdf5_session_add_const(session, "my_const", 1, "int", (char*)&my_const);
+  ops_hdf5_session_add_const(session, "my_text", 11, "char", (char*)my_text);
+  ops_hdf5_session_close(session);
+
 
   ops_print_dat_to_txtfile(integ, "integers.txt");
 
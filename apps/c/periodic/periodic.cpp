@@ -0,0 +1,140 @@
+/*
+* Open source copyright declaration based on BSD open source template:
+* http://www.opensource.org/licenses/bsd-license.php
+*
+* This file is part of the OPS distribution.
+*
+* Copyright (c) 2013, Mike Giles and others. Please see the AUTHORS file in
+* the main source directory for a full list of copyright holders.
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * The name of Mike Giles may not be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY Mike Giles ''AS IS'' AND ANY
+* EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Mike Giles BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/** @Test application for periodic blocks
+  * @details A 9-point average on a doubly periodic block, starting from a
+  *          cos(kx*x)*cos(ky*y) mode which the average only scales, so the
+  *          result is known exactly wherever the halos wrap around correctly
+  */
+
+// standard headers
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+double kx, ky;
+
+// OPS header file
+#define OPS_2D
+#include "ops_seq_v2.h"
+
+#include "periodic_kernels.h"
+
+int main(int argc, char **argv)
+{
+  //initialize sizes using global values
+  int x_cells = 40;
+  int y_cells = 30;
+  int n_iter = 20;
+
+  /**-------------------------- Initialisation --------------------------**/
+
+  // OPS initialisation
+  ops_init(argc,argv,1);
+
+  kx = 2.0*M_PI/x_cells;
+  ky = 2.0*M_PI/y_cells;
+  ops_decl_const("kx",1,"double",&kx);
+  ops_decl_const("ky",1,"double",&ky);
+
+  /**----------------------------OPS Declarations----------------------------**/
+
+  //declare block, periodic in both dimensions
+  ops_block grid2D = ops_decl_block(2, "grid2D");
+  int periodic[2] = {1,1};
+  ops_block_set_periodic(grid2D, periodic);
+
+  //declare stencils
+  int s2D_00[]         = {0,0};
+  int s2D_9pt[]        = {0,0, 1,0, -1,0, 0,1, 0,-1, 1,1, -1,1, 1,-1, -1,-1};
+  ops_stencil S2D_00 = ops_decl_stencil( 2, 1, s2D_00, "00");
+  ops_stencil S2D_9pt = ops_decl_stencil( 2, 9, s2D_9pt, "9pt");
+
+  //declare data on blocks
+  int d_p[2] = {1,1}; //max halo depths for the dat in the possitive direction
+  int d_m[2] = {-1,-1}; //max halo depths for the dat in the negative direction
+  int size[2] = {x_cells, y_cells}; //size of the dat
+  int base[2] = {0,0};
+  double* temp = NULL;
+
+  ops_dat u    = ops_decl_dat(grid2D, 1, size, base, d_m, d_p, temp, "double", "u");
+  ops_dat u2   = ops_decl_dat(grid2D, 1, size, base, d_m, d_p, temp, "double", "u2");
+
+  //declare reduction handles
+  double err = 0.0;
+  ops_reduction red_err = ops_decl_reduction_handle(sizeof(double), "double", "err");
+
+  //decompose the block
+  ops_partition("2D_BLOCK_DECOMPSE");
+
+  double ct0, ct1, et0, et1;
+  ops_timers(&ct0, &et0);
+
+  int iter_range[] = {0,x_cells,0,y_cells};
+  ops_par_loop(periodic_init_kernel, "periodic_init_kernel", grid2D, 2, iter_range,
+               ops_arg_dat(u, 1, S2D_00, "double", OPS_WRITE),
+               ops_arg_idx());
+
+  for (int iter = 0; iter < n_iter; iter++) {
+    ops_par_loop(periodic_average_kernel, "periodic_average_kernel", grid2D, 2, iter_range,
+                 ops_arg_dat(u, 1, S2D_9pt, "double", OPS_READ),
+                 ops_arg_dat(u2, 1, S2D_00, "double", OPS_WRITE));
+    ops_par_loop(periodic_copy_kernel, "periodic_copy_kernel", grid2D, 2, iter_range,
+                 ops_arg_dat(u2, 1, S2D_00, "double", OPS_READ),
+                 ops_arg_dat(u, 1, S2D_00, "double", OPS_WRITE));
+  }
+
+  //the mode is scaled by the same factor at every step
+  double factor = pow((1.0 + 2.0*cos(kx))*(1.0 + 2.0*cos(ky))/9.0, n_iter);
+  ops_par_loop(periodic_error_kernel, "periodic_error_kernel", grid2D, 2, iter_range,
+               ops_arg_dat(u, 1, S2D_00, "double", OPS_READ),
+               ops_arg_gbl(&factor, 1, "double", OPS_READ),
+               ops_arg_idx(),
+               ops_arg_reduce(red_err, 1, "double", OPS_MAX));
+
+  ops_reduction_result(red_err, &err);
+
+  ops_timers(&ct1, &et1);
+
+  ops_printf("\nTotal Wall time %lf\n",et1-et0);
+  ops_printf("Maximum error = %3.15E\n", err);
+
+  if(err < 1e-13) {
+    ops_printf("This run is considered PASSED\n");
+  }
+  else {
+    ops_printf("This test is considered FAILED\n");
+  }
+
+  ops_exit();
+}
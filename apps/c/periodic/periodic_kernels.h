@@ -0,0 +1,22 @@
+#ifndef PERIODIC_KERNELS_H
+#define PERIODIC_KERNELS_H
+
+void periodic_init_kernel(ACC<double> &u, int *idx) {
+  u(0,0) = cos(kx*idx[0])*cos(ky*idx[1]);
+}
+
+void periodic_average_kernel(const ACC<double> &u, ACC<double> &u2) {
+  u2(0,0) = (u(0,0) + u(1,0) + u(-1,0) + u(0,1) + u(0,-1) +
+             u(1,1) + u(-1,1) + u(1,-1) + u(-1,-1))/9.0;
+}
+
+void periodic_copy_kernel(const ACC<double> &u2, ACC<double> &u) {
+  u(0,0) = u2(0,0);
+}
+
+void periodic_error_kernel(const ACC<double> &u, const double *factor, int *idx, double *err) {
+  double diff = fabs(u(0,0) - factor[0]*cos(kx*idx[0])*cos(ky*idx[1]));
+  if (diff > err[0]) err[0] = diff;
+}
+
+#endif //PERIODIC_KERNELS_H
@@ -0,0 +1,47 @@
+#!/bin/bash
+set -e
+cd $OPS_INSTALL_PATH/c
+source ../../scripts/$SOURCE_INTEL
+make -j
+cd $OPS_INSTALL_PATH/../apps/c/periodic/
+
+make clean
+rm -f .generated
+make IEEE=1 -j
+
+
+#============================ Test periodic with Intel Compilers ==========================================
+# Periodic blocks need MPI, on one process the halos are filled by local copies
+echo '============> Running MPI on one process'
+$MPI_INSTALL_PATH/bin/mpirun -np 1 ./periodic_mpi > perf_out
+grep "Maximum error" perf_out
+grep "Total Wall time" perf_out
+grep "PASSED" perf_out
+rc=$?; if [[ $rc != 0 ]]; then echo "TEST FAILED";exit $rc; fi
+rm perf_out
+
+echo '============> Running MPI'
+$MPI_INSTALL_PATH/bin/mpirun -np 6 ./periodic_mpi > perf_out
+grep "Maximum error" perf_out
+grep "Total Wall time" perf_out
+grep "PASSED" perf_out
+rc=$?; if [[ $rc != 0 ]]; then echo "TEST FAILED";exit $rc; fi
+rm perf_out
+
+echo '============> Running DEV_MPI'
+$MPI_INSTALL_PATH/bin/mpirun -np 6 ./periodic_dev_mpi > perf_out
+grep "Maximum error" perf_out
+grep "Total Wall time" perf_out
+grep "PASSED" perf_out
+rc=$?; if [[ $rc != 0 ]]; then echo "TEST FAILED";exit $rc; fi
+rm perf_out
+
+echo '============> Running MPI+OpenMP'
+export OMP_NUM_THREADS=2;$MPI_INSTALL_PATH/bin/mpirun -np 4 ./periodic_mpi_openmp > perf_out
+grep "Maximum error" perf_out
+grep "Total Wall time" perf_out
+grep "PASSED" perf_out
+rc=$?; if [[ $rc != 0 ]]; then echo "TEST FAILED";exit $rc; fi
+rm perf_out
+
+echo "All Intel complied applications PASSED"
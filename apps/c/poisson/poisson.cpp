@@ -68,6 +68,9 @@ int main(int argc, char **argv)
   int n_iter = 10;
   int itertile = n_iter;
   int non_copy = 0;
+  int dump = 0;
+  int repartition = 0;
+  int imbalance = 0;
 
   const char* pch;
   for ( int n = 1; n < argc; n++ ) {
@@ -79,6 +82,14 @@ int main(int argc, char **argv)
     if(pch != NULL) {
       logical_size_y = atoi ( argv[n] + 7 ); continue;
     }
+    pch = strstr(argv[n], "-ngridx=");
+    if(pch != NULL) {
+      ngrid_x = atoi ( argv[n] + 8 ); continue;
+    }
+    pch = strstr(argv[n], "-ngridy=");
+    if(pch != NULL) {
+      ngrid_y = atoi ( argv[n] + 8 ); continue;
+    }
     pch = strstr(argv[n], "-iters=");
     if(pch != NULL) {
       n_iter = atoi ( argv[n] + 7 ); continue;
@@ -91,6 +102,18 @@ int main(int argc, char **argv)
     if(pch != NULL) {
       non_copy = 1; continue;
     }
+    pch = strstr(argv[n], "-dump");
+    if(pch != NULL) {
+      dump = 1; continue;
+    }
+    pch = strstr(argv[n], "-repartition");
+    if(pch != NULL) {
+      repartition = 1; continue;
+    }
+    pch = strstr(argv[n], "-imbalance=");
+    if(pch != NULL) {
+      imbalance = atoi ( argv[n] + 11 ); continue;
+    }
   }
 
   ops_printf("Grid: %dx%d in %dx%d blocks, %d iterations, %d tile height\n",logical_size_x,logical_size_y,ngrid_x,ngrid_y,n_iter,itertile);
@@ -236,12 +259,17 @@ int main(int argc, char **argv)
     }
   }
 
+  //print the initial guess while the loops above may still be held back
+  if (dump) ops_print_dat_to_txtfile(u[0], "poisson_init.dat");
+
   double it0, it1;
   ops_timers(&ct0, &it0);
 
   for (int iter = 0; iter < n_iter; iter++) {
     if (ngrid_x>1 || ngrid_y>1) ops_halo_transfer(u_halos);
     if (iter%itertile == 0) ops_execute(blocks[0]->instance);
+    //rebalance halfway through, from the kernel timings so far
+    if (repartition && iter == n_iter/2) ops_repartition();
 
 
     for (int j = 0; j < ngrid_y; j++) {
@@ -273,6 +301,14 @@ int main(int argc, char **argv)
 							ops_arg_dat(u[i+ngrid_x*j] , 1, S2D_00, "double", OPS_WRITE));
 				}
 			}
+			//repeat the copy on the left half of the first block, loading the
+			//processes there more without changing the results
+			for (int k = 0; k < imbalance; k++) {
+				int iter_range[] = {0,sizes[0]/2,0,sizes[1]};
+				ops_par_loop(poisson_kernel_update, "poisson_kernel_update", blocks[0], 2, iter_range,
+						ops_arg_dat(u2[0], 1, S2D_00, "double", OPS_READ),
+						ops_arg_dat(u[0] , 1, S2D_00, "double", OPS_WRITE));
+			}
 		}
 //    if (iter == 5) u[0] = ops_dat_copy(u[0]); //TESTING
   }
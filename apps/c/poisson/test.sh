@@ -99,6 +99,35 @@ grep "PASSED" perf_out
 rc=$?; if [[ $rc != 0 ]]; then echo "TEST FAILED";exit $rc; fi
 rm perf_out
 
+#each set of runtime options has to reproduce the error of the plain run on a larger grid,
+#-imbalance only loads the processes on the left more, for ops_repartition to correct
+args="-sizex=400 -sizey=400 -iters=40 -dump"
+export OMP_NUM_THREADS=5;$MPI_INSTALL_PATH/bin/mpirun -np 4 ./poisson_mpi_tiled $args > perf_out_ref
+cat poisson_init.dat.* > poisson_init_ref.dat; rm -f poisson_init.dat.*
+for opts in "OPS_COMM_THREAD" "OPS_HALO_DEEP=4" "OPS_HALO_DEEP=4 OPS_TILING_MAXDEPTH=2" "OPS_FUSION" \
+            "-repartition -imbalance=50 -OPS_DIAGS=2" "OPS_TILING_AUTOTUNE -itert=1 -OPS_DIAGS=3" \
+            "OPS_HALO_SHARED -OPS_DIAGS=2" "OPS_HALO_SHARED OPS_HALO_OVERLAP" \
+            "OPS_PARTITION_TOPOLOGY=2 -OPS_DIAGS=2" "OPS_PARTITION_TOPOLOGY=3"; do
+  echo "============> Running MPI_Tiled with $opts"
+  $MPI_INSTALL_PATH/bin/mpirun -np 4 ./poisson_mpi_tiled $args $opts > perf_out
+  cat poisson_init.dat.* > poisson_init_opts.dat; rm -f poisson_init.dat.*
+  grep "Total error:" perf_out
+  grep "Total Wall time" perf_out
+  if [[ $opts == -repartition* ]]; then grep "repartitioned" perf_out; fi
+  if [[ $opts == OPS_TILING_AUTOTUNE* ]]; then grep "Tuned tile size" perf_out; fi
+  #nodes of 2 processes reorder the 2x2 grid, nodes of 3 and 1 cannot be used
+  if [[ $opts == OPS_PARTITION_TOPOLOGY=2* ]]; then grep "nodes arranged as" perf_out; grep "processes on its grid" perf_out; fi
+  if [[ $opts == OPS_PARTITION_TOPOLOGY=3 ]]; then grep "cannot be split evenly" perf_out; fi
+  if [[ $opts == "OPS_HALO_SHARED -OPS_DIAGS=2" ]]; then grep ": [1-9][0-9]* halos copied between processes on the same node" perf_out; fi
+  #the reduction of the error may be summed up in a different order across processes
+  paste <(grep "Total error:" perf_out) <(grep "Total error:" perf_out_ref) | awk '{d = $3 - $6; if (d*d > 1e-24*$6*$6) bad = 1} END {exit bad || NR != 1}'
+  #loops held back for fusion have to be executed before the initial guess is printed
+  if [[ $opts == OPS_FUSION ]]; then diff poisson_init_opts.dat poisson_init_ref.dat; fi
+  rc=$?; if [[ $rc != 0 ]]; then echo "TEST FAILED";exit $rc; fi
+  rm perf_out poisson_init_opts.dat
+done
+rm perf_out_ref poisson_init_ref.dat
+
 echo '============> Running CUDA'
 ./poisson_cuda OPS_BLOCK_SIZE_X=64 OPS_BLOCK_SIZE_Y=4 > perf_out
 grep "Total error:" perf_out
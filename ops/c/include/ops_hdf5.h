@@ -170,6 +170,20 @@ OPS_FTN_INTEROP
 void ops_read_dat_hdf5(ops_dat dat);
 #endif /* DOXYGEN_SHOULD_SKIP_THIS*/
 
+/**
+ * Wait for the writes of ::ops_dat started by ops_fetch_dat_hdf5_file(),
+ * ops_hdf5_session_close(), ops_insitu_step_hdf5() and ops_dump_to_hdf5() to
+ * complete.
+ *
+ * With the `OPS_IO_ASYNC` runtime flag these only take a snapshot of the data
+ * and return, the file is written in the background. Other HDF5 routines,
+ * ops_free_dat() and ops_exit() wait for them on their own, this is needed
+ * before the files are used by anything else. A failed write is thrown by the
+ * routine that waits for it, ops_exit() only reports it.
+ */
+OPS_FTN_INTEROP
+void ops_io_wait();
+
 /**
  * Write all state (blocks, datasets, stencils) to a named HDF5 file.
  *
@@ -183,6 +197,125 @@ void ops_write_const_hdf5(char const *name, int dim, char const *type,
 void ops_get_const_hdf5(char const *name, int dim, char const *type,
                         char *const_data, char const *file_name);
 
+/** Handle of an HDF5 output session, see ops_hdf5_session_open() */
+typedef struct ops_hdf5_session_core *ops_hdf5_session;
+
+/**
+ * Open an output session on a named HDF5 file.
+ *
+ * The datasets and constants added to the session are all written by
+ * ops_hdf5_session_close(), which opens the file only once and issues the
+ * dataset writes together instead of one ops_fetch_dat_hdf5_file() per dat.
+ * Over MPI every process has to add the same dats and constants, in the same
+ * order.
+ *
+ * @param file_name  HDF5 file to write to, created if it does not exist
+ * @return
+ */
+ops_hdf5_session ops_hdf5_session_open(char const *file_name);
+
+/**
+ * Add an ::ops_dat to an output session, it is written with the values it
+ * holds when the session is closed.
+ *
+ * As for ops_fetch_dat_hdf5_file(), the ::ops_block of the dat has to be in
+ * the file already.
+ *
+ * @param session  the output session
+ * @param dat      ::ops_dat to be written
+ */
+void ops_hdf5_session_add_dat(ops_hdf5_session session, ops_dat dat);
+
+/**
+ * Add a constant to an output session, its value is copied when it is added.
+ *
+ * @param session     the output session
+ * @param name        name of the constant in the file
+ * @param dim         number of values
+ * @param type        the name of the type of the values (e.g. "double")
+ * @param const_data  pointer to the values
+ */
+void ops_hdf5_session_add_const(ops_hdf5_session session, char const *name,
+                                int dim, char const *type, char *const_data);
+
+/**
+ * Write everything added to an output session to its file and release the
+ * session.
+ *
+ * With HDF5 1.14 or later all datasets are written by a single (collective)
+ * multi-dataset write. With the `OPS_IO_ASYNC` runtime flag this takes a
+ * snapshot of the dats and the file is written in the background, see
+ * ops_io_wait().
+ *
+ * @param session  the output session
+ */
+void ops_hdf5_session_close(ops_hdf5_session session);
+
+/** Handle of an in-situ output pipeline, see ops_decl_insitu_hdf5() */
+typedef struct ops_insitu_hdf5_core *ops_insitu_hdf5;
+
+/**
+ * Declare an in-situ output pipeline writing planes and slabs of ::ops_dat
+ * to a named HDF5 file every few steps.
+ *
+ * The planes and slabs are added once, their ranges and the buffers they are
+ * copied into are set up then. At each step the pipeline is triggered on,
+ * ops_insitu_step_hdf5() copies them into one of `depth` buffer slots and
+ * writes them to the group named after the step. With the `OPS_IO_ASYNC`
+ * runtime flag the write is done in the background and the copy only waits
+ * when all slots are still being written. Over MPI every process has to
+ * declare the same pipelines and add the same planes and slabs, in the same
+ * order.
+ *
+ * @param file_name  HDF5 file to write to, created if it does not exist
+ * @param frequency  number of steps between two outputs
+ * @param depth      number of buffer slots
+ * @return
+ */
+ops_insitu_hdf5 ops_decl_insitu_hdf5(char const *file_name, int frequency,
+                                     int depth);
+
+/**
+ * Add a plane of an ::ops_dat to an in-situ output pipeline.
+ *
+ * @param insitu             the in-situ output pipeline
+ * @param dat                ::ops_dat holding the plane
+ * @param cross_section_dir  the plane direction (0:I, 1:J and 2:K)
+ * @param pos                the plane position (e.g., 16 for I=16)
+ * @param data_name          name of the dataset in the group of each step
+ */
+void ops_insitu_add_plane_hdf5(ops_insitu_hdf5 insitu, ops_dat dat,
+                               int cross_section_dir, int pos,
+                               char const *data_name);
+
+/**
+ * Add a hyperslab of an ::ops_dat to an in-situ output pipeline.
+ *
+ * @param insitu     the in-situ output pipeline
+ * @param dat        ::ops_dat holding the slab
+ * @param range      the range of the slab, as for ops_write_data_slab_hdf5()
+ * @param data_name  name of the dataset in the group of each step
+ */
+void ops_insitu_add_slab_hdf5(ops_insitu_hdf5 insitu, ops_dat dat,
+                              const int *range, char const *data_name);
+
+/**
+ * Trigger an in-situ output pipeline, its planes and slabs are written if
+ * step is a multiple of its frequency.
+ *
+ * @param insitu  the in-situ output pipeline
+ * @param step    the current step
+ */
+void ops_insitu_step_hdf5(ops_insitu_hdf5 insitu, int step);
+
+/**
+ * Wait for the outputs of an in-situ output pipeline to be written and
+ * release it.
+ *
+ * @param insitu  the in-situ output pipeline
+ */
+void ops_free_insitu_hdf5(ops_insitu_hdf5 insitu);
+
 /**
  * Write a hyperslab of ops_dat to HDF5 file. If the data_name follows the HDF5
  * convention (say block/time/data), data will be created under groups block and time.
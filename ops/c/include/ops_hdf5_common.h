@@ -40,6 +40,9 @@
 #define __OPS_HDF5_COMMON_H
 #include "hdf5.h"
 #include "hdf5_hl.h"
+#include<condition_variable>
+#include<functional>
+#include<mutex>
 #include<string>
 #include<vector>
 #include "ops_exceptions.h"
@@ -52,6 +55,67 @@ hid_t h5_type(const char *type);
 void split_h5_name(const char *data_name,
                    std::vector<std::string> &h5_name_list);
 
+bool ops_hdf5_dat_in_place(const ops_dat dat);
+
+hid_t ops_hdf5_dat_memspace(const ops_dat dat, const hsize_t *disp,
+                            const hsize_t *size);
+
+hid_t ops_hdf5_dat_dcpl(const ops_dat dat, const hsize_t *size,
+                        const int *parts);
+
+void ops_io_submit(OPS_instance *instance, std::function<void()> task);
+
+// a constant registered with an output session, its value is copied
+struct ops_hdf5_session_const {
+  std::string name;
+  int dim;
+  std::string type;
+  std::vector<char> data;
+};
+
+struct ops_hdf5_session_core {
+  std::string file_name;
+  std::vector<ops_dat> dats;
+  std::vector<ops_hdf5_session_const> consts;
+};
+
+// a plane or slab of an in-situ output pipeline, sizes are in file order
+struct ops_insitu_hdf5_item {
+  ops_dat dat;
+  std::string name;
+  int dims;                          // of the dataset, one less for planes
+  int local_range[2 * OPS_MAX_DIM];  // copied by each process
+  hsize_t size[OPS_MAX_DIM];         // of the dataset
+  hsize_t local_size[OPS_MAX_DIM];   // part of this process
+  hsize_t disp[OPS_MAX_DIM];         // and its place in the dataset
+  size_t offset, bytes;              // in a buffer slot
+};
+
+struct ops_insitu_hdf5_core {
+  std::string file_name;
+  int frequency;
+  int depth;
+  std::vector<ops_insitu_hdf5_item> items;
+  std::vector<char *> slots; // allocated when first triggered
+  size_t slot_bytes;
+  long captured, written;
+  std::mutex mutex;
+  std::condition_variable cond;
+};
+
+void ops_insitu_hdf5_add(ops_insitu_hdf5 insitu, ops_dat dat,
+                         char const *data_name, int cross_section_dir,
+                         const int *range, const int *local_range,
+                         const int *local_disp);
+
+char *ops_insitu_hdf5_slot(ops_insitu_hdf5 insitu);
+
+void ops_insitu_hdf5_write(ops_insitu_hdf5 insitu, hid_t file_id,
+                           hid_t xfer_plist, int step, const char *slot);
+
+void ops_insitu_hdf5_submit(ops_insitu_hdf5 insitu,
+                            std::function<void()> write);
+
 void H5_dataset_space(const hid_t file_id, const int data_dims,
                       const hsize_t *global_data_size,
                       const std::vector<std::string> &h5_name_list,
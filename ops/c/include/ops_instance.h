@@ -273,6 +273,24 @@ class OPS_instance {
  */
     void partition(const char *routine);
 	void partition(const char *routine, std::map<std::string, void*>& opts);
+
+/**
+ * Rebalances the partitioning using the measured kernel timings and migrates
+ * the datasets (see ops_repartition()).
+ */
+    void repartition();
+
+/**
+ * Marks the start of a chain of loops that is repeated @p repeats times,
+ * so that its loops are tiled as one batch (see ops_loop_chain_begin()).
+ *
+ * @param repeats  number of times the loops of the chain are issued
+ */
+    void loop_chain_begin(int repeats);
+/**
+ * Marks the end of a chain of loops started with loop_chain_begin().
+ */
+    void loop_chain_end();
 // #endif
 
 	/*******************************************************************************
@@ -303,6 +321,15 @@ class OPS_instance {
 	ops_checkpoint_types *OPS_dat_status;
 	int OPS_ranks_per_node;
 
+	// HDF5 output
+	int ops_io_async;
+	int ops_hdf5_chunk_size; // -1: one chunk per process, 0: contiguous
+	int ops_hdf5_deflate;
+	int ops_hdf5_shuffle;
+	int ops_hdf5_lz4;
+	int ops_hdf5_lossy; // decimal digits kept, -1: lossless
+	int ops_hdf5_aggregators; // MPI-IO writer processes, 0: MPI-IO default
+
 	//SEQ execution
 	int arg_idx[OPS_MAX_DIM];
 
@@ -319,8 +346,22 @@ class OPS_instance {
 	//Tiling
 	int ops_enable_tiling;
 	int ops_cache_size;
+	int ops_l2_cache_size;
+	int ops_tiling_l2;
 	int ops_tiling_mpidepth;
+	int ops_tiling_threaded;
+	int ops_tiling_plans_max;
+	int ops_tiling_autotune;
+	int ops_fusion;
+	std::string ops_tiling_autotune_file;
+	long ops_tiling_plan_hits, ops_tiling_plan_misses, ops_tiling_plan_evictions;
 	double ops_tiled_halo_exchange_time;
+	int ops_halo_overlap;
+	int ops_halo_aggregate;
+	int ops_halo_plans;
+	int ops_halo_shared;
+	int ops_comm_thread;
+	int ops_halo_deep;
 	OPS_instance_tiling *tiling_instance;
 	OPS_instance_checkpointing *checkpointing_instance;
   	int tilesize_x, tilesize_y, tilesize_z;
@@ -330,6 +371,9 @@ class OPS_instance {
 	std::vector<int> ops_force_decomp_y;
 	std::vector<int> ops_force_decomp_z;
 	std::vector<int> processes_per_block;
+	std::vector<double> ops_block_weights;
+	int ops_partition_weighted;
+	int ops_partition_topology;
 	int OPS_realloc;
 	int OPS_soa;
 	int OPS_diags;
@@ -99,6 +99,8 @@ template <typename T> void ops_decl_const2(char const *, int, char const *, T *)
 void ops_decl_const_char(OPS_instance *, int, char const *, int, char *, char const *);
 OPS_FTN_INTEROP
 void ops_reduction_result_char(ops_reduction_core *handle, int type_size, char *ptr);
+OPS_FTN_INTEROP
+void ops_reduction_result_deferred_char(ops_reduction_core *handle, int type_size, char *ptr);
 /*
 * run-time type-checking routines
 */
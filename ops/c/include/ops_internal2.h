@@ -170,6 +170,9 @@ typedef struct {
 ops_reduction ops_decl_reduction_handle_core(OPS_instance *instance, int size, const char *type,
                                              const char *name);
 void ops_execute_reduction(ops_reduction handle);
+void ops_reduction_defer(ops_reduction handle, char *ptr);
+void ops_reductions_start(OPS_instance *instance);
+void ops_reduction_wait(ops_reduction handle);
 
 ops_arg ops_arg_reduce_core(ops_reduction handle, int dim, const char *type,
                             ops_access acc);
@@ -177,7 +180,16 @@ ops_arg ops_arg_reduce_core(ops_reduction handle, int dim, const char *type,
 void ops_init_core(OPS_instance *instance, const int argc, const char *const argv[], const int diags_level);
 
 void ops_exit_lazy(OPS_instance *instance);
+void ops_tiling_plans_free(OPS_instance *instance);
 void ops_exit_core(OPS_instance *instance);
+// Set by the HDF5 library when writing asynchronously (OPS_IO_ASYNC): waits
+// for the pending writes and stops the I/O thread, called on exit
+extern void (*ops_io_stop_dynamic)();
+// Set along with ops_io_stop_dynamic: waits for the pending writes
+extern void (*ops_io_wait_dynamic)();
+// Set by the MPI backend: whether MPI provides MPI_THREAD_MULTIPLE, which the
+// communication and I/O threads need to make MPI calls
+extern int (*ops_thread_multiple_dynamic)();
 
 
 
@@ -239,6 +251,12 @@ void ops_set_halo_dirtybit3(ops_arg *arg, int *iter_range);
 OPS_FTN_INTEROP
 void ops_halo_exchanges(ops_arg *args, int nargs, int *range);
 void ops_halo_exchanges_datlist(ops_dat *dats, int ndats, int *depths);
+int ops_halo_exchanges_begin(ops_arg *args, int nargs, int *range,
+                             int *halo_depths);
+void ops_halo_exchanges_end(ops_arg *args, int nargs, int *range);
+// Makes the MPI halos of all datasets at least depth deep where possible
+// (collective), returns the depth of the halos
+int ops_halo_deepen(OPS_instance *instance, int depth);
 
 OPS_FTN_INTEROP
 void ops_set_dirtybit_device(ops_arg *args, int nargs);
@@ -262,6 +280,7 @@ void ops_dat_set_data_slab_host(ops_dat dat, int part, char *local_buf,
                                 int *local_range);
 
 void ops_compute_moment(double t, double *first, double *second);
+void ops_compute_max(double *t, double *max, int n);
 
 void ops_dump3(ops_dat dat, const char *name);
 
@@ -284,6 +303,9 @@ int compute_ranges(ops_arg* args, int nargs, ops_block block, int* range, int* s
 int ops_get_proc();
 int ops_num_procs();
 void ops_put_data(ops_dat dat);
+ops_kernel_descriptor *ops_kernel_descriptor_alloc(OPS_instance *instance, int nargs);
+void ops_kernel_descriptor_free(ops_kernel_descriptor *desc);
+char *ops_kernel_name_intern(OPS_instance *instance, const char *name);
 OPS_FTN_INTEROP
 void create_kerneldesc_and_enque(char const *name, ops_arg *args, int nargs, int index, int dim, int isdevice, int *range, ops_block block, void (*func)(struct ops_kernel_descriptor *desc));
 
@@ -336,6 +358,9 @@ void _ops_timing_output_stdout(OPS_instance *instance);
 int _ops_is_root(OPS_instance *instance);
 void _ops_partition(OPS_instance *instance, const char *routine);
 void _ops_partition(OPS_instance *instance, const char *routine, std::map<std::string, void*>& opts);
+void _ops_repartition(OPS_instance *instance);
+void _ops_loop_chain_begin(OPS_instance *instance, int repeats);
+void _ops_loop_chain_end(OPS_instance *instance);
 void _ops_exit(OPS_instance *instance);
 
 void ops_printf2(OPS_instance *instance, const char *format, ...);
@@ -385,6 +410,15 @@ template <class T> void ops_reduction_core::get_result(T *ptr) {
   }
   ops_reduction_result_char(this, sizeof(T), (char *)ptr);
 }
+template <class T> void ops_reduction_core::get_result_deferred(T *ptr) {
+  if (type_error(ptr, this->type)) {
+    OPSException ex(OPS_INVALID_ARGUMENT);
+    ex << "Error: incorrect type specified for constant " << this->name << " in ops_reduction_result_deferred";
+    throw ex;
+  }
+  ops_reduction_result_deferred_char(this, sizeof(T), (char *)ptr);
+}
+inline void ops_reduction_core::wait() { ops_reduction_wait(this); }
 template <class T>
 ops_dat ops_block_core::decl_dat(int data_size, int *block_size, int *base,
     int *d_m, int *d_p, int *stride, T *data, char const *type,
@@ -169,6 +169,7 @@ public:
   int dims;         /**< dimension of block, 2D,3D .. etc*/
   char const *name; /**< name of block */
   OPS_instance *instance; /**<< pointer the the OPS_instance*/
+  int periodic[OPS_MAX_DIM]; /**< periodicity in each dimension */
 
 #ifdef OPS_CPP_API
 /**
@@ -224,6 +225,14 @@ public:
   ops_dat_core* decl_dat(int data_size, int *block_size, int *base,
         int *d_m, int *d_p, T *data, char const *type,
         char const *name);
+
+/**
+ * Declares the block periodic in some of its dimensions
+ * (see ops_block_set_periodic()).
+ *
+ * @param periodic  non-zero for each dimension that is periodic
+ */
+  void set_periodic(const int *periodic);
 #endif
 };
 
@@ -251,6 +260,20 @@ struct ops_reduction_core {
  *                the declared
  */
   template <class T> void get_result(T *ptr);
+
+/**
+ * Requests the reduced value without waiting for it, see
+ * ops_reduction_result_deferred().
+ *
+ * @tparam T
+ * @param ptr     a pointer to write the results to once waited for
+ */
+  template <class T> void get_result_deferred(T *ptr);
+
+/**
+ * Waits for a result requested with get_result_deferred().
+ */
+  void wait();
 #endif
 };
 
@@ -603,6 +626,22 @@ void ops_set_soa(const int soa_val);
 OPS_FTN_INTEROP
 ops_block ops_decl_block(int dims, const char *name);
 
+/**
+ * Declares a block periodic in some of its dimensions.
+ *
+ * With MPI, the halos of datasets on the block are then filled across the
+ * periodic boundaries by the regular halo exchanges, or by a local copy
+ * where a single process spans a periodic dimension. The datasets must have a zero base in
+ * the periodic dimensions, and their block halos there are not held by
+ * any process. Must be called before ops_partition(); single node
+ * parallelizations do not support periodic blocks.
+ *
+ * @param block     structured block
+ * @param periodic  non-zero for each dimension that is periodic
+ */
+OPS_FTN_INTEROP
+void ops_block_set_periodic(ops_block block, const int *periodic);
+
 /**
  * This routine defines a dataset.
  *
@@ -916,6 +955,45 @@ template <class T> void ops_reduction_result(ops_reduction handle, T *ptr) {
   ops_reduction_result_char(handle, sizeof(T), (char *)ptr);
 }
 
+/**
+ * This routine requests the reduced value held by a reduction handle, without
+ * waiting for it. The result is written to @p ptr by the time
+ * ops_reduction_wait() returns for the handle.
+ *
+ * Under MPI, results requested one after the other are combined into a single
+ * non-blocking global reduction, which is started when the next loop is
+ * issued, and can overlap with the execution of subsequent loops. Using the
+ * handle in a loop again waits for the result.
+ *
+ * @tparam T
+ * @param handle  the ::ops_reduction handle
+ * @param ptr     a pointer to write the results to, memory size has to match
+ *                the declared, has to remain valid until the result is
+ *                waited for
+ */
+template <class T> void ops_reduction_result_deferred(ops_reduction handle, T *ptr) {
+  if (type_error(ptr, handle->type)) {
+    OPSException ex(OPS_INVALID_ARGUMENT);
+    ex << "Error: incorrect type specified for constant " << handle->name << " in ops_reduction_result_deferred";
+    throw ex;
+  }
+  if (!handle->initialized) {
+    OPSException ex(OPS_INVALID_ARGUMENT);
+    ex << "Error: ops_reduction_result_deferred called for " << handle->name << " but the handle was not previously used in a reduction since the last ops_reduction_result call.";
+    throw ex;
+  }
+  ops_reduction_result_deferred_char(handle, sizeof(T), (char *)ptr);
+}
+
+/**
+ * Waits for a result requested with ops_reduction_result_deferred(), after
+ * which it can be read.
+ *
+ * @param handle  the ::ops_reduction handle
+ */
+OPS_FTN_INTEROP
+void ops_reduction_wait(ops_reduction handle);
+
 /**
  * This routine updates/changes the value of a constant.
  *
@@ -1004,6 +1082,32 @@ void ops_diagnostic_output();
 void ops_timing_output(std::ostream &stream);
 OPS_FTN_INTEROP
 void ops_timing_output_stdout();
+
+/**
+ * Marks the start of a chain of loops that is repeated @p repeats times, such
+ * as the sweeps of an iterative smoother.
+ *
+ * The loops of all the repetitions have to be issued between this call and
+ * ops_loop_chain_end(), the same loops in the same order in every repetition.
+ * With tiling enabled, the loops of the chain are tiled as one batch. Under
+ * MPI, the halos are deepened to what all the repetitions depend on where
+ * possible, so the chain takes a single halo exchange, otherwise it is
+ * executed in groups of repetitions that fit. Reduction results and data
+ * accessed within the chain force the execution of the loops issued so far,
+ * so these should be left until after the chain.
+ * When tiling is not enabled, this call has no effect.
+ *
+ * @param repeats  number of times the loops of the chain are issued
+ */
+OPS_FTN_INTEROP
+void ops_loop_chain_begin(int repeats);
+
+/**
+ * Marks the end of a chain of loops started with ops_loop_chain_begin(), and
+ * executes the loops of the chain.
+ */
+OPS_FTN_INTEROP
+void ops_loop_chain_end();
 #endif
 
 /**
@@ -1060,6 +1164,17 @@ OPS_FTN_INTEROP
 void ops_partition(const char *routine);
 
 void ops_partition_opts(const char *routine, std::map<std::string, void*>& opts);
+
+/**
+ * Moves the boundaries between the processes working on each block so that
+ * processes that have been computing faster since the last call (or since
+ * the start) get more of the block, and migrates the datasets accordingly.
+ * Uses the kernel timings, which are only collected with -OPS_DIAGS=2 or higher.
+ * (links to a dummy function for single node parallelizations).
+ * Must be called by all processes, after ops_partition().
+ */
+OPS_FTN_INTEROP
+void ops_repartition();
 /*******************************************************************************
 * External access support
 *******************************************************************************/
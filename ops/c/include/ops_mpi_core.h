@@ -63,6 +63,9 @@ typedef struct {
   int id_m[OPS_MAX_DIM];
   /// next neighbor in each dimension (in cart cords)
   int id_p[OPS_MAX_DIM];
+  /// neighbors in all face, edge and corner directions (in cart cords),
+  /// direction (o_0,..,o_n) with o_d in {-1,0,1} is at sum_d (o_d+1)*3^d
+  int *id_neigh;
   /// finest level decomposed details
   int decomp_disp[OPS_MAX_DIM];
   int decomp_size[OPS_MAX_DIM];
@@ -73,10 +76,35 @@ typedef struct {
   /// Group communicator for intra-block
   MPI_Group grp;
   int owned;
+  /// processes of the block on the same node, for OPS_HALO_SHARED
+  MPI_Comm shm_comm;
+  /// rank of the previous/next neighbor in shm_comm, -1 if not on the node
+  int shm_m[OPS_MAX_DIM];
+  int shm_p[OPS_MAX_DIM];
+  /// counters of halo exchanges with the neighbors, shared on the node
+  MPI_Win shm_flags_win;
+  int *shm_flags;
+  int *shm_flags_m[OPS_MAX_DIM];
+  int *shm_flags_p[OPS_MAX_DIM];
 } sub_block;
 
 typedef sub_block *sub_block_list;
 
+///
+/// Layout of a dat, at the start of its memory shared on the node, followed
+/// by the data at OPS_SHM_HEADER bytes
+///
+typedef struct {
+  /// product array of the dat
+  size_t prod[OPS_MAX_DIM];
+  /// owned range in each dimension, relative to the start of the data
+  int owned_begin[OPS_MAX_DIM];
+  int owned_end[OPS_MAX_DIM];
+} ops_shm_header;
+
+#define OPS_SHM_HEADER                                                         \
+  ((sizeof(ops_shm_header) + OPS_ALIGNMENT - 1) / OPS_ALIGNMENT * OPS_ALIGNMENT)
+
 ///
 /// Struct for holding the decomposition details of a dat on an MPI process
 ///
@@ -113,6 +141,12 @@ typedef struct {
   /// flag to indicate MPI halo exchange in a direction is needed
   int *dirty_dir_recv;
 
+  /// window holding the data in memory shared on the node, MPI_WIN_NULL if
+  /// the data is private
+  MPI_Win shm_win;
+  /// layout of the data of the previous/next neighbor, if in shm_win
+  ops_shm_header *shm_m[OPS_MAX_DIM];
+  ops_shm_header *shm_p[OPS_MAX_DIM];
 } sub_dat;
 
 typedef sub_dat *sub_dat_list;
@@ -153,6 +187,10 @@ void ops_pack(ops_dat dat, const int src_offset, char *__restrict dest,
 void ops_unpack(ops_dat dat, const int dest_offset, const char *__restrict src,
                 const ops_int_halo *__restrict halo);
 char* OPS_realloc_fast(char *ptr, size_t old_size, size_t new_size);
+void ops_halo_plans_free();
+void ops_halo_group_plans_free();
+void ops_reductions_free();
+void ops_comm_thread_stop();
 ops_dat ops_dat_copy_mpi_core(ops_dat orig_dat);
 ops_kernel_descriptor * ops_dat_deep_copy_mpi_core(ops_dat target, ops_dat orig_dat);
 
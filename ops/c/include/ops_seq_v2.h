@@ -77,6 +77,9 @@ inline void stencil_depth(ops_stencil sten, int* d_pos, int* d_neg)
 #if __cplusplus >= 201103L
 // ops_par_loop implementation with variadic template arguments
 #include <utility>
+#include <tuple>
+#include <vector>
+#include <type_traits>
 #if __cplusplus >= 201402L
 // after c++14 use built in types.
 template <size_t... I> using indices = std::index_sequence<I...>;
@@ -107,106 +110,228 @@ template <typename T> struct param_remove_cvref<T *> {
 template <typename T>
 using param_remove_cvref_t = typename param_remove_cvref<T>::type;
 
-// helper struct to create, pass and free parameters to the kernel
+// number of loop dimensions known at compile time, loops over blocks with
+// fewer dimensions iterate once over the extra ones
+#if defined(OPS_1D)
+#define OPS_SEQ_NDIM 1
+#elif defined(OPS_2D)
+#define OPS_SEQ_NDIM 2
+#elif defined(OPS_3D)
+#define OPS_SEQ_NDIM 3
+#elif defined(OPS_4D)
+#define OPS_SEQ_NDIM 4
+#else
+#define OPS_SEQ_NDIM OPS_MAX_DIM
+#endif
+
+// iteration space of a loop on this process
+struct ops_seq_loop_info {
+  int ndim;               // dimensionality of the block
+  int start[OPS_MAX_DIM]; // local start of the range
+  int end[OPS_MAX_DIM];   // local end of the range
+  int disp[OPS_MAX_DIM];  // global index of the local origin
+  ops_block block;
+  int threaded;           // executed by more than one thread
+};
+
+// combines the partial result of a thread into a reduction
+template <typename T>
+inline void ops_seq_reduce_combine(T &result, const T &partial, int acc) {
+  if (acc == OPS_INC) result += partial;
+  else if (acc == OPS_MIN) result = partial < result ? partial : result;
+  else if (acc == OPS_MAX) result = result < partial ? partial : result;
+}
+template <typename T>
+inline void ops_seq_reduce_combine(std::complex<T> &result,
+                                   const std::complex<T> &partial, int acc) {
+  if (acc == OPS_INC) result += partial;
+}
+
+// helper struct to create and pass parameters to the kernel. Every thread
+// constructs its own on the stack: set_row is called at the start of each
+// row of the innermost dimension with the offset of the row from the start
+// of the range, at returns the parameter for the i-th point of the row, and
+// finish is called when the thread is done
 template <typename ParamT> struct param_handler {
-  static char *construct(const ops_arg &arg, int dim, int ndim, int start[], ops_block block) { 
+  static_assert(std::is_pointer<ParamT>::value,
+                "kernel parameters should be ACC<type>& or pointers");
+};
+
+// pointer parameters: global constants, reductions and ops_arg_idx
+template <typename T> struct param_handler<T *> {
+  const ops_arg &arg;
+  int kind;               // 0: plain pointer, 1: index, 2: partial reduction
+  T *ptr;
+  int idx[OPS_MAX_DIM];
+  int idx_start[OPS_MAX_DIM];
+  T partial[8];           // per-thread partial result of small reductions
+  std::vector<T> partial_large;
+
+  param_handler(const ops_arg &_arg, const ops_seq_loop_info &info)
+      : arg(_arg), kind(0), ptr(nullptr) {
     if (arg.argtype == OPS_ARG_GBL) {
-      if (arg.acc == OPS_READ) return arg.data;
-      else
+      if (arg.acc == OPS_READ) {
+        ptr = (T *)arg.data;
+        return;
+      }
   #ifdef OPS_MPI
-        return ((ops_reduction)arg.data)->data + ((ops_reduction)arg.data)->size * block->index;
+      ptr = (T *)(((ops_reduction)arg.data)->data +
+                  ((ops_reduction)arg.data)->size * info.block->index);
   #else //OPS_MPI
-        return ((ops_reduction)arg.data)->data;
+      ptr = (T *)((ops_reduction)arg.data)->data;
   #endif //OPS_MPI
+      if (!info.threaded) return;
+      kind = 2;
+      if (arg.dim > 8) partial_large.resize(arg.dim);
+      for (int d = 0; d < arg.dim; d++)
+        local()[d] = arg.acc == OPS_INC ? T() : ptr[d];
     } else if (arg.argtype == OPS_ARG_IDX) {
-  #ifdef OPS_MPI
-      sub_block_list sb = OPS_sub_block_list[block->index]; //TODO: Multigrid
-      for (int d = 0; d < dim && d < OPS_MAX_DIM; d++) block->instance->arg_idx[d] = sb->decomp_disp[d] + start[d];
-  #else //OPS_MPI
-      for (int d = 0; d < dim && d < OPS_MAX_DIM; d++) block->instance->arg_idx[d] = start[d];
-  #endif //OPS_MPI
-      return (char *)block->instance->arg_idx;
+      kind = 1;
+      for (int d = 0; d < OPS_MAX_DIM; d++) {
+        idx_start[d] = d < info.ndim ? info.disp[d] + info.start[d] : 0;
+        idx[d] = idx_start[d];
+      }
     }
-    //assert(false && "Arg should be one of OPS_ARG_GBL or OPS_ARG_IDX");
-    return nullptr;
   }
-  static ParamT get(char *data) { return (ParamT)data; } 
-
-#ifdef OPS_MPI 
-static void shift_arg(const ops_arg &arg, char *p, int m, const int* start,
-                      const int offs[], const sub_block_list &sb, OPS_instance *instance)
-#else //OPS_MPI
-static void shift_arg(const ops_arg &arg, char *p, int m, const int* start, 
-                      const int offs[], OPS_instance *instance)
-#endif
-{
-  if (arg.argtype == OPS_ARG_IDX && m < OPS_MAX_DIM) {
-    instance->arg_idx[m]++;
-#ifdef OPS_MPI
-    for (int d = 0; d < m && d < OPS_MAX_DIM; d++) instance->arg_idx[d] = sb->decomp_disp[d] + start[d];
-#else //OPS_MPI
-    for (int d = 0; d < m && d < OPS_MAX_DIM; d++) instance->arg_idx[d] = start[d];
-#endif //OPS_MPI
+
+  T *local() { return arg.dim > 8 ? &partial_large[0] : partial; }
+
+  void set_row(const int *row) {
+    if (kind == 1)
+      for (int d = 1; d < OPS_SEQ_NDIM; d++) idx[d] = idx_start[d] + row[d];
+  }
+
+  bool unit() const { return true; }
+
+  template <bool Unit>
+  T *at(int i) {
+    if (kind == 1) {
+      idx[0] = idx_start[0] + i;
+      return (T *)idx;
+    }
+    return kind == 2 ? local() : ptr;
   }
-}
 
-  static void free(char *) {}
+  void finish() {
+    if (kind != 2) return;
+    T *partial_result = local();
+  #ifdef _OPENMP
+  #pragma omp critical (ops_seq_reduction)
+  #endif
+    for (int d = 0; d < arg.dim; d++)
+      ops_seq_reduce_combine(ptr[d], partial_result[d], arg.acc);
+  }
 };
 
+// dataset parameters, the accessor of each point is built from the start of
+// its row, so the innermost loop only has a plain induction variable
 template <typename T> struct param_handler<ACC<T>> {
-  static char *construct(const ops_arg &arg, int dim, int ndim, int start[], ops_block block) { 
-    if (arg.argtype == OPS_ARG_DAT) {
-      int d_m[OPS_MAX_DIM] = {};
+  T *base;                  // first point of the range
+  T *row_ptr;               // first point of the current row
+  long step[OPS_MAX_DIM];   // distance between neighbouring points
+  int mdim;
+  int size[OPS_MAX_DIM];
+
+  param_handler(const ops_arg &arg, const ops_seq_loop_info &info) {
+    int d_m[OPS_MAX_DIM] = {};
   #ifdef OPS_MPI
-      for (int d = 0; d < dim; d++) d_m[d] = arg.dat->d_m[d] + OPS_sub_dat_list[arg.dat->index]->d_im[d];
+    for (int d = 0; d < info.ndim; d++) d_m[d] = arg.dat->d_m[d] + OPS_sub_dat_list[arg.dat->index]->d_im[d];
   #else //OPS_MPI
-      for (int d = 0; d < dim; d++) d_m[d] = arg.dat->d_m[d];
+    for (int d = 0; d < info.ndim; d++) d_m[d] = arg.dat->d_m[d];
   #endif //OPS_MPI
+    int soa = arg.dat->block->instance->OPS_soa;
+    base = (T *)(arg.data + address(info.ndim, soa ? arg.dat->type_size : arg.dat->elem_size,
+                                    (int *)info.start, arg.dat->size, arg.stencil->stride,
+                                    arg.dat->base, d_m));
+    long prod = soa ? 1 : arg.dat->dim;
+    for (int d = 0; d < OPS_MAX_DIM; d++) {
+      size[d] = arg.dat->size[d];
+      step[d] = d < info.ndim ? prod * arg.stencil->stride[d] : 0;
+      prod *= arg.dat->size[d];
+    }
+    mdim = arg.dim;
+    row_ptr = base;
+  }
+
+  void set_row(const int *row) {
+    row_ptr = base;
+    for (int d = 1; d < OPS_SEQ_NDIM; d++) row_ptr += row[d] * step[d];
+  }
+
+  bool unit() const { return step[0] == 1; }
+
+  template <bool Unit>
+  ACC<T> at(int i) {
+    T *ptr = row_ptr + (Unit ? i : i * step[0]);
 #ifdef OPS_1D
-      return (char *) new ACC<T>(arg.dim, arg.dat->size[0], (T*)(arg.data //base of 2D array
+    return ACC<T>(mdim, size[0], ptr);
 #elif defined(OPS_2D)
-      return (char *) new ACC<T>(arg.dim, arg.dat->size[0], arg.dat->size[1], (T*)(arg.data //base of 2D array
+    return ACC<T>(mdim, size[0], size[1], ptr);
 #elif defined(OPS_3D)
-      return (char *) new ACC<T>(arg.dim, arg.dat->size[0], arg.dat->size[1], arg.dat->size[2], (T*)(arg.data //base of 3D array
+    return ACC<T>(mdim, size[0], size[1], size[2], ptr);
 #elif defined(OPS_4D)
-      return (char *) new ACC<T>(arg.dim, arg.dat->size[0], arg.dat->size[1], arg.dat->size[2], arg.dat->size[3], (T*)(arg.data //base of 3D array
+    return ACC<T>(mdim, size[0], size[1], size[2], size[3], ptr);
 #else
-      return (char *) ((arg.dat->data //TODO
+    static_assert(sizeof(T) == 0, "define OPS_1D, OPS_2D, OPS_3D or OPS_4D to use ACC");
+    return ACC<T>(row_ptr);
 #endif
-      + address(ndim, arg.dat->block->instance->OPS_soa ? arg.dat->type_size : arg.dat->elem_size, &start[0], 
-        arg.dat->size, arg.stencil->stride, arg.dat->base,
-        d_m))); //TODO
-    } 
-    //assert(false && "Arg must be OPS_ARG_DAT if accessed by ACC");
-    return nullptr;
   }
-  static ACC<T>& get(char *data) { return *((ACC<T> *)data); }
-
-#ifdef OPS_MPI 
-static void shift_arg(const ops_arg &arg, char *p, int m, const int* start,
-                      const int offs[], const sub_block_list &sb, OPS_instance *instance)
-#else //OPS_MPI
-static void shift_arg(const ops_arg &arg, char *p, int m, const int* start, 
-                      const int offs[], OPS_instance *instance)
-#endif
-{
-  if (arg.argtype == OPS_ARG_DAT) {
-    int offset = (arg.dat->block->instance->OPS_soa ? 1 : arg.dat->dim) * offs[m];
-    //p = p + ((OPS_soa ? arg.dat->type_size : arg.dat->elem_size) * offs[i][m]);
-    ((ACC<T>*)p)->next(offset); // T must be ACC<type> we need to set to the next element
-  } 
-}
 
-  static void free(char *data) { delete (ACC<T> *)data;}
+  void finish() {}
 };
 
-static void initoffs(const ops_arg &arg, int *offs, const int &ndim, int *start, int *end) {
-  if(arg.stencil != nullptr) {
-    offs[0] = arg.stencil->stride[0]*1;
-    for(int n=1; n<ndim; ++n){
-      offs[n] = off(ndim, n, start, end, arg.dat->size, arg.stencil->stride);
+// calls the kernel with the parameters of a point, which are named here so
+// that they can bind to the reference parameters of the kernel
+template <typename... ParamType, typename... PointT>
+inline void ops_seq_call(void (*kernel)(ParamType...), PointT &&... params) {
+  kernel(params...);
+}
+
+// executes rows [row_begin, row_end) of the iteration space, rows being
+// numbered along the dimensions above the innermost one. Forced inline so that
+// the kernel, known at the call site, can be inlined into the innermost loop
+#if defined(__GNUC__)
+#define OPS_SEQ_INLINE inline __attribute__((always_inline))
+#else
+#define OPS_SEQ_INLINE inline
+#endif
+template <typename... ParamType, typename... OPSARG, size_t... J>
+OPS_SEQ_INLINE void ops_seq_rows(indices<J...>, void (*kernel)(ParamType...),
+                                 const ops_seq_loop_info &info, long row_begin,
+                                 long row_end, const OPSARG &... arguments) {
+  std::tuple<param_handler<param_remove_cvref_t<ParamType>>...> params(
+      param_handler<param_remove_cvref_t<ParamType>>(arguments, info)...);
+
+  // offset of the first row from the start of the range
+  int row[OPS_MAX_DIM] = {0};
+  long rem = row_begin;
+  for (int d = 1; d < OPS_SEQ_NDIM; d++) {
+    int count = d < info.ndim ? info.end[d] - info.start[d] : 1;
+    row[d] = rem % count;
+    rem /= count;
+  }
+  const int count0 = info.end[0] - info.start[0];
+  bool unit = true;
+  (void) std::initializer_list<int>{(unit = unit && std::get<J>(params).unit(), 0)...};
+
+  for (long r = row_begin; r < row_end; r++) {
+    (void) std::initializer_list<int>{(std::get<J>(params).set_row(row), 0)...};
+    // version the innermost loop on unit stride (the common case)
+    if (unit)
+      for (int i = 0; i < count0; i++)
+        ops_seq_call(kernel, std::get<J>(params).template at<true>(i)...);
+    else
+      for (int i = 0; i < count0; i++)
+        ops_seq_call(kernel, std::get<J>(params).template at<false>(i)...);
+
+    // next row
+    for (int d = 1; d < OPS_SEQ_NDIM; d++) {
+      int count = d < info.ndim ? info.end[d] - info.start[d] : 1;
+      if (++row[d] < count) break;
+      row[d] = 0;
     }
   }
+  (void) std::initializer_list<int>{(std::get<J>(params).finish(), 0)...};
 }
 
 template <typename... ParamType, typename... OPSARG, size_t... J>
@@ -215,20 +340,24 @@ void ops_par_loop_impl(indices<J...>, void (*kernel)(ParamType...),
                       OPSARG... arguments) {
   constexpr int N = sizeof...(OPSARG);
 
-  int  count[OPS_MAX_DIM] = {0};
   ops_arg args[N] = {arguments...};
-  
+
   #ifdef CHECKPOINTING
   if (!ops_checkpointing_name_before(args,N,range,name)) return;
   #endif
 
-  int start[OPS_MAX_DIM];
-  int end[OPS_MAX_DIM];
+  ops_seq_loop_info info;
+  int *start = info.start;
+  int *end = info.end;
+  info.block = block;
+  for (int n = 0; n < OPS_MAX_DIM; n++) {
+    start[n] = 0; end[n] = 1; info.disp[n] = 0;
+  }
 
   #ifdef OPS_MPI
   sub_block_list sb = OPS_sub_block_list[block->index];
   if (!sb->owned) return;
-  //compute locally allocated range for the sub-block 
+  //compute locally allocated range for the sub-block
   int ndim = sb->ndim;
   for (int n=0; n<ndim; n++) {
     start[n] = sb->decomp_disp[n];end[n] = sb->decomp_disp[n]+sb->decomp_size[n];
@@ -239,6 +368,7 @@ void ops_par_loop_impl(indices<J...>, void (*kernel)(ParamType...),
     else end[n] = sb->decomp_size[n];
     if (sb->id_p[n]==MPI_PROC_NULL && (range[2*n+1] > sb->decomp_disp[n]+sb->decomp_size[n]))
       end[n] += (range[2*n+1]-sb->decomp_disp[n]-sb->decomp_size[n]);
+    info.disp[n] = sb->decomp_disp[n];
   }
   #else //!OPS_MPI
   int ndim = block->dims;
@@ -246,50 +376,46 @@ void ops_par_loop_impl(indices<J...>, void (*kernel)(ParamType...),
     start[n] = range[2*n];end[n] = range[2*n+1];
   }
   #endif //OPS_MPI
+  info.ndim = ndim;
 
   #ifdef OPS_DEBUG
   ops_register_args(block->instance, args, name);
   #endif
 
-  char *p_a[N] = 
-    {param_handler<param_remove_cvref_t<ParamType>>::construct(arguments, dim, ndim, start, block)...};
-  //Offs decl
-  int offs[N][OPS_MAX_DIM] = {};
-  (void) std::initializer_list<int>{(initoffs(arguments, offs[J], ndim, start, end), 0)...};
-
-  int total_range = 1;
+  long total_rows = 1;
   for (int n=0; n<ndim; n++) {
-    count[n] = end[n]-start[n];  // number in each dimension
-    total_range *= count[n];
-    total_range *= (count[n]<0?0:1);
+    if (end[n] <= start[n]) total_rows = 0;
+    else if (n > 0) total_rows *= end[n] - start[n];
   }
-  count[dim-1]++;     // extra in last to ensure correct termination
 
   ops_H_D_exchanges_host(args, N);
   ops_halo_exchanges(args,N,range);
   ops_H_D_exchanges_host(args, N);
 
-  for (int nt=0; nt<total_range; nt++) {
-    // call kernel function, passing in pointers to data
-
-    kernel((param_handler<param_remove_cvref_t<ParamType>>::get(p_a[J]))... );
+  // global arguments written by the kernel cannot be shared by threads
+  info.threaded = 0;
+  #ifdef _OPENMP
+  info.threaded = total_rows > 1 && omp_get_max_threads() > 1 && !omp_in_parallel();
+  for (int i = 0; i < N; i++)
+    if (args[i].argtype == OPS_ARG_GBL && (args[i].acc == OPS_WRITE || args[i].acc == OPS_RW))
+      info.threaded = 0;
+  #endif
 
-    count[0]--;   // decrement counter
-    int m = 0;    // max dimension with changed index
-    while (count[m]==0) {
-      count[m] =  end[m]-start[m];// reset counter
-      m++;                        // next dimension
-      count[m]--;                 // decrement counter
+  if (total_rows > 0) {
+    if (info.threaded) {
+  #ifdef _OPENMP
+  #pragma omp parallel
+      {
+        int nthreads = omp_get_num_threads();
+        int thread = omp_get_thread_num();
+        long row_begin = total_rows * thread / nthreads;
+        long row_end = total_rows * (thread + 1) / nthreads;
+        ops_seq_rows(indices<J...>{}, kernel, info, row_begin, row_end, arguments...);
+      }
+  #endif
+    } else {
+      ops_seq_rows(indices<J...>{}, kernel, info, 0, total_rows, arguments...);
     }
-
-    // shift pointers to data
-  #ifdef OPS_MPI
-    (void) std::initializer_list<int>{(
-      param_handler<param_remove_cvref_t<ParamType>>::shift_arg(arguments, p_a[J], m, start, offs[J], sb, block->instance),0)...};
-  #else //OPS_MPI
-    (void) std::initializer_list<int>{(
-      param_handler<param_remove_cvref_t<ParamType>>::shift_arg(arguments, p_a[J], m, start, offs[J], block->instance),0)...};
-  #endif //OPS_MPI
   }
 
   #ifdef OPS_DEBUG_DUMP
@@ -299,9 +425,6 @@ void ops_par_loop_impl(indices<J...>, void (*kernel)(ParamType...),
   (void) std::initializer_list<int>{(
   (arguments.argtype == OPS_ARG_DAT && arguments.acc != OPS_READ)?  ops_set_halo_dirtybit3(&arguments,range),0:0)...};
   ops_set_dirtybit_host(args, N);
-
-  (void) std::initializer_list<int>{
-    (param_handler<param_remove_cvref_t<ParamType>>::free(p_a[J]),0)...};
 }
 
 #endif /*DOXYGEN_SHOULD_SKIP_THIS*/
@@ -173,6 +173,15 @@ ops_reduction ops_decl_reduction_handle(int size, const char *type,
 
 void ops_execute_reduction(ops_reduction handle) { (void)handle; }
 
+void ops_reduction_defer(ops_reduction handle, char *ptr) {
+  ops_execute(handle->instance);
+  memcpy(ptr, handle->data, handle->size);
+}
+
+void ops_reductions_start(OPS_instance *instance) { (void)instance; }
+
+void ops_reduction_wait(ops_reduction handle) { (void)handle; }
+
 int _ops_is_root(OPS_instance* instance) { (void)instance; return 1; }
 
 int ops_is_root() { return 1; }
@@ -192,12 +201,32 @@ void ops_halo_exchanges_datlist(ops_dat *dats, int ndats, int *depths) {
   (void)ndats;
 }
 
+int ops_halo_deepen(OPS_instance *instance, int depth) {
+  (void)instance;
+  return depth;
+}
+
 void ops_halo_exchanges(ops_arg *args, int nargs, int *range) {
   (void)args;
   (void)range;
   (void)nargs;
 }
 
+int ops_halo_exchanges_begin(ops_arg *args, int nargs, int *range,
+                             int *halo_depths) {
+  (void)args;
+  (void)range;
+  (void)nargs;
+  (void)halo_depths;
+  return 0;
+}
+
+void ops_halo_exchanges_end(ops_arg *args, int nargs, int *range) {
+  (void)args;
+  (void)range;
+  (void)nargs;
+}
+
 void ops_mpi_reduce_float(ops_arg *args, float *data) {
   (void)args;
   (void)data;
@@ -218,6 +247,11 @@ void ops_compute_moment(double t, double *first, double *second) {
   *second = t * t;
 }
 
+void ops_compute_max(double *t, double *max, int n) {
+  for (int i = 0; i < n; i++)
+    max[i] = t[i];
+}
+
 void ops_printf(const char *format, ...) {
   va_list argptr;
   va_start(argptr, format);
@@ -472,6 +506,7 @@ void ops_dat_get_raw_metadata(ops_dat dat, int part, int *disp, int *size, int *
 
 char* ops_dat_get_raw_pointer(ops_dat dat, int part, ops_stencil stencil, ops_memspace *memspace) {
     (void)stencil; (void)part;
+    ops_execute(dat->block->instance);
     if (dat->dirty_hd == OPS_DEVICE || *memspace == OPS_DEVICE) {
         if(dat->data_d == NULL) {
             OPSException ex(OPS_RUNTIME_ERROR);
@@ -669,6 +704,7 @@ ops_dat ops_dat_copy(ops_dat orig_dat)
 
 void ops_print_dat_to_txtfile(ops_dat dat, const char *file_name) {
   // printf("file %s, name %s type = %s\n",file_name, dat->name, dat->type);
+  ops_execute(dat->block->instance);
   // need to get data from GPU
   ops_get_data(dat);
   ops_print_dat_to_txtfile_core(dat, file_name);
@@ -676,30 +712,53 @@ void ops_print_dat_to_txtfile(ops_dat dat, const char *file_name) {
 
 void ops_NaNcheck(ops_dat dat) {
   char buffer[1]={'\0'};
+  ops_execute(dat->block->instance);
   // need to get data from GPU
   ops_get_data(dat);
   ops_NaNcheck_core(dat, buffer);
 }
 
 
+// Halos are not exchanged without MPI, so they cannot wrap around either
+static void ops_check_periodic(OPS_instance *instance) {
+  for (int b = 0; b < instance->OPS_block_index; b++) {
+    ops_block block = instance->OPS_block_list[b].block;
+    for (int d = 0; d < block->dims; d++)
+      if (block->periodic[d]) {
+        OPSException ex(OPS_NOT_IMPLEMENTED);
+        ex << "Error: block " << block->name << " is periodic, which requires an MPI build (on any number of processes)";
+        throw ex;
+      }
+  }
+}
+
 void _ops_partition(OPS_instance *instance, const char *routine) {
-  (void)instance;
   (void)routine;
+  ops_check_periodic(instance);
 }
 
 void _ops_partition(OPS_instance *instance, const char *routine, std::map<std::string, void*>& opts) {
-  (void)instance;
   (void)routine;
   (void)opts;
+  ops_check_periodic(instance);
 }
 
 void ops_partition(const char *routine) {
   (void)routine;
+  ops_check_periodic(OPS_instance::getOPSInstance());
 }
 
 void ops_partition_opts(const char *routine, std::map<std::string, void*>& opts) {
   (void)routine;
   (void)opts;
+  ops_check_periodic(OPS_instance::getOPSInstance());
+}
+
+void _ops_repartition(OPS_instance *instance) {
+  (void)instance;
+}
+
+void ops_repartition() {
 }
 
 void ops_timers(double *cpu, double *et) {
@@ -763,11 +822,11 @@ void ops_dat_deep_copy(ops_dat target, ops_dat source)
   }
   ops_kernel_descriptor *desc = ops_dat_deep_copy_core(target, source, range);
   if (source->block->instance->OPS_hybrid_gpu) {
-    strcpy(desc->name, "ops_internal_copy_device\0");
+    desc->name = ops_kernel_name_intern(source->block->instance, "ops_internal_copy_device");
     desc->isdevice = 1;
     desc->func = ops_internal_copy_device;
   } else {
-    strcpy(desc->name, "ops_internal_copy_seq\0");
+    desc->name = ops_kernel_name_intern(source->block->instance, "ops_internal_copy_seq");
     desc->isdevice = 0;
     desc->func = ops_internal_copy_seq;
   }
@@ -71,6 +71,14 @@ void OPS_instance::init_globals() {
 	OPS_dat_status=NULL;
 	OPS_ranks_per_node=0;
 
+	// HDF5 output
+	ops_io_async = 0;
+	ops_hdf5_chunk_size = 0;
+	ops_hdf5_deflate = 0;
+	ops_hdf5_shuffle = 0;
+	ops_hdf5_lz4 = 0;
+	ops_hdf5_lossy = -1;
+	ops_hdf5_aggregators = 0;
 
 	// Debugging
 	OPS_curr_args = NULL;
@@ -84,7 +92,24 @@ void OPS_instance::init_globals() {
 	//Tiling
 	ops_enable_tiling = 0;
 	ops_cache_size = 0;
+	ops_l2_cache_size = 0;
+	ops_tiling_l2 = 0;
 	ops_tiling_mpidepth = -1;
+	ops_tiling_threaded = 0;
+	ops_tiling_plans_max = 64;
+	ops_tiling_autotune = 0;
+	ops_fusion = 0;
+	ops_tiling_plan_hits = 0;
+	ops_tiling_plan_misses = 0;
+	ops_tiling_plan_evictions = 0;
+	ops_halo_overlap = 0;
+	ops_halo_aggregate = 0;
+	ops_halo_plans = 0;
+	ops_halo_shared = 0;
+	ops_comm_thread = 0;
+	ops_halo_deep = 0;
+	ops_partition_weighted = 0;
+	ops_partition_topology = 0;
 	ops_tiled_halo_exchange_time=0.0;
 	tiling_instance=NULL;
 	checkpointing_instance=NULL;
@@ -178,6 +203,12 @@ void OPS_instance::timing_output(std::ostream &stream) {
 void OPS_instance::timing_output_stdout() {
   _ops_timing_output(this, std::cout);
 }
+void OPS_instance::loop_chain_begin(int repeats) {
+  _ops_loop_chain_begin(this, repeats);
+}
+void OPS_instance::loop_chain_end() {
+  _ops_loop_chain_end(this);
+}
 
 int OPS_instance::is_root() {
   return _ops_is_root(this);
@@ -191,6 +222,10 @@ void OPS_instance::partition(const char *routine, std::map<std::string, void*>&
   _ops_partition(this, routine, opts);
 }
 
+void OPS_instance::repartition() {
+  _ops_repartition(this);
+}
+
 void OPS_instance::exit() {
   _ops_exit(this);
 }
@@ -217,4 +252,5 @@ void ops_dat_core::set_data_slab(int part, char *data2, int *range, ops_memspace
 size_t ops_dat_core::get_slab_extents(int part, int *disp, int *size2, int *slab) {return ops_dat_get_slab_extents(this, part, disp, size2, slab);}
 int ops_dat_core::get_global_npartitions() { return ops_dat_get_global_npartitions(this); }
 
+void ops_block_core::set_periodic(const int *periodic) {ops_block_set_periodic(this, periodic);}
 void ops_halo_group_core::halo_transfer() {ops_halo_transfer(this);}
@@ -58,6 +58,10 @@ inline int omp_get_max_threads() {
 #endif
 
 #include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <cfloat>
+#include <exception>
 using namespace std;
 
 
@@ -67,11 +71,49 @@ using namespace std;
 //Tiling plan & storage
 struct tiling_plan {
   int nloops;
+  size_t hash;              // combined hash of loop_sequence
+  long last_used;           // for evicting the least recently used plan
+  int tile_sizes[3];
+  int subtiled;             // tiles are split into sub-tiles for the L2 cache
   std::vector<size_t> loop_sequence;
   int ntiles;
   std::vector<std::vector<int> > tiled_ranges; // ranges for each loop
   std::vector<ops_dat> dats_to_exchange;
   std::vector<int> depths_to_exchange;
+  std::vector<int> wavefront_offsets; // CSR-like list of tiles in each wavefront
+  std::vector<int> wavefront_tiles;
+};
+
+//Auto-tuning state of the tile sizes of a sequence of loops: tile sizes
+//around the best one so far are timed, moving to the fastest candidate until
+//none of them improves on it
+struct tiling_tuner {
+  int locked;                  // tuning finished, best holds the result
+  int dims;
+  int extent[3];               // extent of the iteration space
+  int rounds;                  // number of candidate rounds evaluated
+  std::vector<int> candidates; // 3 tile sizes per candidate
+  std::vector<double> times;   // time of each candidate
+  std::vector<int> tried;      // all tile sizes timed so far
+  int current;                 // candidate being timed
+  int runs;                    // executions timed with the current candidate
+                               // on this process
+  int best[3];
+  double best_time;
+};
+#define OPS_TILING_TUNE_RUNS 2
+#define OPS_TILING_TUNE_ROUNDS 4
+
+//Recyclable storage of a kernel descriptor, the descriptor has to be the
+//first member so the two can be cast to each other
+struct ops_kernel_descriptor_storage {
+  ops_kernel_descriptor desc;
+  OPS_instance *instance;
+  int range_storage[4*OPS_MAX_DIM]; // range and orig_range
+  ops_arg *args;
+  int args_capacity;
+  char *gbl;                        // copies of OPS_READ global arguments
+  size_t gbl_capacity;
 };
 
 class OPS_instance_tiling {
@@ -89,6 +131,12 @@ public:
       data_read_deps_edge; // latest data dependencies for each dataset around the edges
 
   std::vector<tiling_plan> tiling_plans;
+  std::unordered_multimap<size_t, int> tiling_plan_index; // hash -> plan
+  long tiling_plan_clock = 0;
+  std::unordered_map<size_t, tiling_tuner> tiling_tuners;  // hash -> tuner
+  std::vector<size_t> tiling_tuner_order; // hashes in order of creation
+  int tiling_tuners_loaded = 0;
+  int tiling_tuner_flushes = 0;           // executions of the queue
 
   // tile sizes
   int TILE1D;
@@ -98,6 +146,20 @@ public:
   // dimensionality of blocks used throughout
   int ops_dims_tiling_internal;
 
+  // recycled kernel descriptors and interned kernel names, keyed by hash
+  std::vector<ops_kernel_descriptor_storage *> kernel_descriptor_pool;
+  std::unordered_multimap<size_t, char *> kernel_names;
+
+  // loop chain declared with ops_loop_chain_begin, 0 repeats if none
+  int chain_repeats = 0;
+  int chain_broken = 0; // the queue was executed within the chain
+
+  // upper bound on the halo depth needed by the queued loops, with deep halos
+  int queue_depth = 0;
+
+  // loops held back to be executed together, with OPS_FUSION
+  std::vector<ops_kernel_descriptor *> fusion_group;
+
 };
 #define TILE4D -1
 #define TILE5D -1
@@ -107,6 +169,14 @@ public:
 #define data_write_deps instance->tiling_instance->data_write_deps
 #define data_read_deps_edge instance->tiling_instance->data_read_deps_edge
 #define tiling_plans instance->tiling_instance->tiling_plans
+#define tiling_plan_index instance->tiling_instance->tiling_plan_index
+#define tiling_plan_clock instance->tiling_instance->tiling_plan_clock
+#define tiling_tuners instance->tiling_instance->tiling_tuners
+#define tiling_tuner_order instance->tiling_instance->tiling_tuner_order
+#define chain_repeats instance->tiling_instance->chain_repeats
+#define chain_broken instance->tiling_instance->chain_broken
+#define queue_depth instance->tiling_instance->queue_depth
+#define fusion_group instance->tiling_instance->fusion_group
 #define TILE1D instance->tiling_instance->TILE1D
 #define TILE2D instance->tiling_instance->TILE2D
 #define TILE3D instance->tiling_instance->TILE3D
@@ -128,9 +198,28 @@ inline int intersection(int range1_beg, int range1_end, int range2_beg,
   return i_max > i_min ? i_max - i_min : 0;
 }
 
-//Queries L3 cache size
+//Loops are queued and executed together by ops_execute when tiling, or when
+//deep halos let them compute redundantly into the halos instead of exchanging
+//them before every loop
+inline int ops_lazy_queued(OPS_instance *instance) {
+  return instance->ops_enable_tiling || instance->ops_halo_deep > 0;
+}
+
+//Largest stencil extent a loop reads datasets through, in any direction
+static int ops_kernel_radius(ops_kernel_descriptor *desc) {
+  int radius = 0;
+  for (int arg = 0; arg < desc->nargs; arg++) {
+    if (desc->args[arg].argtype != OPS_ARG_DAT || desc->args[arg].acc == OPS_WRITE) continue;
+    ops_stencil stencil = desc->args[arg].stencil;
+    for (int p = 0; p < stencil->points * stencil->dims; p++)
+      radius = MAX(radius, abs(stencil->stencil[p]));
+  }
+  return radius;
+}
+
+//Queries the size of the given level of (data) cache, in KB
 #if defined(_WIN32) || defined(WIN32)
-size_t ops_internal_get_cache_size(OPS_instance *instance) {
+size_t ops_internal_get_cache_size(OPS_instance *instance, int level = 3) {
   if (instance->OPS_hybrid_gpu) return 0;
   DWORD ReturnLength = 0;
   GetLogicalProcessorInformation(nullptr, &ReturnLength);
@@ -140,7 +229,7 @@ size_t ops_internal_get_cache_size(OPS_instance *instance) {
     for ( DWORD i = 0 ; i < procInfo.size() ; i++ ) {
       if ( procInfo[i].Relationship == RelationCache ) {
         const CACHE_DESCRIPTOR& Cache= procInfo[i].Cache;
-        if ( Cache.Level == 3 ) {
+        if ( Cache.Level == level && Cache.Type != CacheInstruction ) {
           return Cache.Size / 1024; /* Linux returns size in KB */
         }
       }
@@ -149,21 +238,312 @@ size_t ops_internal_get_cache_size(OPS_instance *instance) {
   return 0;
 }
 #else
-size_t ops_internal_get_cache_size(OPS_instance *instance) {
+size_t ops_internal_get_cache_size(OPS_instance *instance, int level = 3) {
   if (instance->OPS_hybrid_gpu) return 0;
   FILE *p = 0;
   unsigned int i = 0;
-  if (fopen_s(&p, "/sys/devices/system/cpu/cpu0/cache/index3/size", "r")==0) {
-    if ( fscanf_s(p, "%u", &i) != 1 ) {
-        /* Failed... leave i at 0? */
-        i = 0;
-    }
+  char path[64];
+  for (int index = 0; index < 8; index++) {
+    unsigned int l = 0;
+    snprintf(path, 64, "/sys/devices/system/cpu/cpu0/cache/index%d/level", index);
+    if (fopen_s(&p, path, "r") != 0) break;
+    if ( fscanf_s(p, "%u", &l) != 1 ) l = 0;
     fclose(p);
+    if ((int)l != level) continue;
+    // Skip instruction caches
+    snprintf(path, 64, "/sys/devices/system/cpu/cpu0/cache/index%d/type", index);
+    if (fopen_s(&p, path, "r") == 0) {
+      int instruction = fgetc(p) == 'I';
+      fclose(p);
+      if (instruction) continue;
+    }
+    snprintf(path, 64, "/sys/devices/system/cpu/cpu0/cache/index%d/size", index);
+    if (fopen_s(&p, path, "r") == 0) {
+      if ( fscanf_s(p, "%u", &i) != 1 ) {
+          /* Failed... leave i at 0? */
+          i = 0;
+      }
+      fclose(p);
+    }
+    break;
   }
   return i;
 }
 #endif
 
+/////////////////////////////////////////////////////////////////////////
+// Overlapping halo exchanges with computation
+// - execute the interior that does not depend on halo data while the
+//   messages are in flight, then the strips along each face
+/////////////////////////////////////////////////////////////////////////
+
+void ops_execute_overlapped(OPS_instance *instance, ops_kernel_descriptor *desc, int *halo_depths) {
+  int dims = desc->block->dims;
+  int full[2*OPS_MAX_DIM], interior[2*OPS_MAX_DIM];
+  int empty = 0;
+  for (int d = 0; d < 2*OPS_MAX_DIM; d++) {
+    full[d] = desc->range[d];
+    interior[d] = desc->range[d];
+  }
+  for (int d = 0; d < dims; d++) {
+    interior[2*d+0] = MIN(full[2*d+0] + halo_depths[2*d+0], full[2*d+1]);
+    interior[2*d+1] = MAX(full[2*d+1] - halo_depths[2*d+1], interior[2*d+0]);
+    if (interior[2*d+0] == interior[2*d+1]) empty = 1;
+  }
+
+  // Each part of the range records itself as a call of the kernel, the
+  // count and transfer are set afterwards as for a single call
+  int count = 0;
+  float transfer = 0.0f;
+  if (instance->OPS_diags > 1) {
+    ops_timing_realloc(instance, desc->index, desc->name);
+    count = instance->OPS_kernels[desc->index].count;
+    transfer = instance->OPS_kernels[desc->index].transfer;
+  }
+
+  if (!empty) {
+    for (int d = 0; d < 2*OPS_MAX_DIM; d++)
+      desc->range[d] = interior[d];
+    desc->func(desc);
+  }
+
+  double c,t1=0,t2=0;
+  if (instance->OPS_diags > 1)
+    ops_timers_core(&c,&t1);
+  ops_halo_exchanges_end(desc->args,desc->nargs,desc->orig_range);
+  ops_H_D_exchanges_host(desc->args,desc->nargs);
+  if (instance->OPS_diags > 1) {
+    ops_timers_core(&c,&t2);
+    instance->OPS_kernels[desc->index].mpi_time += t2-t1;
+  }
+
+  // Strips along the faces: interior range in the dimensions before d, the
+  // left or right remainder in dimension d, and the full range after d
+  for (int d = 0; d < dims; d++) {
+    for (int side = 0; side < 2; side++) {
+      for (int d2 = 0; d2 < 2*OPS_MAX_DIM; d2++)
+        desc->range[d2] = d2 < 2*d ? interior[d2] : full[d2];
+      desc->range[2*d+0] = side == 0 ? full[2*d+0] : interior[2*d+1];
+      desc->range[2*d+1] = side == 0 ? interior[2*d+0] : full[2*d+1];
+      int strip_empty = 0;
+      for (int d2 = 0; d2 < dims; d2++)
+        if (desc->range[2*d2+0] >= desc->range[2*d2+1]) strip_empty = 1;
+      if (!strip_empty)
+        desc->func(desc);
+    }
+  }
+
+  for (int d = 0; d < 2*OPS_MAX_DIM; d++)
+    desc->range[d] = full[d];
+
+  if (instance->OPS_diags > 1) {
+    instance->OPS_kernels[desc->index].count = count + 1;
+    int start[OPS_MAX_DIM], end[OPS_MAX_DIM], arg_idx[OPS_MAX_DIM];
+    if (compute_ranges(desc->args, desc->nargs, desc->block, full, start, end, arg_idx) >= 0)
+      for (int arg = 0; arg < desc->nargs; arg++)
+        if (desc->args[arg].argtype == OPS_ARG_DAT)
+          transfer += ops_compute_transfer(dims, start, end, &desc->args[arg]);
+    instance->OPS_kernels[desc->index].transfer = transfer;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////
+// Kernel descriptor storage
+// - descriptors are returned to a pool on release and reused, keeping the
+//   capacity of their argument lists
+// - kernel names are interned, descriptors only point to them
+/////////////////////////////////////////////////////////////////////////
+
+char *ops_kernel_name_intern(OPS_instance *instance, const char *name) {
+  if (instance->tiling_instance == NULL)
+    instance->tiling_instance = new OPS_instance_tiling();
+  size_t hash = 5381;
+  for (const char *c = name; *c != '\0'; c++)
+    hash = ((hash << 5) + hash) + (unsigned char)*c;
+  auto matches = instance->tiling_instance->kernel_names.equal_range(hash);
+  for (auto it = matches.first; it != matches.second; ++it)
+    if (strcmp(it->second, name) == 0) return it->second;
+  char *interned = (char *)ops_malloc(strlen(name) + 1);
+  strcpy(interned, name);
+  instance->tiling_instance->kernel_names.insert(std::make_pair(hash, interned));
+  return interned;
+}
+
+ops_kernel_descriptor *ops_kernel_descriptor_alloc(OPS_instance *instance, int nargs) {
+  if (instance->tiling_instance == NULL)
+    instance->tiling_instance = new OPS_instance_tiling();
+  std::vector<ops_kernel_descriptor_storage *> &pool =
+      instance->tiling_instance->kernel_descriptor_pool;
+  ops_kernel_descriptor_storage *storage;
+  if (pool.empty()) {
+    storage = (ops_kernel_descriptor_storage *)ops_calloc(1, sizeof(ops_kernel_descriptor_storage));
+    storage->instance = instance;
+  } else {
+    storage = pool.back();
+    pool.pop_back();
+  }
+  if (storage->args_capacity < nargs) {
+    storage->args = (ops_arg *)ops_realloc(storage->args, nargs * sizeof(ops_arg));
+    storage->args_capacity = nargs;
+  }
+  memset(&storage->desc, 0, sizeof(ops_kernel_descriptor));
+  memset(storage->range_storage, 0, sizeof(storage->range_storage));
+  storage->desc.args = storage->args;
+  storage->desc.nargs = nargs;
+  storage->desc.range = storage->range_storage;
+  storage->desc.orig_range = storage->range_storage + 2 * OPS_MAX_DIM;
+  return &storage->desc;
+}
+
+//Scratch space for the global arguments of a descriptor, valid until release
+static char *ops_kernel_descriptor_gbl(ops_kernel_descriptor *desc, size_t bytes) {
+  ops_kernel_descriptor_storage *storage = (ops_kernel_descriptor_storage *)desc;
+  if (storage->gbl_capacity < bytes) {
+    storage->gbl = (char *)ops_realloc(storage->gbl, bytes);
+    storage->gbl_capacity = bytes;
+  }
+  return storage->gbl;
+}
+
+void ops_kernel_descriptor_free(ops_kernel_descriptor *desc) {
+  if (desc == NULL) return;
+  ops_kernel_descriptor_storage *storage = (ops_kernel_descriptor_storage *)desc;
+  storage->instance->tiling_instance->kernel_descriptor_pool.push_back(storage);
+}
+
+static void ops_kernel_descriptor_pool_exit(OPS_instance *instance) {
+  for (auto storage : instance->tiling_instance->kernel_descriptor_pool) {
+    ops_free(storage->args);
+    ops_free(storage->gbl);
+    ops_free(storage);
+  }
+  instance->tiling_instance->kernel_descriptor_pool.clear();
+  for (auto &name : instance->tiling_instance->kernel_names)
+    ops_free(name.second);
+  instance->tiling_instance->kernel_names.clear();
+}
+
+/////////////////////////////////////////////////////////////////////////
+// Loop fusion
+// - consecutive loops over the same range that only depend on each other
+//   point-wise are held back, then executed together strip by strip along
+//   the outermost dimension, so that what one loop writes is still in cache
+//   when the next one reads it
+/////////////////////////////////////////////////////////////////////////
+
+//Returns 1 if the stencil only accesses the point being computed
+static int ops_stencil_is_point(ops_stencil stencil) {
+  if (stencil->type != 0) return 0;
+  for (int p = 0; p < stencil->points * stencil->dims; p++)
+    if (stencil->stencil[p] != 0) return 0;
+  return 1;
+}
+
+//Loops on the host over regular stencils, without global arguments written
+//other than reductions, can be fused
+static int ops_fusion_candidate(ops_kernel_descriptor *desc) {
+  if (desc->isdevice) return 0;
+  for (int arg = 0; arg < desc->nargs; arg++) {
+    const ops_arg &a = desc->args[arg];
+    if (a.argtype == OPS_ARG_GBL && (a.acc == OPS_WRITE || a.acc == OPS_RW)) return 0;
+    if (a.argtype == OPS_ARG_DAT && a.opt && a.stencil->type != 0) return 0;
+  }
+  return 1;
+}
+
+//Reduction handles are reinitialised by the next loop using them, so a loop
+//with reductions ends the group
+static int ops_fusion_reduces(ops_kernel_descriptor *desc) {
+  for (int arg = 0; arg < desc->nargs; arg++)
+    if (desc->args[arg].argtype == OPS_ARG_GBL && desc->args[arg].acc != OPS_READ)
+      return 1;
+  return 0;
+}
+
+//A loop joins the group if it has the same block and range, and every
+//dataset written by it or by a loop of the group is accessed point-wise
+//by both
+static int ops_fusion_fusable(OPS_instance *instance, ops_kernel_descriptor *desc) {
+  ops_kernel_descriptor *first = fusion_group[0];
+  if (desc->block != first->block) return 0;
+  for (int d = 0; d < 2*desc->block->dims; d++)
+    if (desc->range[d] != first->range[d]) return 0;
+  for (unsigned int loop = 0; loop < fusion_group.size(); loop++) {
+    for (int arg = 0; arg < fusion_group[loop]->nargs; arg++) {
+      const ops_arg &a = fusion_group[loop]->args[arg];
+      if (a.argtype != OPS_ARG_DAT || !a.opt) continue;
+      for (int arg2 = 0; arg2 < desc->nargs; arg2++) {
+        const ops_arg &b = desc->args[arg2];
+        if (b.argtype != OPS_ARG_DAT || !b.opt || b.dat != a.dat) continue;
+        if (a.acc == OPS_READ && b.acc == OPS_READ) continue;
+        if (!ops_stencil_is_point(a.stencil) || !ops_stencil_is_point(b.stencil))
+          return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+//Executes the loops held back, in strips that fit in half the cache size
+//per process (OPS_CACHE_SIZE, or the last level cache)
+static void ops_fusion_flush(OPS_instance *instance) {
+  if (instance->tiling_instance == NULL || fusion_group.size() == 0) return;
+  std::vector<ops_kernel_descriptor *> group;
+  group.swap(fusion_group);
+
+  int dims = group[0]->block->dims;
+  int outer = dims - 1;
+  int full[2*OPS_MAX_DIM];
+  for (int d = 0; d < 2*OPS_MAX_DIM; d++)
+    full[d] = group[0]->range[d];
+  int strip = MAX(1, full[2*outer+1] - full[2*outer+0]);
+  if (group.size() > 1) {
+    // Bytes of the datasets accessed per index of the outermost dimension
+    size_t bytes = 0;
+    std::vector<ops_dat> dats;
+    for (unsigned int loop = 0; loop < group.size(); loop++) {
+      for (int arg = 0; arg < group[loop]->nargs; arg++) {
+        const ops_arg &a = group[loop]->args[arg];
+        if (a.argtype != OPS_ARG_DAT || !a.opt ||
+            std::find(dats.begin(), dats.end(), a.dat) != dats.end()) continue;
+        dats.push_back(a.dat);
+        size_t plane = a.dat->elem_size;
+        for (int d = 0; d < outer; d++)
+          plane *= MAX(1, full[2*d+1] - full[2*d+0]);
+        bytes += plane;
+      }
+    }
+    if (instance->ops_cache_size == 0)
+      instance->ops_cache_size = (int)ops_internal_get_cache_size(instance) / 1000;
+    double cache = instance->ops_cache_size != 0 ? instance->ops_cache_size * 1000000.0 : 8000000.0;
+    strip = MAX(omp_get_max_threads(), int(cache / 2.0 / MAX(bytes, (size_t)1)));
+  }
+
+  int lo = full[2*outer+0];
+  do {
+    for (unsigned int loop = 0; loop < group.size(); loop++) {
+      ops_kernel_descriptor *desc = group[loop];
+      desc->range[2*outer+0] = lo;
+      desc->range[2*outer+1] = MIN(lo + strip, full[2*outer+1]);
+      desc->func(desc);
+    }
+    lo += strip;
+  } while (lo < full[2*outer+1]);
+
+  for (unsigned int loop = 0; loop < group.size(); loop++) {
+    ops_kernel_descriptor *desc = group[loop];
+    desc->range[2*outer+0] = full[2*outer+0];
+    desc->range[2*outer+1] = full[2*outer+1];
+    ops_set_dirtybit_host(desc->args,desc->nargs);
+    for (int arg = 0; arg < desc->nargs; arg++) {
+      if (desc->args[arg].argtype == OPS_ARG_DAT && desc->args[arg].acc != OPS_READ)
+        ops_set_halo_dirtybit3(&desc->args[arg], desc->orig_range);
+    }
+    if (desc->cleanup_func) desc->cleanup_func(desc);
+    ops_kernel_descriptor_free(desc);
+  }
+}
+
 /////////////////////////////////////////////////////////////////////////
 // Enqueueing loops
 // - if tiling enabled, add to the list
@@ -174,19 +554,60 @@ void ops_enqueue_kernel(ops_kernel_descriptor *desc) {
 
   OPS_instance *instance = desc->block->instance;
 
-  if (instance->ops_enable_tiling && instance->tiling_instance == NULL)
+  // Start the global reductions of deferred results before the next loop
+  ops_reductions_start(instance);
+
+  if (ops_lazy_queued(instance) && instance->tiling_instance == NULL)
     instance->tiling_instance = new OPS_instance_tiling();
 
-  if (instance->ops_enable_tiling)
+  if (ops_lazy_queued(instance)) {
+    // With deep halos, the queue is executed before the loops depend on more
+    // than the halos hold, loop chains are split up by _ops_loop_chain_end
+    if (instance->ops_halo_deep > 0 && chain_repeats == 0) {
+      int radius = ops_kernel_radius(desc);
+      if (ops_kernel_list.size() > 0 &&
+          queue_depth + radius > instance->ops_tiling_mpidepth)
+        ops_execute(instance);
+      queue_depth += radius;
+    }
     ops_kernel_list.push_back(desc);
-  else {
+  } else {
     //Prepare the local execution ranges
     int start[OPS_MAX_DIM]={0}, end[OPS_MAX_DIM]={1}, arg_idx[OPS_MAX_DIM];
-    if (compute_ranges(desc->args, desc->nargs,desc->block, desc->range, start, end, arg_idx) < 0) return;
+    if (compute_ranges(desc->args, desc->nargs,desc->block, desc->range, start, end, arg_idx) < 0) {
+      ops_kernel_descriptor_free(desc);
+      return;
+    }
     for (int d = 0; d < desc->block->dims; d++){
       desc->range[2*d+0] = start[d];
       desc->range[2*d+1] = end[d];
     }
+    //Hold back loops that can be fused with the following ones, their halos
+    //are exchanged now as the loops held back do not write them
+    if (instance->ops_fusion) {
+      if (instance->tiling_instance == NULL)
+        instance->tiling_instance = new OPS_instance_tiling();
+      int candidate = ops_fusion_candidate(desc);
+      if (fusion_group.size() > 0 && !(candidate && ops_fusion_fusable(instance, desc)))
+        ops_fusion_flush(instance);
+      if (candidate) {
+        double t1=0,t2=0,c;
+        if (instance->OPS_diags > 1)
+          ops_timers_core(&c,&t1);
+        ops_H_D_exchanges_host(desc->args,desc->nargs);
+        ops_halo_exchanges(desc->args,desc->nargs,desc->orig_range);
+        ops_H_D_exchanges_host(desc->args,desc->nargs);
+        if (instance->OPS_diags > 1) {
+          ops_timers_core(&c,&t2);
+          ops_timing_realloc(instance, desc->index, desc->name);
+          instance->OPS_kernels[desc->index].mpi_time += t2-t1;
+        }
+        fusion_group.push_back(desc);
+        if (ops_fusion_reduces(desc))
+          ops_fusion_flush(instance);
+        return;
+      }
+    }
     //If not tiling, I have to do the halo exchanges here
     double t1=0,t2=0,c;
     if (instance->OPS_diags > 1)
@@ -195,8 +616,13 @@ void ops_enqueue_kernel(ops_kernel_descriptor *desc) {
     //Halo exchanges
     if (desc->isdevice) ops_H_D_exchanges_device(desc->args,desc->nargs);
     else ops_H_D_exchanges_host(desc->args,desc->nargs);
-    ops_halo_exchanges(desc->args,desc->nargs,desc->orig_range);
-    if (!desc->isdevice) ops_H_D_exchanges_host(desc->args,desc->nargs);
+    int halo_depths[2*OPS_MAX_DIM];
+    int overlap = 0;
+    if (instance->ops_halo_overlap && !desc->isdevice)
+      overlap = ops_halo_exchanges_begin(desc->args,desc->nargs,desc->orig_range,halo_depths);
+    else
+      ops_halo_exchanges(desc->args,desc->nargs,desc->orig_range);
+    if (!desc->isdevice && !overlap) ops_H_D_exchanges_host(desc->args,desc->nargs);
 
     if (desc->startup_func) desc->startup_func(desc);
 
@@ -204,7 +630,10 @@ void ops_enqueue_kernel(ops_kernel_descriptor *desc) {
       ops_timers_core(&c,&t2);
     //Run the kernel
     // This function call could potentially throw
-    desc->func(desc);
+    if (overlap)
+      ops_execute_overlapped(instance, desc, halo_depths);
+    else
+      desc->func(desc);
 
     //Dirtybits
     if (desc->isdevice) ops_set_dirtybit_device(desc->args,desc->nargs);
@@ -217,21 +646,7 @@ void ops_enqueue_kernel(ops_kernel_descriptor *desc) {
       instance->OPS_kernels[desc->index].mpi_time += t2-t1;
 
     if (desc->cleanup_func) desc->cleanup_func(desc);
-    for (int i = 0; i < desc->nargs; i++)
-      if (desc->args[i].argtype == OPS_ARG_GBL && desc->args[i].acc == OPS_READ) {
-        ops_free(desc->args[i].data);
-        desc->args[i].data = nullptr;
-      }
-    ops_free(desc->args);
-    desc->args = nullptr;
-    ops_free(desc->name);
-    desc->name = nullptr;
-    ops_free(desc->range);
-    desc->range = nullptr;
-    ops_free(desc->orig_range);
-    desc->orig_range = nullptr;
-    ops_free(desc);
-    desc = nullptr;
+    ops_kernel_descriptor_free(desc);
   }
 }
 
@@ -316,32 +731,298 @@ void ops_compute_mpi_dependencies(OPS_instance *instance, int loop, int d, int *
 }
 
 
+/////////////////////////////////////////////////////////////////////////
+// Tile size auto-tuning
+// - the first executions of each plan are timed with different tile sizes,
+//   then the fastest is kept
+// - times are only compared every OPS_TILING_TUNE_RUNS executions of the
+//   queue, when all processes agree on the maximum times in one reduction, so
+//   every process makes the same choice
+// - tuned sizes can be loaded from and saved to a file, keyed by plan hash
+/////////////////////////////////////////////////////////////////////////
+
+void ops_tiling_tuner_load(OPS_instance *instance) {
+  if (instance->tiling_instance->tiling_tuners_loaded) return;
+  instance->tiling_instance->tiling_tuners_loaded = 1;
+  if (instance->ops_tiling_autotune_file.empty()) return;
+  FILE *f = fopen(instance->ops_tiling_autotune_file.c_str(), "r");
+  if (f == NULL) return;
+  size_t hash;
+  int sizes[3];
+  while (fscanf(f, "%zu %d %d %d", &hash, &sizes[0], &sizes[1], &sizes[2]) == 4) {
+    if (tiling_tuners.find(hash) == tiling_tuners.end())
+      tiling_tuner_order.push_back(hash);
+    tiling_tuner &tuner = tiling_tuners[hash];
+    tuner.locked = 1;
+    for (int d = 0; d < 3; d++)
+      tuner.best[d] = sizes[d];
+  }
+  fclose(f);
+  if (instance->OPS_diags > 2)
+    ops_printf2(instance, "Loaded %d tuned tile sizes from %s\n", (int)tiling_tuners.size(),
+                instance->ops_tiling_autotune_file.c_str());
+}
+
+void ops_tiling_tuner_save(OPS_instance *instance) {
+  if (instance->ops_tiling_autotune_file.empty() || ops_get_proc() != 0) return;
+  FILE *f = fopen(instance->ops_tiling_autotune_file.c_str(), "w");
+  if (f == NULL) {
+    instance->ostream() << "Warning: could not write tuned tile sizes to " << instance->ops_tiling_autotune_file << '\n';
+    return;
+  }
+  for (auto &entry : tiling_tuners)
+    if (entry.second.locked)
+      fprintf(f, "%zu %d %d %d\n", entry.first, entry.second.best[0],
+              entry.second.best[1], entry.second.best[2]);
+  fclose(f);
+}
+
+//Sets up the candidates around the best tile sizes: halving and doubling
+//each tiled dimension
+void ops_tiling_tuner_round(tiling_tuner &tuner) {
+  tuner.candidates.clear();
+  tuner.times.clear();
+  tuner.current = 0;
+  tuner.runs = 0;
+  tuner.rounds++;
+  for (int d = 0; d < tuner.dims; d++) {
+    for (int f = 0; f < 2; f++) {
+      int sizes[3] = {tuner.best[0], tuner.best[1], tuner.best[2]};
+      sizes[d] = f == 0 ? MAX(1, sizes[d] / 2) : MIN(tuner.extent[d], sizes[d] * 2);
+      bool tried = false;
+      for (unsigned int i = 0; i < tuner.tried.size() && !tried; i += 3)
+        tried = tuner.tried[i] == sizes[0] && tuner.tried[i + 1] == sizes[1] &&
+                tuner.tried[i + 2] == sizes[2];
+      if (tried) continue;
+      tuner.candidates.insert(tuner.candidates.end(), sizes, sizes + 3);
+      tuner.tried.insert(tuner.tried.end(), sizes, sizes + 3);
+      tuner.times.push_back(DBL_MAX);
+    }
+  }
+  if (tuner.candidates.empty()) tuner.locked = 1;
+}
+
+//Sets the tile sizes a plan should be built with, starting the tuning of the
+//plan from the given sizes if it is not known yet
+void ops_tiling_tuner_sizes(OPS_instance *instance, size_t hash, int dims,
+                            int *biggest_range, int *tile_sizes) {
+  ops_tiling_tuner_load(instance);
+  if (tiling_tuners.find(hash) == tiling_tuners.end()) {
+    tiling_tuner_order.push_back(hash);
+    tiling_tuner &tuner = tiling_tuners[hash];
+    tuner.dims = MIN(dims, 3);
+    for (int d = 0; d < 3; d++) {
+      tuner.extent[d] = d < tuner.dims ? MAX(1, biggest_range[2 * d + 1] - biggest_range[2 * d]) : 1;
+      tuner.best[d] = d >= tuner.dims ? -1 : tile_sizes[d] > 0 ? MIN(tile_sizes[d], tuner.extent[d]) : tuner.extent[d];
+    }
+    tuner.best_time = DBL_MAX;
+    tuner.candidates.assign(tuner.best, tuner.best + 3);
+    tuner.tried = tuner.candidates;
+    tuner.times.assign(1, DBL_MAX);
+  }
+  tiling_tuner &tuner = tiling_tuners[hash];
+  const int *sizes = tuner.locked ? tuner.best : &tuner.candidates[3 * tuner.current];
+  for (int d = 0; d < 3; d++)
+    tile_sizes[d] = sizes[d];
+}
+
+//Returns 1 if a plan was built with different tile sizes than the ones the
+//tuner wants to use next
+int ops_tiling_tuner_changed(OPS_instance *instance, size_t hash, const int *tile_sizes) {
+  auto it = tiling_tuners.find(hash);
+  if (it == tiling_tuners.end()) return 0;
+  const int *sizes = it->second.locked ? it->second.best : &it->second.candidates[3 * it->second.current];
+  return sizes[0] != tile_sizes[0] || sizes[1] != tile_sizes[1] || sizes[2] != tile_sizes[2];
+}
+
+//Records the execution time of a plan on this process
+void ops_tiling_tuner_record(OPS_instance *instance, size_t hash, double time) {
+  auto it = tiling_tuners.find(hash);
+  if (it == tiling_tuners.end() || it->second.locked) return;
+  tiling_tuner &tuner = it->second;
+  tuner.times[tuner.current] = MIN(tuner.times[tuner.current], time);
+  tuner.runs++;
+}
+
+//Moves a tuner on from a candidate timed on all processes
+void ops_tiling_tuner_next(OPS_instance *instance, tiling_tuner &tuner) {
+  tuner.runs = 0;
+  if (++tuner.current < (int)tuner.times.size()) return;
+
+  // All candidates timed, move to the fastest one if it is an improvement
+  int fastest = 0;
+  for (int i = 1; i < (int)tuner.times.size(); i++)
+    if (tuner.times[i] < tuner.times[fastest]) fastest = i;
+  if (tuner.times[fastest] < tuner.best_time) {
+    tuner.best_time = tuner.times[fastest];
+    for (int d = 0; d < 3; d++)
+      tuner.best[d] = tuner.candidates[3 * fastest + d];
+    if (tuner.rounds < OPS_TILING_TUNE_ROUNDS) ops_tiling_tuner_round(tuner);
+    else tuner.locked = 1;
+  } else {
+    tuner.locked = 1;
+  }
+  if (tuner.locked) {
+    tuner.candidates.clear();
+    tuner.times.clear();
+    tuner.tried.clear();
+    if (instance->OPS_diags > 2)
+      ops_printf2(instance, "Tuned tile size: %dx%dx%d (%g seconds per execution)\n",
+                  tuner.best[0], tuner.best[1], tuner.best[2], tuner.best_time);
+    ops_tiling_tuner_save(instance);
+  }
+}
+
+//Agrees on the timings of the tuners still tuning across processes, and
+//moves on the ones whose candidate was timed OPS_TILING_TUNE_RUNS times
+//everywhere. Called at the same executions of the queue on every process, so
+//the reductions match up even if processes executed different plans, the
+//tuners are compared first and tuning stops if they do not match
+void ops_tiling_tuner_agree(OPS_instance *instance) {
+  std::vector<tiling_tuner *> tuning;
+  std::vector<double> hashes;
+  for (unsigned int i = 0; i < tiling_tuner_order.size(); i++) {
+    tiling_tuner &tuner = tiling_tuners[tiling_tuner_order[i]];
+    if (tuner.locked) continue;
+    tuning.push_back(&tuner);
+    hashes.push_back((double)(tiling_tuner_order[i] & ((1ull << 52) - 1)));
+  }
+
+  // Number of tuners, and their hashes, have to match on all processes
+  double counts[2] = {(double)tuning.size(), -(double)tuning.size()};
+  double max_counts[2];
+  ops_compute_max(counts, max_counts, 2);
+  int n = (int)tuning.size();
+  int agreed = max_counts[0] == -max_counts[1];
+  if (agreed && n > 0) {
+    // Per tuner: hash, minus hash, time of the current candidate, minus the
+    // number of runs, extent and minus the initial tile sizes
+    const int stride = 10;
+    std::vector<double> values(stride * n), max_values(stride * n);
+    for (int i = 0; i < n; i++) {
+      tiling_tuner &tuner = *tuning[i];
+      double *v = &values[stride * i];
+      v[0] = hashes[i];
+      v[1] = -hashes[i];
+      v[2] = tuner.times[tuner.current];
+      v[3] = -(double)tuner.runs;
+      for (int d = 0; d < 3; d++) {
+        v[4 + d] = tuner.extent[d];
+        v[7 + d] = -(double)tuner.candidates[3 * tuner.current + d];
+      }
+    }
+    ops_compute_max(&values[0], &max_values[0], stride * n);
+    for (int i = 0; i < n && agreed; i++)
+      agreed = max_values[stride * i] == -max_values[stride * i + 1];
+    for (int i = 0; i < n && agreed; i++) {
+      tiling_tuner &tuner = *tuning[i];
+      double *v = &max_values[stride * i];
+      if (-v[3] < OPS_TILING_TUNE_RUNS) continue;
+      // The starting tile sizes and the extent may differ between processes,
+      // all of them carry on from the smallest sizes within the largest extent
+      if (tuner.rounds == 0) {
+        for (int d = 0; d < 3; d++) {
+          tuner.extent[d] = (int)v[4 + d];
+          tuner.best[d] = tuner.candidates[d] = -(int)v[7 + d];
+        }
+        tuner.tried = tuner.candidates;
+      }
+      tuner.times[tuner.current] = v[2];
+      ops_tiling_tuner_next(instance, tuner);
+    }
+  }
+  if (!agreed) {
+    if (instance->OPS_diags > 1)
+      ops_printf2(instance, "Warning: processes executed different tiling plans, tile size tuning stopped\n");
+    for (int i = 0; i < n; i++) {
+      tuning[i]->locked = 1;
+      tuning[i]->candidates.clear();
+      tuning[i]->times.clear();
+      tuning[i]->tried.clear();
+    }
+  }
+}
+
 /////////////////////////////////////////////////////////////////////////
 // Creating a new tiling plan
 /////////////////////////////////////////////////////////////////////////
 
-int ops_construct_tile_plan(OPS_instance *instance) {
+//Guesses the shape of tiles with a given number of points, to be executed
+//by nthreads threads
+void ops_guess_tile_sizes(int dims, int points_per_tile, int nthreads,
+                          int *biggest_range, int *tile_sizes) {
+  if (dims == 2) {
+    // aim for an X size twice as much as the Y size, and the Y size an
+    // integer multiple of the #of threads
+    int M = (int)sqrt(points_per_tile /
+                 (3 * nthreads * nthreads));
+    tile_sizes[0] = 3 * M * nthreads;
+    tile_sizes[1] = M * nthreads;
+    // Sanity check
+    if (tile_sizes[0] <= 0 || tile_sizes[1] <= 0)
+      tile_sizes[0] = tile_sizes[1] = -1;
+  } else if (dims == 3) {
+    // determine X size so at least 10*#of max threads is left for Y*Z
+    tile_sizes[0] = biggest_range[1] - biggest_range[0];
+    while ((double)points_per_tile / (double)tile_sizes[0] <
+           10.0 * nthreads)
+      tile_sizes[0] = tile_sizes[0] / 2;
+    tile_sizes[2] = (int)sqrt((double)points_per_tile / (double)tile_sizes[0]);
+    tile_sizes[1] = points_per_tile / (tile_sizes[0] * tile_sizes[2]);
+    // Sanity check
+    if (tile_sizes[0] <= 0 || tile_sizes[1] <= 0 || tile_sizes[2] <= 0)
+      tile_sizes[0] = tile_sizes[1] = tile_sizes[2] = -1;
+  }
+}
+
+int ops_construct_tile_plan(OPS_instance *instance, size_t hash, int slot) {
   // Create new tiling plan
   double t1, t2, c1, c2;
   ops_timers_core(&c1, &t1);
 
+  //
+  // Find a slot for the plan unless rebuilding an existing one, evicting the
+  // least recently used plan if the cache is full
+  //
+  if (slot != -1) {
+    tiling_plans[slot] = tiling_plan();
+  } else if (instance->ops_tiling_plans_max > 0 &&
+             (int)tiling_plans.size() >= instance->ops_tiling_plans_max) {
+    slot = 0;
+    for (int i = 1; i < (int)tiling_plans.size(); i++)
+      if (tiling_plans[i].last_used < tiling_plans[slot].last_used) slot = i;
+    auto matches = tiling_plan_index.equal_range(tiling_plans[slot].hash);
+    for (auto it = matches.first; it != matches.second; ++it)
+      if (it->second == slot) {
+        tiling_plan_index.erase(it);
+        break;
+      }
+    tiling_plans[slot] = tiling_plan();
+    tiling_plan_index.insert(std::make_pair(hash, slot));
+    instance->ops_tiling_plan_evictions++;
+  } else {
+    slot = (int)tiling_plans.size();
+    tiling_plans.resize(tiling_plans.size() + 1);
+    tiling_plan_index.insert(std::make_pair(hash, slot));
+  }
+  tiling_plans[slot].hash = hash;
+
   //
   // Set up pointers
   //
 
-  tiling_plans.resize(tiling_plans.size() + 1);
   std::vector<std::vector<int> > &tiled_ranges =
-      tiling_plans[tiling_plans.size() - 1].tiled_ranges;
+      tiling_plans[slot].tiled_ranges;
   std::vector<ops_dat> &dats_to_exchange = 
-      tiling_plans[tiling_plans.size() - 1].dats_to_exchange;
+      tiling_plans[slot].dats_to_exchange;
   std::vector<int> &depths_to_exchange = 
-      tiling_plans[tiling_plans.size() - 1].depths_to_exchange;
+      tiling_plans[slot].depths_to_exchange;
 
-  tiling_plans[tiling_plans.size() - 1].nloops = (int)ops_kernel_list.size();
-  tiling_plans[tiling_plans.size() - 1].loop_sequence.resize(
+  tiling_plans[slot].nloops = (int)ops_kernel_list.size();
+  tiling_plans[slot].loop_sequence.resize(
       ops_kernel_list.size());
   for (unsigned int i = 0; i < ops_kernel_list.size(); i++)
-    tiling_plans[tiling_plans.size() - 1].loop_sequence[i] =
+    tiling_plans[slot].loop_sequence[i] =
         ops_kernel_list[i]->hash;
 
   //
@@ -389,6 +1070,10 @@ int ops_construct_tile_plan(OPS_instance *instance) {
   TILE2D = instance->tilesize_y;
   TILE3D = instance->tilesize_z;
   int tile_sizes[5] = {TILE1D, TILE2D, TILE3D, TILE4D, TILE5D};
+  // Deep halos without tiling execute each loop over the whole domain at once
+  if (!instance->ops_enable_tiling)
+    for (int d = 0; d < 5; d++)
+      tile_sizes[d] = -1;
   // Initialise tiling datasets
   tiled_ranges.resize(ops_kernel_list.size());
 
@@ -416,34 +1101,49 @@ int ops_construct_tile_plan(OPS_instance *instance) {
   if (instance->OPS_diags > 3)
       ops_printf2(instance, "Bytes per gridpoint: %g\n", data_per_point);
   if (tile_sizes[0] == -1 && tile_sizes[1] == -1 && tile_sizes[2] == -1 &&
-      instance->ops_cache_size != 0) {
+      instance->ops_cache_size != 0 && instance->ops_enable_tiling) {
     int points_per_tile = int((double)instance->ops_cache_size * 1000000.0 / data_per_point);
-    if (dims == 2) {
-      // aim for an X size twice as much as the Y size, and the Y size an
-      // integer multiple of the #of threads
-      int M = (int)sqrt(points_per_tile /
-                   (3 * omp_get_max_threads() * omp_get_max_threads()));
-      tile_sizes[0] = 3 * M * omp_get_max_threads();
-      tile_sizes[1] = M * omp_get_max_threads();
-      // Sanity check
-      if (tile_sizes[0] <= 0 || tile_sizes[1] <= 0)
-        tile_sizes[0] = tile_sizes[1] = -1;
-    } else if (dims == 3) {
-      // determine X size so at least 10*#of max threads is left for Y*Z
-      tile_sizes[0] = biggest_range[1] - biggest_range[0];
-      while ((double)points_per_tile / (double)tile_sizes[0] <
-             10.0 * omp_get_max_threads())
-        tile_sizes[0] = tile_sizes[0] / 2;
-      tile_sizes[2] = (int)sqrt((double)points_per_tile / (double)tile_sizes[0]);
-      tile_sizes[1] = points_per_tile / (tile_sizes[0] * tile_sizes[2]);
-      // Sanity check
-      if (tile_sizes[0] <= 0 || tile_sizes[1] <= 0 || tile_sizes[2] <= 0)
-        tile_sizes[0] = tile_sizes[1] = tile_sizes[2] = -1;
-    }
+    ops_guess_tile_sizes(dims, points_per_tile, omp_get_max_threads(), biggest_range, tile_sizes);
     if (instance->OPS_diags > 3)
       ops_printf2(instance, "Defaulting to the following tile size: %dx%dx%d\n",
                  tile_sizes[0], tile_sizes[1], tile_sizes[2]);
   }
+  if (instance->ops_tiling_autotune)
+    ops_tiling_tuner_sizes(instance, hash, dims, biggest_range, tile_sizes);
+  for (int d = 0; d < 3; d++)
+    tiling_plans[slot].tile_sizes[d] = tile_sizes[d];
+
+  //
+  // Hierarchical tiling: split tiles into sub-tiles that fit in the L2 cache.
+  // The dependency analysis below is carried out on the sub-tiles, and the
+  // sub-tiles of a tile are executed together
+  //
+  int subtiles[OPS_MAX_DIM]; // number of sub-tiles per tile, 0 if not split
+  for (int d = 0; d < OPS_MAX_DIM; d++)
+    subtiles[d] = 0;
+  if (instance->ops_tiling_l2) {
+    if (instance->ops_l2_cache_size == 0)
+      instance->ops_l2_cache_size = (int)ops_internal_get_cache_size(instance, 2);
+    // L2 caches are per core, a sub-tile is executed either by a single thread
+    // or by all of them
+    int nthreads = instance->ops_tiling_threaded ? 1 : omp_get_max_threads();
+    int l2_sizes[5] = {-1, -1, -1, -1, -1};
+    if (instance->ops_l2_cache_size != 0) {
+      int points_per_subtile = int((double)instance->ops_l2_cache_size * 1000.0 * nthreads / data_per_point);
+      ops_guess_tile_sizes(dims, points_per_subtile, nthreads, biggest_range, l2_sizes);
+    }
+    for (int d = 0; d < MIN(dims, 3); d++) {
+      int outer = tile_sizes[d] > 0 ? tile_sizes[d] : biggest_range[2 * d + 1] - biggest_range[2 * d];
+      if (l2_sizes[d] > 0 && l2_sizes[d] < outer) {
+        subtiles[d] = outer / l2_sizes[d];
+        tile_sizes[d] = (outer + subtiles[d] - 1) / subtiles[d];
+        tiling_plans[slot].subtiled = 1;
+      }
+    }
+    if (instance->OPS_diags > 3)
+      ops_printf2(instance, "Sub-tile size for the L2 cache: %dx%dx%d\n",
+                 tile_sizes[0], tile_sizes[1], tile_sizes[2]);
+  }
 
   //
   // Compute max number of tiles in each dimension
@@ -476,7 +1176,52 @@ int ops_construct_tile_plan(OPS_instance *instance) {
 
   // Compute grand total number of tiles
   int total_tiles = tiles_prod[OPS_MAX_DIM];
-  tiling_plans[tiling_plans.size() - 1].ntiles = total_tiles;
+  tiling_plans[slot].ntiles = total_tiles;
+
+  //
+  // Group tiles into wavefronts: a tile only depends on tiles with smaller or
+  // equal indices in every dimension, so tiles on the same anti-diagonal of
+  // the tile grid can be executed concurrently. With sub-tiles, this is done
+  // within each block of sub-tiles making up a tile, the blocks themselves are
+  // executed one after the other
+  //
+  std::vector<int> &wavefront_offsets =
+      tiling_plans[slot].wavefront_offsets;
+  std::vector<int> &wavefront_tiles =
+      tiling_plans[slot].wavefront_tiles;
+  int block_tiles[OPS_MAX_DIM], blocks_prod[OPS_MAX_DIM + 1];
+  int block_wavefronts = 1;
+  blocks_prod[0] = 1;
+  for (int d = 0; d < OPS_MAX_DIM; d++) {
+    block_tiles[d] = subtiles[d] > 0 ? subtiles[d] : ntiles[d];
+    block_wavefronts += block_tiles[d] - 1;
+    blocks_prod[d + 1] = blocks_prod[d] * ((ntiles[d] - 1) / block_tiles[d] + 1);
+  }
+  int nwavefronts = blocks_prod[OPS_MAX_DIM] * block_wavefronts;
+  std::vector<int> tile_wavefront(total_tiles);
+  for (int tile = 0; tile < total_tiles; tile++) {
+    int block = 0, wavefront = 0;
+    for (int d = 0; d < OPS_MAX_DIM; d++) {
+      int idx = (tile / tiles_prod[d]) % ntiles[d];
+      block += (idx / block_tiles[d]) * blocks_prod[d];
+      wavefront += idx % block_tiles[d];
+    }
+    tile_wavefront[tile] = block * block_wavefronts + wavefront;
+  }
+  wavefront_offsets.assign(nwavefronts + 1, 0);
+  wavefront_tiles.resize(total_tiles);
+  for (int tile = 0; tile < total_tiles; tile++)
+    wavefront_offsets[tile_wavefront[tile] + 1]++;
+  for (int w = 0; w < nwavefronts; w++)
+    wavefront_offsets[w + 1] += wavefront_offsets[w];
+  {
+    std::vector<int> fill(wavefront_offsets.begin(), wavefront_offsets.end() - 1);
+    for (int tile = 0; tile < total_tiles; tile++)
+      wavefront_tiles[fill[tile_wavefront[tile]]++] = tile;
+  }
+  // Drop the empty wavefronts of partial blocks
+  wavefront_offsets.erase(std::unique(wavefront_offsets.begin(), wavefront_offsets.end()),
+                          wavefront_offsets.end());
 
   //
   // Initialise storage
@@ -828,48 +1573,70 @@ int ops_construct_tile_plan(OPS_instance *instance) {
     printf2(instance,"Created tiling plan for %d loops in %g seconds, with tile size: %dx%dx%d\n", int(ops_kernel_list.size()), t2 - t1, tile_sizes[0], tile_sizes[1], tile_sizes[2]);
 
   // return index to newly created tiling plan
-  return (int)tiling_plans.size() - 1;
+  return slot;
 }
 
 ////////////////////////////////////////////////////////////////////
 // Execute tiling plan
 ////////////////////////////////////////////////////////////////////
+
+//Checks if a loop has an empty execution range in a given tile
+inline int ops_tile_is_empty(OPS_instance *instance, std::vector<int> &ranges, int tile) {
+  return ranges[OPS_MAX_DIM * 2 * tile + 1] - ranges[OPS_MAX_DIM * 2 * tile + 0] == 0 ||
+         (ops_dims_tiling_internal > 1 &&
+          ranges[OPS_MAX_DIM * 2 * tile + 3] - ranges[OPS_MAX_DIM * 2 * tile + 2] == 0) ||
+         (ops_dims_tiling_internal > 2 &&
+          ranges[OPS_MAX_DIM * 2 * tile + 5] - ranges[OPS_MAX_DIM * 2 * tile + 4] == 0);
+}
+
 void ops_execute(OPS_instance *instance) {
 
   if(instance == NULL)
     instance = OPS_instance::getOPSInstance();
 
-  if (!instance->ops_enable_tiling) return;
+  ops_fusion_flush(instance);
+  if (!ops_lazy_queued(instance)) return;
   if (instance->tiling_instance == NULL)
     instance->tiling_instance = new OPS_instance_tiling();
+  queue_depth = 0;
   if (ops_kernel_list.size() == 0)
     return;
+  if (chain_repeats) chain_broken = 1;
 
   // Try to find an existing tiling plan for this sequence of loops which is
   // 
   //       instance->tiling_instance->ops_kernel_list
   // 
   // which is a vector of ops_kernel_descriptors
+  //
+  // Plans are indexed by the combined hash of the loops (which includes their
+  // ranges and datasets), the loop hashes are compared on a hash match
+  size_t hash = 5381;
+  for (unsigned int j = 0; j < ops_kernel_list.size(); j++)
+    hash = ((hash << 5) + hash) + ops_kernel_list[j]->hash;
   int match = -1;
-  for (unsigned int i = 0; i < tiling_plans.size(); i++) {
-    if (int(ops_kernel_list.size()) == tiling_plans[i].nloops) {
-      int count = 0;
-      for (unsigned int j = 0; j < ops_kernel_list.size(); j++) {
-        if (ops_kernel_list[j]->hash == tiling_plans[i].loop_sequence[j])
-          count++;
-        else
-          break;
-      }
-      if (count == int(ops_kernel_list.size())) {
-        match = i;
-        break;
-      }
-    }
+  auto matches = tiling_plan_index.equal_range(hash);
+  for (auto it = matches.first; it != matches.second && match == -1; ++it) {
+    tiling_plan &plan = tiling_plans[it->second];
+    if (int(ops_kernel_list.size()) != plan.nloops) continue;
+    unsigned int j = 0;
+    while (j < ops_kernel_list.size() && ops_kernel_list[j]->hash == plan.loop_sequence[j])
+      j++;
+    if (j == ops_kernel_list.size()) match = it->second;
   }
 
   // If not found, construct one
-  if (match == -1)
-    match = ops_construct_tile_plan(instance);
+  if (match == -1) {
+    instance->ops_tiling_plan_misses++;
+    match = ops_construct_tile_plan(instance, hash, -1);
+  } else {
+    instance->ops_tiling_plan_hits++;
+    // Rebuild the plan if the auto-tuner moved on to different tile sizes
+    if (instance->ops_tiling_autotune &&
+        ops_tiling_tuner_changed(instance, hash, tiling_plans[match].tile_sizes))
+      ops_construct_tile_plan(instance, hash, match);
+  }
+  tiling_plans[match].last_used = tiling_plan_clock++;
   std::vector<std::vector<int> > &tiled_ranges =
       tiling_plans[match].tiled_ranges;
   int total_tiles = tiling_plans[match].ntiles;
@@ -895,34 +1662,102 @@ void ops_execute(OPS_instance *instance) {
     if (ops_kernel_list[i]->startup_func) ops_kernel_list[i]->startup_func(ops_kernel_list[i]);
   }
   //Execute tiles
-  for (int tile = 0; tile < total_tiles; tile++) {
-    for (unsigned int i = 0; i < ops_kernel_list.size(); i++) {
-
-      if (tiled_ranges[i][OPS_MAX_DIM * 2 * tile + 1] -
-                  tiled_ranges[i][OPS_MAX_DIM * 2 * tile + 0] ==
-              0 ||
-          (ops_dims_tiling_internal > 1 &&
-           tiled_ranges[i][OPS_MAX_DIM * 2 * tile + 3] -
-                   tiled_ranges[i][OPS_MAX_DIM * 2 * tile + 2] ==
-               0) ||
-          (ops_dims_tiling_internal > 2 &&
-           tiled_ranges[i][OPS_MAX_DIM * 2 * tile + 5] -
-                   tiled_ranges[i][OPS_MAX_DIM * 2 * tile + 4] ==
-               0))
-        continue;
-
-      for (int d = 0; d <  OPS_MAX_DIM * 2; d++) {
-        ops_kernel_list[i]->range[d] = tiled_ranges[i][OPS_MAX_DIM * 2 * tile + d];
+  double tune_t1 = 0, tune_t2 = 0;
+  if (instance->ops_tiling_autotune)
+    ops_timers_core(&c, &tune_t1);
+  int threaded = instance->ops_tiling_threaded;
+  for (unsigned int i = 0; i < ops_kernel_list.size(); i++)
+    if (ops_kernel_list[i]->isdevice) threaded = 0;
+  // With diagnostics on, the kernels record their timings in OPS_kernels
+  // (and may grow it), which is not safe from several threads
+  if (instance->OPS_diags > 1) threaded = 0;
+
+  if (threaded) {
+    // Loops with reductions update the global result in place at the end of
+    // the kernel, so those have to be serialised across tiles
+    std::vector<int> has_reduction(ops_kernel_list.size(), 0);
+    for (unsigned int i = 0; i < ops_kernel_list.size(); i++)
+      for (int arg = 0; arg < ops_kernel_list[i]->nargs; arg++)
+        if (ops_kernel_list[i]->args[arg].argtype == OPS_ARG_GBL &&
+            ops_kernel_list[i]->args[arg].acc != OPS_READ)
+          has_reduction[i] = 1;
+
+    std::vector<int> &wavefront_offsets = tiling_plans[match].wavefront_offsets;
+    std::vector<int> &wavefront_tiles = tiling_plans[match].wavefront_tiles;
+    std::exception_ptr error = nullptr;
+
+    // Kernels run on a single thread within each tile
+#if defined(_OPENMP)
+    int max_active_levels = omp_get_max_active_levels();
+    omp_set_max_active_levels(1);
+#endif
+#pragma omp parallel
+    {
+      for (unsigned int w = 0; w + 1 < wavefront_offsets.size(); w++) {
+#pragma omp for schedule(dynamic)
+        for (int t = wavefront_offsets[w]; t < wavefront_offsets[w + 1]; t++) {
+          int tile = wavefront_tiles[t];
+          for (unsigned int i = 0; i < ops_kernel_list.size(); i++) {
+            if (ops_tile_is_empty(instance, tiled_ranges[i], tile))
+              continue;
+
+            // Each thread works on a private copy of the descriptor
+            ops_kernel_descriptor desc = *ops_kernel_list[i];
+            int range[OPS_MAX_DIM * 2];
+            desc.range = range;
+            for (int d = 0; d < OPS_MAX_DIM * 2; d++)
+              range[d] = tiled_ranges[i][OPS_MAX_DIM * 2 * tile + d];
+            if (instance->OPS_diags > 4)
+              printf2(instance,"Proc %d Executing %s %d-%d %d-%d %d-%d\n", ops_get_proc(), desc.name,
+                     range[0], range[1], range[2], range[3], range[4], range[5]);
+            try {
+              if (has_reduction[i]) {
+#pragma omp critical (ops_tile_reduction)
+                desc.func(&desc);
+              } else
+                desc.func(&desc);
+            } catch (...) {
+#pragma omp critical (ops_tile_error)
+              if (error == nullptr) error = std::current_exception();
+            }
+          }
+        }
+      }
+    }
+#if defined(_OPENMP)
+    omp_set_max_active_levels(max_active_levels);
+#endif
+    if (error != nullptr) std::rethrow_exception(error);
+  } else {
+    // Sub-tiles are executed block by block
+    std::vector<int> &wavefront_tiles = tiling_plans[match].wavefront_tiles;
+    int subtiled = tiling_plans[match].subtiled;
+    for (int t = 0; t < total_tiles; t++) {
+      int tile = subtiled ? wavefront_tiles[t] : t;
+      for (unsigned int i = 0; i < ops_kernel_list.size(); i++) {
+
+        if (ops_tile_is_empty(instance, tiled_ranges[i], tile))
+          continue;
+
+        for (int d = 0; d <  OPS_MAX_DIM * 2; d++) {
+          ops_kernel_list[i]->range[d] = tiled_ranges[i][OPS_MAX_DIM * 2 * tile + d];
+        }
+        if (instance->OPS_diags > 4)
+          printf2(instance,"Proc %d Executing %s %d-%d %d-%d %d-%d\n", ops_get_proc(), ops_kernel_list[i]->name,
+                 ops_kernel_list[i]->range[0], ops_kernel_list[i]->range[1],
+                 ops_kernel_list[i]->range[2], ops_kernel_list[i]->range[3],
+                 ops_kernel_list[i]->range[4], ops_kernel_list[i]->range[5]);
+        // This function call could potentially throw
+        ops_kernel_list[i]->func(ops_kernel_list[i]);
       }
-      if (instance->OPS_diags > 4)
-        printf2(instance,"Proc %d Executing %s %d-%d %d-%d %d-%d\n", ops_get_proc(), ops_kernel_list[i]->name,
-               ops_kernel_list[i]->range[0], ops_kernel_list[i]->range[1],
-               ops_kernel_list[i]->range[2], ops_kernel_list[i]->range[3],
-               ops_kernel_list[i]->range[4], ops_kernel_list[i]->range[5]);
-      // This function call could potentially throw
-      ops_kernel_list[i]->func(ops_kernel_list[i]);
     }
   }
+  if (instance->ops_tiling_autotune) {
+    ops_timers_core(&c, &tune_t2);
+    ops_tiling_tuner_record(instance, hash, tune_t2 - tune_t1);
+    if (++instance->tiling_instance->tiling_tuner_flushes % OPS_TILING_TUNE_RUNS == 0)
+      ops_tiling_tuner_agree(instance);
+  }
 
   //Set dirtybits
   for (unsigned int i = 0; i < ops_kernel_list.size(); i++) {
@@ -936,22 +1771,7 @@ void ops_execute(OPS_instance *instance) {
 
   for (unsigned int i = 0; i < ops_kernel_list.size(); i++) {
     if (ops_kernel_list[i]->cleanup_func) ops_kernel_list[i]->cleanup_func(ops_kernel_list[i]);
-    for (int j = 0; j < ops_kernel_list[i]->nargs; j++) {
-      if (ops_kernel_list[i]->args[j].argtype == OPS_ARG_GBL && 
-          ops_kernel_list[i]->args[j].acc == OPS_READ) {
-        ops_free(ops_kernel_list[i]->args[j].data);
-        ops_kernel_list[i]->args[j].data = nullptr;
-      }
-    }
-    ops_free(ops_kernel_list[i]->args);
-    ops_kernel_list[i]->args = nullptr;
-    ops_free(ops_kernel_list[i]->name);
-    ops_kernel_list[i]->name = nullptr;
-    ops_free(ops_kernel_list[i]->range);
-    ops_kernel_list[i]->range = nullptr;
-    ops_free(ops_kernel_list[i]->orig_range);
-    ops_kernel_list[i]->orig_range = nullptr;
-    ops_free(ops_kernel_list[i]);
+    ops_kernel_descriptor_free(ops_kernel_list[i]);
     ops_kernel_list[i] = nullptr;
   }
   ops_kernel_list.clear();
@@ -959,10 +1779,9 @@ void ops_execute(OPS_instance *instance) {
 
 void create_kerneldesc_and_enque(char const *name, ops_arg *args, int nargs, int index, int dim, int isdevice, int *range, ops_block block, void (*func)(struct ops_kernel_descriptor *desc))
 {
-    ops_kernel_descriptor *desc = (ops_kernel_descriptor *)calloc(1,sizeof(ops_kernel_descriptor));
+    ops_kernel_descriptor *desc = ops_kernel_descriptor_alloc(block->instance, nargs);
 
-    desc->name = (char*) calloc(strlen(name)+1, sizeof(char));
-    strcpy(desc->name, name);       strcat(desc->name,"\0");
+    desc->name = ops_kernel_name_intern(block->instance, name);
     desc->name_len = strlen(name);
     desc->block = block;
     desc->dim = dim;
@@ -971,17 +1790,17 @@ void create_kerneldesc_and_enque(char const *name, ops_arg *args, int nargs, int
     desc->hash = 5381;
     desc->hash = ((desc->hash << 5) + desc->hash) + index;
 
-    desc->range = (int*) calloc(2*OPS_MAX_DIM, sizeof(int));
-    desc->orig_range = (int*) calloc(2*OPS_MAX_DIM, sizeof(int));
-
     for ( int i=0; i < 2*block->dims; i++ ) {
         desc->range[i] = range[i];
         desc->orig_range[i] = range[i];
         desc->hash = ((desc->hash << 5) + desc->hash) + range[i];
     }
 
-    desc->nargs = nargs;
-    desc->args = (ops_arg*)ops_malloc(nargs*sizeof(ops_arg));
+    size_t gbl_bytes = 0;
+    for ( int n=0; n < nargs; n++)
+        if (args[n].argtype == OPS_ARG_GBL && args[n].acc == OPS_READ)
+            gbl_bytes += ROUND_UP(args[n].dim*args[n].elem_size);
+    char *gbl = ops_kernel_descriptor_gbl(desc, gbl_bytes);
 
     for ( int n=0; n < nargs; n++) {
         desc->args[n] = args[n];
@@ -989,9 +1808,9 @@ void create_kerneldesc_and_enque(char const *name, ops_arg *args, int nargs, int
         if (args[n].argtype == OPS_ARG_DAT)
             desc->hash = ((desc->hash << 5) + desc->hash) + args[n].dat->index;
         if (args[n].argtype == OPS_ARG_GBL && args[n].acc == OPS_READ) {
-            char *tmp = (char*)ops_malloc(args[n].dim*args[n].elem_size);
-            memcpy(tmp, args[n].data,args[n].dim*args[n].elem_size);
-            desc->args[n].data = tmp;
+            memcpy(gbl, args[n].data,args[n].dim*args[n].elem_size);
+            desc->args[n].data = gbl;
+            gbl += ROUND_UP(args[n].dim*args[n].elem_size);
         }
     }
     desc->func = func;
@@ -999,30 +1818,114 @@ void create_kerneldesc_and_enque(char const *name, ops_arg *args, int nargs, int
     ops_enqueue_kernel(desc);  
 }
 
+/////////////////////////////////////////////////////////////////////////
+// Loop chains
+// - the loops of a chain repeated several times are passed to the tiler
+//   together, the tiles are built as for any other sequence of loops
+// - with MPI, the halos are deepened to what all repetitions depend on (up to
+//   MAX_DEPTH-1, and the narrowest process), so the chain needs a single halo
+//   exchange, otherwise it is executed in groups of repetitions that fit
+/////////////////////////////////////////////////////////////////////////
+
+//Upper bound on the halo depth needed by a sequence of queued loops
+static int ops_loop_chain_depth(OPS_instance *instance, int first, int last) {
+  int depth = 0;
+  for (int loop = first; loop < last; loop++)
+    depth += ops_kernel_radius(ops_kernel_list[loop]);
+  return depth;
+}
+
+void _ops_loop_chain_begin(OPS_instance *instance, int repeats) {
+  if (!ops_lazy_queued(instance)) return;
+  if (instance->tiling_instance == NULL)
+    instance->tiling_instance = new OPS_instance_tiling();
+  if (repeats < 1)
+    throw OPSException(OPS_INVALID_ARGUMENT, "Error: ops_loop_chain_begin called with less than one repetition");
+  if (chain_repeats)
+    throw OPSException(OPS_INVALID_ARGUMENT, "Error: ops_loop_chain_begin called within another loop chain");
+  ops_execute(instance);
+  chain_repeats = repeats;
+  chain_broken = 0;
+}
+
+void _ops_loop_chain_end(OPS_instance *instance) {
+  if (!ops_lazy_queued(instance)) return;
+  if (instance->tiling_instance == NULL || chain_repeats == 0)
+    throw OPSException(OPS_INVALID_ARGUMENT, "Error: ops_loop_chain_end called without ops_loop_chain_begin");
+  int repeats = chain_repeats;
+  chain_repeats = 0;
+  int nloops = ops_kernel_list.size();
+  if (chain_broken || nloops % repeats != 0) {
+    if (instance->OPS_diags > 1)
+      ops_printf2(instance, "Warning: loop chain of %d repetitions %s, executing its loops without deepening the halos\n",
+                  repeats, chain_broken ? "was executed before its end (e.g. by a reduction result)"
+                                        : "does not have the same number of loops in each repetition");
+    if (instance->ops_halo_deep <= 0) {
+      ops_execute(instance);
+      return;
+    }
+    // With deep halos, the loops are executed in the longest runs that fit
+    std::vector<ops_kernel_descriptor *> chain;
+    chain.swap(ops_kernel_list);
+    for (unsigned int first = 0; first < chain.size();) {
+      unsigned int last = first + 1;
+      int depth = ops_kernel_radius(chain[first]);
+      while (last < chain.size() &&
+             depth + ops_kernel_radius(chain[last]) <= instance->ops_tiling_mpidepth)
+        depth += ops_kernel_radius(chain[last++]);
+      ops_kernel_list.assign(chain.begin() + first, chain.begin() + last);
+      ops_execute(instance);
+      first = last;
+    }
+    return;
+  }
+
+  int loops_per_repeat = nloops / repeats;
+  int depth = ops_loop_chain_depth(instance, 0, loops_per_repeat);
+  int olddepth = instance->ops_tiling_mpidepth;
+  int mpidepth = ops_halo_deepen(instance, depth * repeats);
+  // The datasets were reallocated with the deeper halos under the queued loops
+  for (int loop = 0; mpidepth != olddepth && loop < nloops; loop++) {
+    for (int arg = 0; arg < ops_kernel_list[loop]->nargs; arg++) {
+      ops_arg &a = ops_kernel_list[loop]->args[arg];
+      if (a.argtype != OPS_ARG_DAT || a.dat == NULL) continue;
+      a.data = a.dat->data;
+      a.data_d = a.dat->data_d;
+    }
+  }
+  int group = depth > 0 ? MAX(1, mpidepth / depth) : repeats;
+  group = MIN(group, repeats);
+  if (instance->OPS_diags > 3)
+    ops_printf2(instance, "Executing loop chain of %d loops, %d repetitions in groups of %d\n",
+                loops_per_repeat, repeats, group);
+
+  std::vector<ops_kernel_descriptor *> chain;
+  chain.swap(ops_kernel_list);
+  for (int r = 0; r < repeats; r += group) {
+    int last = MIN(r + group, repeats);
+    ops_kernel_list.assign(chain.begin() + r * loops_per_repeat,
+                           chain.begin() + last * loops_per_repeat);
+    ops_execute(instance);
+  }
+}
+
+// Drops the tiling plans, which are only valid for the current decomposition
+void ops_tiling_plans_free(OPS_instance *instance) {
+  if (instance->tiling_instance == NULL) return;
+  tiling_plans.clear();
+  tiling_plan_index.clear();
+}
+
 // This funtion called from OPS_instance destructor
 void ops_exit_lazy(OPS_instance *instance) {
   if (instance->tiling_instance == NULL) return;
   for (unsigned int i = 0; i < ops_kernel_list.size(); i++) {
     if (ops_kernel_list[i]->cleanup_func) ops_kernel_list[i]->cleanup_func(ops_kernel_list[i]);
-    for (int j = 0; j < ops_kernel_list[i]->nargs; j++) {
-      if (ops_kernel_list[i]->args[j].argtype == OPS_ARG_GBL && 
-          ops_kernel_list[i]->args[j].acc == OPS_READ) {
-        ops_free(ops_kernel_list[i]->args[j].data);
-        ops_kernel_list[i]->args[j].data = nullptr;
-      }
-    }
-    ops_free(ops_kernel_list[i]->args);
-    ops_kernel_list[i]->args = nullptr;
-    ops_free(ops_kernel_list[i]->name);
-    ops_kernel_list[i]->name = nullptr;
-    ops_free(ops_kernel_list[i]->range);
-    ops_kernel_list[i]->range = nullptr;
-    ops_free(ops_kernel_list[i]->orig_range);
-    ops_kernel_list[i]->orig_range = nullptr;
-    ops_free(ops_kernel_list[i]);
+    ops_kernel_descriptor_free(ops_kernel_list[i]);
     ops_kernel_list[i] = nullptr;
   }
   ops_kernel_list.clear();
+  ops_kernel_descriptor_pool_exit(instance);
   delete instance->tiling_instance;
   instance->tiling_instance = nullptr;
 }
@@ -135,6 +135,12 @@ void _ops_set_args(OPS_instance *instance, const char *argv) {
     instance->ops_cache_size = atoi(temp + 15);
     if (instance->is_root()) instance->ostream() << "\n Cache size per process = " << instance->ops_cache_size << '\n';
   }
+  pch = strstr(argv, "OPS_L2_CACHE_SIZE=");
+  if (pch != NULL) {
+    snprintf(temp, 64, "%s", pch);
+    instance->ops_l2_cache_size = atoi(temp + 18);
+    if (instance->is_root()) instance->ostream() << "\n L2 cache size per core (KB) = " << instance->ops_l2_cache_size << '\n';
+  }
   pch = strstr(argv, "OPS_REALLOC=");
   if (pch != NULL) {
     snprintf(temp, 64, "%s", pch);
@@ -153,6 +159,90 @@ void _ops_set_args(OPS_instance *instance, const char *argv) {
     instance->ops_tiling_mpidepth = atoi(temp + 20);
     if (instance->is_root()) instance->ostream() << "\n Max tiling depth across processes = " << instance->ops_tiling_mpidepth << '\n';
   }
+  pch = strstr(argv, "OPS_TILING_L2");
+  if (pch != NULL) {
+    instance->ops_tiling_l2 = 1;
+    if (instance->is_root()) instance->ostream() << "\n Hierarchical tiling for the L3 and L2 caches\n";
+  }
+  pch = strstr(argv, "OPS_TILING_PLANS_MAX=");
+  if (pch != NULL) {
+    snprintf(temp, 64, "%s", pch);
+    instance->ops_tiling_plans_max = atoi(temp + 21);
+    if (instance->is_root()) instance->ostream() << "\n Max number of cached tiling plans = " << instance->ops_tiling_plans_max << '\n';
+  }
+  pch = strstr(argv, "OPS_TILING_AUTOTUNE");
+  if (pch != NULL) {
+    instance->ops_tiling_autotune = 1;
+    if (instance->is_root()) instance->ostream() << "\n Auto-tuning tile sizes\n";
+  }
+  pch = strstr(argv, "OPS_TILING_AUTOTUNE_FILE=");
+  if (pch != NULL) {
+    std::string file(pch + 25);
+    instance->ops_tiling_autotune_file = file.substr(0, file.find(' '));
+    if (instance->is_root()) instance->ostream() << "\n Tuned tile sizes file = " << instance->ops_tiling_autotune_file << '\n';
+  }
+  pch = strstr(argv, "OPS_TILING_THREADED");
+  if (pch != NULL) {
+    instance->ops_tiling_threaded = 1;
+    if (instance->is_root()) instance->ostream() << "\n Thread-parallel tile execution enabled\n";
+  }
+  pch = strstr(argv, "OPS_FUSION");
+  if (pch != NULL) {
+    instance->ops_fusion = 1;
+    if (instance->is_root()) instance->ostream() << "\n Fusing consecutive loops with point-wise dependencies\n";
+  }
+  pch = strstr(argv, "OPS_HALO_OVERLAP");
+  if (pch != NULL) {
+    instance->ops_halo_overlap = 1;
+    if (instance->is_root()) instance->ostream() << "\n Overlapping halo exchanges with computation\n";
+  }
+  pch = strstr(argv, "OPS_COMM_THREAD");
+  if (pch != NULL) {
+    if (ops_thread_multiple_dynamic != NULL && !ops_thread_multiple_dynamic()) {
+      if (instance->is_root()) instance->ostream() << "\n Warning: MPI does not provide MPI_THREAD_MULTIPLE, OPS_COMM_THREAD ignored\n";
+    } else {
+      instance->ops_comm_thread = 1;
+      instance->ops_halo_overlap = 1;
+      if (instance->is_root()) instance->ostream() << "\n Halo exchanges and reductions on a separate communication thread\n";
+    }
+  }
+  pch = strstr(argv, "OPS_HALO_AGGREGATE");
+  if (pch != NULL) {
+    instance->ops_halo_aggregate = 1;
+    if (instance->is_root()) instance->ostream() << "\n Aggregating halo exchanges of all dimensions\n";
+  }
+  pch = strstr(argv, "OPS_HALO_PLANS");
+  if (pch != NULL) {
+    instance->ops_halo_aggregate = 1;
+    instance->ops_halo_plans = 1;
+    if (instance->is_root()) instance->ostream() << "\n Caching halo exchange plans with persistent requests\n";
+  }
+  pch = strstr(argv, "OPS_HALO_SHARED");
+  if (pch != NULL) {
+    instance->ops_halo_shared = 1;
+    if (instance->is_root()) instance->ostream() << "\n Copying halos directly between processes on the same node\n";
+  }
+  pch = strstr(argv, "OPS_HALO_DEEP=");
+  if (pch != NULL) {
+    snprintf(temp, 64, "%s", pch);
+    instance->ops_halo_deep = atoi(temp + 14);
+    if (instance->is_root()) instance->ostream() << "\n Deep halos with redundant computation, depth = " << instance->ops_halo_deep << '\n';
+  }
+  pch = strstr(argv, "OPS_PARTITION_WEIGHTED");
+  if (pch != NULL) {
+    instance->ops_partition_weighted = 1;
+    if (instance->is_root()) instance->ostream() << "\n Assigning processes to blocks in proportion to their size\n";
+  }
+  pch = strstr(argv, "OPS_PARTITION_TOPOLOGY");
+  if (pch != NULL) {
+    snprintf(temp, 64, "%s", pch);
+    instance->ops_partition_topology = temp[22] == '=' ? atoi(temp + 23) : -1;
+    if (instance->is_root()) {
+      instance->ostream() << "\n Keeping neighbouring processes on the same node";
+      if (instance->ops_partition_topology > 0) instance->ostream() << ", " << instance->ops_partition_topology << " processes per node";
+      instance->ostream() << '\n';
+    }
+  }
   pch = strstr(argv, "OPS_PROCESSES_PER_BLOCK=");
   if (pch != NULL) {
     snprintf(temp, 64, "%s", pch);
@@ -222,21 +312,67 @@ void _ops_set_args(OPS_instance *instance, const char *argv) {
     if (instance->is_root()) instance->ostream() << "\n OPS Checkpointing enabled\n";
   }
 
-  /*pch = strstr(argv, "OPS_HDF5_CHUNK_SIZE=");
+  pch = strstr(argv, "OPS_IO_ASYNC");
   if (pch != NULL) {
-    strncpy(temp, pch, 25);
-    for (int i = 0; i < OPS_MAX_DIM; i++)
-      ops_hdf5_chunk_size[i] = MAX(atoi(temp + 20),1);
-    ops_printf("\n HDF5 write chunck size = (%d)^%s \n",
-      ops_hdf5_chunk_size[0],OPS_MAX_DIM);
-  }*/
+    if (ops_thread_multiple_dynamic != NULL && !ops_thread_multiple_dynamic()) {
+      if (instance->is_root()) instance->ostream() << "\n Warning: MPI does not provide MPI_THREAD_MULTIPLE, OPS_IO_ASYNC ignored\n";
+    } else {
+      snprintf(temp, 64, "%s", pch);
+      instance->ops_io_async = temp[12] == '=' ? MAX(atoi(temp + 13), 1) : 2;
+      if (instance->is_root()) instance->ostream() << "\n Asynchronous HDF5 output, " << instance->ops_io_async << " snapshots in flight\n";
+    }
+  }
+
+  pch = strstr(argv, "OPS_HDF5_CHUNK_SIZE=");
+  if (pch != NULL) {
+    snprintf(temp, 64, "%s", pch);
+    instance->ops_hdf5_chunk_size = MAX(atoi(temp + 20), 1);
+    if (instance->is_root()) instance->ostream() << "\n HDF5 write chunk size = " << instance->ops_hdf5_chunk_size << " points per dimension\n";
+  } else if (strstr(argv, "OPS_HDF5_CHUNK") != NULL) {
+    instance->ops_hdf5_chunk_size = -1;
+    if (instance->is_root()) instance->ostream() << "\n HDF5 write chunks aligned with the decomposition\n";
+  }
+  pch = strstr(argv, "OPS_HDF5_DEFLATE");
+  if (pch != NULL) {
+    snprintf(temp, 64, "%s", pch);
+    instance->ops_hdf5_deflate = temp[16] == '=' ? MIN(MAX(atoi(temp + 17), 1), 9) : 1;
+    if (instance->is_root()) instance->ostream() << "\n HDF5 deflate compression, level " << instance->ops_hdf5_deflate << '\n';
+  }
+  if (strstr(argv, "OPS_HDF5_SHUFFLE") != NULL) {
+    instance->ops_hdf5_shuffle = 1;
+    if (instance->is_root()) instance->ostream() << "\n HDF5 byte shuffle filter\n";
+  }
+  if (strstr(argv, "OPS_HDF5_LZ4") != NULL) {
+    instance->ops_hdf5_lz4 = 1;
+    if (instance->is_root()) instance->ostream() << "\n HDF5 LZ4 compression\n";
+  }
+  pch = strstr(argv, "OPS_HDF5_LOSSY=");
+  if (pch != NULL) {
+    snprintf(temp, 64, "%s", pch);
+    instance->ops_hdf5_lossy = MAX(atoi(temp + 15), 0);
+    if (instance->is_root()) instance->ostream() << "\n HDF5 lossy compression, floating point values kept to " << instance->ops_hdf5_lossy << " decimal digits\n";
+  }
+  pch = strstr(argv, "OPS_HDF5_AGGREGATORS=");
+  if (pch != NULL) {
+    snprintf(temp, 64, "%s", pch);
+    instance->ops_hdf5_aggregators = MAX(atoi(temp + 21), 0);
+    if (instance->is_root()) instance->ostream() << "\n HDF5 writes aggregated onto " << instance->ops_hdf5_aggregators << " processes\n";
+  }
 
 
 }
 
+// Deep halos need MPI halos at least as deep, whichever order OPS_HALO_DEEP
+// and OPS_TILING_MAXDEPTH were given in
+static void ops_set_args_halo_depth(OPS_instance *instance) {
+  if (instance->ops_halo_deep > 0)
+    instance->ops_tiling_mpidepth = MAX(instance->ops_tiling_mpidepth, instance->ops_halo_deep);
+}
+
 extern "C" void ops_set_args_ftn(char *argv, int len) {
   argv[len]='\0';
   _ops_set_args(OPS_instance::getOPSInstance(), argv);
+  ops_set_args_halo_depth(OPS_instance::getOPSInstance());
 }
 
 /* Special function only called by fortran backend to get
@@ -245,6 +381,7 @@ Fortran to C
 */
 extern "C" void ops_set_args(const char *argv) {
   _ops_set_args(OPS_instance::getOPSInstance(), argv);
+  ops_set_args_halo_depth(OPS_instance::getOPSInstance());
 }
 
 /*
@@ -255,12 +392,18 @@ void ops_init_core(OPS_instance *instance, const int argc, const char *const arg
   for (int n = 1; n < argc; n++) {
     _ops_set_args(instance, argv[n]);
   }
+  ops_set_args_halo_depth(instance);
 
   /*Initialize the double linked list to hold ops_dats*/
   TAILQ_INIT(&instance->OPS_dat_list);
 }
 
+void (*ops_io_stop_dynamic)() = NULL;
+void (*ops_io_wait_dynamic)() = NULL;
+int (*ops_thread_multiple_dynamic)() = NULL;
+
 void ops_exit_core(OPS_instance *instance) {
+  if (ops_io_stop_dynamic != NULL) ops_io_stop_dynamic();
   ops_checkpointing_exit(instance);
   ops_exit_lazy(instance);
   ops_dat_entry *item = TAILQ_FIRST(&instance->OPS_dat_list);
@@ -401,6 +544,11 @@ ops_block ops_decl_block(int dims, const char *name) {
   return _ops_decl_block(OPS_instance::getOPSInstance(), dims, name);
 }
 
+void ops_block_set_periodic(ops_block block, const int *periodic) {
+  for (int d = 0; d < block->dims; d++)
+    block->periodic[d] = periodic[d] != 0;
+}
+
 void ops_decl_const_core(int dim, char const *type, int typeSize, char *data,
                          char const *name) {
   (void)dim;
@@ -1063,6 +1211,16 @@ void ops_reduction_result_char(ops_reduction handle, int type_size, char *ptr) {
   handle->initialized = 0;
 }
 
+void ops_reduction_result_deferred_char(ops_reduction handle, int type_size, char *ptr) {
+  // Checkpointing records reduction results as they are read
+  if (handle->instance->OPS_enable_checkpointing) {
+    ops_reduction_result_char(handle, type_size, ptr);
+    return;
+  }
+  ops_reduction_defer(handle, ptr);
+  handle->initialized = 0;
+}
+
 
 void _ops_diagnostic_output(OPS_instance *instance) {
   if (instance->OPS_diags > 2) {
@@ -1297,6 +1455,14 @@ void ops_print_dat_to_txtfile_core(ops_dat dat, const char* file_name_in)
 
 void ops_timing_output_stdout() { ops_timing_output(std::cout); }
 
+void ops_loop_chain_begin(int repeats) {
+  _ops_loop_chain_begin(OPS_instance::getOPSInstance(), repeats);
+}
+
+void ops_loop_chain_end() {
+  _ops_loop_chain_end(OPS_instance::getOPSInstance());
+}
+
 void _ops_timing_output(OPS_instance *instance, std::ostream &stream) {
 
   if (instance->OPS_diags > 1)
@@ -1364,6 +1530,11 @@ void _ops_timing_output(OPS_instance *instance, std::ostream &stream) {
       ops_fprintf2(stream, "Total halo exchange time: %g\n", sumtime_mpi);
     }
 
+    if (instance->ops_enable_tiling)
+      ops_fprintf2(stream, "Tiling plan cache: %ld hits, %ld misses, %ld evictions\n",
+                   instance->ops_tiling_plan_hits, instance->ops_tiling_plan_misses,
+                   instance->ops_tiling_plan_evictions);
+
     moments_time[0] = 0.0;
     ops_compute_moment(instance->ops_user_halo_exchanges_time, &moments_time[0], &moments_time[1]);
     if (moments_time[0] > 0.0) {
@@ -1909,9 +2080,7 @@ void ops_internal_copy_seq(ops_kernel_descriptor *desc) {
 ops_kernel_descriptor * ops_dat_deep_copy_core(ops_dat target, ops_dat orig_dat, int *range) 
 {
     ops_kernel_descriptor *desc =
-        (ops_kernel_descriptor *)ops_calloc(1, sizeof(ops_kernel_descriptor));
-    desc->range = (int*) calloc(2*OPS_MAX_DIM, sizeof(int));
-    desc->orig_range = (int*) calloc(2*OPS_MAX_DIM, sizeof(int));
+        ops_kernel_descriptor_alloc(orig_dat->block->instance, 2);
 
     //  desc->name = "ops_internal_copy_seq";
     desc->block = orig_dat->block;
@@ -1926,8 +2095,6 @@ ops_kernel_descriptor * ops_dat_deep_copy_core(ops_dat target, ops_dat orig_dat,
         desc->orig_range[i] = range[i];
         desc->hash = ((desc->hash << 5) + desc->hash) + range[i];
     }
-    desc->nargs = 2;
-    desc->args = (ops_arg *)ops_malloc(2 * sizeof(ops_arg));
     desc->args[0] = ops_arg_dat(orig_dat, orig_dat->dim, desc->block->instance->OPS_internal_0[orig_dat->block->dims -1], orig_dat->type, OPS_READ);
     desc->hash = ((desc->hash << 5) + desc->hash) + desc->args[0].dat->index;
     desc->args[1] = ops_arg_dat(target, orig_dat->dim, desc->block->instance->OPS_internal_0[orig_dat->block->dims -1], orig_dat->type, OPS_WRITE);
@@ -2176,6 +2343,7 @@ void ops_upload_gbls(ops_arg* args, int nargs) {
 
 void ops_free_dat(ops_dat dat) {
   ops_execute();
+  if (ops_io_wait_dynamic != NULL) ops_io_wait_dynamic();
   delete dat;
 }
 
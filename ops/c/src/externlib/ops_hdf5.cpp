@@ -66,6 +66,7 @@ static char *copy_str(char const *src) {
 }
 
 void ops_fetch_block_hdf5_file(ops_block block, char const *file_name) {
+  ops_io_wait();
   // HDF5 APIs definitions
   hid_t file_id;  // file identifier
   hid_t group_id; // group identifier
@@ -122,6 +123,7 @@ void ops_fetch_block_hdf5_file(ops_block block, char const *file_name) {
  *******************************************************************************/
 
 void ops_fetch_stencil_hdf5_file(ops_stencil stencil, char const *file_name) {
+  ops_io_wait();
   // HDF5 APIs definitions
   hid_t file_id;  // file identifier
   hid_t dset_id;  // dataset identifier
@@ -181,6 +183,7 @@ void ops_fetch_stencil_hdf5_file(ops_stencil stencil, char const *file_name) {
  * if file does not exist, creates it
  *******************************************************************************/
 void ops_fetch_halo_hdf5_file(ops_halo halo, char const *file_name) {
+  ops_io_wait();
   // HDF5 APIs definitions
   hid_t file_id;  // file identifier
   hid_t group_id; // group identifier
@@ -321,19 +324,41 @@ void remove_padding3D(ops_dat dat, hsize_t *size, char *data) {
 }
 
 /*******************************************************************************
- * Routine to write an ops_dat to a named hdf5 file,
- * if file does not exist, creates it
- * if the data set does not exists in file creates data set
+ * Opens a named hdf5 file for writing, if file does not exist, creates it
  *******************************************************************************/
+static hid_t open_file_hdf5(char const *file_name) {
+  OPS_instance *instance = OPS_instance::getOPSInstance();
 
-void ops_fetch_dat_hdf5_file(ops_dat dat, char const *file_name) {
+  // Set up file access property list
+  hid_t plist_id = H5Pcreate(H5P_FILE_ACCESS);
 
-  ops_block block = dat->block;
+  if (file_exist(file_name) == 0) {
+    if (instance->OPS_diags > 3)
+      if (instance->is_root())
+        instance->ostream()
+            << "File " << file_name << "does not exist .... creating file\n";
+    FILE *fp;
+    fp = fopen(file_name, "w");
+    fclose(fp);
 
-  // HDF5 APIs definitions
-  hid_t file_id;  // file identifier
-  hid_t group_id; // group identifier
-  hid_t plist_id; // property list identifier
+    // Create a new file
+    hid_t file_id = H5Fcreate(file_name, H5F_ACC_TRUNC, H5P_DEFAULT, plist_id);
+    H5Fclose(file_id);
+  }
+
+  hid_t file_id = H5Fopen(file_name, H5F_ACC_RDWR, plist_id);
+  H5Pclose(plist_id);
+  return file_id;
+}
+
+/*******************************************************************************
+ * Opens the dataset of an ops_dat in an open hdf5 file,
+ * if the data set does not exists in file creates data set, otherwise checks
+ * that its attributes match the ops_dat
+ *******************************************************************************/
+static hid_t open_dat_hdf5(hid_t file_id, ops_dat dat, char const *file_name) {
+
+  ops_block block = dat->block;
 
   hsize_t g_size[OPS_MAX_DIM] = {0};
   int gbl_size[OPS_MAX_DIM] = {0};
@@ -346,273 +371,323 @@ void ops_fetch_dat_hdf5_file(ops_dat dat, char const *file_name) {
 
   /* Need to strip out the padding from the x-dimension*/
   g_size[0] = g_size[0] - dat->x_pad;
-  hsize_t t_size = 1;
-  for (int d = 0; d < block->dims; d++)
-    t_size *= g_size[d];
-  char *data = (char *)ops_malloc(t_size * dat->elem_size);
 
-  int range[2*OPS_MAX_DIM] = {0};
-  for (int d = 0; d < block->dims; d++) {
-    range[2 * d] = dat->d_m[d];
-    range[2 * d + 1] = dat->size[d] - dat->d_p[d];
-    // ops_printf("range[%d]=%d range[%d]=%d size=%d d_p=%d d_m=%d\n", 2 * d,
-    //            range[2 * d], 2 * d + 1, range[2 * d + 1], dat->size[d],
-    //            dat->d_p[d], dat->d_m[d]);
-  }
-  ops_dat_fetch_data_slab_host(dat, 0, data, range);
   // make sure we multiply by the number of data values per element (i.e.
   // dat->dim)
-  // g_size[1] = g_size[1]*dat->dim;
-  if (block->dims == 1)
-    g_size[0] = g_size[0] * dat->dim; // -- this needs to be tested for 1D
-  else if (block->dims == 2)
-    // Jianping Meng: it looks that growing the zero index is better
-    g_size[0] =
-        g_size[0] * dat->dim; //**note we are using [1] instead of [0] here !!
-  else if (block->dims == 3) {
-    g_size[0] =
-        g_size[0] * dat->dim; //**note that for 3D we are using [0] here !!
-  }
+  // Jianping Meng: it looks that growing the zero index is better
+  g_size[0] = g_size[0] * dat->dim;
 
   hsize_t G_SIZE[OPS_MAX_DIM];
-  if (block->dims == 1) {
-    G_SIZE[0] = g_size[0];
-  } else if (block->dims == 2) {
-    G_SIZE[0] = g_size[1];
-    G_SIZE[1] = g_size[0];
-  } else if (block->dims == 3) {
-    G_SIZE[0] = g_size[2];
-    G_SIZE[1] = g_size[1];
-    G_SIZE[2] = g_size[0];
-  }
-
-  // Set up file access property list with parallel I/O access
-  plist_id = H5Pcreate(H5P_FILE_ACCESS);
-
-  if (file_exist(file_name) == 0) {
-    if (dat->block->instance->OPS_diags > 3)
-      if (dat->block->instance->is_root())
-        dat->block->instance->ostream()
-            << "File " << file_name << "does not exist .... creating file\n";
-    FILE *fp;
-    fp = fopen(file_name, "w");
-    fclose(fp);
-
-    // Create a new file
-    file_id = H5Fcreate(file_name, H5F_ACC_TRUNC, H5P_DEFAULT, plist_id);
-    H5Fclose(file_id);
-  }
-
-  file_id = H5Fopen(file_name, H5F_ACC_RDWR, plist_id);
-  H5Pclose(plist_id);
+  for (int d = 0; d < block->dims; d++)
+    G_SIZE[d] = g_size[block->dims - 1 - d];
 
   if (H5Lexists(file_id, block->name, H5P_DEFAULT) == 0) {
     OPSException ex(OPS_HDF5_ERROR);
     ex << "Error: ops_fetch_dat_hdf5_file: ops_block on which this ops_dat "
        << dat->name << " is declared does not exist in the file";
     throw ex;
+  }
 
-  } else {
-    // open existing group -- an ops_block is a group
-    group_id = H5Gopen2(file_id, block->name, H5P_DEFAULT);
-
-    if (H5Lexists(group_id, dat->name, H5P_DEFAULT) ==
-        0) { // dat does not exisits .. create
-      if (dat->block->instance->OPS_diags > 2)
-        if (dat->block->instance->is_root())
-          dat->block->instance->ostream()
-              << "ops_fetch_dat_hdf5_file: ops_dat " << dat->name
-              << " does not exists in the ops_block " << block->name
-              << " ... creating ops_dat\n";
-
-      H5LTmake_dataset(group_id, dat->name, block->dims, G_SIZE,
-                       h5_type(dat->type), data);
-
-      // attach attributes to dat
-      H5LTset_attribute_string(group_id, dat->name, "ops_type",
-                               "ops_dat"); // ops type
-      H5LTset_attribute_string(group_id, dat->name, "block",
-                               block->name); // block
-      H5LTset_attribute_int(group_id, dat->name, "block_index", &(block->index),
-                            1); // block index
-      H5LTset_attribute_int(group_id, dat->name, "dim", &(dat->dim), 1); // dim
-      H5LTset_attribute_int(group_id, dat->name, "size", gbl_size,
-                            block->dims); // size
-      H5LTset_attribute_int(group_id, dat->name, "d_m", dat->d_m,
-                            block->dims); // d_m
-
-      // need to substract x_pad from d_p before writing attribute to file
-      int orig_d_p[OPS_MAX_DIM];
-      for (int d = 0; d < block->dims; d++)
-        orig_d_p[d] = dat->d_p[d];
-      orig_d_p[0] = dat->d_p[0] - dat->x_pad;
-
-      H5LTset_attribute_int(group_id, dat->name, "d_p", orig_d_p,
-                            block->dims); // d_p
-      H5LTset_attribute_int(group_id, dat->name, "base", dat->base,
-                            block->dims);                               // base
-      H5LTset_attribute_string(group_id, dat->name, "type", dat->type); // type
-    } else { // dat exisits .. check attributes and if matching .. ovewrite
-
-      dat->block->instance->ostream()
-          << "Dataset '" << dat->name << "' already found in file " << file_name
-          << " ... ";
-
-      char ops_type[10], type[10];
-      char blk[40];
-      int bindex, dim, gsize[OPS_MAX_DIM], d_m[OPS_MAX_DIM], d_p[OPS_MAX_DIM],
-          base[OPS_MAX_DIM];
+  // open existing group -- an ops_block is a group
+  hid_t group_id = H5Gopen2(file_id, block->name, H5P_DEFAULT);
 
-      if (H5LTget_attribute_string(group_id, dat->name, "ops_type", ops_type) <
-          0) { // ops type
+  if (H5Lexists(group_id, dat->name, H5P_DEFAULT) ==
+      0) { // dat does not exisits .. create
+    if (dat->block->instance->OPS_diags > 2)
+      if (dat->block->instance->is_root())
+        dat->block->instance->ostream()
+            << "ops_fetch_dat_hdf5_file: ops_dat " << dat->name
+            << " does not exists in the ops_block " << block->name
+            << " ... creating ops_dat\n";
+
+    // chunks and filters requested by the OPS_HDF5_* arguments
+    int parts[OPS_MAX_DIM];
+    for (int d = 0; d < OPS_MAX_DIM; d++)
+      parts[d] = 1;
+    hid_t plist_id = ops_hdf5_dat_dcpl(dat, G_SIZE, parts);
+
+    hid_t dataspace = H5Screate_simple(block->dims, G_SIZE, NULL);
+    hid_t dset_id = H5Dcreate(group_id, dat->name, h5_type(dat->type),
+                              dataspace, H5P_DEFAULT, plist_id, H5P_DEFAULT);
+    H5Dclose(dset_id);
+    H5Sclose(dataspace);
+    H5Pclose(plist_id);
+
+    // attach attributes to dat
+    H5LTset_attribute_string(group_id, dat->name, "ops_type",
+                             "ops_dat"); // ops type
+    H5LTset_attribute_string(group_id, dat->name, "block",
+                             block->name); // block
+    H5LTset_attribute_int(group_id, dat->name, "block_index", &(block->index),
+                          1); // block index
+    H5LTset_attribute_int(group_id, dat->name, "dim", &(dat->dim), 1); // dim
+    H5LTset_attribute_int(group_id, dat->name, "size", gbl_size,
+                          block->dims); // size
+    H5LTset_attribute_int(group_id, dat->name, "d_m", dat->d_m,
+                          block->dims); // d_m
+
+    // need to substract x_pad from d_p before writing attribute to file
+    int orig_d_p[OPS_MAX_DIM];
+    for (int d = 0; d < block->dims; d++)
+      orig_d_p[d] = dat->d_p[d];
+    orig_d_p[0] = dat->d_p[0] - dat->x_pad;
+
+    H5LTset_attribute_int(group_id, dat->name, "d_p", orig_d_p,
+                          block->dims); // d_p
+    H5LTset_attribute_int(group_id, dat->name, "base", dat->base,
+                          block->dims);                               // base
+    H5LTset_attribute_string(group_id, dat->name, "type", dat->type); // type
+  } else { // dat exisits .. check attributes and if matching .. ovewrite
+
+    dat->block->instance->ostream()
+        << "Dataset '" << dat->name << "' already found in file " << file_name
+        << " ... ";
+
+    char ops_type[10], type[10];
+    char blk[40];
+    int bindex, dim, gsize[OPS_MAX_DIM], d_m[OPS_MAX_DIM], d_p[OPS_MAX_DIM],
+        base[OPS_MAX_DIM];
+
+    if (H5LTget_attribute_string(group_id, dat->name, "ops_type", ops_type) <
+        0) { // ops type
+      OPSException ex(OPS_HDF5_ERROR);
+      ex << "Error: Attribute \"ops_type\" not found in dat" << dat->name;
+      throw ex;
+    } else {
+      if (strcmp("ops_dat", ops_type) != 0) {
         OPSException ex(OPS_HDF5_ERROR);
-        ex << "Error: Attribute \"ops_type\" not found in dat" << dat->name;
+        ex << "Error: ops_type: " << ops_type << " of dat: " << dat->name
+           << " is not ops_dat";
         throw ex;
-      } else {
-        if (strcmp("ops_dat", ops_type) != 0) {
-          OPSException ex(OPS_HDF5_ERROR);
-          ex << "Error: ops_type: " << ops_type << " of dat: " << dat->name
-             << " is not ops_dat";
-          throw ex;
-        }
       }
-      if (H5LTget_attribute_string(group_id, dat->name, "block", blk) <
-          0) { // block
+    }
+    if (H5LTget_attribute_string(group_id, dat->name, "block", blk) <
+        0) { // block
+      OPSException ex(OPS_HDF5_ERROR);
+      ex << "Error: Attribute \"block\" not found in dat" << dat->name;
+      throw ex;
+    } else {
+      if (strcmp(block->name, blk) != 0) {
         OPSException ex(OPS_HDF5_ERROR);
-        ex << "Error: Attribute \"block\" not found in dat" << dat->name;
+        ex << "Error: ops_block name: " << block->name
+           << "of dat: " << dat->name << " does not match block name :" << blk
+           << " in file";
         throw ex;
-      } else {
-        if (strcmp(block->name, blk) != 0) {
-          OPSException ex(OPS_HDF5_ERROR);
-          ex << "Error: ops_block name: " << block->name
-             << "of dat: " << dat->name << " does not match block name :" << blk
-             << " in file";
-          throw ex;
-        }
       }
-      if (H5LTget_attribute_int(group_id, dat->name, "block_index", &bindex) <
-          0) { // block index
+    }
+    if (H5LTget_attribute_int(group_id, dat->name, "block_index", &bindex) <
+        0) { // block index
+      OPSException ex(OPS_HDF5_ERROR);
+      ex << "Error: Attribute \"block_index\" not found in dat" << dat->name;
+      throw ex;
+    } else {
+      if (block->index != bindex) {
         OPSException ex(OPS_HDF5_ERROR);
-        ex << "Error: Attribute \"block_index\" not found in dat" << dat->name;
+        ex << "Error: ops_block index: " << block->index
+           << "of dat: " << dat->name
+           << " does not match block index :" << bindex << " in file";
         throw ex;
-      } else {
-        if (block->index != bindex) {
-          OPSException ex(OPS_HDF5_ERROR);
-          ex << "Error: ops_block index: " << block->index
-             << "of dat: " << dat->name
-             << " does not match block index :" << bindex << " in file";
-          throw ex;
-        }
       }
-      if (H5LTget_attribute_int(group_id, dat->name, "dim", &dim) < 0) { // dim
+    }
+    if (H5LTget_attribute_int(group_id, dat->name, "dim", &dim) < 0) { // dim
+      OPSException ex(OPS_HDF5_ERROR);
+      ex << "Error: Attribute \"dim\" not found in dat" << dat->name;
+      throw ex;
+    } else {
+      if (dat->dim != dim) {
         OPSException ex(OPS_HDF5_ERROR);
-        ex << "Error: Attribute \"dim\" not found in dat" << dat->name;
+        ex << "Error: ops_dat dim: " << dat->dim << "of dat: " << dat->name
+           << " does not match dat dim :" << dim << "in file";
         throw ex;
-      } else {
-        if (dat->dim != dim) {
+      }
+    }
+
+    if (H5LTget_attribute_int(group_id, dat->name, "size", gsize) <
+        0) { // size
+      OPSException ex(OPS_HDF5_ERROR);
+      ex << "Error: Attribute \"size\" not found in dat" << dat->name;
+      throw ex;
+    } else {
+      for (int i = 0; i < dat->dim; i++) {
+        if (gbl_size[i] !=
+            gsize[i]) { // remember checking global size as computed above
           OPSException ex(OPS_HDF5_ERROR);
-          ex << "Error: ops_dat dim: " << dat->dim << "of dat: " << dat->name
-             << " does not match dat dim :" << dim << "in file";
+          ex << "Error: ops_dat size: " << dat->size[i]
+             << " of dimension: " << i << " of dat: " << dat->name
+             << " does not match dat size: " << gsize[i] << " in file ";
           throw ex;
         }
       }
+    }
 
-      if (H5LTget_attribute_int(group_id, dat->name, "size", gsize) <
-          0) { // size
-        OPSException ex(OPS_HDF5_ERROR);
-        ex << "Error: Attribute \"size\" not found in dat" << dat->name;
-        throw ex;
-      } else {
-        for (int i = 0; i < dat->dim; i++) {
-          if (gbl_size[i] !=
-              gsize[i]) { // remember checking global size as computed above
-            OPSException ex(OPS_HDF5_ERROR);
-            ex << "Error: ops_dat size: " << dat->size[i]
-               << " of dimension: " << i << " of dat: " << dat->name
-               << " does not match dat size: " << gsize[i] << " in file ";
-            throw ex;
-          }
+    if (H5LTget_attribute_int(group_id, dat->name, "d_m", d_m) < 0) { // d_m
+      OPSException ex(OPS_HDF5_ERROR);
+      ex << "Error: Attribute \"d_m\" not found in dat" << dat->name;
+      throw ex;
+    } else {
+      for (int i = 0; i < dat->dim; i++) {
+        if (dat->d_m[i] != d_m[i]) {
+          OPSException ex(OPS_HDF5_ERROR);
+          ex << "Error: ops_dat d_m: " << dat->d_m[i] << "of dimension: " << i
+             << " of dat: " << dat->name
+             << " does not match dat d_m: " << d_m[i] << "in file ";
+          throw ex;
         }
       }
+    }
+    if (H5LTget_attribute_int(group_id, dat->name, "d_p", d_p) < 0) { // d_p
+      OPSException ex(OPS_HDF5_ERROR);
+      ex << "Error: Attribute \"d_p\" not found in dat" << dat->name;
+      throw ex;
+    } else {
+      // need to substract x_pad from d_p before checking attribute on file
+      int orig_d_p[OPS_MAX_DIM];
+      for (int d = 0; d < block->dims; d++)
+        orig_d_p[d] = dat->d_p[d];
+      orig_d_p[0] = dat->d_p[0] - dat->x_pad;
 
-      if (H5LTget_attribute_int(group_id, dat->name, "d_m", d_m) < 0) { // d_m
-        OPSException ex(OPS_HDF5_ERROR);
-        ex << "Error: Attribute \"d_m\" not found in dat" << dat->name;
-        throw ex;
-      } else {
-        for (int i = 0; i < dat->dim; i++) {
-          if (dat->d_m[i] != d_m[i]) {
-            OPSException ex(OPS_HDF5_ERROR);
-            ex << "Error: ops_dat d_m: " << dat->d_m[i] << "of dimension: " << i
-               << " of dat: " << dat->name
-               << " does not match dat d_m: " << d_m[i] << "in file ";
-            throw ex;
-          }
-        }
-      }
-      if (H5LTget_attribute_int(group_id, dat->name, "d_p", d_p) < 0) { // d_p
-        OPSException ex(OPS_HDF5_ERROR);
-        ex << "Error: Attribute \"d_p\" not found in dat" << dat->name;
-        throw ex;
-      } else {
-        // need to substract x_pad from d_p before checking attribute on file
-        int orig_d_p[OPS_MAX_DIM];
-        for (int d = 0; d < block->dims; d++)
-          orig_d_p[d] = dat->d_p[d];
-        orig_d_p[0] = dat->d_p[0] - dat->x_pad;
-
-        for (int i = 0; i < dat->dim; i++) {
-          if (orig_d_p[i] != d_p[i]) {
-            OPSException ex(OPS_HDF5_ERROR);
-            ex << "Error: ops_dat d_p: " << orig_d_p[i]
-               << " of dimension: " << i << " of dat: " << dat->name
-               << " does not match dat d_p: " << d_p[i] << " in file ";
-            throw ex;
-          }
+      for (int i = 0; i < dat->dim; i++) {
+        if (orig_d_p[i] != d_p[i]) {
+          OPSException ex(OPS_HDF5_ERROR);
+          ex << "Error: ops_dat d_p: " << orig_d_p[i]
+             << " of dimension: " << i << " of dat: " << dat->name
+             << " does not match dat d_p: " << d_p[i] << " in file ";
+          throw ex;
         }
       }
-      if (H5LTget_attribute_int(group_id, dat->name, "base", base) <
-          0) { // base
-        OPSException ex(OPS_HDF5_ERROR);
-        ex << "Error: Attribute \"base\" not found in dat" << dat->name;
-        throw ex;
-      } else {
-        for (int i = 0; i < dat->dim; i++) {
-          if (dat->base[i] != base[i]) {
-            OPSException ex(OPS_HDF5_ERROR);
-            ex << "Error: ops_dat base: " << dat->base[i]
-               << "of dimension: " << i << "of dat: " << dat->name
-               << " does not match dat base: " << base[i] << "in file ";
-            throw ex;
-          }
+    }
+    if (H5LTget_attribute_int(group_id, dat->name, "base", base) <
+        0) { // base
+      OPSException ex(OPS_HDF5_ERROR);
+      ex << "Error: Attribute \"base\" not found in dat" << dat->name;
+      throw ex;
+    } else {
+      for (int i = 0; i < dat->dim; i++) {
+        if (dat->base[i] != base[i]) {
+          OPSException ex(OPS_HDF5_ERROR);
+          ex << "Error: ops_dat base: " << dat->base[i]
+             << "of dimension: " << i << "of dat: " << dat->name
+             << " does not match dat base: " << base[i] << "in file ";
+          throw ex;
         }
       }
-      if (H5LTget_attribute_string(group_id, dat->name, "type", type) <
-          0) { // type
+    }
+    if (H5LTget_attribute_string(group_id, dat->name, "type", type) <
+        0) { // type
+      OPSException ex(OPS_HDF5_ERROR);
+      ex << "Error: Attribute \"type\" not found in dat" << dat->name;
+      throw ex;
+    } else {
+      if (strcmp(dat->type, type) != 0) {
         OPSException ex(OPS_HDF5_ERROR);
-        ex << "Error: Attribute \"type\" not found in dat" << dat->name;
+        ex << "Error: ops_dat type: " << dat->type << " of dat: " << dat->name
+           << " does not match dat type :" << type << "in file";
         throw ex;
-      } else {
-        if (strcmp(dat->type, type) != 0) {
-          OPSException ex(OPS_HDF5_ERROR);
-          ex << "Error: ops_dat type: " << dat->type << " of dat: " << dat->name
-             << " does not match dat type :" << type << "in file";
-          throw ex;
-        }
       }
+    }
 
-      // all good , overwrite the existing dataset
-      dat->block->instance->ostream() << " overwriting"
-                                      << "\n";
+    // all good , overwrite the existing dataset
+    dat->block->instance->ostream() << " overwriting"
+                                    << "\n";
+  }
 
-      hid_t dset_id = H5Dopen(group_id, dat->name, H5P_DEFAULT);
-      hid_t dataspace = H5Dget_space(dset_id);
-      hid_t datatype = h5_type(dat->type);
-      H5Dwrite(dset_id, datatype, H5S_ALL, dataspace, H5P_DEFAULT, data);
+  hid_t dset_id = H5Dopen(group_id, dat->name, H5P_DEFAULT);
+  H5Gclose(group_id);
+  return dset_id;
+}
+
+/*******************************************************************************
+ * Memory dataspace of data laid out either as the local array of an ops_dat
+ * (in_place) or as its points without padding
+ *******************************************************************************/
+static hid_t dat_memspace_hdf5(ops_dat dat, bool in_place) {
+  if (!in_place)
+    return H5S_ALL;
+  // padding is left out by the memory dataspace of a local array
+  hsize_t l_disp[OPS_MAX_DIM] = {0};
+  hsize_t l_size[OPS_MAX_DIM] = {0};
+  for (int d = 0; d < dat->block->dims; d++)
+    l_size[d] = dat->size[d];
+  l_size[0] = l_size[0] - dat->x_pad;
+  return ops_hdf5_dat_memspace(dat, l_disp, l_size);
+}
+
+/*******************************************************************************
+ * Writes data to the dataset of an ops_dat in a named hdf5 file, data is laid
+ * out either as the local array of the dat (in_place) or as its points without
+ * padding
+ *******************************************************************************/
+static void write_dat_hdf5(ops_dat dat, char const *file_name, char *data,
+                           bool in_place) {
+  hid_t file_id = open_file_hdf5(file_name);
+  hid_t dset_id = open_dat_hdf5(file_id, dat, file_name);
+  hid_t memspace = dat_memspace_hdf5(dat, in_place);
+
+  H5Dwrite(dset_id, h5_type(dat->type), memspace, H5S_ALL, H5P_DEFAULT, data);
+
+  if (memspace != H5S_ALL)
+    H5Sclose(memspace);
+  H5Dclose(dset_id);
+  H5Fclose(file_id);
+}
+
+/*******************************************************************************
+ * Fetches the data of an ops_dat to be written to hdf5, the local array of the
+ * dat itself if in_place, unless OPS_IO_ASYNC needs a snapshot of it
+ *******************************************************************************/
+static char *stage_dat_hdf5(ops_dat dat, bool in_place) {
+  OPS_instance *instance = dat->block->instance;
+  char *data = dat->data;
+  if (in_place) {
+    ops_execute(instance);
+    ops_get_data(dat);
+    // the dat may change while it is written in the background
+    if (instance->ops_io_async) {
+      size_t bytes = dat->elem_size;
+      for (int d = 0; d < dat->block->dims; d++)
+        bytes *= dat->size[d];
+      data = (char *)ops_malloc(bytes);
+      memcpy(data, dat->data, bytes);
     }
-    free(data);
-    H5Gclose(group_id);
-    H5Fclose(file_id);
+  } else {
+    hsize_t t_size = 1;
+    for (int d = 0; d < dat->block->dims; d++)
+      t_size *= dat->size[d] - (d == 0 ? dat->x_pad : 0);
+    data = (char *)ops_malloc(t_size * dat->elem_size);
+
+    int range[2*OPS_MAX_DIM] = {0};
+    for (int d = 0; d < dat->block->dims; d++) {
+      range[2 * d] = dat->d_m[d];
+      range[2 * d + 1] = dat->size[d] - dat->d_p[d];
+    }
+    ops_dat_fetch_data_slab_host(dat, 0, data, range);
+  }
+  return data;
+}
+
+/*******************************************************************************
+ * Routine to write an ops_dat to a named hdf5 file,
+ * if file does not exist, creates it
+ * if the data set does not exists in file creates data set
+ *******************************************************************************/
+
+void ops_fetch_dat_hdf5_file(ops_dat dat, char const *file_name) {
+  OPS_instance *instance = dat->block->instance;
+
+  // write straight from the dat, unless its layout has to be converted
+  bool in_place = ops_hdf5_dat_in_place(dat);
+  char *data = stage_dat_hdf5(dat, in_place);
+
+  if (instance->ops_io_async) {
+    std::string file(file_name);
+    ops_io_submit(instance, [=] {
+      write_dat_hdf5(dat, file.c_str(), data, in_place);
+      free(data);
+    });
+  } else {
+    write_dat_hdf5(dat, file_name, data, in_place);
+    if (data != dat->data)
+      free(data);
   }
 }
 
@@ -621,6 +696,7 @@ void ops_fetch_dat_hdf5_file(ops_dat dat, char const *file_name) {
  *******************************************************************************/
 ops_block ops_decl_block_hdf5(int dims, const char *block_name,
                               char const *file_name) {
+  ops_io_wait();
   // HDF5 APIs definitions
   hid_t file_id;  // file identifier
   hid_t plist_id; // property list identifier
@@ -697,6 +773,7 @@ ops_block ops_decl_block_hdf5(int dims, const char *block_name,
 ops_stencil ops_decl_stencil_hdf5(int dims, int points,
                                   const char *stencil_name,
                                   char const *file_name) {
+  ops_io_wait();
   // HDF5 APIs definitions
   hid_t file_id;  // file identifier
   hid_t plist_id; // property list identifier
@@ -799,6 +876,7 @@ ops_stencil ops_decl_stencil_hdf5(int dims, int points,
  * Routine to read an ops_halo from an hdf5 file
  *******************************************************************************/
 ops_halo ops_decl_halo_hdf5(ops_dat from, ops_dat to, char const *file_name) {
+  ops_io_wait();
   // HDF5 APIs definitions
   hid_t file_id;  // file identifier
   hid_t plist_id; // property list identifier
@@ -913,6 +991,7 @@ ops_halo ops_decl_halo_hdf5(ops_dat from, ops_dat to, char const *file_name) {
  *******************************************************************************/
 ops_dat ops_decl_dat_hdf5(ops_block block, int dat_dim, char const *type,
                           char const *dat_name, char const *file_name) {
+  ops_io_wait();
   // HDF5 APIs definitions
   hid_t file_id;  // file identifier
   hid_t group_id; // group identifier
@@ -1050,13 +1129,12 @@ ops_dat ops_decl_dat_hdf5(ops_block block, int dat_dim, char const *type,
   hid_t datatype = h5_type(read_type);
   size_t type_size = H5Tget_size(datatype);
 
-  // read in the actual data
   hsize_t t_size = 1;
-  for (int d = 0; d < block->dims; d++)
-    t_size *= read_size[d] - read_d_m[d] + read_d_p[d];
-  char *data = (char *)ops_malloc(t_size * dat_dim * type_size);
-
-  H5LTread_dataset(group_id, dat_name, datatype, data);
+  hsize_t l_size[OPS_MAX_DIM] = {0};
+  for (int d = 0; d < block->dims; d++) {
+    l_size[d] = read_size[d] - read_d_m[d] + read_d_p[d];
+    t_size *= l_size[d];
+  }
 
   int stride[] = {1, 1, 1, 1, 1};
   char *data_char = NULL;
@@ -1071,12 +1149,28 @@ ops_dat ops_decl_dat_hdf5(ops_block block, int dat_dim, char const *type,
   created_dat->user_managed = 0;
   created_dat->mem = t_size * dat_dim * type_size;
 
+  // read in the actual data, straight into the dat unless its layout has to
+  // be converted
+  hsize_t l_disp[OPS_MAX_DIM] = {0};
+  hid_t memspace = ops_hdf5_dat_memspace(created_dat, l_disp, l_size);
+  if (memspace != H5I_INVALID_HID) {
+    hid_t dset_id = H5Dopen(group_id, dat_name, H5P_DEFAULT);
+    H5Dread(dset_id, datatype, memspace, H5S_ALL, H5P_DEFAULT,
+            created_dat->data);
+    H5Dclose(dset_id);
+    H5Sclose(memspace);
+    created_dat->dirty_hd = 1;
+  } else {
+    char *data = (char *)ops_malloc(t_size * dat_dim * type_size);
+    H5LTread_dataset(group_id, dat_name, datatype, data);
+    //Here we assum the data read in are in AoS layout, so we need to transpose
+    ops_dat_set_data_host(created_dat, 0, data);
+    free(data);
+  }
+
   H5Pclose(plist_id);
   H5Gclose(group_id);
   H5Fclose(file_id);
-  //Here we assum the data read in are in AoS layout, so we need to transpose
-  ops_dat_set_data_host(created_dat, 0, data);
-  free(data);
 
   return created_dat;
 }
@@ -1099,17 +1193,6 @@ void ops_dump_to_hdf5(char const *file_name) {
         OPS_instance::getOPSInstance()->OPS_block_list[n].block, file_name);
   }
 
-  TAILQ_FOREACH(item, &OPS_instance::getOPSInstance()->OPS_dat_list, entries) {
-    if (OPS_instance::getOPSInstance()->OPS_diags > 2)
-      if (OPS_instance::getOPSInstance()->is_root())
-        OPS_instance::getOPSInstance()->ostream()
-            << "Dumping dat " << (item->dat)->name << " to HDF5 file "
-            << file_name << "\n";
-    if (item->dat->e_dat !=
-        1) // currently cannot write edge dats .. need to fix this
-      ops_fetch_dat_hdf5_file(item->dat, file_name);
-  }
-
   for (int i = 0; i < OPS_instance::getOPSInstance()->OPS_stencil_index; i++) {
     if (OPS_instance::getOPSInstance()->OPS_diags > 2)
       if (OPS_instance::getOPSInstance()->is_root())
@@ -1133,6 +1216,21 @@ void ops_dump_to_hdf5(char const *file_name) {
     ops_fetch_halo_hdf5_file(OPS_instance::getOPSInstance()->OPS_halo_list[i],
                              file_name);
   }
+
+  // dats last, with OPS_IO_ASYNC the other writes would wait for them, all in
+  // one session so that the file is opened once for them
+  ops_hdf5_session session = ops_hdf5_session_open(file_name);
+  TAILQ_FOREACH(item, &OPS_instance::getOPSInstance()->OPS_dat_list, entries) {
+    if (OPS_instance::getOPSInstance()->OPS_diags > 2)
+      if (OPS_instance::getOPSInstance()->is_root())
+        OPS_instance::getOPSInstance()->ostream()
+            << "Dumping dat " << (item->dat)->name << " to HDF5 file "
+            << file_name << "\n";
+    if (item->dat->e_dat !=
+        1) // currently cannot write edge dats .. need to fix this
+      ops_hdf5_session_add_dat(session, item->dat);
+  }
+  ops_hdf5_session_close(session);
 }
 
 /*******************************************************************************
@@ -1155,6 +1253,7 @@ extern "C" char *ops_fetch_dat_char(ops_dat dat, char *u_dat) {
 
 void ops_get_const_hdf5(char const *name, int dim, char const *type,
                         char *const_data, char const *file_name) {
+  ops_io_wait();
   // HDF5 APIs definitions
   hid_t file_id;   // file identifier
   hid_t dset_id;   // dataset identifier
@@ -1236,30 +1335,17 @@ void ops_get_const_hdf5(char const *name, int dim, char const *type,
 }
 
 /*******************************************************************************
- * Routine to write a constant to a named hdf5 file
+ * Writes a constant to an open hdf5 file
  *******************************************************************************/
-
-void ops_write_const_hdf5(char const *name, int dim, char const *type,
-                          char *const_data, char const *file_name) {
+static void write_const_hdf5(hid_t file_id, char const *name, int dim,
+                             char const *type, char *const_data,
+                             char const *file_name) {
   // HDF5 APIs definitions
-  hid_t file_id;   // file identifier
   hid_t dset_id;   // dataset identifier
   hid_t dataspace; // data space identifier
   htri_t status;   // status for checking return values
   hid_t attr;      // attribute identifier
 
-  if (file_exist(file_name) == 0) {
-    if (OPS_instance::getOPSInstance()->OPS_diags > 3) {
-      OPS_instance::getOPSInstance()->ostream()
-          << "File " << file_name << " does not exist .... creating file\n";
-    }
-    file_id = H5Fcreate(file_name, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
-    H5Fclose(file_id);
-  }
-
-  /* Open the existing file. */
-  file_id = H5Fopen(file_name, H5F_ACC_RDWR, H5P_DEFAULT);
-
   // Check if const already exists in data set
   status = H5Lexists(file_id, name, H5P_DEFAULT);
   if (status > 0) {
@@ -1312,7 +1398,6 @@ void ops_write_const_hdf5(char const *name, int dim, char const *type,
                           const_data);
     ops_free(typ);
     H5Dclose(dset_id);
-    H5Fclose(file_id);
 
     return;
   }
@@ -1387,14 +1472,97 @@ void ops_write_const_hdf5(char const *name, int dim, char const *type,
   H5Aclose(attribute);
   H5Sclose(dataspace);
   H5Dclose(dset_id);
+}
 
+/*******************************************************************************
+ * Routine to write a constant to a named hdf5 file
+ *******************************************************************************/
+void ops_write_const_hdf5(char const *name, int dim, char const *type,
+                          char *const_data, char const *file_name) {
+  ops_io_wait();
+  hid_t file_id = open_file_hdf5(file_name);
+  write_const_hdf5(file_id, name, dim, type, const_data, file_name);
   H5Fclose(file_id);
 }
 
+/*******************************************************************************
+ * Writes the dats and constants of an output session, data[i] holds the data
+ * of the i-th dat as staged by stage_dat_hdf5
+ *******************************************************************************/
+static void write_session_hdf5(ops_hdf5_session session,
+                               std::vector<char *> const &data) {
+  char const *file_name = session->file_name.c_str();
+  hid_t file_id = open_file_hdf5(file_name);
+
+  for (auto &c : session->consts)
+    write_const_hdf5(file_id, c.name.c_str(), c.dim, c.type.c_str(),
+                     c.data.data(), file_name);
+
+  size_t count = session->dats.size();
+  std::vector<hid_t> dset_ids(count), mem_type_ids(count),
+      mem_space_ids(count), file_space_ids(count, H5S_ALL);
+  std::vector<const void *> bufs(count);
+  for (size_t i = 0; i < count; i++) {
+    ops_dat dat = session->dats[i];
+    dset_ids[i] = open_dat_hdf5(file_id, dat, file_name);
+    mem_type_ids[i] = h5_type(dat->type);
+    mem_space_ids[i] = dat_memspace_hdf5(dat, ops_hdf5_dat_in_place(dat));
+    bufs[i] = data[i];
+  }
+
+  if (count > 0) {
+#if H5_VERSION_GE(1, 14, 0)
+    H5Dwrite_multi(count, dset_ids.data(), mem_type_ids.data(),
+                   mem_space_ids.data(), file_space_ids.data(), H5P_DEFAULT,
+                   bufs.data());
+#else
+    for (size_t i = 0; i < count; i++)
+      H5Dwrite(dset_ids[i], mem_type_ids[i], mem_space_ids[i],
+               file_space_ids[i], H5P_DEFAULT, bufs[i]);
+#endif
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    if (mem_space_ids[i] != H5S_ALL)
+      H5Sclose(mem_space_ids[i]);
+    H5Dclose(dset_ids[i]);
+  }
+  H5Fclose(file_id);
+}
+
+/*******************************************************************************
+ * Routine to write the dats and constants of an output session to its hdf5
+ * file
+ *******************************************************************************/
+void ops_hdf5_session_close(ops_hdf5_session session) {
+  OPS_instance *instance = OPS_instance::getOPSInstance();
+
+  std::vector<char *> data;
+  for (auto dat : session->dats)
+    data.push_back(stage_dat_hdf5(dat, ops_hdf5_dat_in_place(dat)));
+
+  if (instance->ops_io_async) {
+    ops_io_submit(instance, [=] {
+      write_session_hdf5(session, data);
+      for (auto d : data)
+        free(d);
+      delete session;
+    });
+    return;
+  }
+
+  ops_io_wait();
+  write_session_hdf5(session, data);
+  for (size_t i = 0; i < data.size(); i++)
+    if (data[i] != session->dats[i]->data)
+      free(data[i]);
+  delete session;
+}
+
 void determin_plane_buf_size(const ops_dat &data, const int buf_dims,
                        const int cross_section_dir, int *buf_size) {
   const int space_dim{data->block->dims};
-  int *size{new int(space_dim)};
+  int size[OPS_MAX_DIM];
   for (int d = 0; d < space_dim; d++) {
     size[d] = data->size[d] - (data->d_p[d] - data->d_m[d]);
   }
@@ -1407,13 +1575,12 @@ void determin_plane_buf_size(const ops_dat &data, const int buf_dims,
       reduced_index++;
     }
   }
-  delete size;
 }
 
 void determine_plane_range(const ops_dat &data, const int cross_section_dir,
                      const int pos, int *range) {
   const int space_dim{data->block->dims};
-  int *size{new int(space_dim)};
+  int size[OPS_MAX_DIM];
   for (int d = 0; d < space_dim; d++) {
     size[d] = data->size[d] - (data->d_p[d] - data->d_m[d]);
   }
@@ -1424,10 +1591,10 @@ void determine_plane_range(const ops_dat &data, const int cross_section_dir,
   }
   range[2 * cross_section_dir + 1] = pos + 1;
   range[2 * cross_section_dir] = pos;
-  delete size;
 }
 
 hid_t H5_file_handle(const char *file_name) {
+  ops_io_wait();
 
   hid_t file_plist_id{H5Pcreate(H5P_FILE_ACCESS)};
 
@@ -1452,7 +1619,7 @@ void write_buf_hdf5(char const *file_name, const char *data_name,
                           char *buf) {
   // HDF5 APIs definitions
   hid_t file_id{H5_file_handle(file_name)};
-  hsize_t *size_f{new hsize_t(dims)};
+  hsize_t size_f[OPS_MAX_DIM];
   for (int d = 0; d < dims; d++) {
     size_f[d] = size[dims - d - 1];
   }
@@ -1473,7 +1640,6 @@ void write_buf_hdf5(char const *file_name, const char *data_name,
     H5Gclose(groupid_list[grp]);
   }
   H5Fclose(file_id);
-  delete size_f;
 }
 
 void write_buf_hdf5(char const *file_name, const char *data_name,
@@ -1481,7 +1647,7 @@ void write_buf_hdf5(char const *file_name, const char *data_name,
                           char *buf) {
   // HDF5 APIs definitions
   hid_t file_id{H5_file_handle(file_name)};
-  hsize_t *size_f{new hsize_t(dims)};
+  hsize_t size_f[OPS_MAX_DIM];
   for (int d = 0; d < dims; d++) {
     size_f[d] = size[dims - d - 1];
   }
@@ -1502,7 +1668,6 @@ void write_buf_hdf5(char const *file_name, const char *data_name,
     H5Gclose(groupid_list[grp]);
   }
   H5Fclose(file_id);
-  delete size_f;
 }
 
 void ops_write_plane_hdf5(const ops_dat dat, const int cross_section_dir,
@@ -1513,8 +1678,8 @@ void ops_write_plane_hdf5(const ops_dat dat, const int cross_section_dir,
         (pos <= dat->size[cross_section_dir])) {
 
       int dims{dat->block->dims - 1};
-      int *range{new int(2 * dat->block->dims)};
-      int *size{new int(dims)};
+      int range[2 * OPS_MAX_DIM];
+      int size[OPS_MAX_DIM];
       determin_plane_buf_size(dat, dims, cross_section_dir, size);
       hsize_t buf_element_size{1};
       for (int i = 0; i < dims; i++) {
@@ -1529,9 +1694,7 @@ void ops_write_plane_hdf5(const ops_dat dat, const int cross_section_dir,
       size[0] *= (dat->dim);
       write_buf_hdf5(file_name, data_name, dat, dims, size, real_precision,
                      write_buf);
-      delete range;
       free(write_buf);
-      delete size;
     } else {
       ops_printf("The dat %s doesn't have the specified plane = %d \n",
                  dat->name, pos);
@@ -1553,8 +1716,8 @@ void ops_write_plane_hdf5(const ops_dat dat, const int cross_section_dir,
         (pos <= dat->size[cross_section_dir])) {
 
       int dims{dat->block->dims - 1};
-      int *range{new int(2 * dat->block->dims)};
-      int *size{new int(dims)};
+      int range[2 * OPS_MAX_DIM];
+      int size[OPS_MAX_DIM];
       determin_plane_buf_size(dat, dims, cross_section_dir, size);
       hsize_t buf_element_size{1};
       for (int i = 0; i < dims; i++) {
@@ -1568,9 +1731,7 @@ void ops_write_plane_hdf5(const ops_dat dat, const int cross_section_dir,
       // Consider the multi-dim data
       size[0] *= (dat->dim);
       write_buf_hdf5(file_name, data_name, dat, dims, size, write_buf);
-      delete range;
       free(write_buf);
-      delete size;
     } else {
       ops_printf("The dat %s doesn't have the specified plane = %d \n",
                  dat->name, pos);
@@ -1586,7 +1747,7 @@ void ops_write_plane_hdf5(const ops_dat dat, const int cross_section_dir,
 void ops_write_data_slab_hdf5(const ops_dat dat, const int *range,
                               const char *file_name, const char *data_name) {
   const int dims{dat->block->dims};
-  int *size{new int(dims)};
+  int size[OPS_MAX_DIM];
   size_t total_size{1};
   for (int d = 0; d < dims; d++) {
     size[d] = range[2 * d + 1] - range[2 * d];
@@ -1599,14 +1760,13 @@ void ops_write_data_slab_hdf5(const ops_dat dat, const int *range,
   ops_dat_fetch_data_slab_host(dat, 0, write_buf, (int *)range);
   write_buf_hdf5(file_name, data_name, dat, dims, size, write_buf);
   free(write_buf);
-  delete size;
 }
 
 void ops_write_data_slab_hdf5(const ops_dat dat, const int *range,
                               const char *file_name, const char *data_name,
                               REAL_PRECISION real_precision) {
   const int dims{dat->block->dims};
-  int *size{new int(dims)};
+  int size[OPS_MAX_DIM];
   size_t total_size{1};
   for (int d = 0; d < dims; d++) {
     size[d] = range[2 * d + 1] - range[2 * d];
@@ -1619,7 +1779,6 @@ void ops_write_data_slab_hdf5(const ops_dat dat, const int *range,
   ops_dat_fetch_data_slab_host(dat, 0, write_buf, (int *)range);
   write_buf_hdf5(file_name, data_name, dat, dims, size, real_precision, write_buf);
   free(write_buf);
-  delete size;
 }
 
 void ops_write_plane_group_hdf5(
@@ -1713,3 +1872,45 @@ void ops_write_plane_group_hdf5(
   }
   ops_write_plane_group_hdf5(planes, plane_names, key, data_list,real_precision);
 }
+
+/*******************************************************************************
+ * In-situ output pipelines, the whole of each plane or slab is copied by the
+ * single process
+ *******************************************************************************/
+void ops_insitu_add_plane_hdf5(ops_insitu_hdf5 insitu, ops_dat dat,
+                               int cross_section_dir, int pos,
+                               char const *data_name) {
+  const int d{cross_section_dir};
+  if ((d < 0) || (d >= dat->block->dims) || (pos < 0) ||
+      (pos >= dat->size[d] - (dat->d_p[d] - dat->d_m[d]))) {
+    OPSException ex(OPS_INVALID_ARGUMENT);
+    ex << "Error: the dat " << dat->name << " doesn't have the plane " << pos
+       << " in direction " << cross_section_dir;
+    throw ex;
+  }
+  int range[2 * OPS_MAX_DIM];
+  int disp[OPS_MAX_DIM]{0};
+  determine_plane_range(dat, cross_section_dir, pos, range);
+  ops_insitu_hdf5_add(insitu, dat, data_name, cross_section_dir, range, range,
+                      disp);
+}
+
+void ops_insitu_add_slab_hdf5(ops_insitu_hdf5 insitu, ops_dat dat,
+                              const int *range, char const *data_name) {
+  int disp[OPS_MAX_DIM]{0};
+  ops_insitu_hdf5_add(insitu, dat, data_name, -1, range, range, disp);
+}
+
+void ops_insitu_step_hdf5(ops_insitu_hdf5 insitu, int step) {
+  if (step % insitu->frequency != 0)
+    return;
+  char *slot = ops_insitu_hdf5_slot(insitu);
+  for (auto &item : insitu->items)
+    ops_dat_fetch_data_slab_host(item.dat, 0, slot + item.offset,
+                                 item.local_range);
+  ops_insitu_hdf5_submit(insitu, [=] {
+    hid_t file_id = open_file_hdf5(insitu->file_name.c_str());
+    ops_insitu_hdf5_write(insitu, file_id, H5P_DEFAULT, step, slot);
+    H5Fclose(file_id);
+  });
+}
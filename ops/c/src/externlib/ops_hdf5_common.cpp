@@ -35,7 +35,13 @@
  * @author Jianping Meng (started 03-Mar-2023)
  * @details Implements the OPS API calls for the HDF5 file I/O functionality
  */
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 // Use version 2 of H5Dopen H5Acreate and H5Dcreate
@@ -156,6 +162,127 @@ void split_h5_name(const char *data_name,
   }
 }
 
+/*******************************************************************************
+ * Whether the local array of a dat is laid out as its dataset in the file,
+ * i.e. it is not a struct of arrays with more than one component
+ *******************************************************************************/
+bool ops_hdf5_dat_in_place(const ops_dat dat) {
+  return dat->dim == 1 || !dat->block->instance->OPS_soa;
+}
+
+/*******************************************************************************
+ * Creates a memory dataspace over the local (halo padded) array of a dat,
+ * selecting the size[d] points from point disp[d] in each dimension, so that
+ * the data is written from or read into dat->data directly. Returns
+ * H5I_INVALID_HID when the layout differs from the file, the data then has to
+ * be copied
+ *******************************************************************************/
+hid_t ops_hdf5_dat_memspace(const ops_dat dat, const hsize_t *disp,
+                            const hsize_t *size) {
+  const int dims = dat->block->dims;
+  if (!ops_hdf5_dat_in_place(dat))
+    return H5I_INVALID_HID;
+  // dimensions are reversed in the file, and the components of a point are
+  // contiguous along the innermost one
+  hsize_t mem_size[OPS_MAX_DIM] = {0}, start[OPS_MAX_DIM] = {0},
+          count[OPS_MAX_DIM] = {0};
+  int empty = 0;
+  for (int d = 0; d < dims; d++) {
+    hsize_t components = d == 0 ? dat->dim : 1;
+    mem_size[dims - 1 - d] = (hsize_t)dat->size[d] * components;
+    start[dims - 1 - d] = disp[d] * components;
+    count[dims - 1 - d] = size[d] * components;
+    if (size[d] == 0)
+      empty = 1;
+  }
+  hid_t memspace = H5Screate_simple(dims, mem_size, NULL);
+  if (empty)
+    H5Sselect_none(memspace);
+  else
+    H5Sselect_hyperslab(memspace, H5S_SELECT_SET, start, NULL, count, NULL);
+  return memspace;
+}
+
+// registered HDF5 filter of LZ4, available as a plugin
+#define OPS_H5Z_FILTER_LZ4 32004
+
+// largest chunk created, HDF5 cannot handle chunks of 4 GiB or more and the
+// filters hold a whole chunk in memory
+#define OPS_HDF5_MAX_CHUNK ((hsize_t)1 << 30)
+
+/*******************************************************************************
+ * Creates the dataset creation property list of the dataset of a dat, with the
+ * chunks and filters requested by the OPS_HDF5_* runtime arguments. size is
+ * the size of the dataset and parts the number of processes it is split over,
+ * both in file order (dimensions reversed). Filters need a chunked layout, by
+ * default one chunk per process, split along the outermost dimensions where it
+ * would be larger than OPS_HDF5_MAX_CHUNK
+ *******************************************************************************/
+hid_t ops_hdf5_dat_dcpl(const ops_dat dat, const hsize_t *size,
+                        const int *parts) {
+  OPS_instance *instance = dat->block->instance;
+  const int dims = dat->block->dims;
+  hid_t plist_id = H5Pcreate(H5P_DATASET_CREATE);
+  bool filtered = instance->ops_hdf5_deflate > 0 ||
+                  instance->ops_hdf5_shuffle || instance->ops_hdf5_lz4 ||
+                  instance->ops_hdf5_lossy >= 0;
+  if (instance->ops_hdf5_chunk_size == 0 && !filtered)
+    return plist_id;
+
+  // the components of a point are contiguous along the innermost dimension,
+  // chunks are made of whole points
+  hsize_t chunk[OPS_MAX_DIM];
+  for (int d = 0; d < dims; d++) {
+    hsize_t components = d == dims - 1 ? dat->dim : 1;
+    hsize_t points = size[d] / components;
+    if (instance->ops_hdf5_chunk_size > 0)
+      chunk[d] = MIN((hsize_t)instance->ops_hdf5_chunk_size, points);
+    else
+      chunk[d] = (points + parts[d] - 1) / parts[d];
+    chunk[d] = MAX(chunk[d], (hsize_t)1) * components;
+  }
+  hid_t type = h5_type(dat->type);
+  for (int d = 0; d < dims; d++) {
+    hsize_t bytes = H5Tget_size(type);
+    for (int d2 = 0; d2 < dims; d2++)
+      bytes *= chunk[d2];
+    if (bytes <= OPS_HDF5_MAX_CHUNK)
+      break;
+    hsize_t components = d == dims - 1 ? dat->dim : 1;
+    hsize_t slice = bytes / (chunk[d] / components);
+    chunk[d] = MAX(OPS_HDF5_MAX_CHUNK / slice, (hsize_t)1) * components;
+  }
+  H5Pset_chunk(plist_id, dims, chunk);
+  // every chunk is written, filling them first would only cost time
+  H5Pset_fill_time(plist_id, H5D_FILL_TIME_NEVER);
+
+  if (instance->ops_hdf5_lossy >= 0) {
+    if (H5Tget_class(type) == H5T_FLOAT && H5Tget_size(type) >= 4)
+      H5Pset_scaleoffset(plist_id, H5Z_SO_FLOAT_DSCALE,
+                         instance->ops_hdf5_lossy);
+    else if (H5Tget_class(type) == H5T_INTEGER)
+      H5Pset_scaleoffset(plist_id, H5Z_SO_INT, H5Z_SO_INT_MINBITS_DEFAULT);
+  }
+  if (instance->ops_hdf5_shuffle)
+    H5Pset_shuffle(plist_id);
+  int deflate = instance->ops_hdf5_deflate;
+  if (instance->ops_hdf5_lz4) {
+    if (H5Zfilter_avail(OPS_H5Z_FILTER_LZ4) > 0) {
+      H5Pset_filter(plist_id, OPS_H5Z_FILTER_LZ4, H5Z_FLAG_OPTIONAL, 0, NULL);
+    } else {
+      static bool warned = false;
+      if (!warned && instance->is_root())
+        instance->ostream() << "Warning: HDF5 LZ4 filter plugin not found, "
+                               "using deflate instead\n";
+      warned = true;
+      deflate = MAX(deflate, 1);
+    }
+  }
+  if (deflate > 0)
+    H5Pset_deflate(plist_id, deflate);
+  return plist_id;
+}
+
   // create the dataset or open the dataset if existing
 void H5_dataset_space(const hid_t file_id, const int data_dims,
                       const hsize_t *global_data_size,
@@ -224,12 +351,11 @@ void H5_dataset_space(const hid_t file_id, const int data_dims,
     bool dims_consistent{ndims == data_dims};
     bool size_consistent{true};
     if (dims_consistent) {
-      hsize_t *size{new hsize_t(ndims)};
-      H5Sget_simple_extent_dims(file_space, size, NULL);
+      std::vector<hsize_t> size(ndims);
+      H5Sget_simple_extent_dims(file_space, size.data(), NULL);
       for (int d = 0; d < ndims; d++) {
         size_consistent = size_consistent && (size[d] == global_data_size[d]);
       }
-      delete size;
     }
     if ((not dims_consistent) || (not size_consistent)) {
       H5Sclose(file_space);
@@ -275,12 +401,11 @@ void H5_dataset_space(const hid_t file_id, const int data_dims,
     bool dims_consistent{ndims == data_dims};
     bool size_consistent{true};
     if (dims_consistent) {
-      hsize_t *size{new hsize_t(ndims)};
-      H5Sget_simple_extent_dims(file_space, size, NULL);
+      std::vector<hsize_t> size(ndims);
+      H5Sget_simple_extent_dims(file_space, size.data(), NULL);
       for (int d = 0; d < ndims; d++) {
         size_consistent = size_consistent && (size[d] == global_data_size[d]);
       }
-      delete size;
     }
     if ((not dims_consistent) || (not size_consistent)) {
       H5Sclose(file_space);
@@ -292,3 +417,336 @@ void H5_dataset_space(const hid_t file_id, const int data_dims,
     }
   }
 }
+
+/*******************************************************************************
+ * Asynchronous output (OPS_IO_ASYNC): snapshots of dats are written by a
+ * single I/O thread, in the order they were taken. While any write is pending
+ * only this thread calls HDF5, every other HDF5 routine first waits for them.
+ *******************************************************************************/
+struct ops_io_thread_state {
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::deque<std::function<void()> > tasks;
+  long submitted, completed;
+  bool running, stop;
+  std::exception_ptr error; // first exception thrown by a write
+};
+static ops_io_thread_state ops_io;
+
+static void ops_io_thread_main() {
+  std::unique_lock<std::mutex> lock(ops_io.mutex);
+  while (true) {
+    ops_io.cond.wait(lock, [] { return ops_io.stop || !ops_io.tasks.empty(); });
+    if (ops_io.tasks.empty())
+      return;
+    std::function<void()> task = ops_io.tasks.front();
+    ops_io.tasks.pop_front();
+    lock.unlock();
+    std::exception_ptr error;
+    try {
+      task();
+    } catch (...) {
+      error = std::current_exception();
+    }
+    lock.lock();
+    if (error && !ops_io.error)
+      ops_io.error = error;
+    ops_io.completed++;
+    ops_io.cond.notify_all();
+  }
+}
+
+static void ops_io_stop() {
+  {
+    std::unique_lock<std::mutex> lock(ops_io.mutex);
+    if (!ops_io.running)
+      return;
+    ops_io.stop = true;
+    ops_io.cond.notify_all();
+  }
+  ops_io.thread.join();
+  ops_io.running = false;
+  // During shutdown a failed write is reported rather than thrown, so that
+  // the rest of the exit still runs
+  try {
+    ops_io_wait();
+  } catch (std::exception &e) {
+    OPS_instance::getOPSInstance()->ostream()
+        << "Error: asynchronous HDF5 write failed: " << e.what() << "\n";
+  }
+}
+
+// Queues a write, first waiting until fewer than instance->ops_io_async are
+// pending, so that at most that many snapshots are held at a time
+void ops_io_submit(OPS_instance *instance, std::function<void()> task) {
+  std::unique_lock<std::mutex> lock(ops_io.mutex);
+  if (!ops_io.running) {
+    ops_io.stop = false;
+    ops_io.thread = std::thread(ops_io_thread_main);
+    ops_io.running = true;
+    ops_io_stop_dynamic = ops_io_stop;
+    ops_io_wait_dynamic = ops_io_wait;
+  }
+  ops_io.cond.wait(lock, [instance] {
+    return ops_io.submitted - ops_io.completed < instance->ops_io_async;
+  });
+  ops_io.tasks.push_back(task);
+  ops_io.submitted++;
+  ops_io.cond.notify_all();
+}
+
+void ops_io_wait() {
+  std::unique_lock<std::mutex> lock(ops_io.mutex);
+  ops_io.cond.wait(lock, [] { return ops_io.completed == ops_io.submitted; });
+  if (ops_io.error) {
+    std::exception_ptr error = ops_io.error;
+    ops_io.error = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+/*******************************************************************************
+ * HDF5 output sessions: dats and constants are registered with the session
+ * and written by ops_hdf5_session_close() of each library, opening the file
+ * once
+ *******************************************************************************/
+static size_t type_size(const char *type) {
+  if (strcmp(type, "double") == 0 || strcmp(type, "double precision") == 0 ||
+      strcmp(type, "real(8)") == 0 || strcmp(type, "real(kind=8)") == 0)
+    return sizeof(double);
+  else if (strcmp(type, "float") == 0 || strcmp(type, "real") == 0 ||
+           strcmp(type, "real(4)") == 0 || strcmp(type, "real(kind=4)") == 0)
+    return sizeof(float);
+  else if (strcmp(type, "half") == 0)
+    return 2;
+  else if (strcmp(type, "int") == 0 || strcmp(type, "int(4)") == 0 ||
+           strcmp(type, "integer") == 0 || strcmp(type, "integer(4)") == 0 ||
+           strcmp(type, "integer(kind=4)") == 0)
+    return sizeof(int);
+  else if (strcmp(type, "long") == 0)
+    return sizeof(long);
+  else if (strcmp(type, "long long") == 0 || strcmp(type, "ll") == 0)
+    return sizeof(long long);
+  else if (strcmp(type, "short") == 0)
+    return sizeof(short);
+  else if (strcmp(type, "char") == 0)
+    return sizeof(char);
+  OPSException ex(OPS_HDF5_ERROR);
+  ex << "Error: Unknown data type " << type
+     << " for converting to hdf5 recognised types";
+  throw ex;
+}
+
+ops_hdf5_session ops_hdf5_session_open(char const *file_name) {
+  ops_hdf5_session session = new ops_hdf5_session_core;
+  session->file_name = file_name;
+  return session;
+}
+
+void ops_hdf5_session_add_dat(ops_hdf5_session session, ops_dat dat) {
+  if (dat->e_dat == 1) {
+    OPSException ex(OPS_HDF5_ERROR);
+    ex << "Error: ops_hdf5_session_add_dat: cannot write edge dat "
+       << dat->name;
+    throw ex;
+  }
+  session->dats.push_back(dat);
+}
+
+void ops_hdf5_session_add_const(ops_hdf5_session session, char const *name,
+                                int dim, char const *type, char *const_data) {
+  ops_hdf5_session_const c;
+  c.name = name;
+  c.dim = dim;
+  c.type = type;
+  c.data.assign(const_data, const_data + dim * type_size(type));
+  session->consts.push_back(c);
+}
+
+/*******************************************************************************
+ * In-situ output pipelines: planes and slabs are copied into one of a few
+ * buffer slots when the pipeline is triggered and written from there, in the
+ * background with OPS_IO_ASYNC. The part of each process in them is set up by
+ * ops_insitu_add_plane_hdf5() and ops_insitu_add_slab_hdf5() of each library
+ *******************************************************************************/
+ops_insitu_hdf5 ops_decl_insitu_hdf5(char const *file_name, int frequency,
+                                     int depth) {
+  if (frequency < 1 || depth < 1) {
+    OPSException ex(OPS_INVALID_ARGUMENT);
+    ex << "Error: ops_decl_insitu_hdf5: frequency and depth of " << file_name
+       << " have to be positive";
+    throw ex;
+  }
+  ops_insitu_hdf5 insitu = new ops_insitu_hdf5_core;
+  insitu->file_name = file_name;
+  insitu->frequency = frequency;
+  insitu->depth = depth;
+  insitu->slot_bytes = 0;
+  insitu->captured = 0;
+  insitu->written = 0;
+  return insitu;
+}
+
+// range is the global range of the plane or slab, local_range the range this
+// process copies and local_disp where that starts relative to range
+void ops_insitu_hdf5_add(ops_insitu_hdf5 insitu, ops_dat dat,
+                         char const *data_name, int cross_section_dir,
+                         const int *range, const int *local_range,
+                         const int *local_disp) {
+  if (!insitu->slots.empty()) {
+    OPSException ex(OPS_INVALID_ARGUMENT);
+    ex << "Error: cannot add " << data_name << " to the in-situ output of "
+       << insitu->file_name << " after it has been triggered";
+    throw ex;
+  }
+  if (dat->e_dat == 1) {
+    OPSException ex(OPS_HDF5_ERROR);
+    ex << "Error: cannot write planes of edge dat " << dat->name;
+    throw ex;
+  }
+
+  ops_insitu_hdf5_item item;
+  item.dat = dat;
+  item.name = data_name;
+  hsize_t size_c[OPS_MAX_DIM], local_size_c[OPS_MAX_DIM], disp_c[OPS_MAX_DIM];
+  size_t count = 1;
+  int dims = 0;
+  for (int d = 0; d < dat->block->dims; d++) {
+    item.local_range[2 * d] = local_range[2 * d];
+    item.local_range[2 * d + 1] = local_range[2 * d + 1];
+    int local_count = local_range[2 * d + 1] - local_range[2 * d];
+    count *= local_count;
+    if (d == cross_section_dir)
+      continue;
+    size_c[dims] = range[2 * d + 1] - range[2 * d];
+    local_size_c[dims] = local_count;
+    disp_c[dims] = local_count > 0 ? local_disp[d] : 0;
+    dims++;
+  }
+  // a plane of a 1D dat is a single point
+  if (dims == 0) {
+    size_c[0] = 1;
+    local_size_c[0] = count;
+    disp_c[0] = 0;
+    dims = 1;
+  }
+  // Consider multi-dim data
+  size_c[0] *= dat->dim;
+  local_size_c[0] *= dat->dim;
+  disp_c[0] *= dat->dim;
+
+  item.dims = dims;
+  for (int d = 0; d < dims; d++) {
+    item.size[d] = size_c[dims - d - 1];
+    item.local_size[d] = local_size_c[dims - d - 1];
+    item.disp[d] = disp_c[dims - d - 1];
+  }
+  item.bytes = count * dat->elem_size;
+  item.offset = insitu->slot_bytes;
+  insitu->slot_bytes += item.bytes;
+  insitu->items.push_back(item);
+}
+
+// Next buffer slot to copy into, waits until it has been written
+char *ops_insitu_hdf5_slot(ops_insitu_hdf5 insitu) {
+  std::unique_lock<std::mutex> lock(insitu->mutex);
+  if (insitu->slots.empty())
+    for (int i = 0; i < insitu->depth; i++)
+      insitu->slots.push_back(
+          (char *)ops_malloc(insitu->slot_bytes > 0 ? insitu->slot_bytes : 1));
+  insitu->cond.wait(lock, [insitu] {
+    return insitu->captured - insitu->written < insitu->depth;
+  });
+  return insitu->slots[insitu->captured++ % insitu->depth];
+}
+
+// Writes the planes and slabs copied into slot to the group of step, over MPI
+// all processes call this collectively
+void ops_insitu_hdf5_write(ops_insitu_hdf5 insitu, hid_t file_id,
+                           hid_t xfer_plist, int step, const char *slot) {
+  std::string group = std::to_string(step);
+  size_t count = insitu->items.size();
+  std::vector<hid_t> dset_ids(count), mem_type_ids(count),
+      mem_space_ids(count), file_space_ids(count);
+  std::vector<const void *> bufs(count);
+  std::vector<std::vector<hid_t>> groupid_lists(count);
+  for (size_t i = 0; i < count; i++) {
+    ops_insitu_hdf5_item &item = insitu->items[i];
+    std::vector<std::string> h5_name_list;
+    split_h5_name((group + "/" + item.name).c_str(), h5_name_list);
+    groupid_lists[i].resize(h5_name_list.size() - 1);
+    H5_dataset_space(file_id, item.dims, item.size, h5_name_list,
+                     item.dat->type, groupid_lists[i], dset_ids[i],
+                     file_space_ids[i]);
+    mem_type_ids[i] = h5_type(item.dat->type);
+    mem_space_ids[i] = H5Screate_simple(item.dims, item.local_size, NULL);
+    if (item.bytes == 0) {
+      H5Sselect_none(mem_space_ids[i]);
+      H5Sselect_none(file_space_ids[i]);
+    } else {
+      H5Sselect_hyperslab(file_space_ids[i], H5S_SELECT_SET, item.disp, NULL,
+                          item.local_size, NULL);
+    }
+    bufs[i] = slot + item.offset;
+  }
+
+  if (count > 0) {
+#if H5_VERSION_GE(1, 14, 0)
+    H5Dwrite_multi(count, dset_ids.data(), mem_type_ids.data(),
+                   mem_space_ids.data(), file_space_ids.data(), xfer_plist,
+                   bufs.data());
+#else
+    for (size_t i = 0; i < count; i++)
+      H5Dwrite(dset_ids[i], mem_type_ids[i], mem_space_ids[i],
+               file_space_ids[i], xfer_plist, bufs[i]);
+#endif
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    H5Sclose(file_space_ids[i]);
+    H5Sclose(mem_space_ids[i]);
+    H5Dclose(dset_ids[i]);
+    for (int grp = groupid_lists[i].size() - 1; grp >= 0; grp--)
+      H5Gclose(groupid_lists[i][grp]);
+  }
+}
+
+// Runs the write of a slot, on the I/O thread with OPS_IO_ASYNC, and frees
+// the slot once it is done
+void ops_insitu_hdf5_submit(ops_insitu_hdf5 insitu,
+                            std::function<void()> write) {
+  OPS_instance *instance = OPS_instance::getOPSInstance();
+  auto task = [insitu, write] {
+    std::exception_ptr error;
+    try {
+      write();
+    } catch (...) {
+      error = std::current_exception();
+    }
+    std::unique_lock<std::mutex> lock(insitu->mutex);
+    insitu->written++;
+    insitu->cond.notify_all();
+    lock.unlock();
+    if (error)
+      std::rethrow_exception(error);
+  };
+
+  if (instance->ops_io_async) {
+    ops_io_submit(instance, task);
+    return;
+  }
+  ops_io_wait();
+  task();
+}
+
+void ops_free_insitu_hdf5(ops_insitu_hdf5 insitu) {
+  {
+    std::unique_lock<std::mutex> lock(insitu->mutex);
+    insitu->cond.wait(lock,
+                      [insitu] { return insitu->written == insitu->captured; });
+  }
+  for (auto slot : insitu->slots)
+    free(slot);
+  delete insitu;
+}
@@ -219,6 +219,10 @@ void ops_compute_moment(double t, double *first, double *second) {
   *second = times_reduced[1] / (double)comm_size;
 }
 
+void ops_compute_max(double *t, double *max, int n) {
+  MPI_Allreduce(t, max, n, MPI_DOUBLE, MPI_MAX, OPS_MPI_GLOBAL);
+}
+
 int _ops_is_root(OPS_instance *instance) {
   int my_rank;
   MPI_Comm_rank(OPS_MPI_GLOBAL, &my_rank);
@@ -255,6 +259,7 @@ void ops_set_dirtybit_host(ops_arg *args, int nargs) {
 
 ops_arg ops_arg_reduce(ops_reduction handle, int dim, const char *type,
                        ops_access acc) {
+  ops_reduction_wait(handle);
   int was_initialized = handle->initialized;
   ops_arg temp = ops_arg_reduce_core(handle, dim, type, acc);
   if (!was_initialized) {
@@ -584,6 +589,9 @@ ops_dat ops_dat_copy_mpi_core(ops_dat orig_dat) {
   sd->dat = dat;
   sd->dirty_dir_send = dirt1;
   sd->dirty_dir_recv = dirt2;
+  sd->shm_win = MPI_WIN_NULL; // the copy has private memory
+  for (int d = 0; d < OPS_MAX_DIM; d++)
+    sd->shm_m[d] = sd->shm_p[d] = NULL;
   size_t *prod_t = (size_t *)ops_malloc((orig_dat->block->dims + 1) * sizeof(size_t));
   memcpy(prod_t, &OPS_sub_dat_list[orig_dat->index]->prod[-1], (orig_dat->block->dims + 1) * sizeof(size_t));
   sd->prod = &prod_t[1];
@@ -50,6 +50,13 @@ extern char *ops_buffer_recv_2;
 extern OPS_instance *global_ops_instance;
 extern int partitioned;
 
+// Whether the communication and I/O threads may make MPI calls
+static int ops_mpi_thread_multiple() {
+  int provided;
+  MPI_Query_thread(&provided);
+  return provided >= MPI_THREAD_MULTIPLE;
+}
+
 void _ops_init(OPS_instance *instance, const int argc, const char *const argv[], const int diags) {
   //We do not have thread safety across MPI
   if ( OPS_instance::numInstances() != 1 ) {
@@ -60,7 +67,15 @@ void _ops_init(OPS_instance *instance, const int argc, const char *const argv[],
   int flag = 0;
   MPI_Initialized(&flag);
   if (!flag) {
-    MPI_Init((int *)(&argc), (char ***)&argv);
+    // The communication and I/O threads make MPI calls alongside the main thread
+    int thread_multiple = 0;
+    for (int n = 1; n < argc; n++)
+      if (strstr(argv[n], "OPS_COMM_THREAD") != NULL || strstr(argv[n], "OPS_IO_ASYNC") != NULL) thread_multiple = 1;
+    if (thread_multiple) {
+      int provided;
+      MPI_Init_thread((int *)(&argc), (char ***)&argv, MPI_THREAD_MULTIPLE, &provided);
+    } else
+      MPI_Init((int *)(&argc), (char ***)&argv);
   }
 
   //Splitting up the communication world for MPMD apps
@@ -88,8 +103,23 @@ void _ops_init(OPS_instance *instance, const int argc, const char *const argv[],
   // we assign that to the global non-thread safe var and carry on.
   global_ops_instance = instance;
 
+  // flags given later through ops_set_args are checked against the thread
+  // level as well
+  ops_thread_multiple_dynamic = ops_mpi_thread_multiple;
+
   ops_init_core(instance, argc, argv, diags);
   ops_init_device(instance, argc, argv, diags);
+
+  if (instance->ops_comm_thread || instance->ops_io_async) {
+    int provided;
+    MPI_Query_thread(&provided);
+    if (provided < MPI_THREAD_MULTIPLE) {
+      if (instance->is_root() && instance->ops_comm_thread) instance->ostream() << "Warning: MPI does not provide MPI_THREAD_MULTIPLE, OPS_COMM_THREAD disabled\n";
+      if (instance->is_root() && instance->ops_io_async) instance->ostream() << "Warning: MPI does not provide MPI_THREAD_MULTIPLE, OPS_IO_ASYNC disabled\n";
+      instance->ops_comm_thread = 0;
+      instance->ops_io_async = 0;
+    }
+  }
 }
 
 void ops_init(const int argc, const char *const argv[], const int diags) {
@@ -164,6 +194,7 @@ ops_dat ops_decl_dat_char(ops_block block, int size, int *dat_size, int *base,
   sub_dat_list sd = (sub_dat_list)ops_calloc(1, sizeof(sub_dat));
   sd->dat = dat;
   sd->dirtybit = 1;
+  sd->shm_win = MPI_WIN_NULL;
   sd->dirty_dir_send =
       (int *)ops_malloc(sizeof(int) * 2 * block->dims * MAX_DEPTH);
   for (int i = 0; i < 2 * block->dims * MAX_DEPTH; i++)
@@ -182,6 +213,7 @@ ops_dat ops_decl_dat_char(ops_block block, int size, int *dat_size, int *base,
 }
 
 void ops_print_dat_to_txtfile(ops_dat dat, const char *file_name) {
+  ops_execute(dat->block->instance);
   if (OPS_sub_block_list[dat->block->index]->owned == 1) {
     ops_get_data(dat);
     ops_print_dat_to_txtfile_core(dat, file_name);
@@ -189,6 +221,7 @@ void ops_print_dat_to_txtfile(ops_dat dat, const char *file_name) {
 }
 
 void ops_NaNcheck(ops_dat dat) {
+  ops_execute(dat->block->instance);
   if (OPS_sub_block_list[dat->block->index]->owned == 1) {
     ops_get_data(dat);
     char buffer[30];
@@ -215,11 +248,11 @@ void ops_dat_deep_copy(ops_dat target, ops_dat source) {
 
   ops_kernel_descriptor *desc = ops_dat_deep_copy_mpi_core(target, source);
   if (source->block->instance->OPS_hybrid_gpu) {
-    strcpy(desc->name, "ops_internal_copy_device\0");
+    desc->name = ops_kernel_name_intern(source->block->instance, "ops_internal_copy_device");
     desc->isdevice = 1;
     desc->func = ops_internal_copy_device;
   } else {
-    strcpy(desc->name, "ops_internal_copy_seq\0");
+    desc->name = ops_kernel_name_intern(source->block->instance, "ops_internal_copy_seq");
     desc->isdevice = 0;
     desc->func = ops_internal_copy_seq;
   }
@@ -263,7 +263,7 @@ void determine_plane_global_range(const ops_dat dat,
                                   int *range) {
   const int space_dim{dat->block->dims};
   const sub_dat *sd = OPS_sub_dat_list[dat->index];
-  int *size{new int(space_dim)};
+  int size[OPS_MAX_DIM];
   for (int d = 0; d < space_dim; d++) {
     size[d] = sd->gbl_size[d] - (sd->gbl_d_p[d] - sd->gbl_d_m[d]);
   }
@@ -274,7 +274,6 @@ void determine_plane_global_range(const ops_dat dat,
   }
   range[2 * cross_section_dir + 1] = pos + 1;
   range[2 * cross_section_dir] = pos;
-  delete size;
 }
 void copy_data_buf(const ops_dat &dat, const int *local_range,
                    char *local_buf) {
@@ -320,6 +319,7 @@ void copy_data_buf(const ops_dat &dat, const int *local_range,
  * if the block does not exists in file creates block as a hdf5 group
  *******************************************************************************/
 void ops_fetch_block_hdf5_file(ops_block block, char const *file_name) {
+  ops_io_wait();
   sub_block *sb = OPS_sub_block_list[block->index];
 
   if (sb->owned == 1) {
@@ -394,6 +394,7 @@ void ops_fetch_block_hdf5_file(ops_block block, char const *file_name) {
  * if file does not exist, creates it
  *******************************************************************************/
 void ops_fetch_stencil_hdf5_file(ops_stencil stencil, char const *file_name) {
+  ops_io_wait();
   // HDF5 APIs definitions
   hid_t file_id;  // file identifier
   hid_t dset_id;  // dataset identifier
@@ -468,6 +469,7 @@ void ops_fetch_stencil_hdf5_file(ops_stencil stencil, char const *file_name) {
  * if file does not exist, creates it
  *******************************************************************************/
 void ops_fetch_halo_hdf5_file(ops_halo halo, char const *file_name) {
+  ops_io_wait();
   // HDF5 APIs definitions
   hid_t file_id;  // file identifier
   hid_t group_id; // group identifier
@@ -555,476 +557,568 @@ void ops_fetch_halo_hdf5_file(ops_halo halo, char const *file_name) {
 }
 
 /*******************************************************************************
- * Routine to write an ops_dat to a named hdf5 file,
- * if file does not exist, creates it
- * if the data set does not exists in file creates data set
+ * Opens a named hdf5 file for collective writes over comm, if file does not
+ * exist, creates it
  *******************************************************************************/
-void ops_fetch_dat_hdf5_file(ops_dat dat, char const *file_name) {
-  sub_block *sb = OPS_sub_block_list[dat->block->index];
-  if (sb->owned == 1) {
-    // fetch data onto the host ( if needed ) based on the backend
-    ops_get_data(dat);
-
-    // compute the number of elements that this process will write to the final
-    // file
-    // also compute the correct offsets on the final file that this process
-    // should begin from to write
-    sub_dat *sd = OPS_sub_dat_list[dat->index];
-    ops_block block = dat->block;
-
-    hsize_t disp[block->dims]; // global disps to compute the chunk data set
-    // dimensions
-    hsize_t l_disp[block->dims]; // local disps to remove MPI halos
-    hsize_t size[block->dims];   // local size to compute the chunk data set
-    // dimensions
-    hsize_t gbl_size[block->dims]; // global size to compute the chunk data set
-    // dimensions
-
-    int g_size[block->dims]; // global size of the dat attribute to write to
-    // hdf5 file
-    int g_d_m[block->dims]; // global size of the block halo (-) depth
-                            // attribute
-    // to write to hdf5 file
-    int g_d_p[block->dims]; // global size of the block halo (+) depth
-                            // attribute
-    // to write to hdf5 file
+static hid_t open_file_hdf5(char const *file_name, MPI_Comm comm,
+                            MPI_Info info) {
+  hid_t file_id;
 
-    hsize_t count[block->dims];  // parameters for for hdf5 file chuck writing
-    hsize_t stride[block->dims]; // parameters for for hdf5 file chuck writing
+  // Set up file access property list with parallel I/O access
+  hid_t plist_id = H5Pcreate(H5P_FILE_ACCESS);
+  H5Pset_fapl_mpio(plist_id, comm, info);
 
-    for (int d = 0; d < block->dims; d++) {
-      // remove left MPI halo to get start disp from beginning of dat
-      // include left block halo
-      disp[d] = sd->decomp_disp[d] -
-                sd->gbl_d_m[d];    // global displacements of the data set
-      l_disp[d] = 0 - sd->d_im[d]; // local displacements of the data set (i.e.
-      // per MPI proc)
-      size[d] = sd->decomp_size[d]; // local size to compute the chunk data set
-      // dimensions
-      gbl_size[d] = sd->gbl_size[d]; // global size to compute the chunk data
-      // set dimensions
+  if (file_exist(file_name) == 0) {
+    // MPI_Barrier(OPS_MPI_GLOBAL);
+    if (OPS_instance::getOPSInstance()->OPS_diags > 2)
+      ops_printf("File %s does not exist .... creating file\n", file_name);
+    // MPI_Barrier(OPS_MPI_HDF5_BLOCK_WORLD);
+    if (ops_is_root()) {
+      FILE *fp;
+      fp = fopen(file_name, "w");
+      fclose(fp);
+    }
+    // Create a new file collectively and release property list identifier.
+    file_id = H5Fcreate(file_name, H5F_ACC_TRUNC, H5P_DEFAULT, plist_id);
+    H5Fclose(file_id);
+  }
 
-      g_d_m[d] = sd->gbl_d_m[d]; // global halo depth(-) attribute to be written
-      // to hdf5 file
-      g_d_p[d] = sd->gbl_d_p[d]; // global halo depth(+) attribute to be written
-      // to hdf5 file
-      g_size[d] = sd->gbl_size[d] + g_d_m[d] -
-                  g_d_p[d]; // global size attribute to be written to hdf5 file
+  file_id = H5Fopen(file_name, H5F_ACC_RDWR, plist_id);
+  H5Pclose(plist_id);
+  return file_id;
+}
 
-      count[d] = 1;
-      stride[d] = 1;
+/*******************************************************************************
+ * Opens the dataset of an ops_dat in an open hdf5 file, if the data set does
+ * not exists in file creates data set, and checks that its attributes match
+ * the ops_dat. Only the global sizes of the dat are used, so that processes
+ * not holding its block can take part too
+ *******************************************************************************/
+static hid_t open_dat_hdf5(hid_t file_id, ops_dat dat, char const *file_name) {
+  sub_dat *sd = OPS_sub_dat_list[dat->index];
+  ops_block block = dat->block;
+
+  hsize_t gbl_size[block->dims]; // global size to compute the chunk data set
+  // dimensions
+
+  int g_size[block->dims]; // global size of the dat attribute to write to
+  // hdf5 file
+  int g_d_m[block->dims]; // global size of the block halo (-) depth
+                          // attribute
+  // to write to hdf5 file
+  int g_d_p[block->dims]; // global size of the block halo (+) depth
+                          // attribute
+  // to write to hdf5 file
+
+  for (int d = 0; d < block->dims; d++) {
+    gbl_size[d] = sd->gbl_size[d]; // global size to compute the chunk data
+    // set dimensions
+
+    g_d_m[d] = sd->gbl_d_m[d]; // global halo depth(-) attribute to be written
+    // to hdf5 file
+    g_d_p[d] = sd->gbl_d_p[d]; // global halo depth(+) attribute to be written
+    // to hdf5 file
+    g_size[d] = sd->gbl_size[d] + g_d_m[d] -
+                g_d_p[d]; // global size attribute to be written to hdf5 file
+  }
+
+  // make sure we multiply by the number of data values per
+  // element (i.e. dat->dim) to get full size of the data
+  // Jianping Meng: I found that growing the dim 0 rather than dim 1 can
+  // lead to a more consistent post-processing procedure for multi-dim data
+  gbl_size[0] = gbl_size[0] * dat->dim;
 
-      // printf("l_disp[%d] = %d ",d,l_disp[d]);
-      // printf("disp[%d] = %d ",d,disp[d]);
-      // printf("size[%d] = %d ",d,size[d]);
-      // printf("dat->size[%d] = %d ",d,dat->size[d]);
-      // printf("gbl_size[%d] = %d \n",d,sd->gbl_size[d]);
-      // printf("g_size[%d] = %d ",d,g_size[d]);
-      // printf("dat->d_m[%d] = %d ",d,g_d_m[d]);
-      // printf("dat->d_p[%d] = %d ",d,g_d_p[d]);
-    }
+  hid_t plist_id;  // property list identifier
+  hid_t filespace; // data space identifier
+  hid_t dset_id;   // dataset identifier
 
-    hsize_t t_size = 1;
-    for (int d = 0; d < dat->block->dims; d++)
-      t_size *= size[d];
-    // printf("t_size = %d ",t_size);
-    char *data = (char *)ops_malloc(t_size * dat->elem_size);
+  if (H5Lexists(file_id, block->name, H5P_DEFAULT) == 0) {
+    OPSException ex(OPS_HDF5_ERROR);
+    ex << "Error: Error: ops_fetch_dat_hdf5_file: ops_block on which this "
+          "ops_dat "
+       << dat->name << " is declared does not exist in the file";
+    throw ex;
+  }
 
-    // create new communicator
-    int my_rank, comm_size;
-    MPI_Comm OPS_MPI_HDF5_BLOCK_WORLD;
-    // use the communicator for MPI procs holding this block
-    MPI_Comm_dup(sb->comm1, &OPS_MPI_HDF5_BLOCK_WORLD);
-    MPI_Comm_rank(OPS_MPI_HDF5_BLOCK_WORLD, &my_rank);
-    MPI_Comm_size(OPS_MPI_HDF5_BLOCK_WORLD, &comm_size);
+  // open existing group -- an ops_block is a group
+  hid_t group_id = H5Gopen2(file_id, block->name, H5P_DEFAULT);
+  int overwriting = 0;
 
-    const int space_dim{dat->block->dims};
-    int *local_range{new int(2 * space_dim)};
-    int *range{new int(2 * space_dim)};
-    for (int d = 0; d < space_dim; d++) {
-      range[2 * d] = g_d_m[d];
-      range[2 * d + 1] = g_size[d] + g_d_p[d];
-    }
-    determine_local_range(dat, range, local_range);
-    copy_data_buf(dat, local_range, data);
-    delete range;
-    delete local_range;
+  if (H5Lexists(group_id, dat->name, H5P_DEFAULT) == 0) {
+    if (OPS_instance::getOPSInstance()->OPS_diags > 2)
+      ops_printf(
+          "ops_fetch_dat_hdf5_file: ops_dat %s does not exists in the "
+          "ops_block %s ... creating ops_dat\n",
+          dat->name, block->name);
 
-    // make sure we multiply by the number of data values per
-    // element (i.e. dat->dim) to get full size of the data
-    size[0] = size[0] * dat->dim;
-    disp[0] = disp[0] * dat->dim;
+    // transpose global size as on hdf5 file the dims are written transposed
+    hsize_t GBL_SIZE[block->dims];
     if (block->dims == 1) {
-      gbl_size[0] = gbl_size[0] * dat->dim; //-- this needs to be tested for 1D
+      GBL_SIZE[0] = gbl_size[0];
     } else if (block->dims == 2) {
-      // Jianping Meng: I found that growing the dim 0 rather than dim 1 can
-      // lead to a more consistent post-processing procedure for multi-dim data
-      //**note we are using [1] instead of [0] here !!
-      gbl_size[0] = gbl_size[0] * dat->dim;
+      GBL_SIZE[0] = gbl_size[1];
+      GBL_SIZE[1] = gbl_size[0];
     } else if (block->dims == 3) {
-      gbl_size[0] =
-          gbl_size[0] * dat->dim; //**note that for 3D we are using [0] here !!
+      GBL_SIZE[0] = gbl_size[2];
+      GBL_SIZE[1] = gbl_size[1];
+      GBL_SIZE[2] = gbl_size[0];
     }
 
-    // MPI variables
-    MPI_Info info = MPI_INFO_NULL;
+    // Create the dataspace for the dataset
+    filespace =
+        H5Screate_simple(block->dims, GBL_SIZE, NULL); // space in file
 
-    // HDF5 APIs definitions
-    hid_t file_id;   // file identifier
-    hid_t group_id;  // group identifier
-    hid_t dset_id;   // dataset identifier
-    hid_t filespace; // data space identifier
-    hid_t plist_id;  // property list identifier
-    hid_t memspace;  // memory space identifier
+    // Create chunked dataset, with the chunks aligned with the decomposition
+    // of the block by default, and the filters requested by the OPS_HDF5_*
+    // arguments
+    sub_block *sb = OPS_sub_block_list[block->index];
+    int parts[block->dims];
+    for (int d = 0; d < block->dims; d++)
+      parts[d] = sb->pdims[block->dims - 1 - d];
+    plist_id = ops_hdf5_dat_dcpl(dat, GBL_SIZE, parts);
 
-    // hsize_t CHUNK_SIZE[block->dims];
+    // Create the dataset with default properties and close filespace.
+    dset_id = H5Dcreate(group_id, dat->name, h5_type(dat->type), filespace,
+                        H5P_DEFAULT, plist_id, H5P_DEFAULT);
 
-    // Set up file access property list with parallel I/O access
-    plist_id = H5Pcreate(H5P_FILE_ACCESS);
-    H5Pset_fapl_mpio(plist_id, OPS_MPI_HDF5_BLOCK_WORLD, info);
+    H5Pclose(plist_id);
+    H5Sclose(filespace);
+    H5Dclose(dset_id);
 
-    if (file_exist(file_name) == 0) {
-      // MPI_Barrier(OPS_MPI_GLOBAL);
-      if (OPS_instance::getOPSInstance()->OPS_diags > 2)
-        ops_printf("File %s does not exist .... creating file\n", file_name);
-      // MPI_Barrier(OPS_MPI_HDF5_BLOCK_WORLD);
-      if (ops_is_root()) {
-        FILE *fp;
-        fp = fopen(file_name, "w");
-        fclose(fp);
-      }
-      // Create a new file collectively and release property list identifier.
-      file_id = H5Fcreate(file_name, H5F_ACC_TRUNC, H5P_DEFAULT, plist_id);
-      H5Fclose(file_id);
+    // attach attributes to dat
+    H5LTset_attribute_string(group_id, dat->name, "ops_type",
+                             "ops_dat"); // ops type
+    H5LTset_attribute_string(group_id, dat->name, "block",
+                             block->name); // block
+    H5LTset_attribute_int(group_id, dat->name, "block_index",
+                          &(block->index), 1); // block index
+    H5LTset_attribute_int(group_id, dat->name, "dim", &(dat->dim),
+                          1); // dim
+    H5LTset_attribute_int(group_id, dat->name, "size", g_size,
+                          block->dims); // size
+    H5LTset_attribute_int(group_id, dat->name, "d_m", g_d_m,
+                          block->dims); // d_m
+    H5LTset_attribute_int(group_id, dat->name, "d_p", g_d_p,
+                          block->dims); // d_p
+    H5LTset_attribute_int(group_id, dat->name, "base", dat->base,
+                          block->dims); // base
+    H5LTset_attribute_string(group_id, dat->name, "type",
+                             dat->type); // type
+  } else {
+    ops_printf("Dataset %s already found in file %s ... ", dat->name,
+               file_name);
+    overwriting = 1;
+  }
+
+  //
+  // check attributes .. error if not equal
+  //
+  char read_ops_type[20];
+  if (H5LTget_attribute_string(group_id, dat->name, "ops_type",
+                               read_ops_type) < 0) {
+    OPSException ex(OPS_HDF5_ERROR);
+    ex << "Error: ops_fetch_dat_hdf5_file: Attribute \"ops_type\" not "
+          "found in data set"
+       << dat->name;
+    throw ex;
+  } else {
+    if (strcmp("ops_dat", read_ops_type) != 0) {
+      OPSException ex(OPS_HDF5_ERROR);
+      ex << "Error: ops_fetch_dat_hdf5_file: ops_type of dat " << dat->name
+         << " is not ops_dat";
+      throw ex;
     }
+  }
 
-    file_id = H5Fopen(file_name, H5F_ACC_RDWR, plist_id);
-    H5Pclose(plist_id);
+  char read_block_name[30];
+  if (H5LTget_attribute_string(group_id, dat->name, "block",
+                               read_block_name) < 0) {
+    OPSException ex(OPS_HDF5_ERROR);
+    ex << "Error: ops_decl_block_hdf5: Attribute \"block\" not found in "
+          "data set "
+       << dat->name;
+    throw ex;
+  } else {
+    if (strcmp(block->name, read_block_name) != 0) {
+      OPSException ex(OPS_HDF5_ERROR);
+      ex << "Error: ops_decl_block_hdf5: Attribute \"block\" mismatch "
+            "for data set "
+         << dat->name << "block name: " << block->name
+         << " read block name: " << read_block_name;
+      throw ex;
+    }
+  }
 
-    if (H5Lexists(file_id, block->name, H5P_DEFAULT) == 0) {
+  int read_block_index;
+  if (H5LTget_attribute_int(group_id, dat->name, "block_index",
+                            &read_block_index) < 0) {
+    OPSException ex(OPS_HDF5_ERROR);
+    ex << "Error: ops_decl_block_hdf5: Attribute \"block_index\" not "
+          "found in data set "
+       << dat->name;
+    throw ex;
+  } else {
+    if (block->index != read_block_index) {
       OPSException ex(OPS_HDF5_ERROR);
-      ex << "Error: Error: ops_fetch_dat_hdf5_file: ops_block on which this "
-            "ops_dat "
-         << dat->name << " is declared does not exist in the file";
+      ex << "Error: ops_decl_block_hdf5: Attribute \"block_index\" "
+            "mismatch for data set "
+         << dat->name << " read " << read_block_index
+         << " versus provided: " << block->index;
       throw ex;
-    } else {
-      // open existing group -- an ops_block is a group
-      group_id = H5Gopen2(file_id, block->name, H5P_DEFAULT);
-      int overwriting = 0;
-
-      if (H5Lexists(group_id, dat->name, H5P_DEFAULT) == 0) {
-        if (OPS_instance::getOPSInstance()->OPS_diags > 2)
-          ops_printf(
-              "ops_fetch_dat_hdf5_file: ops_dat %s does not exists in the "
-              "ops_block %s ... creating ops_dat\n",
-              dat->name, block->name);
-
-        // transpose global size as on hdf5 file the dims are written transposed
-        hsize_t GBL_SIZE[block->dims];
-        if (block->dims == 1) {
-          GBL_SIZE[0] = gbl_size[0];
-        } else if (block->dims == 2) {
-          GBL_SIZE[0] = gbl_size[1];
-          GBL_SIZE[1] = gbl_size[0];
-        } else if (block->dims == 3) {
-          GBL_SIZE[0] = gbl_size[2];
-          GBL_SIZE[1] = gbl_size[1];
-          GBL_SIZE[2] = gbl_size[0];
-        }
+    }
+  }
 
-        // Create the dataspace for the dataset
-        filespace =
-            H5Screate_simple(block->dims, GBL_SIZE, NULL); // space in file
-
-        // Create a reasonable chunk size
-        /*int cart_dims[OPS_MAX_DIM], cart_periods[OPS_MAX_DIM],
-            cart_coords[OPS_MAX_DIM];
-        MPI_Cart_get(sb->comm, block->dims, cart_dims, cart_periods,
-                     cart_coords);
-
-        for (int i = 0; i < block->dims; i++) {
-          CHUNK_SIZE[i] = MAX((GBL_SIZE[i] / 10), 1); // need to have a constant
-        chinksize
-                                                      // regardless of the
-        number of mpi procs
-
-          printf("%s GBL_SIZE[%d] = %d, size[%d] = %d, cart_dims[%d] = %d, "
-                 "CHUNK_SIZE[%d] = %d, value[%d] = %lf\n",
-                 dat->name, i, GBL_SIZE[i], i, size[i], i, cart_dims[i], i,
-                 CHUNK_SIZE[i], i, GBL_SIZE[i] / (double)cart_dims[i]);
-        }*/
-
-        // Create chunked dataset
-        plist_id = H5Pcreate(H5P_DATASET_CREATE);
-        // H5Pset_chunk(plist_id, block->dims, GBL_SIZE); // chunk data set need
-        //  to be the same size
-        //  on each proc
-
-        // Create the dataset with default properties and close filespace.
-        dset_id = H5Dcreate(group_id, dat->name, h5_type(dat->type), filespace,
-                            H5P_DEFAULT, plist_id, H5P_DEFAULT);
-
-        H5Pclose(plist_id);
-        H5Sclose(filespace);
-        H5Dclose(dset_id);
-
-        // attach attributes to dat
-        H5LTset_attribute_string(group_id, dat->name, "ops_type",
-                                 "ops_dat"); // ops type
-        H5LTset_attribute_string(group_id, dat->name, "block",
-                                 block->name); // block
-        H5LTset_attribute_int(group_id, dat->name, "block_index",
-                              &(block->index), 1); // block index
-        H5LTset_attribute_int(group_id, dat->name, "dim", &(dat->dim),
-                              1); // dim
-        H5LTset_attribute_int(group_id, dat->name, "size", g_size,
-                              block->dims); // size
-        H5LTset_attribute_int(group_id, dat->name, "d_m", g_d_m,
-                              block->dims); // d_m
-        H5LTset_attribute_int(group_id, dat->name, "d_p", g_d_p,
-                              block->dims); // d_p
-        H5LTset_attribute_int(group_id, dat->name, "base", dat->base,
-                              block->dims); // base
-        H5LTset_attribute_string(group_id, dat->name, "type",
-                                 dat->type); // type
-      } else {
-        ops_printf("Dataset %s already found in file %s ... ", dat->name,
-                   file_name);
-        overwriting = 1;
-      }
+  int read_dim;
+  if (H5LTget_attribute_int(group_id, dat->name, "dim", &read_dim) < 0) {
+    OPSException ex(OPS_HDF5_ERROR);
+    ex << "Error: ops_decl_block_hdf5: Attribute \"dim\" not found in "
+          "data set "
+       << dat->name;
+    throw ex;
+  } else {
+    if (dat->dim != read_dim) {
+      OPSException ex(OPS_HDF5_ERROR);
+      ex << "Error: ops_decl_block_hdf5: Attribute \"dim\" mismatch for "
+            "data set "
+         << dat->name << " read " << read_dim
+         << " versus provided: " << dat->dim;
+      throw ex;
+    }
+  }
 
-      //
-      // check attributes .. error if not equal
-      //
-      char read_ops_type[20];
-      if (H5LTget_attribute_string(group_id, dat->name, "ops_type",
-                                   read_ops_type) < 0) {
+  int read_size[block->dims];
+  if (H5LTget_attribute_int(group_id, dat->name, "size", read_size) < 0) {
+    OPSException ex(OPS_HDF5_ERROR);
+    ex << "Error: ops_decl_block_hdf5: Attribute \"size\" not found in "
+          "data set "
+       << dat->name;
+    throw ex;
+  } else {
+    for (int d = 0; d < block->dims; d++) {
+      if (g_size[d] != read_size[d]) {
         OPSException ex(OPS_HDF5_ERROR);
-        ex << "Error: ops_fetch_dat_hdf5_file: Attribute \"ops_type\" not "
-              "found in data set"
-           << dat->name;
+        ex << "Error: ops_decl_block_hdf5: Attribute \"size\" mismatch "
+              "for data set "
+           << dat->name << " read " << read_size[d]
+           << " versus provided: " << g_size[d] << " in dim " << d;
         throw ex;
-      } else {
-        if (strcmp("ops_dat", read_ops_type) != 0) {
-          OPSException ex(OPS_HDF5_ERROR);
-          ex << "Error: ops_fetch_dat_hdf5_file: ops_type of dat " << dat->name
-             << " is not ops_dat";
-          throw ex;
-        }
       }
+    }
+  }
 
-      char read_block_name[30];
-      if (H5LTget_attribute_string(group_id, dat->name, "block",
-                                   read_block_name) < 0) {
+  int read_d_m[block->dims];
+  if (H5LTget_attribute_int(group_id, dat->name, "d_m", read_d_m) < 0) {
+    OPSException ex(OPS_HDF5_ERROR);
+    ex << "Error: ops_decl_block_hdf5: Attribute \"d_m\" not found in "
+          "data set "
+       << dat->name;
+    throw ex;
+  } else {
+    for (int d = 0; d < block->dims; d++) {
+      if (g_d_m[d] != read_d_m[d]) {
         OPSException ex(OPS_HDF5_ERROR);
-        ex << "Error: ops_decl_block_hdf5: Attribute \"block\" not found in "
-              "data set "
-           << dat->name;
+        ex << "Error: ops_decl_block_hdf5: Attribute \"d_m\" mismatch "
+              "for data set "
+           << dat->name << " read " << read_d_m[d]
+           << " versus provided: " << g_d_m[d] << " in dim " << d;
         throw ex;
-      } else {
-        if (strcmp(block->name, read_block_name) != 0) {
-          OPSException ex(OPS_HDF5_ERROR);
-          ex << "Error: ops_decl_block_hdf5: Attribute \"block\" mismatch "
-                "for data set "
-             << dat->name << "block name: " << block->name
-             << " read block name: " << read_block_name;
-          throw ex;
-        }
       }
+    }
+  }
 
-      int read_block_index;
-      if (H5LTget_attribute_int(group_id, dat->name, "block_index",
-                                &read_block_index) < 0) {
+  int read_d_p[block->dims];
+  if (H5LTget_attribute_int(group_id, dat->name, "d_p", read_d_p) < 0) {
+    OPSException ex(OPS_HDF5_ERROR);
+    ex << "Error: ops_decl_block_hdf5: Attribute \"d_p\" not found in "
+          "data set "
+       << dat->name;
+    throw ex;
+  } else {
+    for (int d = 0; d < block->dims; d++) {
+      if (g_d_p[d] != read_d_p[d]) {
         OPSException ex(OPS_HDF5_ERROR);
-        ex << "Error: ops_decl_block_hdf5: Attribute \"block_index\" not "
-              "found in data set "
-           << dat->name;
+        ex << "Error: ops_decl_block_hdf5: Attribute \"d_p\" mismatch "
+              "for data set "
+           << dat->name << " read " << read_d_p[d]
+           << " versus provided: " << g_d_p[d] << " in dim " << d;
         throw ex;
-      } else {
-        if (block->index != read_block_index) {
-          OPSException ex(OPS_HDF5_ERROR);
-          ex << "Error: ops_decl_block_hdf5: Attribute \"block_index\" "
-                "mismatch for data set "
-             << dat->name << " read " << read_block_index
-             << " versus provided: " << block->index;
-          throw ex;
-        }
       }
+    }
+  }
 
-      int read_dim;
-      if (H5LTget_attribute_int(group_id, dat->name, "dim", &read_dim) < 0) {
+  int read_base[block->dims];
+  if (H5LTget_attribute_int(group_id, dat->name, "base", read_base) < 0) {
+    OPSException ex(OPS_HDF5_ERROR);
+    ex << "Error: ops_decl_block_hdf5: Attribute \"base\" not found in "
+          "data set "
+       << dat->name;
+    throw ex;
+  } else {
+    for (int d = 0; d < block->dims; d++) {
+      if (dat->base[d] != read_base[d]) {
         OPSException ex(OPS_HDF5_ERROR);
-        ex << "Error: ops_decl_block_hdf5: Attribute \"dim\" not found in "
-              "data set "
-           << dat->name;
+        ex << "Error: ops_decl_block_hdf5: Attribute \"base\" mismatch "
+              "for data set "
+           << dat->name << " read " << read_base[d]
+           << " versus provided: " << dat->base[d] << " in dim " << d;
         throw ex;
-      } else {
-        if (dat->dim != read_dim) {
-          OPSException ex(OPS_HDF5_ERROR);
-          ex << "Error: ops_decl_block_hdf5: Attribute \"dim\" mismatch for "
-                "data set "
-             << dat->name << " read " << read_dim
-             << " versus provided: " << dat->dim;
-          throw ex;
-        }
       }
+    }
+  }
 
-      int read_size[block->dims];
-      if (H5LTget_attribute_int(group_id, dat->name, "size", read_size) < 0) {
-        OPSException ex(OPS_HDF5_ERROR);
-        ex << "Error: ops_decl_block_hdf5: Attribute \"size\" not found in "
-              "data set "
-           << dat->name;
-        throw ex;
-      } else {
-        for (int d = 0; d < block->dims; d++) {
-          if (g_size[d] != read_size[d]) {
-            OPSException ex(OPS_HDF5_ERROR);
-            ex << "Error: ops_decl_block_hdf5: Attribute \"size\" mismatch "
-                  "for data set "
-               << dat->name << " read " << read_size[d]
-               << " versus provided: " << g_size[d] << " in dim " << d;
-            throw ex;
-          }
-        }
-      }
+  char read_type[15];
+  if (H5LTget_attribute_string(group_id, dat->name, "type", read_type) <
+      0) {
+    OPSException ex(OPS_HDF5_ERROR);
+    ex << "Error: ops_decl_block_hdf5: Attribute \"type\" not found in "
+          "data set "
+       << dat->name;
+    throw ex;
+  } else {
+    if (strcmp(dat->type, read_type) != 0) {
+      OPSException ex(OPS_HDF5_ERROR);
+      ex << "Error: ops_decl_block_hdf5: Attribute \"type\" mismatch for "
+            "data set "
+         << dat->name << " read " << read_type
+         << " versus provided: " << dat->type;
+      throw ex;
+    }
+  }
 
-      int read_d_m[block->dims];
-      if (H5LTget_attribute_int(group_id, dat->name, "d_m", read_d_m) < 0) {
-        OPSException ex(OPS_HDF5_ERROR);
-        ex << "Error: ops_decl_block_hdf5: Attribute \"d_m\" not found in "
-              "data set "
-           << dat->name;
-        throw ex;
-      } else {
-        for (int d = 0; d < block->dims; d++) {
-          if (g_d_m[d] != read_d_m[d]) {
-            OPSException ex(OPS_HDF5_ERROR);
-            ex << "Error: ops_decl_block_hdf5: Attribute \"d_m\" mismatch "
-                  "for data set "
-               << dat->name << " read " << read_d_m[d]
-               << " versus provided: " << g_d_m[d] << " in dim " << d;
-            throw ex;
-          }
-        }
-      }
+  // all good , overwrite the existing dataset
+  if (overwriting)
+    ops_printf("overwriting\n");
 
-      int read_d_p[block->dims];
-      if (H5LTget_attribute_int(group_id, dat->name, "d_p", read_d_p) < 0) {
-        OPSException ex(OPS_HDF5_ERROR);
-        ex << "Error: ops_decl_block_hdf5: Attribute \"d_p\" not found in "
-              "data set "
-           << dat->name;
-        throw ex;
-      } else {
-        for (int d = 0; d < block->dims; d++) {
-          if (g_d_p[d] != read_d_p[d]) {
-            OPSException ex(OPS_HDF5_ERROR);
-            ex << "Error: ops_decl_block_hdf5: Attribute \"d_p\" mismatch "
-                  "for data set "
-               << dat->name << " read " << read_d_p[d]
-               << " versus provided: " << g_d_p[d] << " in dim " << d;
-            throw ex;
-          }
-        }
-      }
+  // open existing dat
+  dset_id = H5Dopen(group_id, dat->name, H5P_DEFAULT);
+  H5Gclose(group_id);
+  return dset_id;
+}
 
-      int read_base[block->dims];
-      if (H5LTget_attribute_int(group_id, dat->name, "base", read_base) < 0) {
-        OPSException ex(OPS_HDF5_ERROR);
-        ex << "Error: ops_decl_block_hdf5: Attribute \"base\" not found in "
-              "data set "
-           << dat->name;
-        throw ex;
-      } else {
-        for (int d = 0; d < block->dims; d++) {
-          if (dat->base[d] != read_base[d]) {
-            OPSException ex(OPS_HDF5_ERROR);
-            ex << "Error: ops_decl_block_hdf5: Attribute \"base\" mismatch "
-                  "for data set "
-               << dat->name << " read " << read_base[d]
-               << " versus provided: " << dat->base[d] << " in dim " << d;
-            throw ex;
-          }
-        }
-      }
+/*******************************************************************************
+ * Selects the part of the dataset of an ops_dat held by this process, in the
+ * file dataspace and in a memory dataspace of data laid out either as the
+ * local array of the dat (in_place) or as its points without MPI halos.
+ * Processes not holding the block of the dat select nothing
+ *******************************************************************************/
+static void select_dat_hdf5(ops_dat dat, hid_t dset_id, bool in_place,
+                            hid_t *memspace, hid_t *filespace) {
+  sub_block *sb = OPS_sub_block_list[dat->block->index];
+  *filespace = H5Dget_space(dset_id);
+  if (sb->owned == 0) {
+    hsize_t one = 1;
+    *memspace = H5Screate_simple(1, &one, NULL);
+    H5Sselect_none(*memspace);
+    H5Sselect_none(*filespace);
+    return;
+  }
 
-      char read_type[15];
-      if (H5LTget_attribute_string(group_id, dat->name, "type", read_type) <
-          0) {
-        OPSException ex(OPS_HDF5_ERROR);
-        ex << "Error: ops_decl_block_hdf5: Attribute \"type\" not found in "
-              "data set "
-           << dat->name;
-        throw ex;
-      } else {
-        if (strcmp(dat->type, read_type) != 0) {
-          OPSException ex(OPS_HDF5_ERROR);
-          ex << "Error: ops_decl_block_hdf5: Attribute \"type\" mismatch for "
-                "data set "
-             << dat->name << " read " << read_type
-             << " versus provided: " << dat->type;
-          throw ex;
-        }
-      }
+  // compute the number of elements that this process will write to the final
+  // file
+  // also compute the correct offsets on the final file that this process
+  // should begin from to write
+  sub_dat *sd = OPS_sub_dat_list[dat->index];
+  ops_block block = dat->block;
+
+  hsize_t disp[block->dims]; // global disps to compute the chunk data set
+  // dimensions
+  hsize_t l_disp[block->dims]; // local disps to remove MPI halos
+  hsize_t size[block->dims];   // local size to compute the chunk data set
+  // dimensions
+
+  hsize_t count[block->dims];  // parameters for for hdf5 file chuck writing
+  hsize_t stride[block->dims]; // parameters for for hdf5 file chuck writing
+
+  for (int d = 0; d < block->dims; d++) {
+    // remove left MPI halo to get start disp from beginning of dat
+    // include left block halo
+    disp[d] = sd->decomp_disp[d] -
+              sd->gbl_d_m[d];    // global displacements of the data set
+    l_disp[d] = 0 - sd->d_im[d]; // local displacements of the data set (i.e.
+    // per MPI proc)
+    size[d] = sd->decomp_size[d]; // local size to compute the chunk data set
+    // dimensions
 
-      // all good , overwrite the existing dataset
-      if (overwriting)
-        ops_printf("overwriting\n");
-
-      // open existing dat
-      dset_id = H5Dopen(group_id, dat->name, H5P_DEFAULT);
-
-      // Need to flip the dimensions to accurately write to HDF5 chunk
-      // decomposition
-      hsize_t DISP[block->dims];
-      hsize_t SIZE[block->dims];
-      if (block->dims == 1) {
-        DISP[0] = disp[0];
-        SIZE[0] = size[0];
-      } else if (block->dims == 2) {
-        DISP[0] = disp[1];
-        DISP[1] = disp[0];
-        SIZE[0] = size[1];
-        SIZE[1] = size[0];
-      } else if (block->dims == 3) {
-        DISP[0] = disp[2];
-        DISP[1] = disp[1]; // note how dimension 1 remains the same !!
-        DISP[2] = disp[0];
-        SIZE[0] = size[2];
-        SIZE[1] = size[1]; // note how dimension 1 remains the same !!
-        SIZE[2] = size[0];
-      }
+    count[d] = 1;
+    stride[d] = 1;
+  }
+
+  // MPI halos are left out by the memory dataspace of a local array
+  if (in_place)
+    *memspace = ops_hdf5_dat_memspace(dat, l_disp, size);
+
+  // make sure we multiply by the number of data values per
+  // element (i.e. dat->dim) to get full size of the data
+  size[0] = size[0] * dat->dim;
+  disp[0] = disp[0] * dat->dim;
+
+  // Need to flip the dimensions to accurately write to HDF5 chunk
+  // decomposition
+  hsize_t DISP[block->dims];
+  hsize_t SIZE[block->dims];
+  if (block->dims == 1) {
+    DISP[0] = disp[0];
+    SIZE[0] = size[0];
+  } else if (block->dims == 2) {
+    DISP[0] = disp[1];
+    DISP[1] = disp[0];
+    SIZE[0] = size[1];
+    SIZE[1] = size[0];
+  } else if (block->dims == 3) {
+    DISP[0] = disp[2];
+    DISP[1] = disp[1]; // note how dimension 1 remains the same !!
+    DISP[2] = disp[0];
+    SIZE[0] = size[2];
+    SIZE[1] = size[1]; // note how dimension 1 remains the same !!
+    SIZE[2] = size[0];
+  }
+
+  if (!in_place)
+    *memspace = H5Screate_simple(
+        block->dims, SIZE,
+        NULL); // block of memory to write to file by each proc
+
+  // Select hyperslab
+  H5Sselect_hyperslab(*filespace, H5S_SELECT_SET, DISP, stride, count, SIZE);
+}
 
-      memspace = H5Screate_simple(
-          block->dims, SIZE,
-          NULL); // block of memory to write to file by each proc
+/*******************************************************************************
+ * Writes this process's part of an ops_dat to its dataset in a named hdf5
+ * file, collectively over OPS_MPI_HDF5_BLOCK_WORLD, which is then freed. data
+ * is laid out either as the local array of the dat (in_place) or as its points
+ * without MPI halos
+ *******************************************************************************/
+static void write_dat_hdf5(ops_dat dat, char const *file_name, char *data,
+                           bool in_place, MPI_Comm OPS_MPI_HDF5_BLOCK_WORLD) {
+  hid_t file_id =
+      open_file_hdf5(file_name, OPS_MPI_HDF5_BLOCK_WORLD, MPI_INFO_NULL);
+  hid_t dset_id = open_dat_hdf5(file_id, dat, file_name);
+  hid_t memspace, filespace;
+  select_dat_hdf5(dat, dset_id, in_place, &memspace, &filespace);
 
-      // Select hyperslab
-      filespace = H5Dget_space(dset_id);
-      H5Sselect_hyperslab(filespace, H5S_SELECT_SET, DISP, stride, count, SIZE);
+  // Create property list for collective dataset write.
+  hid_t plist_id = H5Pcreate(H5P_DATASET_XFER);
+  H5Pset_dxpl_mpio(plist_id, H5FD_MPIO_COLLECTIVE);
 
-      // Create property list for collective dataset write.
-      plist_id = H5Pcreate(H5P_DATASET_XFER);
-      H5Pset_dxpl_mpio(plist_id, H5FD_MPIO_COLLECTIVE);
+  // write data
+  hid_t datatype = h5_type(dat->type);
+  H5Dwrite(dset_id, datatype, memspace, filespace, plist_id, data);
 
-      // write data
-      hid_t datatype = h5_type(dat->type);
-      H5Dwrite(dset_id, datatype, memspace, filespace, plist_id, data);
+  MPI_Barrier(OPS_MPI_HDF5_BLOCK_WORLD);
 
-      MPI_Barrier(OPS_MPI_HDF5_BLOCK_WORLD);
-      free(data);
+  H5Sclose(filespace);
+  H5Pclose(plist_id);
+  H5Dclose(dset_id);
+  H5Sclose(memspace);
 
-      H5Sclose(filespace);
-      H5Pclose(plist_id);
-      H5Dclose(dset_id);
-      H5Sclose(memspace);
+  H5Fclose(file_id);
+  MPI_Comm_free(&OPS_MPI_HDF5_BLOCK_WORLD);
+}
 
-      H5Gclose(group_id);
-      H5Fclose(file_id);
-      MPI_Comm_free(&OPS_MPI_HDF5_BLOCK_WORLD);
+// Asynchronous writes (OPS_IO_ASYNC) and output sessions use a communicator
+// of their own, the main thread may be using OPS_MPI_GLOBAL at the same time.
+// It is duplicated once and kept for all of them
+static MPI_Comm OPS_MPI_HDF5_IO_WORLD = MPI_COMM_NULL;
+
+static MPI_Comm io_world() {
+  if (OPS_MPI_HDF5_IO_WORLD == MPI_COMM_NULL)
+    MPI_Comm_dup(OPS_MPI_GLOBAL, &OPS_MPI_HDF5_IO_WORLD);
+  return OPS_MPI_HDF5_IO_WORLD;
+}
+
+// MPI-IO hints of the files written over io_world(): the writes of all
+// processes go through collective buffering, onto OPS_HDF5_AGGREGATORS writer
+// processes if given
+static MPI_Info io_info() {
+  MPI_Info info;
+  MPI_Info_create(&info);
+  MPI_Info_set(info, "romio_cb_write", "enable");
+  int aggregators = OPS_instance::getOPSInstance()->ops_hdf5_aggregators;
+  if (aggregators > 0)
+    MPI_Info_set(info, "cb_nodes", std::to_string(aggregators).c_str());
+  return info;
+}
+
+/*******************************************************************************
+ * Fetches the local part of an ops_dat to be written to hdf5, the local array
+ * of the dat itself if in_place, unless OPS_IO_ASYNC needs a snapshot of it.
+ * NULL on processes not holding the block of the dat
+ *******************************************************************************/
+static char *stage_dat_hdf5(ops_dat dat, bool in_place) {
+  OPS_instance *instance = dat->block->instance;
+  sub_block *sb = OPS_sub_block_list[dat->block->index];
+  char *data = NULL;
+  if (sb->owned == 1) {
+    // fetch data onto the host ( if needed ) based on the backend
+    ops_get_data(dat);
+
+    // write straight from the local array, unless its layout has to be
+    // converted
+    if (in_place) {
+      ops_execute(instance);
+      ops_get_data(dat);
+      data = dat->data;
+      // the dat may change while it is written in the background
+      if (instance->ops_io_async) {
+        size_t bytes = dat->elem_size;
+        for (int d = 0; d < dat->block->dims; d++)
+          bytes *= dat->size[d];
+        data = (char *)ops_malloc(bytes);
+        memcpy(data, dat->data, bytes);
+      }
+    } else {
+      sub_dat *sd = OPS_sub_dat_list[dat->index];
+      hsize_t t_size = 1;
+      int local_range[2 * OPS_MAX_DIM];
+      int range[2 * OPS_MAX_DIM];
+      for (int d = 0; d < dat->block->dims; d++) {
+        t_size *= sd->decomp_size[d];
+        range[2 * d] = sd->gbl_d_m[d];
+        range[2 * d + 1] = sd->gbl_size[d] + sd->gbl_d_m[d];
+      }
+      data = (char *)ops_malloc(t_size * dat->elem_size);
+      determine_local_range(dat, range, local_range);
+      copy_data_buf(dat, local_range, data);
     }
   }
+  return data;
+}
+
+/*******************************************************************************
+ * Routine to write an ops_dat to a named hdf5 file,
+ * if file does not exist, creates it
+ * if the data set does not exists in file creates data set
+ *******************************************************************************/
+void ops_fetch_dat_hdf5_file(ops_dat dat, char const *file_name) {
+  OPS_instance *instance = dat->block->instance;
+  sub_block *sb = OPS_sub_block_list[dat->block->index];
+  bool in_place = ops_hdf5_dat_in_place(dat);
+  char *data = stage_dat_hdf5(dat, in_place);
+  MPI_Comm OPS_MPI_HDF5_BLOCK_WORLD = MPI_COMM_NULL;
+  if (sb->owned == 1) {
+    // use the communicator for MPI procs holding this block
+    MPI_Comm_dup(sb->comm1, &OPS_MPI_HDF5_BLOCK_WORLD);
+  }
+
+  if (instance->ops_io_async) {
+    MPI_Comm io_comm = io_world();
+    std::string file(file_name);
+    ops_io_submit(instance, [=] {
+      if (data != NULL) {
+        write_dat_hdf5(dat, file.c_str(), data, in_place,
+                       OPS_MPI_HDF5_BLOCK_WORLD);
+        free(data);
+      }
+      MPI_Barrier(io_comm); // wait for every rank to finish
+    });
+    return;
+  }
+
+  if (data != NULL) {
+    write_dat_hdf5(dat, file_name, data, in_place, OPS_MPI_HDF5_BLOCK_WORLD);
+    if (data != dat->data)
+      free(data);
+  }
   MPI_Barrier(OPS_MPI_GLOBAL); // wait for every rank to finish their I/O
   return;
 }
@@ -1034,6 +1128,7 @@ void ops_fetch_dat_hdf5_file(ops_dat dat, char const *file_name) {
  *******************************************************************************/
 ops_block ops_decl_block_hdf5(int dims, const char *block_name,
                               char const *file_name) {
+  ops_io_wait();
   // create new communicator
   int my_rank, comm_size;
   MPI_Comm_dup(OPS_MPI_GLOBAL, &OPS_MPI_HDF5_WORLD);
@@ -1121,6 +1216,7 @@ ops_block ops_decl_block_hdf5(int dims, const char *block_name,
 ops_stencil ops_decl_stencil_hdf5(int dims, int points,
                                   const char *stencil_name,
                                   char const *file_name) {
+  ops_io_wait();
   // create new communicator
   int my_rank, comm_size;
   MPI_Comm_dup(OPS_MPI_GLOBAL, &OPS_MPI_HDF5_WORLD);
@@ -1232,6 +1328,7 @@ ops_stencil ops_decl_stencil_hdf5(int dims, int points,
  * Routine to read an ops_halo from an hdf5 file
  *******************************************************************************/
 ops_halo ops_decl_halo_hdf5(ops_dat from, ops_dat to, char const *file_name) {
+  ops_io_wait();
   // create new communicator
   int my_rank, comm_size;
   MPI_Comm_dup(OPS_MPI_GLOBAL, &OPS_MPI_HDF5_WORLD);
@@ -1358,6 +1455,7 @@ ops_halo ops_decl_halo_hdf5(ops_dat from, ops_dat to, char const *file_name) {
  *******************************************************************************/
 ops_dat ops_decl_dat_hdf5(ops_block block, int dat_dim, char const *type,
                           char const *dat_name, char const *file_name) {
+  ops_io_wait();
   ops_read_dat_hdf5_dynamic = ops_read_dat_hdf5;
 
   // create new communicator
@@ -1538,6 +1636,7 @@ ops_dat ops_decl_dat_hdf5(ops_block block, int dat_dim, char const *type,
  * only used with the MPI backends
  *******************************************************************************/
 void ops_read_dat_hdf5(ops_dat dat) {
+  ops_io_wait();
   sub_block *sb = OPS_sub_block_list[dat->block->index];
   if (sb->owned == 1) {
     // compute the number of elements that this process will read from file
@@ -1600,9 +1699,15 @@ void ops_read_dat_hdf5(ops_dat dat) {
     hsize_t t_size = 1;
     for (int d = 0; d < dat->block->dims; d++)
       t_size *= size[d];
-    char *data = (char *)ops_malloc(t_size * dat->elem_size);
     dat->mem = t_size * dat->elem_size;
 
+    // read straight into the local array, MPI halos excluded by the memory
+    // dataspace, unless its layout has to be converted
+    hid_t memspace = ops_hdf5_dat_memspace(dat, l_disp, size2);
+    char *data = dat->data;
+    if (memspace == H5I_INVALID_HID)
+      data = (char *)ops_malloc(t_size * dat->elem_size);
+
     // make sure we multiply by the number of
     // data values per element (i.e. dat->dim) to get full size of the data
     size[0] = size[0] * dat->dim;
@@ -1634,7 +1739,6 @@ void ops_read_dat_hdf5(ops_dat dat) {
     hid_t dset_id;   // dataset identifier
     hid_t filespace; // data space identifier
     hid_t plist_id;  // property list identifier
-    hid_t memspace;  // memory space identifier
 
     // open given hdf5 file .. if it exists
     if (file_exist(dat->hdf5_file) == 0) {
@@ -1703,9 +1807,10 @@ void ops_read_dat_hdf5(ops_dat dat) {
       SIZE[2] = size[0];
     }
 
-    memspace = H5Screate_simple(
-        block->dims, size,
-        NULL); // block of memory to read from file by each proc
+    if (data != dat->data)
+      memspace = H5Screate_simple(
+          block->dims, size,
+          NULL); // block of memory to read from file by each proc
 
     // Select hyperslab
     filespace = H5Dget_space(dset_id);
@@ -1728,9 +1833,17 @@ void ops_read_dat_hdf5(ops_dat dat) {
     //   add_mpi_halos4D(dat, size2, l_disp, data);
     // else if (block->dims == 5)
     //   add_mpi_halos5D(dat, size2, l_disp, data);
-    ops_dat_set_data(dat, 0, data);
-
-    free(data);
+    if (data != dat->data) {
+      ops_dat_set_data(dat, 0, data);
+      free(data);
+    } else {
+      dat->dirty_hd = 1;
+      sd->dirtybit = 1;
+      for (int i = 0; i < 2 * block->dims * MAX_DEPTH; i++) {
+        sd->dirty_dir_send[i] = 1;
+        sd->dirty_dir_recv[i] = 1;
+      }
+    }
     H5Sclose(filespace);
     H5Pclose(plist_id);
     H5Dclose(dset_id);
@@ -1758,13 +1871,6 @@ void ops_dump_to_hdf5(char const *file_name) {
         OPS_instance::getOPSInstance()->OPS_block_list[n].block, file_name);
   }
 
-  TAILQ_FOREACH(item, &OPS_instance::getOPSInstance()->OPS_dat_list, entries) {
-    printf("Dumping dat %15s to HDF5 file %s\n", (item->dat)->name, file_name);
-    if (item->dat->e_dat !=
-        1) // currently cannot write edge dats .. need to fix this
-      ops_fetch_dat_hdf5_file(item->dat, file_name);
-  }
-
   for (int i = 0; i < OPS_instance::getOPSInstance()->OPS_stencil_index; i++) {
     printf("Dumping stencil %15s to HDF5 file %s\n",
            OPS_instance::getOPSInstance()->OPS_stencil_list[i]->name,
@@ -1782,6 +1888,17 @@ void ops_dump_to_hdf5(char const *file_name) {
     ops_fetch_halo_hdf5_file(OPS_instance::getOPSInstance()->OPS_halo_list[i],
                              file_name);
   }
+
+  // dats last, with OPS_IO_ASYNC the other writes would wait for them, all in
+  // one session so that the file is opened once for them
+  ops_hdf5_session session = ops_hdf5_session_open(file_name);
+  TAILQ_FOREACH(item, &OPS_instance::getOPSInstance()->OPS_dat_list, entries) {
+    printf("Dumping dat %15s to HDF5 file %s\n", (item->dat)->name, file_name);
+    if (item->dat->e_dat !=
+        1) // currently cannot write edge dats .. need to fix this
+      ops_hdf5_session_add_dat(session, item->dat);
+  }
+  ops_hdf5_session_close(session);
 }
 
 /*******************************************************************************
@@ -1891,6 +2008,7 @@ herr_t get_dataset_properties(hid_t dset_id,
  *******************************************************************************/
 void ops_get_const_hdf5(char const *name, int dim, char const *type,
                         char *const_data, char const *file_name) {
+  ops_io_wait();
   // create new communicator
   int my_rank, comm_size;
   MPI_Comm_dup(OPS_MPI_GLOBAL, &OPS_MPI_HDF5_WORLD);
@@ -1981,55 +2099,23 @@ void ops_get_const_hdf5(char const *name, int dim, char const *type,
 }
 
 /*******************************************************************************
- * Routine to write a constant to a named hdf5 file
+ * Writes a constant to an hdf5 file open for collective writes over comm
  *******************************************************************************/
-void ops_write_const_hdf5(char const *name, int dim, char const *type,
-                          char *const_data, char const *file_name) {
-  // letting know that writing is happening ...
-  // ops_printf("Writing '%s' to file '%s'\n", name, file_name);
-
-  // create new communicator
-  int my_rank, comm_size;
-  MPI_Comm_dup(OPS_MPI_GLOBAL, &OPS_MPI_HDF5_WORLD);
-  MPI_Comm_rank(OPS_MPI_HDF5_WORLD, &my_rank);
-  MPI_Comm_size(OPS_MPI_HDF5_WORLD, &comm_size);
-
-  // MPI variables
-  MPI_Info info = MPI_INFO_NULL;
-
+static void write_const_hdf5(hid_t file_id, MPI_Comm comm, char const *name,
+                             int dim, char const *type, char *const_data,
+                             char const *file_name) {
   // HDF5 APIs definitions
-  hid_t file_id;   // file identifier
   hid_t dset_id;   // dataset identifier
   hid_t plist_id;  // property list identifier
   hid_t dataspace; // data space identifier
   htri_t status;   // status for checking return values
 
-  // Set up file access property list with parallel I/O access
-  plist_id = H5Pcreate(H5P_FILE_ACCESS);
-  H5Pset_fapl_mpio(plist_id, OPS_MPI_HDF5_WORLD, info);
-
-  if (file_exist(file_name) == 0) {
-    if (OPS_instance::getOPSInstance()->OPS_diags > 3) {
-      ops_printf("File %s does not exist .... creating file\n", file_name);
-    }
-    file_id = H5Fcreate(file_name, H5F_ACC_EXCL, H5P_DEFAULT, plist_id);
-    H5Fclose(file_id);
-  }
-
-  /* Open the existing file. */
-  file_id = H5Fopen(file_name, H5F_ACC_RDWR, plist_id);
-  H5Pclose(plist_id);
-
   // Check if const already exists in data set
   status = H5Lexists(file_id, name, H5P_DEFAULT);
   if (status > 0) {
     ops_printf("Const dataset %s already found in file %s ... ", name,
                file_name);
 
-    // Set up file access property list with parallel I/O access
-    plist_id = H5Pcreate(H5P_FILE_ACCESS);
-    H5Pset_fapl_mpio(plist_id, OPS_MPI_HDF5_WORLD, info);
-
     // open existing data set
     dset_id = H5Dopen(file_id, name, H5P_DEFAULT);
 
@@ -2045,7 +2131,7 @@ void ops_write_const_hdf5(char const *name, int dim, char const *type,
     if (status < 0) {
       ops_printf("Could not get properties of dataset '%s' in file '%s'\n",
                  name, file_name);
-      MPI_Abort(OPS_MPI_HDF5_WORLD, 2);
+      MPI_Abort(comm, 2);
     }
 
     const_dim = dset_props.size;
@@ -2053,7 +2139,7 @@ void ops_write_const_hdf5(char const *name, int dim, char const *type,
       ops_printf(
           "dim of constant %d in file %s and requested dim %d do not match\n",
           const_dim, file_name, dim);
-      MPI_Abort(OPS_MPI_HDF5_WORLD, 2);
+      MPI_Abort(comm, 2);
     }
 
     const char *typ = dset_props.type_str;
@@ -2078,8 +2164,6 @@ void ops_write_const_hdf5(char const *name, int dim, char const *type,
     H5Pclose(plist_id);
     H5Sclose(dataspace);
     H5Dclose(dset_id);
-    H5Fclose(file_id);
-    MPI_Comm_free(&OPS_MPI_HDF5_WORLD);
     return;
   }
 
@@ -2155,19 +2239,121 @@ void ops_write_const_hdf5(char const *name, int dim, char const *type,
     ops_printf(
         "Unknown type %s for constant %s: cannot write constant to file\n",
         type, name);
-    MPI_Abort(OPS_MPI_HDF5_WORLD, 2);
+    MPI_Abort(comm, 2);
   }
 
   H5Aclose(attribute);
   H5Sclose(dataspace);
   H5Dclose(dset_id);
+}
+
+/*******************************************************************************
+ * Routine to write a constant to a named hdf5 file
+ *******************************************************************************/
+void ops_write_const_hdf5(char const *name, int dim, char const *type,
+                          char *const_data, char const *file_name) {
+  ops_io_wait();
+  // letting know that writing is happening ...
+  // ops_printf("Writing '%s' to file '%s'\n", name, file_name);
+
+  // create new communicator
+  MPI_Comm_dup(OPS_MPI_GLOBAL, &OPS_MPI_HDF5_WORLD);
+
+  hid_t file_id = open_file_hdf5(file_name, OPS_MPI_HDF5_WORLD, MPI_INFO_NULL);
+  write_const_hdf5(file_id, OPS_MPI_HDF5_WORLD, name, dim, type, const_data,
+                   file_name);
 
   H5Fclose(file_id);
   MPI_Comm_free(&OPS_MPI_HDF5_WORLD);
 }
 
+/*******************************************************************************
+ * Writes the dats and constants of an output session collectively over comm,
+ * data[i] holds the local part of the i-th dat as staged by stage_dat_hdf5
+ *******************************************************************************/
+static void write_session_hdf5(ops_hdf5_session session,
+                               std::vector<char *> const &data, MPI_Comm comm) {
+  char const *file_name = session->file_name.c_str();
+
+  MPI_Info info = io_info();
+  hid_t file_id = open_file_hdf5(file_name, comm, info);
+  MPI_Info_free(&info);
+
+  for (auto &c : session->consts)
+    write_const_hdf5(file_id, comm, c.name.c_str(), c.dim, c.type.c_str(),
+                     (char *)c.data.data(), file_name);
+
+  size_t count = session->dats.size();
+  std::vector<hid_t> dset_ids(count), mem_type_ids(count),
+      mem_space_ids(count), file_space_ids(count);
+  std::vector<const void *> bufs(count);
+  for (size_t i = 0; i < count; i++) {
+    ops_dat dat = session->dats[i];
+    dset_ids[i] = open_dat_hdf5(file_id, dat, file_name);
+    mem_type_ids[i] = h5_type(dat->type);
+    select_dat_hdf5(dat, dset_ids[i], ops_hdf5_dat_in_place(dat),
+                    &mem_space_ids[i], &file_space_ids[i]);
+    bufs[i] = data[i];
+  }
+
+  // Create property list for collective dataset write.
+  hid_t plist_id = H5Pcreate(H5P_DATASET_XFER);
+  H5Pset_dxpl_mpio(plist_id, H5FD_MPIO_COLLECTIVE);
+
+  if (count > 0) {
+#if H5_VERSION_GE(1, 14, 0)
+    H5Dwrite_multi(count, dset_ids.data(), mem_type_ids.data(),
+                   mem_space_ids.data(), file_space_ids.data(), plist_id,
+                   bufs.data());
+#else
+    for (size_t i = 0; i < count; i++)
+      H5Dwrite(dset_ids[i], mem_type_ids[i], mem_space_ids[i],
+               file_space_ids[i], plist_id, bufs[i]);
+#endif
+  }
+
+  H5Pclose(plist_id);
+  for (size_t i = 0; i < count; i++) {
+    H5Sclose(file_space_ids[i]);
+    H5Sclose(mem_space_ids[i]);
+    H5Dclose(dset_ids[i]);
+  }
+  H5Fclose(file_id);
+}
+
+/*******************************************************************************
+ * Routine to write the dats and constants of an output session to its hdf5
+ * file
+ *******************************************************************************/
+void ops_hdf5_session_close(ops_hdf5_session session) {
+  OPS_instance *instance = OPS_instance::getOPSInstance();
+
+  std::vector<char *> data;
+  for (auto dat : session->dats)
+    data.push_back(stage_dat_hdf5(dat, ops_hdf5_dat_in_place(dat)));
+  MPI_Comm io_comm = io_world();
+
+  if (instance->ops_io_async) {
+    ops_io_submit(instance, [=] {
+      write_session_hdf5(session, data, io_comm);
+      for (auto d : data)
+        free(d);
+      delete session;
+    });
+    return;
+  }
+
+  ops_io_wait();
+  write_session_hdf5(session, data, io_comm);
+  for (size_t i = 0; i < data.size(); i++)
+    if (data[i] != session->dats[i]->data)
+      free(data[i]);
+  delete session;
+}
+
 // create a h5 file or open a h5 file if existing
 hid_t H5_file_handle(const MPI_Comm &mpi_comm, const char *file_name) {
+  ops_io_wait();
   int my_rank;
   MPI_Comm_rank(mpi_comm, &my_rank);
   MPI_Info info = MPI_INFO_NULL;
@@ -2212,12 +2398,12 @@ void write_plane_buf_hdf5(const char *file_name, const char *data_name,
     const int space_dim{dat->block->dims};
     const int data_dims{space_dim - 1};
     const sub_dat *sd = OPS_sub_dat_list[dat->index];
-    hsize_t *local_data_size_c{new hsize_t(data_dims)};
-    hsize_t *local_data_size_f{new hsize_t(data_dims)};
-    hsize_t *global_data_size_c{new hsize_t(data_dims)};
-    hsize_t *global_data_size_f{new hsize_t(data_dims)};
-    hsize_t *global_data_disp_c{new hsize_t(data_dims)};
-    hsize_t *global_data_disp_f{new hsize_t(data_dims)};
+    hsize_t local_data_size_c[OPS_MAX_DIM];
+    hsize_t local_data_size_f[OPS_MAX_DIM];
+    hsize_t global_data_size_c[OPS_MAX_DIM];
+    hsize_t global_data_size_f[OPS_MAX_DIM];
+    hsize_t global_data_disp_c[OPS_MAX_DIM];
+    hsize_t global_data_disp_f[OPS_MAX_DIM];
 
     {
       int reduced_index{0};
@@ -2260,8 +2446,8 @@ void write_plane_buf_hdf5(const char *file_name, const char *data_name,
 
     // block of memory to write to file by each proc
     hid_t memspace{H5Screate_simple(data_dims, local_data_size_f, NULL)};
-    hsize_t *stride{new hsize_t(data_dims)};
-    hsize_t *count{new hsize_t(data_dims)};
+    hsize_t stride[OPS_MAX_DIM];
+    hsize_t count[OPS_MAX_DIM];
     for (int d = 0; d < data_dims; d++) {
       stride[d] = 1;
       count[d] = 1;
@@ -2282,15 +2468,6 @@ void write_plane_buf_hdf5(const char *file_name, const char *data_name,
       H5Gclose(groupid_list[grp]);
     }
     H5Fclose(file_id);
-
-    delete count;
-    delete stride;
-    delete local_data_size_c;
-    delete local_data_size_f;
-    delete global_data_size_c;
-    delete global_data_size_f;
-    delete global_data_disp_c;
-    delete global_data_disp_f;
     MPI_Comm_free(&PLANE_WORLD);
   }
 }
@@ -2317,12 +2494,12 @@ void write_plane_buf_hdf5(const char *file_name, const char *data_name,
     const int space_dim{dat->block->dims};
     const int data_dims{space_dim - 1};
     const sub_dat *sd = OPS_sub_dat_list[dat->index];
-    hsize_t *local_data_size_c{new hsize_t(data_dims)};
-    hsize_t *local_data_size_f{new hsize_t(data_dims)};
-    hsize_t *global_data_size_c{new hsize_t(data_dims)};
-    hsize_t *global_data_size_f{new hsize_t(data_dims)};
-    hsize_t *global_data_disp_c{new hsize_t(data_dims)};
-    hsize_t *global_data_disp_f{new hsize_t(data_dims)};
+    hsize_t local_data_size_c[OPS_MAX_DIM];
+    hsize_t local_data_size_f[OPS_MAX_DIM];
+    hsize_t global_data_size_c[OPS_MAX_DIM];
+    hsize_t global_data_size_f[OPS_MAX_DIM];
+    hsize_t global_data_disp_c[OPS_MAX_DIM];
+    hsize_t global_data_disp_f[OPS_MAX_DIM];
 
     {
       int reduced_index{0};
@@ -2366,8 +2543,8 @@ void write_plane_buf_hdf5(const char *file_name, const char *data_name,
 
     // block of memory to write to file by each proc
     hid_t memspace{H5Screate_simple(data_dims, local_data_size_f, NULL)};
-    hsize_t *stride{new hsize_t(data_dims)};
-    hsize_t *count{new hsize_t(data_dims)};
+    hsize_t stride[OPS_MAX_DIM];
+    hsize_t count[OPS_MAX_DIM];
     for (int d = 0; d < data_dims; d++) {
       stride[d] = 1;
       count[d] = 1;
@@ -2388,15 +2565,6 @@ void write_plane_buf_hdf5(const char *file_name, const char *data_name,
       H5Gclose(groupid_list[grp]);
     }
     H5Fclose(file_id);
-
-    delete count;
-    delete stride;
-    delete local_data_size_c;
-    delete local_data_size_f;
-    delete global_data_size_c;
-    delete global_data_size_f;
-    delete global_data_disp_c;
-    delete global_data_disp_f;
     MPI_Comm_free(&PLANE_WORLD);
   }
 }
@@ -2430,12 +2598,12 @@ void write_slab_buf_hdf5(const char *file_name, const char *data_name,
 
 
     const sub_dat *sd = OPS_sub_dat_list[dat->index];
-    hsize_t *local_data_size_c{new hsize_t(space_dim)};
-    hsize_t *local_data_size_f{new hsize_t(space_dim)};
-    hsize_t *global_data_size_c{new hsize_t(space_dim)};
-    hsize_t *global_data_size_f{new hsize_t(space_dim)};
-    hsize_t *global_data_disp_c{new hsize_t(space_dim)};
-    hsize_t *global_data_disp_f{new hsize_t(space_dim)};
+    hsize_t local_data_size_c[OPS_MAX_DIM];
+    hsize_t local_data_size_f[OPS_MAX_DIM];
+    hsize_t global_data_size_c[OPS_MAX_DIM];
+    hsize_t global_data_size_f[OPS_MAX_DIM];
+    hsize_t global_data_disp_c[OPS_MAX_DIM];
+    hsize_t global_data_disp_f[OPS_MAX_DIM];
 
     for (int d = 0; d < space_dim; d++) {
 
@@ -2477,8 +2645,8 @@ void write_slab_buf_hdf5(const char *file_name, const char *data_name,
 
     // block of memory to write to file by each proc
     hid_t memspace{H5Screate_simple(space_dim, local_data_size_f, NULL)};
-    hsize_t *stride{new hsize_t(space_dim)};
-    hsize_t *count{new hsize_t(space_dim)};
+    hsize_t stride[OPS_MAX_DIM];
+    hsize_t count[OPS_MAX_DIM];
     for (int d = 0; d < space_dim; d++) {
       stride[d] = 1;
       count[d] = 1;
@@ -2499,15 +2667,6 @@ void write_slab_buf_hdf5(const char *file_name, const char *data_name,
       H5Gclose(groupid_list[grp]);
     }
     H5Fclose(file_id);
-
-    delete count;
-    delete stride;
-    delete local_data_size_c;
-    delete local_data_size_f;
-    delete global_data_size_c;
-    delete global_data_size_f;
-    delete global_data_disp_c;
-    delete global_data_disp_f;
     MPI_Comm_free(&SLAB_WORLD);
   }
 }
@@ -2540,12 +2699,12 @@ void write_slab_buf_hdf5(const char *file_name, const char *data_name,
 
 
     const sub_dat *sd = OPS_sub_dat_list[dat->index];
-    hsize_t *local_data_size_c{new hsize_t(space_dim)};
-    hsize_t *local_data_size_f{new hsize_t(space_dim)};
-    hsize_t *global_data_size_c{new hsize_t(space_dim)};
-    hsize_t *global_data_size_f{new hsize_t(space_dim)};
-    hsize_t *global_data_disp_c{new hsize_t(space_dim)};
-    hsize_t *global_data_disp_f{new hsize_t(space_dim)};
+    hsize_t local_data_size_c[OPS_MAX_DIM];
+    hsize_t local_data_size_f[OPS_MAX_DIM];
+    hsize_t global_data_size_c[OPS_MAX_DIM];
+    hsize_t global_data_size_f[OPS_MAX_DIM];
+    hsize_t global_data_disp_c[OPS_MAX_DIM];
+    hsize_t global_data_disp_f[OPS_MAX_DIM];
 
     for (int d = 0; d < space_dim; d++) {
 
@@ -2588,8 +2747,8 @@ void write_slab_buf_hdf5(const char *file_name, const char *data_name,
 
     // block of memory to write to file by each proc
     hid_t memspace{H5Screate_simple(space_dim, local_data_size_f, NULL)};
-    hsize_t *stride{new hsize_t(space_dim)};
-    hsize_t *count{new hsize_t(space_dim)};
+    hsize_t stride[OPS_MAX_DIM];
+    hsize_t count[OPS_MAX_DIM];
     for (int d = 0; d < space_dim; d++) {
       stride[d] = 1;
       count[d] = 1;
@@ -2610,15 +2769,6 @@ void write_slab_buf_hdf5(const char *file_name, const char *data_name,
       H5Gclose(groupid_list[grp]);
     }
     H5Fclose(file_id);
-
-    delete count;
-    delete stride;
-    delete local_data_size_c;
-    delete local_data_size_f;
-    delete global_data_size_c;
-    delete global_data_size_f;
-    delete global_data_disp_c;
-    delete global_data_disp_f;
     MPI_Comm_free(&SLAB_WORLD);
   }
 }
@@ -2634,9 +2784,9 @@ void ops_write_plane_hdf5(const ops_dat dat, const int cross_section_dir,
       sub_block *sb = OPS_sub_block_list[dat->block->index];
       if (sb->owned == 1) {
         const int space_dim{dat->block->dims};
-        int *global_range{new int(2 * space_dim)};
+        int global_range[2 * OPS_MAX_DIM];
         determine_plane_global_range(dat, cross_section_dir, pos, global_range);
-        int *local_range{new int(2 * space_dim)};
+        int local_range[2 * OPS_MAX_DIM];
         // TODO if the plane is out of global range, computer range will
         // generate error
         determine_local_range(dat, global_range, local_range);
@@ -2657,8 +2807,6 @@ void ops_write_plane_hdf5(const ops_dat dat, const int cross_section_dir,
                              local_range, global_range, local_buf);
         free(local_buf);
         //}
-        delete global_range;
-        delete local_range;
       }
     } else {
       ops_printf("The dat %s doesn't have the specified plane = %d \n",
@@ -2680,7 +2828,7 @@ void ops_write_data_slab_hdf5(const ops_dat dat, const int *range,
   sub_block *sb = OPS_sub_block_list[dat->block->index];
   if (sb->owned == 1) {
     const int space_dim{dat->block->dims};
-    int *local_range{new int(2 * space_dim)};
+    int local_range[2 * OPS_MAX_DIM];
     // TODO if the plane is out of global range, computer range will generate
     // error
     determine_local_range(dat, range, local_range);
@@ -2701,8 +2849,6 @@ void ops_write_data_slab_hdf5(const ops_dat dat, const int *range,
                         local_buf);
     free(local_buf);
     //}
-
-    delete local_range;
   }
 }
 
@@ -2764,9 +2910,9 @@ void ops_write_plane_hdf5(const ops_dat dat, const int cross_section_dir,
       sub_block *sb = OPS_sub_block_list[dat->block->index];
       if (sb->owned == 1) {
         const int space_dim{dat->block->dims};
-        int *global_range{new int(2 * space_dim)};
+        int global_range[2 * OPS_MAX_DIM];
         determine_plane_global_range(dat, cross_section_dir, pos, global_range);
-        int *local_range{new int(2 * space_dim)};
+        int local_range[2 * OPS_MAX_DIM];
         // TODO if the plane is out of global range, computer range will
         // generate error
         determine_local_range(dat, global_range, local_range);
@@ -2781,8 +2927,6 @@ void ops_write_plane_hdf5(const ops_dat dat, const int cross_section_dir,
                              local_range, global_range, real_precision, local_buf);
         free(local_buf);
         //}
-        delete global_range;
-        delete local_range;
       }
     } else {
       ops_printf("The dat %s doesn't have the specified plane = %d \n",
@@ -2804,7 +2948,7 @@ void ops_write_data_slab_hdf5(const ops_dat dat, const int *range,
   sub_block *sb = OPS_sub_block_list[dat->block->index];
   if (sb->owned == 1) {
     const int space_dim{dat->block->dims};
-    int *local_range{new int(2 * space_dim)};
+    int local_range[2 * OPS_MAX_DIM];
     // TODO if the plane is out of global range, computer range will generate
     // error
     determine_local_range(dat, range, local_range);
@@ -2825,8 +2969,6 @@ void ops_write_data_slab_hdf5(const ops_dat dat, const int *range,
                         real_precision, local_buf);
     free(local_buf);
     //}
-
-    delete local_range;
   }
 }
 
@@ -2876,3 +3018,68 @@ void ops_write_plane_group_hdf5(
   }
   ops_write_plane_group_hdf5(planes, plane_names, key, data_list, real_precision);
 }
+
+/*******************************************************************************
+ * In-situ output pipelines, each process copies the part of a plane or slab
+ * in its own sub-block, the writes of all are aggregated by MPI-IO
+ *******************************************************************************/
+static void add_insitu_hdf5(ops_insitu_hdf5 insitu, ops_dat dat,
+                            char const *data_name, int cross_section_dir,
+                            const int *range) {
+  const sub_block *sb = OPS_sub_block_list[dat->block->index];
+  const sub_dat *sd = OPS_sub_dat_list[dat->index];
+  int local_range[2 * OPS_MAX_DIM]{0};
+  int local_disp[OPS_MAX_DIM]{0};
+  if (sb->owned == 1) {
+    determine_local_range(dat, range, local_range);
+    for (int d = 0; d < dat->block->dims; d++)
+      local_disp[d] = MAX(range[2 * d], sd->decomp_disp[d]) - range[2 * d];
+  }
+  ops_insitu_hdf5_add(insitu, dat, data_name, cross_section_dir, range,
+                      local_range, local_disp);
+}
+
+void ops_insitu_add_plane_hdf5(ops_insitu_hdf5 insitu, ops_dat dat,
+                               int cross_section_dir, int pos,
+                               char const *data_name) {
+  const sub_dat *sd = OPS_sub_dat_list[dat->index];
+  const int d{cross_section_dir};
+  if ((d < 0) || (d >= dat->block->dims) || (pos < 0) ||
+      (pos >= sd->gbl_size[d] - (sd->gbl_d_p[d] - sd->gbl_d_m[d]))) {
+    OPSException ex(OPS_INVALID_ARGUMENT);
+    ex << "Error: the dat " << dat->name << " doesn't have the plane " << pos
+       << " in direction " << cross_section_dir;
+    throw ex;
+  }
+  int range[2 * OPS_MAX_DIM];
+  determine_plane_global_range(dat, cross_section_dir, pos, range);
+  add_insitu_hdf5(insitu, dat, data_name, cross_section_dir, range);
+}
+
+void ops_insitu_add_slab_hdf5(ops_insitu_hdf5 insitu, ops_dat dat,
+                              const int *range, char const *data_name) {
+  add_insitu_hdf5(insitu, dat, data_name, -1, range);
+}
+
+void ops_insitu_step_hdf5(ops_insitu_hdf5 insitu, int step) {
+  if (step % insitu->frequency != 0)
+    return;
+  // on every process, the pending loops may exchange halos
+  ops_execute(OPS_instance::getOPSInstance());
+  char *slot = ops_insitu_hdf5_slot(insitu);
+  for (auto &item : insitu->items)
+    if (item.bytes > 0)
+      copy_data_buf(item.dat, item.local_range, slot + item.offset);
+  MPI_Comm io_comm = io_world();
+  ops_insitu_hdf5_submit(insitu, [=] {
+    MPI_Info info = io_info();
+    hid_t file_id =
+        open_file_hdf5(insitu->file_name.c_str(), io_comm, info);
+    MPI_Info_free(&info);
+    hid_t plist_id = H5Pcreate(H5P_DATASET_XFER);
+    H5Pset_dxpl_mpio(plist_id, H5FD_MPIO_COLLECTIVE);
+    ops_insitu_hdf5_write(insitu, file_id, plist_id, step, slot);
+    H5Pclose(plist_id);
+    H5Fclose(file_id);
+  });
+}
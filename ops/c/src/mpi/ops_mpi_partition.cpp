@@ -38,6 +38,8 @@
   */
 
 #include <math.h>
+#include <algorithm>
+#include <vector>
 #include <mpi.h>
 #include <ops_mpi_core.h>
 #include <ops_exceptions.h>
@@ -67,6 +69,19 @@ int ops_comm_global_size;
 int ops_my_global_rank;
 int partitioned = 0;
 
+// Assignment of processes to blocks and their extents, as returned by
+// ops_partition_blocks, kept for ops_repartition
+static int *part_processes = NULL;
+static int *part_offsets = NULL;
+static int *part_disps = NULL;
+static int *part_sizes = NULL;
+static int *part_dimsplit = NULL;
+static double repartition_time = 0.0; // kernel time at the last repartition
+
+// Imbalance between the slowest and fastest slab of processes ignored by
+// ops_repartition
+#define OPS_REPARTITION_TOLERANCE 0.05
+
 sub_block_list *OPS_sub_block_list; // pointer to list holding sub-block
                                     // geometries
 
@@ -76,6 +91,152 @@ sub_dat_list *OPS_sub_dat_list; // pointer to list holding sub-dat
 int intersection(int range1_beg, int range1_end, int range2_beg,
                  int range2_end);
 
+// Size of the largest dataset defined on a block, accumulated into max_sizes
+static void ops_block_max_sizes(ops_block block, int *max_sizes) {
+  ops_dat_entry *item, *tmp_item;
+  for (item = TAILQ_FIRST(&(OPS_instance::getOPSInstance()->OPS_block_list[block->index].datasets));
+       item != NULL; item = tmp_item) {
+    tmp_item = TAILQ_NEXT(item, entries);
+    for (int d = 0; d < block->dims; d++)
+      max_sizes[d] = MAX(item->dat->size[d] + item->dat->base[d] +
+                             item->dat->d_m[d] - item->dat->d_p[d],
+                         max_sizes[d]);
+  }
+}
+
+// Distributes nproc processes between the blocks, each getting at least one,
+// so that the largest number of grid points (times the weight of the block)
+// per process is minimal
+static void ops_partition_weighted_counts(int nproc, double *weights,
+                                          int *processes_per_block) {
+  int nblocks = OPS_instance::getOPSInstance()->OPS_block_index;
+  std::vector<double> load(nblocks);
+  for (int i = 0; i < nblocks; i++) {
+    ops_block block = OPS_instance::getOPSInstance()->OPS_block_list[i].block;
+    int max_sizes[OPS_MAX_DIM] = {0};
+    ops_block_max_sizes(block, max_sizes);
+    load[i] = weights == NULL ? 1.0 : weights[i];
+    for (int d = 0; d < block->dims; d++)
+      load[i] *= MAX(max_sizes[d], 1);
+    processes_per_block[i] = 1;
+  }
+  for (int p = nblocks; p < nproc; p++) {
+    int busiest = 0;
+    for (int i = 1; i < nblocks; i++)
+      if (load[i] / processes_per_block[i] > load[busiest] / processes_per_block[busiest])
+        busiest = i;
+    processes_per_block[busiest]++;
+  }
+}
+
+// Splits nproc processes across the dimensions of a block so that the total
+// area of the boundaries between the processes is minimal, optionally with
+// the number of parts in each dimension dividing those in divides
+static void ops_partition_min_surface_rec(int nproc, int ndim, int *max_sizes,
+                                          int *fixed, int *divides, int d,
+                                          int *current, int *best_dims,
+                                          double *best) {
+  for (int p = 1; p <= nproc; p++) {
+    if (nproc % p != 0 || (fixed[d] != 0 && fixed[d] != p) ||
+        p > MAX(max_sizes[d], 1) || (divides != NULL && divides[d] % p != 0))
+      continue;
+    current[d] = p;
+    if (d < ndim - 1) {
+      ops_partition_min_surface_rec(nproc / p, ndim, max_sizes, fixed, divides,
+                                    d + 1, current, best_dims, best);
+      continue;
+    }
+    if (p != nproc) continue; // the last dimension takes the rest
+    double surface = 0;
+    for (int d1 = 0; d1 < ndim; d1++) {
+      double face = current[d1] - 1;
+      for (int d2 = 0; d2 < ndim; d2++)
+        if (d2 != d1) face *= MAX(max_sizes[d2], 1);
+      surface += face;
+    }
+    if (*best < 0 || surface < *best) {
+      *best = surface;
+      for (int d1 = 0; d1 < ndim; d1++) best_dims[d1] = current[d1];
+    }
+  }
+}
+
+// Dimensions with a non-zero entry in pdims are kept as given, returns 0 if
+// there is no split with at least one grid point per process
+static int ops_partition_min_surface(int nproc, int ndim, int *max_sizes,
+                                     int *pdims) {
+  int current[OPS_MAX_DIM], best_dims[OPS_MAX_DIM];
+  double best = -1;
+  ops_partition_min_surface_rec(nproc, ndim, max_sizes, pdims, NULL, 0,
+                                current, best_dims, &best);
+  if (best < 0) return 0;
+  for (int d = 0; d < ndim; d++) pdims[d] = best_dims[d];
+  return 1;
+}
+
+// Node of each process, numbered by its lowest rank: processes sharing memory
+// as reported by MPI, or groups of ranks_per_node consecutive ranks
+static std::vector<int> ops_partition_nodes(int ranks_per_node) {
+  std::vector<int> nodes(ops_comm_global_size);
+  if (ranks_per_node > 0) {
+    for (int p = 0; p < ops_comm_global_size; p++)
+      nodes[p] = p - p % ranks_per_node;
+    return nodes;
+  }
+  MPI_Comm node_comm;
+  MPI_Comm_split_type(OPS_MPI_GLOBAL, MPI_COMM_TYPE_SHARED, ops_my_global_rank,
+                      MPI_INFO_NULL, &node_comm);
+  int leader;
+  MPI_Allreduce(&ops_my_global_rank, &leader, 1, MPI_INT, MPI_MIN, node_comm);
+  MPI_Comm_free(&node_comm);
+  MPI_Allgather(&leader, 1, MPI_INT, &nodes[0], 1, MPI_INT, OPS_MPI_GLOBAL);
+  return nodes;
+}
+
+// Reassigns the nproc processes of a block, listed in processes, to the pdims
+// grid so that each node holds a box of neighbouring processes, with the node
+// grid chosen to minimise the area of the boundaries between nodes. Returns 0
+// and leaves processes unchanged if the nodes hold different numbers of the
+// processes or no node grid fits in pdims.
+static int ops_partition_topology_map(int nproc, int ndim, int *max_sizes,
+                                      int *pdims, std::vector<int> &nodes,
+                                      int *processes, int *node_dims) {
+  std::vector<int> node_ids;
+  std::vector<std::vector<int> > node_ranks;
+  for (int j = 0; j < nproc; j++) {
+    int n = std::find(node_ids.begin(), node_ids.end(), nodes[processes[j]]) - node_ids.begin();
+    if (n == (int)node_ids.size()) {
+      node_ids.push_back(nodes[processes[j]]);
+      node_ranks.push_back(std::vector<int>());
+    }
+    node_ranks[n].push_back(processes[j]);
+  }
+  int nnodes = node_ids.size();
+  for (int n = 1; n < nnodes; n++)
+    if (node_ranks[n].size() != node_ranks[0].size()) return 0;
+
+  int fixed[OPS_MAX_DIM] = {0}, current[OPS_MAX_DIM];
+  double best = -1;
+  ops_partition_min_surface_rec(nnodes, ndim, max_sizes, fixed, pdims, 0,
+                                current, node_dims, &best);
+  if (best < 0) return 0;
+
+  for (int j = 0; j < nproc; j++) {
+    int node = 0, local = 0;
+    for (int d = 0; d < ndim; d++) {
+      int cumdim = 1;
+      for (int d2 = d + 1; d2 < ndim; d2++)
+        cumdim *= pdims[d2];
+      int coord = (j / cumdim) % pdims[d];
+      int local_dim = pdims[d] / node_dims[d];
+      node = node * node_dims[d] + coord / local_dim;
+      local = local * local_dim + coord % local_dim;
+    }
+    processes[j] = node_ranks[node][local];
+  }
+  return 1;
+}
+
 /*
  * Returns a CSR-like array, listing the processes assigned to each block and
  * describing their sub-dimensions
@@ -83,6 +244,14 @@ int intersection(int range1_beg, int range1_end, int range2_beg,
  */
 void ops_partition_blocks(int **processes, int **proc_offsets, int **proc_disps,
                           int **proc_sizes, int **proc_dimsplit, std::map<std::string, void*> &opts) {
+  // optional relative cost of a grid point on each block
+  double *weights = NULL;
+  if (opts.count("block_weights"))
+    weights = (double*)opts["block_weights"];
+  else if ((int)OPS_instance::getOPSInstance()->ops_block_weights.size() == OPS_instance::getOPSInstance()->OPS_block_index)
+    weights = &OPS_instance::getOPSInstance()->ops_block_weights[0];
+  int weighted = OPS_instance::getOPSInstance()->ops_partition_weighted || weights != NULL;
+
   // partitioning strategy 1. many blocks, few MPI processes, no splitting, just
   // spread around
   if (ops_comm_global_size <= OPS_instance::getOPSInstance()->OPS_block_index) {
@@ -95,20 +264,33 @@ void ops_partition_blocks(int **processes, int **proc_offsets, int **proc_disps,
     *proc_dimsplit =
         (int *)ops_malloc(OPS_MAX_DIM * OPS_instance::getOPSInstance()->OPS_block_index * sizeof(int));
 
+    // weighted: largest blocks first, each to the least loaded process
+    std::vector<double> proc_load(weighted ? ops_comm_global_size : 0, 0.0);
+    std::vector<std::pair<double, int> > block_load;
+    for (int i = 0; weighted && i < OPS_instance::getOPSInstance()->OPS_block_index; i++) {
+      ops_block block = OPS_instance::getOPSInstance()->OPS_block_list[i].block;
+      int max_sizes[OPS_MAX_DIM] = {0};
+      ops_block_max_sizes(block, max_sizes);
+      double load = weights == NULL ? 1.0 : weights[i];
+      for (int d = 0; d < block->dims; d++)
+        load *= MAX(max_sizes[d], 1);
+      block_load.push_back(std::make_pair(-load, i));
+    }
+    std::sort(block_load.begin(), block_load.end());
+    for (unsigned int b = 0; b < block_load.size(); b++) {
+      int proc = 0;
+      for (int p = 1; p < ops_comm_global_size; p++)
+        if (proc_load[p] < proc_load[proc]) proc = p;
+      proc_load[proc] -= block_load[b].first;
+      (*processes)[block_load[b].second] = proc;
+    }
+
     for (int i = 0; i < OPS_instance::getOPSInstance()->OPS_block_index; i++) {
-      (*processes)[i] = i % ops_comm_global_size;
+      if (!weighted) (*processes)[i] = i % ops_comm_global_size;
       (*proc_offsets)[i] = i;
       ops_block block = OPS_instance::getOPSInstance()->OPS_block_list[i].block;
       int max_sizes[OPS_MAX_DIM] = {0};
-      ops_dat_entry *item, *tmp_item;
-      for (item = TAILQ_FIRST(&(OPS_instance::getOPSInstance()->OPS_block_list[block->index].datasets));
-           item != NULL; item = tmp_item) {
-        tmp_item = TAILQ_NEXT(item, entries);
-        for (int d = 0; d < block->dims; d++)
-          max_sizes[d] = MAX(item->dat->size[d] + item->dat->base[d] +
-                                 item->dat->d_m[d] - item->dat->d_p[d],
-                             max_sizes[d]);
-      }
+      ops_block_max_sizes(block, max_sizes);
 
       for (int j = 0; j < OPS_MAX_DIM; j++) {
         (*proc_disps)[OPS_MAX_DIM * i + j] = 0;
@@ -136,6 +318,10 @@ void ops_partition_blocks(int **processes, int **proc_offsets, int **proc_disps,
         ex << "Error: processes_per_block argument to ops_partition: requested " << nproc_total << " but only " << ops_comm_global_size << " available";
         throw ex;
       }
+    } else if (weighted) {
+      nproc_total = ops_comm_global_size;
+      processes_per_block = (int*)ops_malloc(OPS_instance::getOPSInstance()->OPS_block_index * sizeof(int));
+      ops_partition_weighted_counts(nproc_total, weights, processes_per_block);
     } else {
       processes_per_block = (int*)ops_malloc(OPS_instance::getOPSInstance()->OPS_block_index * sizeof(int));
       for (int i = 0; i < OPS_instance::getOPSInstance()->OPS_block_index; i++)
@@ -151,6 +337,7 @@ void ops_partition_blocks(int **processes, int **proc_offsets, int **proc_disps,
         (int *)ops_malloc(OPS_MAX_DIM * OPS_instance::getOPSInstance()->OPS_block_index * sizeof(int));
 
     int process_count_accumulator = 0;
+    std::vector<int> nodes; // node of each process, for OPS_PARTITION_TOPOLOGY
     int blockdims = OPS_instance::getOPSInstance()->OPS_block_list[0].block->dims;
     for (int i = 0; i < OPS_instance::getOPSInstance()->OPS_block_index; i++) {
       ops_block block = OPS_instance::getOPSInstance()->OPS_block_list[i].block;
@@ -159,6 +346,10 @@ void ops_partition_blocks(int **processes, int **proc_offsets, int **proc_disps,
         (*processes)[(*proc_offsets)[i] + j] = process_count_accumulator + j;
       process_count_accumulator += processes_per_block[i];
 
+      // Determine the size of the largest dataset defined on the block
+      int max_sizes[OPS_MAX_DIM] = {1};
+      ops_block_max_sizes(block, max_sizes);
+
       // Use MPI_Dims_create to split the block along different dimensions
       int ndim = block->dims;
       int pdims[OPS_MAX_DIM] = {0};
@@ -204,23 +395,41 @@ void ops_partition_blocks(int **processes, int **proc_offsets, int **proc_disps,
       if (prod > processes_per_block[i]) throw OPSException(OPS_RUNTIME_CONFIGURATION_ERROR, "Error: force_decomp requested more processes than available for the block");
       
       //printf("requesting %dx%d for %d processes\n", pdims[0], pdims[1], processes_per_block[i]);
-      MPI_Dims_create(processes_per_block[i], ndim, pdims);
+      // or, when weighted, minimise the boundaries between the processes
+      if (!weighted || !ops_partition_min_surface(processes_per_block[i], ndim, max_sizes, pdims))
+        MPI_Dims_create(processes_per_block[i], ndim, pdims);
       for (int d = 0; d < ndim; d++)
         (*proc_dimsplit)[i * OPS_MAX_DIM + d] = pdims[d];
 //        (*proc_dimsplit)[i * OPS_MAX_DIM + d] = pdims[ndim-d-1];
       for (int d = ndim; d < OPS_MAX_DIM; d++)
         (*proc_dimsplit)[i * OPS_MAX_DIM + d] = 1;
 
-      // Determine the size of the largest dataset defined on the block
-      int max_sizes[OPS_MAX_DIM] = {1};
-      ops_dat_entry *item, *tmp_item;
-      for (item = TAILQ_FIRST(&(OPS_instance::getOPSInstance()->OPS_block_list[block->index].datasets));
-           item != NULL; item = tmp_item) {
-        tmp_item = TAILQ_NEXT(item, entries);
-        for (int d = 0; d < block->dims; d++)
-          max_sizes[d] = MAX(item->dat->size[d] + item->dat->base[d] +
-                                 item->dat->d_m[d] - item->dat->d_p[d],
-                             max_sizes[d]);
+      // keep boxes of neighbouring processes on the same node
+      if (OPS_instance::getOPSInstance()->ops_partition_topology != 0) {
+        if (nodes.empty())
+          nodes = ops_partition_nodes(OPS_instance::getOPSInstance()->ops_partition_topology);
+        int node_dims[OPS_MAX_DIM];
+        int *block_procs = &(*processes)[(*proc_offsets)[i]];
+        std::vector<int> before(block_procs, block_procs + processes_per_block[i]);
+        if (ops_partition_topology_map(processes_per_block[i], ndim, max_sizes, pdims,
+                                       nodes, block_procs, node_dims)) {
+          if (OPS_instance::getOPSInstance()->OPS_diags > 1) {
+            // the processes of the block may only have been reordered
+            std::vector<int> after(block_procs, block_procs + processes_per_block[i]);
+            std::sort(before.begin(), before.end());
+            std::sort(after.begin(), after.end());
+            if (before != after)
+              throw OPSException(OPS_INTERNAL_ERROR, "Error: OPS_PARTITION_TOPOLOGY did not permute the processes of a block");
+            ops_printf("block \"%s\" nodes arranged as ", block->name);
+            for (int d = 0; d < ndim; d++)
+              ops_printf(d == ndim - 1 ? "%d\n" : "%dx", node_dims[d]);
+            ops_printf("block \"%s\" processes on its grid:", block->name);
+            for (int j = 0; j < processes_per_block[i]; j++)
+              ops_printf(" %d", block_procs[j]);
+            ops_printf("\n");
+          }
+        } else
+          ops_printf("Warning: block \"%s\" cannot be split evenly between its nodes, ignoring OPS_PARTITION_TOPOLOGY\n", block->name);
       }
 
       // Given the split in different dimensions, equally divide up the block
@@ -254,6 +463,108 @@ void ops_partition_blocks(int **processes, int **proc_offsets, int **proc_disps,
   }
 }
 
+// Finds the neighbors of a sub-block on the same node, and sets up the
+// counters of the halo exchanges with them, for OPS_HALO_SHARED
+static void ops_decomp_shared(sub_block *sb) {
+  OPS_instance *instance = OPS_instance::getOPSInstance();
+  MPI_Comm_split_type(sb->comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL,
+                      &sb->shm_comm);
+  if (instance->ops_partition_topology > 0) {
+    // nodes as given by OPS_PARTITION_TOPOLOGY=
+    MPI_Comm node_comm;
+    MPI_Comm_split(sb->shm_comm,
+                   ops_my_global_rank / instance->ops_partition_topology, 0,
+                   &node_comm);
+    MPI_Comm_free(&sb->shm_comm);
+    sb->shm_comm = node_comm;
+  }
+
+  MPI_Group cart_group, shm_group;
+  MPI_Comm_group(sb->comm, &cart_group);
+  MPI_Comm_group(sb->shm_comm, &shm_group);
+  int my_cart_rank;
+  MPI_Comm_rank(sb->comm, &my_cart_rank);
+  for (int n = 0; n < sb->ndim; n++) {
+    int ids[2] = {sb->id_m[n], sb->id_p[n]}, shm_ids[2];
+    for (int i = 0; i < 2; i++) {
+      shm_ids[i] = -1;
+      // a process that is its own neighbor wraps its halos without MPI
+      if (ids[i] == MPI_PROC_NULL || ids[i] == my_cart_rank) continue;
+      MPI_Group_translate_ranks(cart_group, 1, &ids[i], shm_group, &shm_ids[i]);
+      if (shm_ids[i] == MPI_UNDEFINED) shm_ids[i] = -1;
+    }
+    sb->shm_m[n] = shm_ids[0];
+    sb->shm_p[n] = shm_ids[1];
+  }
+  MPI_Group_free(&cart_group);
+  MPI_Group_free(&shm_group);
+  if (instance->OPS_diags > 1) {
+    int sides = 0, total = 0;
+    for (int n = 0; n < sb->ndim; n++)
+      sides += (sb->shm_m[n] >= 0) + (sb->shm_p[n] >= 0);
+    MPI_Reduce(&sides, &total, 1, MPI_INT, MPI_SUM, 0, sb->comm);
+    if (my_cart_rank == 0)
+      printf("block \"%s\": %d halos copied between processes on the same node\n",
+             sb->block->name, total);
+  }
+
+  // ready and done counters for each side of each dimension
+  MPI_Info info;
+  MPI_Info_create(&info);
+  MPI_Info_set(info, "alloc_shared_noncontig", "true");
+  MPI_Win_allocate_shared(4 * OPS_MAX_DIM * sizeof(int), sizeof(int), info,
+                          sb->shm_comm, &sb->shm_flags, &sb->shm_flags_win);
+  MPI_Info_free(&info);
+  memset(sb->shm_flags, 0, 4 * OPS_MAX_DIM * sizeof(int));
+  MPI_Win_lock_all(MPI_MODE_NOCHECK, sb->shm_flags_win);
+  for (int n = 0; n < sb->ndim; n++) {
+    MPI_Aint size;
+    int disp_unit;
+    if (sb->shm_m[n] >= 0)
+      MPI_Win_shared_query(sb->shm_flags_win, sb->shm_m[n], &size, &disp_unit,
+                           &sb->shm_flags_m[n]);
+    if (sb->shm_p[n] >= 0)
+      MPI_Win_shared_query(sb->shm_flags_win, sb->shm_p[n], &size, &disp_unit,
+                           &sb->shm_flags_p[n]);
+  }
+  MPI_Win_sync(sb->shm_flags_win);
+  MPI_Barrier(sb->shm_comm);
+}
+
+// Allocates the data of a dat in memory shared with the other processes of
+// the block on the node, with its layout in front of it
+static char *ops_decomp_dat_alloc_shared(sub_block *sb, ops_dat dat,
+                                         size_t bytes) {
+  sub_dat *sd = OPS_sub_dat_list[dat->index];
+  MPI_Info info;
+  MPI_Info_create(&info);
+  MPI_Info_set(info, "alloc_shared_noncontig", "true");
+  ops_shm_header *header;
+  MPI_Win_allocate_shared(OPS_SHM_HEADER + bytes, 1, info, sb->shm_comm,
+                          &header, &sd->shm_win);
+  MPI_Info_free(&info);
+  char *data = (char *)header + OPS_SHM_HEADER;
+  memset(data, 0, bytes);
+  for (int n = 0; n < OPS_MAX_DIM; n++) {
+    header->prod[n] = n < sb->ndim ? sd->prod[n] : sd->prod[sb->ndim - 1];
+    header->owned_begin[n] = -dat->d_m[n] - sd->d_im[n];
+    header->owned_end[n] = dat->size[n] - dat->d_p[n] - sd->d_ip[n];
+  }
+  MPI_Barrier(sb->shm_comm);
+  for (int n = 0; n < sb->ndim; n++) {
+    MPI_Aint size;
+    int disp_unit;
+    sd->shm_m[n] = sd->shm_p[n] = NULL;
+    if (sb->shm_m[n] >= 0)
+      MPI_Win_shared_query(sd->shm_win, sb->shm_m[n], &size, &disp_unit,
+                           &sd->shm_m[n]);
+    if (sb->shm_p[n] >= 0)
+      MPI_Win_shared_query(sd->shm_win, sb->shm_p[n], &size, &disp_unit,
+                           &sd->shm_p[n]);
+  }
+  return data;
+}
+
 void ops_decomp(ops_block block, int num_proc, int *processes, int *proc_disps,
                 int *proc_sizes, int *proc_dimsplit) {
 
@@ -270,6 +581,10 @@ void ops_decomp(ops_block block, int num_proc, int *processes, int *proc_disps,
   sb->comm = MPI_COMM_NULL;
   sb->comm1 = MPI_COMM_NULL;
   sb->grp = MPI_GROUP_NULL;
+  sb->shm_comm = MPI_COMM_NULL;
+  sb->shm_flags_win = MPI_WIN_NULL;
+  for (int n = 0; n < OPS_MAX_DIM; n++)
+    sb->shm_m[n] = sb->shm_p[n] = -1;
 
   int my_local_rank = -1;
   for (int i = 0; i < num_proc; i++) {
@@ -285,7 +600,14 @@ void ops_decomp(ops_block block, int num_proc, int *processes, int *proc_disps,
   int *pdims = proc_dimsplit;
   int *periodic = (int *)ops_malloc(ndim * sizeof(int));
   for (int n = 0; n < ndim; n++) {
-    periodic[n] = 0; // false .. for now
+    periodic[n] = block->periodic[n];
+    // tiles are not skewed across periodic boundaries
+    if (periodic[n] && (OPS_instance::getOPSInstance()->ops_enable_tiling ||
+                        OPS_instance::getOPSInstance()->ops_halo_deep > 0)) {
+      OPSException ex(OPS_NOT_IMPLEMENTED);
+      ex << "Error: block " << block->name << " is periodic, which is not supported with OPS_TILING or OPS_HALO_DEEP";
+      throw ex;
+    }
   }
   MPI_Group global;
   MPI_Comm_group(OPS_MPI_GLOBAL, &global);
@@ -311,6 +633,24 @@ void ops_decomp(ops_block block, int num_proc, int *processes, int *proc_disps,
     for (int n = 0; n < ndim; n++)
       MPI_Cart_shift(sb->comm, n, 1, &(sb->id_m[n]), &(sb->id_p[n]));
 
+    int nneigh = 1;
+    for (int n = 0; n < ndim; n++)
+      nneigh *= 3;
+    sb->id_neigh = (int *)ops_malloc(nneigh * sizeof(int));
+    for (int i = 0; i < nneigh; i++) {
+      int coords[OPS_MAX_DIM];
+      int inside = 1;
+      for (int n = 0, p = i; n < ndim; n++, p /= 3) {
+        coords[n] = sb->coords[n] + p % 3 - 1;
+        if (!periodic[n] && (coords[n] < 0 || coords[n] >= pdims[n]))
+          inside = 0;
+      }
+      if (inside)
+        MPI_Cart_rank(sb->comm, coords, &(sb->id_neigh[i]));
+      else
+        sb->id_neigh[i] = MPI_PROC_NULL;
+    }
+
     /** ---- store subgrid dimensions and displacements ---- **/
 
     for (int n = 0; n < ndim; n++) {
@@ -326,6 +666,10 @@ void ops_decomp(ops_block block, int num_proc, int *processes, int *proc_disps,
       sb->decomp_disp[n] = 0;
       sb->decomp_size[n] = 1;
     }
+
+    if (OPS_instance::getOPSInstance()->ops_halo_shared &&
+        !OPS_instance::getOPSInstance()->OPS_hybrid_gpu)
+      ops_decomp_shared(sb);
   } else {
     for (int n = 0; n < OPS_MAX_DIM; n++) {
       sb->decomp_disp[n] = 0;
@@ -349,113 +693,207 @@ void ops_decomp(ops_block block, int num_proc, int *processes, int *proc_disps,
   ops_free(periodic);
 }
 
-void ops_decomp_dats(sub_block *sb) {
+// Computes the extents of the local part of a dataset from its global
+// extents (still held in dat) and the extents of the sub-block
+static void ops_decomp_dat_sizes(sub_block *sb, ops_dat dat) {
   ops_block block = sb->block;
-  ops_dat_entry *item, *tmp_item;
-  for (item = TAILQ_FIRST(&(OPS_instance::getOPSInstance()->OPS_block_list[block->index].datasets));
-       item != NULL; item = tmp_item) {
-    tmp_item = TAILQ_NEXT(item, entries);
-    ops_dat dat = item->dat;
-    sub_dat *sd = OPS_sub_dat_list[dat->index];
-
-    // aggregate size and prod array
-    size_t *prod_t = (size_t *)ops_malloc((sb->ndim + 1) * sizeof(size_t));
-    size_t *prod = &prod_t[1];
-    prod[-1] = 1;
-    sd->prod = prod;
-    sd->halos = NULL;
+  sub_dat *sd = OPS_sub_dat_list[dat->index];
 
-    for (int d = 0; d < block->dims; d++) {
-      // first store away the details of the dat (i.e global dat details)
-      sd->gbl_base[d] = dat->base[d]; // global start base
-      sd->gbl_size[d] = dat->size[d]; // global size of data elements in this
-                                      // dat (i.e. pure data)
-      sd->gbl_d_m[d] =
-          dat->d_m[d]; // global dat halo at the beginning (minus size)
-      sd->gbl_d_p[d] = dat->d_p[d]; // global dat halo at the end (positive
-                                    // size)
-
-      // special treatment if it's an edge dataset in this direction
-      if (dat->e_dat && (dat->size[d] == 1)) {
-        if (dat->base[d] != 0) {
-          OPSException ex(OPS_RUNTIME_ERROR);
-          ex << "Error: dataset " << dat->name << " is an edge dataset, but has a non-0 base";
-          throw ex;
-        }
-        prod[d] = prod[d - 1];
-        sd->decomp_disp[d] = 0;
-        sd->decomp_size[d] = 1;
-        sd->d_im[d] = 0; // no intra-block halo
-        sd->d_ip[d] = 0;
-        continue;
+  // aggregate size and prod array
+  size_t *prod_t = (size_t *)ops_malloc((sb->ndim + 1) * sizeof(size_t));
+  size_t *prod = &prod_t[1];
+  prod[-1] = 1;
+  sd->prod = prod;
+  sd->halos = NULL;
+
+  for (int d = 0; d < block->dims; d++) {
+    // first store away the details of the dat (i.e global dat details)
+    sd->gbl_base[d] = dat->base[d]; // global start base
+    sd->gbl_size[d] = dat->size[d]; // global size of data elements in this
+                                    // dat (i.e. pure data)
+    sd->gbl_d_m[d] =
+        dat->d_m[d]; // global dat halo at the beginning (minus size)
+    sd->gbl_d_p[d] = dat->d_p[d]; // global dat halo at the end (positive
+                                  // size)
+
+    // special treatment if it's an edge dataset in this direction
+    if (dat->e_dat && (dat->size[d] == 1)) {
+      if (dat->base[d] != 0) {
+        OPSException ex(OPS_RUNTIME_ERROR);
+        ex << "Error: dataset " << dat->name << " is an edge dataset, but has a non-0 base";
+        throw ex;
       }
+      prod[d] = prod[d - 1];
+      sd->decomp_disp[d] = 0;
+      sd->decomp_size[d] = 1;
+      sd->d_im[d] = 0; // no intra-block halo
+      sd->d_ip[d] = 0;
+      continue;
+    }
+
+    if (block->periodic[d] && dat->base[d] != 0) {
+      OPSException ex(OPS_RUNTIME_ERROR);
+      ex << "Error: dataset " << dat->name << " is on a block periodic in dimension " << d << ", but has a non-0 base";
+      throw ex;
+    }
 
-      // global size of dat
-      int zerobase_gbl_size =
-          dat->size[d] + dat->d_m[d] - dat->d_p[d] + dat->base[d];
-
-      sd->decomp_disp[d] = sb->decomp_disp[d]/dat->stride[d] + (sb->decomp_disp[d]%dat->stride[d] == 0 ? 0:1);
-      int next_block = (sb->decomp_disp[d]+sb->decomp_size[d]);
-      sd->decomp_size[d] = MAX(0,MIN(next_block/dat->stride[d] + (next_block%dat->stride[d] == 0 ? 0:1) - sd->decomp_disp[d],
-                                      zerobase_gbl_size - sd->decomp_disp[d]));
-      if (sb->id_m[d] != MPI_PROC_NULL) {
-        // if not negative end, then there is no block-level left padding, but
-        // intra-block halo padding
-        dat->base[d] = 0;
-        // TODO: compute this properly, or lazy or something
-        sd->d_im[d] = dat->d_m[d]; // intra-block (MPI) halos are set to be
-                                   // equal to block halos
-        if (OPS_instance::getOPSInstance()->ops_enable_tiling && OPS_instance::getOPSInstance()->ops_tiling_mpidepth>0)
+    // global size of dat
+    int zerobase_gbl_size =
+        dat->size[d] + dat->d_m[d] - dat->d_p[d] + dat->base[d];
+
+    sd->decomp_disp[d] = sb->decomp_disp[d]/dat->stride[d] + (sb->decomp_disp[d]%dat->stride[d] == 0 ? 0:1);
+    int next_block = (sb->decomp_disp[d]+sb->decomp_size[d]);
+    sd->decomp_size[d] = MAX(0,MIN(next_block/dat->stride[d] + (next_block%dat->stride[d] == 0 ? 0:1) - sd->decomp_disp[d],
+                                    zerobase_gbl_size - sd->decomp_disp[d]));
+    if (sb->id_m[d] != MPI_PROC_NULL) {
+      // if not negative end (or periodic), then there is no block-level left
+      // padding, but intra-block halo padding
+      dat->base[d] = 0;
+      // TODO: compute this properly, or lazy or something
+      sd->d_im[d] = dat->d_m[d]; // intra-block (MPI) halos are set to be
+                                 // equal to block halos
+      if (OPS_instance::getOPSInstance()->ops_enable_tiling && OPS_instance::getOPSInstance()->ops_tiling_mpidepth>0)
 					sd->d_im[d] = -OPS_instance::getOPSInstance()->ops_tiling_mpidepth;
+      // deep halos are never shallower than the block halos
+      if (OPS_instance::getOPSInstance()->ops_halo_deep > 0)
+        sd->d_im[d] = MIN(dat->d_m[d], -OPS_instance::getOPSInstance()->ops_tiling_mpidepth);
 
-        dat->d_m[d] = 0;
-      } else {
-        sd->decomp_disp[d] +=
-            (dat->base[d] + dat->d_m[d]); // move left end to negative for base
-                                          // and left block halo
-        sd->decomp_size[d] -= (dat->base[d] + dat->d_m[d]); // extend size
-        sd->d_im[d] = 0; // no intra-block halo
-      }
+      dat->d_m[d] = 0;
+    } else {
+      sd->decomp_disp[d] +=
+          (dat->base[d] + dat->d_m[d]); // move left end to negative for base
+                                        // and left block halo
+      sd->decomp_size[d] -= (dat->base[d] + dat->d_m[d]); // extend size
+      sd->d_im[d] = 0; // no intra-block halo
+    }
 
-      if (sb->id_p[d] != MPI_PROC_NULL) {
-        // if not positive end
-        // TODO: compute this properly, or lazy or something
-        sd->d_ip[d] = dat->d_p[d]; // intra-block (MPI) halos are set to be
-                                   // equal to block halos
+    if (sb->id_p[d] != MPI_PROC_NULL) {
+      // if not positive end
+      // TODO: compute this properly, or lazy or something
+      sd->d_ip[d] = dat->d_p[d]; // intra-block (MPI) halos are set to be
+                                 // equal to block halos
 
-        if (OPS_instance::getOPSInstance()->ops_enable_tiling && OPS_instance::getOPSInstance()->ops_tiling_mpidepth>0)
+      if (OPS_instance::getOPSInstance()->ops_enable_tiling && OPS_instance::getOPSInstance()->ops_tiling_mpidepth>0)
 					sd->d_ip[d] = OPS_instance::getOPSInstance()->ops_tiling_mpidepth;
+      if (OPS_instance::getOPSInstance()->ops_halo_deep > 0)
+        sd->d_ip[d] = MAX(dat->d_p[d], OPS_instance::getOPSInstance()->ops_tiling_mpidepth);
 
-        dat->d_p[d] = 0;
+      dat->d_p[d] = 0;
 
-        /*if (d == 0) { // Compute x-dim padding for vectorization
-          int temp_size = sd->decomp_size[0] - sd->d_im[0] + sd->d_ip[0];
-          int x_pad = (1+((temp_size-1)/32))*32 - temp_size;
-          sd->d_ip[0] = x_pad;
-        }*/
+      /*if (d == 0) { // Compute x-dim padding for vectorization
+        int temp_size = sd->decomp_size[0] - sd->d_im[0] + sd->d_ip[0];
+        int x_pad = (1+((temp_size-1)/32))*32 - temp_size;
+        sd->d_ip[0] = x_pad;
+      }*/
 
-      } else {
-        sd->decomp_size[d] += dat->d_p[d]; // if last in this dimension, extend
-                                           // with left block halo size
-        sd->d_ip[d] = 0;                   // no intra-block halo
-
-        /*if (d == 0) { // Compute x-dim padding for vectorization
-          int x_pad = (1+((sd->decomp_size[0]-1)/32))*32 - sd->decomp_size[0] ;
-          sd->decomp_size[0] += x_pad;
-          dat->d_p[0] += x_pad;
-        }*/
-      }
-      dat->size[d] = sd->decomp_size[d] - sd->d_im[d] + sd->d_ip[d];
-      prod[d] = prod[d - 1] * dat->size[d];
+    } else {
+      sd->decomp_size[d] += dat->d_p[d]; // if last in this dimension, extend
+                                         // with left block halo size
+      sd->d_ip[d] = 0;                   // no intra-block halo
+
+      /*if (d == 0) { // Compute x-dim padding for vectorization
+        int x_pad = (1+((sd->decomp_size[0]-1)/32))*32 - sd->decomp_size[0] ;
+        sd->decomp_size[0] += x_pad;
+        dat->d_p[0] += x_pad;
+      }*/
     }
+    dat->size[d] = sd->decomp_size[d] - sd->d_im[d] + sd->d_ip[d];
+    prod[d] = prod[d - 1] * dat->size[d];
+  }
+}
+
+// Computes the offset to the base index and the strided halo access patterns
+// of the local part of a dataset
+static void ops_decomp_dat_layout(sub_block *sb, ops_dat dat) {
+  ops_block block = sb->block;
+  sub_dat *sd = OPS_sub_dat_list[dat->index];
+  size_t *prod = sd->prod;
+
+  // Compute offset in bytes to the base index
+  dat->base_offset = 0;
+  size_t cumsize = 1;
+  for (int i = 0; i < block->dims; i++) {
+    dat->base_offset += (OPS_instance::getOPSInstance()->OPS_soa ? dat->type_size : dat->elem_size)
+                        * cumsize *
+                        (-dat->base[i] - dat->d_m[i] - sd->d_im[i]);
+    cumsize *= dat->size[i];
+  }
+
+  // TODO: halo exchanges should not include the block halo part for
+  // partitions that are on the edge of a block
+
+  /// MPI data types are no longer used as the manual data types were found to
+  /// be more optimal
+  // sd->mpidat = (MPI_Datatype *) ops_malloc(sizeof(MPI_Datatype)*sb->ndim *
+  // MAX_DEPTH);
+  // MPI_Datatype new_type_p; //create generic type for MPI comms
+  // MPI_Type_contiguous(dat->elem_size, MPI_CHAR, &new_type_p);
+  // MPI_Type_commit(&new_type_p);
+
+  sd->halos =
+      (ops_int_halo *)ops_calloc(MAX_DEPTH * sb->ndim , sizeof(ops_int_halo));
+
+  for (int n = 0; n < sb->ndim; n++) {
+    for (int d = 0; d < MAX_DEPTH; d++) {
+      /// MPI data types are no longer used as the manual data types were
+      /// found to be more optimal
+      // MPI_Type_vector(prod[sb->ndim - 1]/prod[n], d*prod[n-1],
+      //                prod[n], new_type_p, &(sd->mpidat[MAX_DEPTH*n+d]));
+      // MPI_Type_commit(&(sd->mpidat[MAX_DEPTH*n+d]));
+
+      // populate the struct duplicating information in MPI_Datatypes for
+      // (strided) halo access
+      sd->halos[MAX_DEPTH * n + d].count = prod[sb->ndim - 1] / prod[n];
+      sd->halos[MAX_DEPTH * n + d].blocklength =
+          d * prod[n - 1] * dat->type_size;
+      sd->halos[MAX_DEPTH * n + d].stride = prod[n] * dat->type_size;
+
+      // printf("Datatype: %d %d %d\n", prod[sb->ndim - 1]/prod[n], prod[n-1],
+      // prod[n]);
+      // printf("dat->name %s, Datatype %d %d
+      // %d\n",dat->name,sd->halos[MAX_DEPTH*n+d].count,
+      // sd->halos[MAX_DEPTH*n+d].blocklength,
+      // sd->halos[MAX_DEPTH*n+d].stride);
+    }
+  }
+}
+
+void ops_decomp_dats(sub_block *sb) {
+  ops_block block = sb->block;
+  ops_dat_entry *item, *tmp_item;
+  for (item = TAILQ_FIRST(&(OPS_instance::getOPSInstance()->OPS_block_list[block->index].datasets));
+       item != NULL; item = tmp_item) {
+    tmp_item = TAILQ_NEXT(item, entries);
+    ops_dat dat = item->dat;
+    sub_dat *sd = OPS_sub_dat_list[dat->index];
+    ops_decomp_dat_sizes(sb, dat);
+    size_t *prod = sd->prod;
 
     if (!sb->owned) {
       sd->mpidat = NULL;
       continue;
     }
 
-    // Allocate datasets
-    if (dat->data == NULL){
+    // Allocate datasets, in memory shared on the node if all processes of
+    // the block there leave it to OPS
+    int shared = 0;
+    if (sb->shm_comm != MPI_COMM_NULL) {
+      int unallocated = dat->data == NULL;
+      MPI_Allreduce(&unallocated, &shared, 1, MPI_INT, MPI_MIN, sb->shm_comm);
+    }
+    if (shared) {
+      dat->data = ops_decomp_dat_alloc_shared(sb, dat, prod[sb->ndim - 1] * dat->elem_size);
+      dat->mem = prod[sb->ndim - 1] * dat->elem_size;
+      dat->user_managed = 1; // freed with the window
+      if (dat->is_hdf5 == 0)
+        dat->hdf5_file = "none";
+      else if (ops_read_dat_hdf5_dynamic == NULL) {
+        OPSException ex(OPS_RUNTIME_ERROR);
+        ex << "Error: using ops_decl_dat_hdf5, but lib_ops_hdf5_mpi.so was not linked";
+        throw ex;
+      } else
+        ops_read_dat_hdf5_dynamic(dat);
+    } else if (dat->data == NULL){
       if (dat->is_hdf5 == 0) {
         dat->data = (char *)ops_calloc(prod[sb->ndim-1]*dat->elem_size,1);
         //dat->data = (char *)ops_malloc(prod[sb->ndim - 1] * dat->elem_size * 1);
@@ -479,56 +917,9 @@ void ops_decomp_dats(sub_block *sb) {
         dat->hdf5_file = "none";
     }
 
-    // Compute offset in bytes to the base index
-    dat->base_offset = 0;
-    size_t cumsize = 1;
-    for (int i = 0; i < block->dims; i++) {
-      dat->base_offset += (OPS_instance::getOPSInstance()->OPS_soa ? dat->type_size : dat->elem_size)
-                          * cumsize *
-                          (-dat->base[i] - dat->d_m[i] - sd->d_im[i]);
-      cumsize *= dat->size[i];
-    }
-
+    ops_decomp_dat_layout(sb, dat);
     ops_cpHostToDevice(dat->block->instance, (void **)&(dat->data_d), (void **)&(dat->data),
                        prod[sb->ndim - 1] * dat->elem_size);
-
-    // TODO: halo exchanges should not include the block halo part for
-    // partitions that are on the edge of a block
-
-    /// MPI data types are no longer used as the manual data types were found to
-    /// be more optimal
-    // sd->mpidat = (MPI_Datatype *) ops_malloc(sizeof(MPI_Datatype)*sb->ndim *
-    // MAX_DEPTH);
-    // MPI_Datatype new_type_p; //create generic type for MPI comms
-    // MPI_Type_contiguous(dat->elem_size, MPI_CHAR, &new_type_p);
-    // MPI_Type_commit(&new_type_p);
-
-    sd->halos =
-        (ops_int_halo *)ops_calloc(MAX_DEPTH * sb->ndim , sizeof(ops_int_halo));
-
-    for (int n = 0; n < sb->ndim; n++) {
-      for (int d = 0; d < MAX_DEPTH; d++) {
-        /// MPI data types are no longer used as the manual data types were
-        /// found to be more optimal
-        // MPI_Type_vector(prod[sb->ndim - 1]/prod[n], d*prod[n-1],
-        //                prod[n], new_type_p, &(sd->mpidat[MAX_DEPTH*n+d]));
-        // MPI_Type_commit(&(sd->mpidat[MAX_DEPTH*n+d]));
-
-        // populate the struct duplicating information in MPI_Datatypes for
-        // (strided) halo access
-        sd->halos[MAX_DEPTH * n + d].count = prod[sb->ndim - 1] / prod[n];
-        sd->halos[MAX_DEPTH * n + d].blocklength =
-            d * prod[n - 1] * dat->type_size;
-        sd->halos[MAX_DEPTH * n + d].stride = prod[n] * dat->type_size;
-
-        // printf("Datatype: %d %d %d\n", prod[sb->ndim - 1]/prod[n], prod[n-1],
-        // prod[n]);
-        // printf("dat->name %s, Datatype %d %d
-        // %d\n",dat->name,sd->halos[MAX_DEPTH*n+d].count,
-        // sd->halos[MAX_DEPTH*n+d].blocklength,
-        // sd->halos[MAX_DEPTH*n+d].stride);
-      }
-    }
   }
 }
 
@@ -543,6 +934,31 @@ void ops_calc_disp_size_for_dat_and_proc(ops_dat dat, int d, int proc, int *proc
   *proc_size = MAX(0,MIN(next_block - *proc_disp, zerobase_gbl_size - *proc_disp));
 }
 
+// Part [*iter_beg, *iter_end) of the iteration range of a halo whose points
+// fall into [beg, end) along a dimension of the dataset, where the halo starts
+// at base and is walked backwards if dir is negative
+static void ops_halo_iter_range(int beg, int end, int base, int size, int dir,
+                                int *iter_beg, int *iter_end) {
+  beg = MAX(beg, base);
+  end = MIN(end, base + size);
+  if (end <= beg) {
+    *iter_beg = *iter_end = 0;
+  } else if (dir > 0) {
+    *iter_beg = beg - base;
+    *iter_end = end - base;
+  } else {
+    *iter_beg = base + size - end;
+    *iter_end = base + size - beg;
+  }
+}
+
+// First point along a dimension of the dataset that the part
+// [iter_beg, iter_end) of the iteration range of a halo touches
+static int ops_halo_dat_begin(int base, int size, int dir, int iter_beg,
+                              int iter_end) {
+  return dir > 0 ? base + iter_beg : base + size - iter_end;
+}
+
 void ops_partition_halos(int *processes, int *proc_offsets, int *proc_disps,
                          int *proc_sizes, int *proc_dimsplit) {
   int rank;
@@ -576,27 +992,15 @@ void ops_partition_halos(int *processes, int *proc_offsets, int *proc_disps,
     // Map out all halo regions where the current process has the "from" part
     if (sb_from->owned) {
       int all_dims = 1;
-      int intersection_range[OPS_MAX_DIM]; // size of my part of the halo
-      int relative_base[OPS_MAX_DIM]; // of my part of the halo into the full
-                                      // halo
-      // first, compute the intersection and location of the halo within my
-      // owned part of the dataset
+      // part of the iteration range of the halo I hold the source of
+      int iter_beg[OPS_MAX_DIM], iter_end[OPS_MAX_DIM];
       for (int d = 0; d < sb_from->ndim; d++) {
-        int intersection_local = intersection(
-            sd_from->decomp_disp[d],
-            sd_from->decomp_disp[d] + sd_from->decomp_size[d],
-            halo->from_base[d],
-            halo->from_base[d] + halo->iter_size[abs(halo->from_dir[d]) - 1]);
-        int d2 = 0;
-        while (d2 != abs(halo->from_dir[d]) - 1)
-          d2++;
-        intersection_range[d2] = intersection_local;
-        // where my part of the halo begins in the full halo, with the
-        // coordinate ordering of iter_range
-        relative_base[d2] = (sd_from->decomp_disp[d] - halo->from_base[d]) > 0
-                                ? (sd_from->decomp_disp[d] - halo->from_base[d])
-                                : 0;
-        all_dims = all_dims && (intersection_local > 0);
+        int e = abs(halo->from_dir[d]) - 1;
+        ops_halo_iter_range(sd_from->decomp_disp[d],
+                            sd_from->decomp_disp[d] + sd_from->decomp_size[d],
+                            halo->from_base[d], halo->iter_size[e],
+                            halo->from_dir[d], &iter_beg[e], &iter_end[e]);
+        all_dims = all_dims && (iter_end[e] > iter_beg[e]);
       }
       // it there is an actual intersection, discover all target partitions that
       // connect to my bit of the halo
@@ -620,58 +1024,50 @@ void ops_partition_halos(int *processes, int *proc_offsets, int *proc_disps,
         for (int j = proc_offsets[halo->to->block->index];
              j < proc_offsets[halo->to->block->index + 1]; ++j) {
           all_dims = 1;
-          int to_base[OPS_MAX_DIM], from_relative_base[OPS_MAX_DIM],
-              owned_range_for_proc[OPS_MAX_DIM];
+          int beg[OPS_MAX_DIM], end[OPS_MAX_DIM], to_disp[OPS_MAX_DIM];
           for (int d = 0; d < sb_to->ndim; ++d) {
             int proc_disp_j;// = proc_disps[j * OPS_MAX_DIM + d];
             int proc_size_j;// = proc_sizes[j * OPS_MAX_DIM + d];
             ops_calc_disp_size_for_dat_and_proc(halo->to, d, j, &proc_disp_j, &proc_size_j, proc_disps, proc_sizes);
-            int left_pad =
-                (proc_disp_j == 0 ? (sd_to->gbl_base[d] + sd_to->gbl_d_m[d]) : 0);
+            // no process holds the block halo of a periodic dimension
+            int periodic = halo->to->block->periodic[d];
+            int left_pad = (proc_disp_j == 0 && !periodic
+                                ? (sd_to->gbl_base[d] + sd_to->gbl_d_m[d])
+                                : 0);
             // determine if target partition is at the end in the current
             // dimension
             int zerobase_gbl_size =
               sd_to->gbl_size[d] + sd_to->gbl_d_m[d] - sd_to->gbl_d_p[d] + sd_to->gbl_base[d];
             int is_last = (proc_disp_j+proc_size_j) == zerobase_gbl_size;
-            int right_pad = is_last ? sd_to->gbl_d_p[d] : 0;
-
-            int intersection_local = intersection(
-                proc_disp_j + left_pad, proc_disp_j + proc_size_j + right_pad,
-                halo->to_base[d] + relative_base[abs(halo->to_dir[d]) - 1],
-                halo->to_base[d] + relative_base[abs(halo->to_dir[d]) - 1] +
-                    intersection_range[abs(halo->to_dir[d]) - 1]);
-            int d2 = 0;
-            while (d2 != abs(halo->to_dir[d]) - 1)
-              d2++;
-            owned_range_for_proc[d2] = intersection_local;
-            to_base[d] =
-                (halo->to_base[d] + relative_base[abs(halo->to_dir[d]) - 1] -
-                 proc_disp_j) >= left_pad
-                    ? (halo->to_base[d] +
-                       relative_base[abs(halo->to_dir[d]) - 1] - proc_disp_j)
-                    : 0;
-            from_relative_base[d2] =
-                (proc_disp_j + left_pad - halo->to_base[d] -
-                 relative_base[abs(halo->to_dir[d]) - 1]) > 0
-                    ? (proc_disp_j + left_pad - halo->to_base[d] -
-                       relative_base[abs(halo->to_dir[d]) - 1])
-                    : 0;
-            all_dims = all_dims && (intersection_local > 0);
+            int right_pad = is_last && !periodic ? sd_to->gbl_d_p[d] : 0;
+
+            int e = abs(halo->to_dir[d]) - 1;
+            ops_halo_iter_range(proc_disp_j + left_pad,
+                                proc_disp_j + proc_size_j + right_pad,
+                                halo->to_base[d], halo->iter_size[e],
+                                halo->to_dir[d], &beg[e], &end[e]);
+            beg[e] = MAX(beg[e], iter_beg[e]);
+            end[e] = MIN(end[e], iter_end[e]);
+            to_disp[d] = proc_disp_j + left_pad;
+            all_dims = all_dims && (end[e] > beg[e]);
           }
           if (all_dims) {
             // set up entry
             int entry = OPS_mpi_halo_list[i].nproc_from;
             OPS_mpi_halo_list[i].proclist[entry] = processes[j];
             for (int d = 0; d < sb_from->ndim; d++) {
+              int e = abs(halo->from_dir[d]) - 1;
               OPS_mpi_halo_list[i].local_iter_size[OPS_MAX_DIM * entry + d] =
-                  owned_range_for_proc[d];
+                  end[d] - beg[d];
               OPS_mpi_halo_list[i].local_from_base[OPS_MAX_DIM * entry + d] =
-                  ((halo->from_base[d] - sd_from->decomp_disp[d]) > 0
-                       ? (halo->from_base[d] - sd_from->decomp_disp[d])
-                       : 0) +
-                  from_relative_base[abs(halo->from_dir[d]) - 1];
+                  ops_halo_dat_begin(halo->from_base[d], halo->iter_size[e],
+                                     halo->from_dir[d], beg[e], end[e]) -
+                  sd_from->decomp_disp[d];
+              e = abs(halo->to_dir[d]) - 1;
               OPS_mpi_halo_list[i].local_to_base[OPS_MAX_DIM * entry + d] =
-                  to_base[d]; // This isn't really relevant, but good for debug
+                  ops_halo_dat_begin(halo->to_base[d], halo->iter_size[e],
+                                     halo->to_dir[d], beg[e], end[e]) -
+                  to_disp[d]; // This isn't really relevant, but good for debug
                               // (if both blocks on same proc)
             }
             OPS_mpi_halo_list[i].nproc_from++;
@@ -694,26 +1090,15 @@ void ops_partition_halos(int *processes, int *proc_offsets, int *proc_disps,
     // Map out all halo regions where the current process has the "to" part
     if (sb_to->owned) {
       int all_dims = 1;
-      int intersection_range[OPS_MAX_DIM]; // size of my part of the halo
-      int relative_base[OPS_MAX_DIM]; // of my part of the halo into the full
-                                      // halo
-      // first, compute the intersection and location of the halo within my
-      // owned part of the dataset
-      for (int d = 0; d < sb_from->ndim; d++) {
-        int intersection_local = intersection(
-            sd_to->decomp_disp[d],
-            sd_to->decomp_disp[d] + sd_to->decomp_size[d], halo->to_base[d],
-            halo->to_base[d] + halo->iter_size[abs(halo->to_dir[d]) - 1]);
-        int d2 = 0;
-        while (d2 != abs(halo->to_dir[d]) - 1)
-          d2++;
-        intersection_range[d2] = intersection_local;
-        // where my part of the halo begins in the full halo, with the
-        // coordinate ordering of iter_range
-        relative_base[d2] = (sd_to->decomp_disp[d] - halo->to_base[d]) > 0
-                                ? (sd_to->decomp_disp[d] - halo->to_base[d])
-                                : 0;
-        all_dims = all_dims && (intersection_local > 0);
+      // part of the iteration range of the halo I hold the target of
+      int iter_beg[OPS_MAX_DIM], iter_end[OPS_MAX_DIM];
+      for (int d = 0; d < sb_to->ndim; d++) {
+        int e = abs(halo->to_dir[d]) - 1;
+        ops_halo_iter_range(sd_to->decomp_disp[d],
+                            sd_to->decomp_disp[d] + sd_to->decomp_size[d],
+                            halo->to_base[d], halo->iter_size[e],
+                            halo->to_dir[d], &iter_beg[e], &iter_end[e]);
+        all_dims = all_dims && (iter_end[e] > iter_beg[e]);
       }
       // it there is an actual intersection, discover all target partitions that
       // connect to my bit of the halo
@@ -748,41 +1133,28 @@ void ops_partition_halos(int *processes, int *proc_offsets, int *proc_disps,
         for (int j = proc_offsets[halo->from->block->index];
              j < proc_offsets[halo->from->block->index + 1]; ++j) {
           all_dims = 1;
-          int from_base[OPS_MAX_DIM], to_relative_base[OPS_MAX_DIM],
-              owned_range_for_proc[OPS_MAX_DIM];
+          int beg[OPS_MAX_DIM], end[OPS_MAX_DIM], from_disp[OPS_MAX_DIM];
           for (int d = 0; d < sb_from->ndim; ++d) {
             int proc_disp_j;// = proc_disps[j * OPS_MAX_DIM + d];
             int proc_size_j;// = proc_sizes[j * OPS_MAX_DIM + d];
             ops_calc_disp_size_for_dat_and_proc(halo->from, d, j, &proc_disp_j, &proc_size_j, proc_disps, proc_sizes);
-            int left_pad =
-                (proc_disp_j == 0 ? sd_from->gbl_base[d] + sd_from->gbl_d_m[d] : 0);
+            int periodic = halo->from->block->periodic[d];
+            int left_pad = (proc_disp_j == 0 && !periodic
+                                ? sd_from->gbl_base[d] + sd_from->gbl_d_m[d]
+                                : 0);
             int zerobase_gbl_size =
               sd_from->gbl_size[d] + sd_from->gbl_d_m[d] - sd_from->gbl_d_p[d] + sd_from->gbl_base[d];
             int is_last = (proc_disp_j+proc_size_j) == zerobase_gbl_size;
-            int right_pad = is_last ? sd_from->gbl_d_p[d] : 0;
-            int intersection_local = intersection(
-                proc_disp_j + left_pad, proc_disp_j + proc_size_j + right_pad,
-                halo->from_base[d] + relative_base[abs(halo->from_dir[d]) - 1],
-                halo->from_base[d] + relative_base[abs(halo->from_dir[d]) - 1] +
-                    intersection_range[abs(halo->from_dir[d]) - 1]);
-            int d2 = 0;
-            while (d2 != abs(halo->from_dir[d]) - 1)
-              d2++;
-            owned_range_for_proc[d2] = intersection_local;
-            from_base[d] =
-                (halo->from_base[d] +
-                 relative_base[abs(halo->from_dir[d]) - 1] - proc_disp_j) >=
-                        left_pad
-                    ? (halo->from_base[d] +
-                       relative_base[abs(halo->from_dir[d]) - 1] - proc_disp_j)
-                    : 0;
-            to_relative_base[d2] =
-                (proc_disp_j + left_pad - halo->from_base[d] -
-                 relative_base[abs(halo->from_dir[d]) - 1]) > 0
-                    ? (proc_disp_j + left_pad - halo->from_base[d] -
-                       relative_base[abs(halo->from_dir[d]) - 1])
-                    : 0;
-            all_dims = all_dims && (intersection_local > 0);
+            int right_pad = is_last && !periodic ? sd_from->gbl_d_p[d] : 0;
+            int e = abs(halo->from_dir[d]) - 1;
+            ops_halo_iter_range(proc_disp_j + left_pad,
+                                proc_disp_j + proc_size_j + right_pad,
+                                halo->from_base[d], halo->iter_size[e],
+                                halo->from_dir[d], &beg[e], &end[e]);
+            beg[e] = MAX(beg[e], iter_beg[e]);
+            end[e] = MIN(end[e], iter_end[e]);
+            from_disp[d] = proc_disp_j + left_pad;
+            all_dims = all_dims && (end[e] > beg[e]);
           }
           if (all_dims) {
             // set up entry
@@ -790,15 +1162,18 @@ void ops_partition_halos(int *processes, int *proc_offsets, int *proc_disps,
                 OPS_mpi_halo_list[i].nproc_from + OPS_mpi_halo_list[i].nproc_to;
             OPS_mpi_halo_list[i].proclist[entry] = processes[j];
             for (int d = 0; d < sb_to->ndim; d++) {
+              int e = abs(halo->to_dir[d]) - 1;
               OPS_mpi_halo_list[i].local_iter_size[OPS_MAX_DIM * entry + d] =
-                  owned_range_for_proc[d];
+                  end[d] - beg[d];
               OPS_mpi_halo_list[i].local_to_base[OPS_MAX_DIM * entry + d] =
-                  ((halo->to_base[d] - sd_to->decomp_disp[d]) > 0
-                       ? (halo->to_base[d] - sd_to->decomp_disp[d])
-                       : 0) +
-                  to_relative_base[abs(halo->to_dir[d]) - 1];
+                  ops_halo_dat_begin(halo->to_base[d], halo->iter_size[e],
+                                     halo->to_dir[d], beg[e], end[e]) -
+                  sd_to->decomp_disp[d];
+              e = abs(halo->from_dir[d]) - 1;
               OPS_mpi_halo_list[i].local_from_base[OPS_MAX_DIM * entry + d] =
-                  from_base[d]; // This isn't really relevant, but good for
+                  ops_halo_dat_begin(halo->from_base[d], halo->iter_size[e],
+                                     halo->from_dir[d], beg[e], end[e]) -
+                  from_disp[d]; // This isn't really relevant, but good for
                                 // debug (if both blocks on same proc)
             }
             OPS_mpi_halo_list[i].nproc_to++;
@@ -925,6 +1300,35 @@ void ops_partition_halos(int *processes, int *proc_offsets, int *proc_disps,
   ops_free(neighbor_array_send);
 }
 
+// Frees the inter-block halo lists created by ops_partition_halos
+static void ops_partition_halos_free() {
+  for (int i = 0; i < OPS_instance::getOPSInstance()->OPS_halo_index; i++) {
+    if (OPS_mpi_halo_list[i].nproc_from > 0 ||
+        OPS_mpi_halo_list[i].nproc_to > 0) {
+      ops_free(OPS_mpi_halo_list[i].proclist);
+      ops_free(OPS_mpi_halo_list[i].local_from_base);
+      ops_free(OPS_mpi_halo_list[i].local_to_base);
+      ops_free(OPS_mpi_halo_list[i].local_iter_size);
+    }
+  }
+  ops_free(OPS_mpi_halo_list);
+  for (int i = 0; i < OPS_instance::getOPSInstance()->OPS_halo_group_index; i++) {
+    if (OPS_mpi_halo_group_list[i].nhalos > 0) {
+      //ops_free(OPS_mpi_halo_group_list[i].num_neighbors_send);
+      //ops_free(OPS_mpi_halo_group_list[i].num_neighbors_recv);
+      ops_free(OPS_mpi_halo_group_list[i].mpi_halos);
+      ops_free(OPS_mpi_halo_group_list[i].neighbors_send);
+      ops_free(OPS_mpi_halo_group_list[i].neighbors_recv);
+      ops_free(OPS_mpi_halo_group_list[i].send_sizes);
+      ops_free(OPS_mpi_halo_group_list[i].recv_sizes);
+      ops_free(OPS_mpi_halo_group_list[i].statuses);
+      ops_free(OPS_mpi_halo_group_list[i].requests);
+    }
+  }
+  ops_free(OPS_mpi_halo_group_list);
+  ops_free(mpi_neigh_size);
+}
+
 void _ops_partition(OPS_instance *instance, const char *routine, std::map<std::string, void*>& opts) {
   if (partitioned) throw OPSException(OPS_RUNTIME_CONFIGURATION_ERROR, "Error: ops_partition called more than once");
   // create list to hold sub-grid decomposition geometries for each mpi process
@@ -996,11 +1400,11 @@ void _ops_partition(OPS_instance *instance, const char *routine, std::map<std::s
   ops_partition_halos(processes, proc_offsets, proc_disps, proc_sizes,
                       proc_dimsplit);
 
-  ops_free(processes);
-  ops_free(proc_offsets);
-  ops_free(proc_disps);
-  ops_free(proc_sizes);
-  ops_free(proc_dimsplit);
+  part_processes = processes;
+  part_offsets = proc_offsets;
+  part_disps = proc_disps;
+  part_sizes = proc_sizes;
+  part_dimsplit = proc_dimsplit;
 
   partitioned = 1;
 }
@@ -1016,6 +1420,8 @@ void _ops_partition(OPS_instance *instance, const char *routine) {
 // and perhaps will need to be allocated on-the-fly.
 
 void ops_mpi_exit(OPS_instance *instance) {
+  ops_comm_thread_stop();
+  if (ops_io_stop_dynamic != NULL) ops_io_stop_dynamic();
 
   /*for (int b = 0; b < OPS_block_index; b++) { // for each block
     ops_block block = OPS_block_list[b].block;
@@ -1036,6 +1442,11 @@ void ops_mpi_exit(OPS_instance *instance) {
     }
   }*/
 
+  // memory shared on the node, including that of freed datasets
+  for (int i = 0; i < OPS_instance::getOPSInstance()->OPS_dat_index; i++)
+    if (OPS_sub_dat_list[i]->shm_win != MPI_WIN_NULL)
+      MPI_Win_free(&OPS_sub_dat_list[i]->shm_win);
+
   ops_dat_entry *item;
   TAILQ_FOREACH(item, &OPS_instance::getOPSInstance()->OPS_dat_list, entries) {
     int i = (item->dat)->index;
@@ -1049,31 +1460,15 @@ void ops_mpi_exit(OPS_instance *instance) {
   ops_free(OPS_sub_dat_list);
   //OPS_sub_dat_list = NULL;
 
-  for (int i = 0; i < OPS_instance::getOPSInstance()->OPS_halo_index; i++) {
-    if (OPS_mpi_halo_list[i].nproc_from > 0 ||
-        OPS_mpi_halo_list[i].nproc_to > 0) {
-      ops_free(OPS_mpi_halo_list[i].proclist);
-      ops_free(OPS_mpi_halo_list[i].local_from_base);
-      ops_free(OPS_mpi_halo_list[i].local_to_base);
-      ops_free(OPS_mpi_halo_list[i].local_iter_size);
-    }
-  }
-  ops_free(OPS_mpi_halo_list);
-  for (int i = 0; i < OPS_instance::getOPSInstance()->OPS_halo_group_index; i++) {
-    if (OPS_mpi_halo_group_list[i].nhalos > 0) {
-      //ops_free(OPS_mpi_halo_group_list[i].num_neighbors_send);
-      //ops_free(OPS_mpi_halo_group_list[i].num_neighbors_recv);
-      ops_free(OPS_mpi_halo_group_list[i].mpi_halos);
-      ops_free(OPS_mpi_halo_group_list[i].neighbors_send);
-      ops_free(OPS_mpi_halo_group_list[i].neighbors_recv);
-      ops_free(OPS_mpi_halo_group_list[i].send_sizes);
-      ops_free(OPS_mpi_halo_group_list[i].recv_sizes);
-      ops_free(OPS_mpi_halo_group_list[i].statuses);
-      ops_free(OPS_mpi_halo_group_list[i].requests);
-    }
-  }
-  ops_free(OPS_mpi_halo_group_list);
-  ops_free(mpi_neigh_size);
+  ops_partition_halos_free();
+  ops_free(part_processes);
+  ops_free(part_offsets);
+  ops_free(part_disps);
+  ops_free(part_sizes);
+  ops_free(part_dimsplit);
+  ops_halo_plans_free();
+  ops_halo_group_plans_free();
+  ops_reductions_free();
   if (OPS_instance::getOPSInstance()->OPS_enable_checkpointing)
     ops_free(OPS_checkpointing_dup_buffer);
 
@@ -1081,18 +1476,408 @@ void ops_mpi_exit(OPS_instance *instance) {
   for (int b = 0; b < OPS_instance::getOPSInstance()->OPS_block_index; b++) { // for each block
     sub_block *sb = OPS_sub_block_list[b];
 
+    if (sb->shm_comm != MPI_COMM_NULL) {
+      MPI_Win_unlock_all(sb->shm_flags_win);
+      MPI_Win_free(&(sb->shm_flags_win));
+      MPI_Comm_free(&(sb->shm_comm));
+    }
     if (sb->owned) {
       MPI_Comm_free(&(sb->comm));
       MPI_Comm_free(&(sb->comm1));
     }
 
     MPI_Group_free(&(sb->grp));
+    ops_free(sb->id_neigh);
     ops_free(OPS_sub_block_list[b]);
   }
   ops_free(OPS_sub_block_list);
   MPI_Comm_free(&OPS_MPI_GLOBAL);
 }
 
+// Coordinates of the j-th process of block b in its processor grid, the same
+// row-major ordering as in ops_partition_blocks and MPI_Cart_create
+static void ops_repartition_coords(int b, int j, int ndim, int *coords) {
+  int *dimsplit = &part_dimsplit[b * OPS_MAX_DIM];
+  for (int d = 0; d < ndim; d++) {
+    int cumdim = 1;
+    for (int d2 = d + 1; d2 < ndim; d2++)
+      cumdim *= dimsplit[d2];
+    coords[d] = ((j - part_offsets[b]) / cumdim) % dimsplit[d];
+  }
+}
+
+// Range of a dataset owned by process j (including the block halo on the
+// edges that are not periodic), in the coordinates of sub_dat::decomp_disp
+static void ops_repartition_owned(ops_dat dat, int j, int *coords,
+                                  int *proc_disps, int *proc_sizes, int *start,
+                                  int *end) {
+  sub_dat *sd = OPS_sub_dat_list[dat->index];
+  int *dimsplit = &part_dimsplit[dat->block->index * OPS_MAX_DIM];
+  for (int d = 0; d < dat->block->dims; d++) {
+    if (dat->e_dat && sd->gbl_size[d] == 1) {
+      start[d] = 0;
+      end[d] = 1;
+      continue;
+    }
+    int disp, size;
+    ops_calc_disp_size_for_dat_and_proc(dat, d, j, &disp, &size, proc_disps,
+                                        proc_sizes);
+    int periodic = dat->block->periodic[d];
+    start[d] = disp + (coords[d] == 0 && !periodic
+                           ? sd->gbl_base[d] + sd->gbl_d_m[d]
+                           : 0);
+    end[d] = disp + size +
+             (coords[d] == dimsplit[d] - 1 && !periodic ? sd->gbl_d_p[d] : 0);
+  }
+}
+
+// Copies a box of a local dataset (whose first element is at origin and
+// aggregate sizes are prod) to or from a contiguous buffer, returns the number
+// of bytes
+static size_t ops_repartition_box(ops_dat dat, char *data, const int *origin,
+                                  const size_t *prod, const int *start,
+                                  const int *end, char *buf, int pack) {
+  int ndim = dat->block->dims;
+  size_t points = 1;
+  for (int d = 0; d < ndim; d++)
+    points *= MAX(end[d] - start[d], 0);
+  if (points == 0 || buf == NULL) return points * dat->elem_size;
+  int soa = dat->block->instance->OPS_soa && dat->dim > 1;
+  size_t run = end[0] - start[0];
+  for (size_t r = 0; r < points / run; r++) {
+    size_t off = start[0] - origin[0];
+    size_t rem = r;
+    for (int d = 1; d < ndim; d++) {
+      off += (start[d] - origin[d] + rem % (end[d] - start[d])) * prod[d - 1];
+      rem /= (end[d] - start[d]);
+    }
+    if (!soa) {
+      char *ptr = data + off * dat->elem_size;
+      if (pack) memcpy(buf, ptr, run * dat->elem_size);
+      else      memcpy(ptr, buf, run * dat->elem_size);
+      buf += run * dat->elem_size;
+    } else {
+      for (int c = 0; c < dat->dim; c++) {
+        char *ptr = data + (c * prod[ndim - 1] + off) * dat->type_size;
+        if (pack) memcpy(buf, ptr, run * dat->type_size);
+        else      memcpy(ptr, buf, run * dat->type_size);
+        buf += run * dat->type_size;
+      }
+    }
+  }
+  return points * dat->elem_size;
+}
+
+// Moves the contents of a dataset from the decomposition given by old_disps
+// and old_sizes to the one currently in part_disps and part_sizes, and
+// recomputes its local sizes and layout
+static void ops_repartition_dat(ops_dat dat, int *old_disps, int *old_sizes) {
+  OPS_instance *instance = dat->block->instance;
+  int b = dat->block->index;
+  int ndim = dat->block->dims;
+  sub_block *sb = OPS_sub_block_list[b];
+  sub_dat *sd = OPS_sub_dat_list[dat->index];
+
+  if (instance->OPS_hybrid_gpu) ops_get_data(dat);
+
+  // Store the old local layout, and restore the global extents of the dat
+  char *old_data = dat->data;
+  int old_origin[OPS_MAX_DIM];
+  size_t old_prod[OPS_MAX_DIM];
+  for (int d = 0; d < ndim; d++) {
+    old_origin[d] = sd->decomp_disp[d] + sd->d_im[d];
+    old_prod[d] = sd->prod[d];
+    dat->base[d] = sd->gbl_base[d];
+    dat->size[d] = sd->gbl_size[d];
+    dat->d_m[d] = sd->gbl_d_m[d];
+    dat->d_p[d] = sd->gbl_d_p[d];
+  }
+  ops_free(sd->halos);
+  ops_free(&sd->prod[-1]);
+
+  ops_decomp_dat_sizes(sb, dat);
+  int new_origin[OPS_MAX_DIM];
+  for (int d = 0; d < ndim; d++)
+    new_origin[d] = sd->decomp_disp[d] + sd->d_im[d];
+  dat->mem = sd->prod[ndim - 1] * dat->elem_size;
+  MPI_Win old_win = sd->shm_win;
+  if (old_win != MPI_WIN_NULL)
+    dat->data = ops_decomp_dat_alloc_shared(sb, dat, dat->mem);
+  else
+    dat->data = (char *)ops_calloc(dat->mem, 1);
+
+  // Every piece of the old decomposition that intersects a piece of the new
+  // one is sent from its old owner to the new one
+  int me = -1;
+  for (int j = part_offsets[b]; j < part_offsets[b + 1]; j++)
+    if (part_processes[j] == ops_my_global_rank) me = j;
+  int my_coords[OPS_MAX_DIM], my_old_start[OPS_MAX_DIM], my_old_end[OPS_MAX_DIM],
+      my_new_start[OPS_MAX_DIM], my_new_end[OPS_MAX_DIM];
+  ops_repartition_coords(b, me, ndim, my_coords);
+  ops_repartition_owned(dat, me, my_coords, old_disps, old_sizes, my_old_start,
+                        my_old_end);
+  ops_repartition_owned(dat, me, my_coords, part_disps, part_sizes,
+                        my_new_start, my_new_end);
+
+  std::vector<std::vector<char> > buffers;
+  std::vector<std::vector<int> > recv_boxes;
+  std::vector<MPI_Request> requests;
+  for (int pass = 0; pass < 2; pass++) { // receives first, then sends
+    for (int j = part_offsets[b]; j < part_offsets[b + 1]; j++) {
+      int coords[OPS_MAX_DIM], other_start[OPS_MAX_DIM], other_end[OPS_MAX_DIM];
+      ops_repartition_coords(b, j, ndim, coords);
+      ops_repartition_owned(dat, j, coords, pass == 0 ? old_disps : part_disps,
+                            pass == 0 ? old_sizes : part_sizes, other_start,
+                            other_end);
+      std::vector<int> box(2 * OPS_MAX_DIM, 0);
+      for (int d = 0; d < ndim; d++) {
+        int *start = pass == 0 ? my_new_start : my_old_start;
+        int *end = pass == 0 ? my_new_end : my_old_end;
+        box[d] = MAX(start[d], other_start[d]);
+        box[OPS_MAX_DIM + d] = MIN(end[d], other_end[d]);
+        // replicated edge datasets come from the process in the same slab
+        if (dat->e_dat && sd->gbl_size[d] == 1 && coords[d] != my_coords[d])
+          box[OPS_MAX_DIM + d] = box[d];
+      }
+      size_t bytes = ops_repartition_box(dat, NULL, NULL, NULL, &box[0],
+                                         &box[OPS_MAX_DIM], NULL, 0);
+      if (bytes == 0) continue;
+      if (j == me) {
+        if (pass == 1) continue;
+        std::vector<char> tmp(bytes);
+        ops_repartition_box(dat, old_data, old_origin, old_prod, &box[0],
+                            &box[OPS_MAX_DIM], &tmp[0], 1);
+        ops_repartition_box(dat, dat->data, new_origin, sd->prod, &box[0],
+                            &box[OPS_MAX_DIM], &tmp[0], 0);
+        continue;
+      }
+      buffers.push_back(std::vector<char>(bytes));
+      requests.push_back(MPI_REQUEST_NULL);
+      if (pass == 0) {
+        recv_boxes.push_back(box);
+        MPI_Irecv(&buffers.back()[0], (int)bytes, MPI_CHAR, part_processes[j],
+                  dat->index, OPS_MPI_GLOBAL, &requests.back());
+      } else {
+        ops_repartition_box(dat, old_data, old_origin, old_prod, &box[0],
+                            &box[OPS_MAX_DIM], &buffers.back()[0], 1);
+        MPI_Isend(&buffers.back()[0], (int)bytes, MPI_CHAR, part_processes[j],
+                  dat->index, OPS_MPI_GLOBAL, &requests.back());
+      }
+    }
+  }
+  if (requests.size() > 0)
+    MPI_Waitall((int)requests.size(), &requests[0], MPI_STATUSES_IGNORE);
+  for (unsigned int r = 0; r < recv_boxes.size(); r++)
+    ops_repartition_box(dat, dat->data, new_origin, sd->prod, &recv_boxes[r][0],
+                        &recv_boxes[r][OPS_MAX_DIM], &buffers[r][0], 0);
+  if (old_win != MPI_WIN_NULL)
+    MPI_Win_free(&old_win);
+  else
+    ops_free(old_data);
+
+  ops_decomp_dat_layout(sb, dat);
+  if (instance->OPS_hybrid_gpu) {
+    ops_device_free(instance, (void **)&(dat->data_d));
+    ops_cpHostToDevice(instance, (void **)&(dat->data_d), (void **)&(dat->data),
+                       dat->mem);
+    dat->dirty_hd = 0;
+  }
+  sd->dirtybit = 1;
+  for (int i = 0; i < 2 * ndim * MAX_DEPTH; i++) {
+    sd->dirty_dir_send[i] = 1;
+    sd->dirty_dir_recv[i] = 1;
+  }
+}
+
+// Rebuilds the plans made for the previous local layout of the datasets
+static void ops_repartition_plans(OPS_instance *instance) {
+  ops_partition_halos_free();
+  OPS_mpi_halo_list =
+      (ops_mpi_halo *)ops_calloc(instance->OPS_halo_index , sizeof(ops_mpi_halo));
+  OPS_mpi_halo_group_list = (ops_mpi_halo_group *)ops_calloc(
+      instance->OPS_halo_group_index , sizeof(ops_mpi_halo_group));
+  ops_partition_halos(part_processes, part_offsets, part_disps, part_sizes,
+                      part_dimsplit);
+  ops_halo_plans_free();
+  ops_halo_group_plans_free();
+  ops_tiling_plans_free(instance);
+}
+
+// New split of the size points of a block along one dimension into nparts
+// slabs, with widths proportional to speed but no narrower than min_width
+static void ops_repartition_split(int size, int nparts, const double *speed,
+                                  int min_width, int *disps) {
+  double total = 0.0;
+  for (int c = 0; c < nparts; c++)
+    total += speed[c];
+  double cum = 0.0;
+  disps[0] = 0;
+  for (int c = 1; c < nparts; c++) {
+    cum += speed[c - 1];
+    disps[c] = MAX((int)(size * cum / total + 0.5), disps[c - 1] + min_width);
+  }
+  disps[nparts] = size;
+  for (int c = nparts - 1; c > 0; c--)
+    disps[c] = MIN(disps[c], disps[c + 1] - min_width);
+}
+
+void _ops_repartition(OPS_instance *instance) {
+  if (!partitioned)
+    throw OPSException(OPS_RUNTIME_CONFIGURATION_ERROR, "Error: ops_repartition called before ops_partition");
+  ops_execute(instance);
+
+  // Time spent computing on each process since the last repartitioning
+  double time = 0.0;
+  for (int k = -1; instance->OPS_kern_max > 0 && k < instance->OPS_kern_max; k++)
+    time += instance->OPS_kernels[k].time;
+  double my_time = time - repartition_time;
+  repartition_time = time;
+  std::vector<double> times(ops_comm_global_size);
+  MPI_Allgather(&my_time, 1, MPI_DOUBLE, &times[0], 1, MPI_DOUBLE,
+                OPS_MPI_GLOBAL);
+  if (*std::max_element(times.begin(), times.end()) <= 0.0) {
+    ops_printf("Warning: ops_repartition needs kernel timings, run with -OPS_DIAGS=2 or higher\n");
+    return;
+  }
+
+  int nproc_total = part_offsets[instance->OPS_block_index];
+  int *old_disps = (int *)ops_malloc(OPS_MAX_DIM * nproc_total * sizeof(int));
+  int *old_sizes = (int *)ops_malloc(OPS_MAX_DIM * nproc_total * sizeof(int));
+  memcpy(old_disps, part_disps, OPS_MAX_DIM * nproc_total * sizeof(int));
+  memcpy(old_sizes, part_sizes, OPS_MAX_DIM * nproc_total * sizeof(int));
+
+  int changed = 0;
+  for (int b = 0; b < instance->OPS_block_index; b++) {
+    ops_block block = instance->OPS_block_list[b].block;
+    int *dimsplit = &part_dimsplit[b * OPS_MAX_DIM];
+    int block_changed = 0;
+    for (int d = 0; d < block->dims; d++) {
+      int nparts = dimsplit[d];
+      if (nparts < 2) continue;
+      // a process has to own at least as many points as the halo of its
+      // neighbours
+      int min_width = MAX(1, instance->ops_enable_tiling || instance->ops_halo_deep > 0 ? instance->ops_tiling_mpidepth : 0);
+      ops_dat_entry *item;
+      TAILQ_FOREACH(item, &(instance->OPS_block_list[b].datasets), entries) {
+        sub_dat *sd = OPS_sub_dat_list[item->dat->index];
+        min_width = MAX(min_width, MAX(-sd->gbl_d_m[d], sd->gbl_d_p[d]));
+      }
+
+      // average time of the processes in each slab along this dimension
+      std::vector<double> slab_time(nparts, 0.0), speed(nparts);
+      std::vector<int> slab_count(nparts, 0), width(nparts, 0);
+      int size = 0;
+      for (int j = part_offsets[b]; j < part_offsets[b + 1]; j++) {
+        int coords[OPS_MAX_DIM];
+        ops_repartition_coords(b, j, block->dims, coords);
+        slab_time[coords[d]] += times[part_processes[j]];
+        slab_count[coords[d]]++;
+        width[coords[d]] = part_sizes[j * OPS_MAX_DIM + d];
+        size = MAX(size, part_disps[j * OPS_MAX_DIM + d] + part_sizes[j * OPS_MAX_DIM + d]);
+      }
+      double min_time = 0.0, max_time = 0.0;
+      for (int c = 0; c < nparts; c++) {
+        slab_time[c] /= MAX(slab_count[c], 1);
+        min_time = c == 0 ? slab_time[c] : MIN(min_time, slab_time[c]);
+        max_time = c == 0 ? slab_time[c] : MAX(max_time, slab_time[c]);
+        speed[c] = width[c] / slab_time[c];
+      }
+      if (min_time <= 0.0 || max_time < (1.0 + OPS_REPARTITION_TOLERANCE) * min_time ||
+          size < nparts * min_width)
+        continue;
+
+      std::vector<int> disps(nparts + 1);
+      ops_repartition_split(size, nparts, &speed[0], min_width, &disps[0]);
+      for (int j = part_offsets[b]; j < part_offsets[b + 1]; j++) {
+        int coords[OPS_MAX_DIM];
+        ops_repartition_coords(b, j, block->dims, coords);
+        part_disps[j * OPS_MAX_DIM + d] = disps[coords[d]];
+        part_sizes[j * OPS_MAX_DIM + d] = disps[coords[d] + 1] - disps[coords[d]];
+      }
+      for (int c = 0; c < nparts; c++)
+        block_changed = block_changed || (disps[c + 1] - disps[c] != width[c]);
+    }
+    if (!block_changed) continue;
+    changed = 1;
+
+    ops_printf("block \"%s\" repartitioned to slab widths ", block->name);
+    for (int d = 0; d < block->dims; d++) {
+      for (int c = 0; c < dimsplit[d]; c++) {
+        int cumdim = 1;
+        for (int d2 = d + 1; d2 < block->dims; d2++)
+          cumdim *= dimsplit[d2];
+        ops_printf("%d ", part_sizes[(part_offsets[b] + c * cumdim) * OPS_MAX_DIM + d]);
+      }
+      ops_printf(d == block->dims - 1 ? "\n" : "x ");
+    }
+
+    sub_block *sb = OPS_sub_block_list[b];
+    if (!sb->owned) continue;
+    ops_dat_entry *item;
+    TAILQ_FOREACH(item, &(instance->OPS_block_list[b].datasets), entries) {
+      if ((item->dat->user_managed &&
+           OPS_sub_dat_list[item->dat->index]->shm_win == MPI_WIN_NULL) ||
+          item->dat->locked_hd > 0) {
+        OPSException ex(OPS_RUNTIME_ERROR);
+        ex << "Error: ops_repartition cannot move dataset " << item->dat->name << " as its memory is held by the user";
+        throw ex;
+      }
+    }
+    for (int j = part_offsets[b]; j < part_offsets[b + 1]; j++) {
+      if (part_processes[j] != ops_my_global_rank) continue;
+      for (int d = 0; d < block->dims; d++) {
+        sb->decomp_disp[d] = part_disps[j * OPS_MAX_DIM + d];
+        sb->decomp_size[d] = part_sizes[j * OPS_MAX_DIM + d];
+      }
+    }
+    TAILQ_FOREACH(item, &(instance->OPS_block_list[b].datasets), entries)
+      ops_repartition_dat(item->dat, old_disps, old_sizes);
+  }
+  ops_free(old_disps);
+  ops_free(old_sizes);
+  if (!changed) return;
+  ops_repartition_plans(instance);
+}
+
+int ops_halo_deepen(OPS_instance *instance, int depth) {
+  if (!partitioned || depth <= instance->ops_tiling_mpidepth)
+    return instance->ops_tiling_mpidepth;
+
+  // A halo is filled from what the neighbour owns, and the datasets have to be
+  // moved to the new layout
+  int local[2] = {MAX_DEPTH - 1, 1};
+  for (int b = 0; b < instance->OPS_block_index; b++) {
+    sub_block *sb = OPS_sub_block_list[b];
+    if (!sb->owned) continue;
+    for (int d = 0; d < sb->ndim; d++)
+      if (sb->id_m[d] != MPI_PROC_NULL || sb->id_p[d] != MPI_PROC_NULL)
+        local[0] = MIN(local[0], sb->decomp_size[d]);
+    ops_dat_entry *item;
+    TAILQ_FOREACH(item, &(instance->OPS_block_list[b].datasets), entries)
+      if ((item->dat->user_managed &&
+           OPS_sub_dat_list[item->dat->index]->shm_win == MPI_WIN_NULL) ||
+          item->dat->locked_hd > 0)
+        local[1] = 0;
+  }
+  int global[2];
+  MPI_Allreduce(local, global, 2, MPI_INT, MPI_MIN, OPS_MPI_GLOBAL);
+  depth = MIN(depth, global[0]);
+  if (!global[1] || depth <= instance->ops_tiling_mpidepth)
+    return instance->ops_tiling_mpidepth;
+
+  instance->ops_tiling_mpidepth = depth;
+  for (int b = 0; b < instance->OPS_block_index; b++) {
+    if (!OPS_sub_block_list[b]->owned) continue;
+    ops_dat_entry *item;
+    TAILQ_FOREACH(item, &(instance->OPS_block_list[b].datasets), entries)
+      ops_repartition_dat(item->dat, part_disps, part_sizes);
+  }
+  ops_repartition_plans(instance);
+  if (instance->OPS_diags > 1)
+    ops_printf("MPI halos deepened to %d\n", depth);
+  return depth;
+}
+
 void ops_partition(const char *routine) {
   _ops_partition(OPS_instance::getOPSInstance(), routine);
 }
@@ -1101,6 +1886,10 @@ void ops_partition_opts(const char *routine, std::map<std::string, void*>& opts)
   _ops_partition(OPS_instance::getOPSInstance(), routine, opts);
 }
 
+void ops_repartition() {
+  _ops_repartition(OPS_instance::getOPSInstance());
+}
+
 static inline int intersection2(int range1_beg, int range1_end, int range2_beg,
                  int range2_end, int *intersect_begin)
 {
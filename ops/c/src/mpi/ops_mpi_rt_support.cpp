@@ -35,6 +35,7 @@
   * @author Gihan Mudalige, Istvan Reguly
   * @details Implements the runtime support routines for the OPS mpi backend
   */
+#include <algorithm>
 #include <vector>
 #include <ops_lib_core.h>
 #include "ops_util.h"
@@ -42,6 +43,15 @@
 #include <ops_mpi_core.h>
 #include <ops_exceptions.h>
 #include <cassert>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <exception>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #define AGGREGATE
 int ops_buffer_size = 0;
@@ -70,6 +80,33 @@ int contains(int point, int *range) {
   return (point >= range[0] && point < range[1]);
 }
 
+// Period of dat in dimension dim if its block is periodic there, 0 otherwise
+static int ops_dat_period(ops_dat dat, int dim) {
+  sub_dat_list sd = OPS_sub_dat_list[dat->index];
+  if (!dat->block->periodic[dim] || (dat->e_dat && sd->gbl_size[dim] == 1))
+    return 0;
+  return sd->gbl_size[dim] + sd->gbl_d_m[dim] - sd->gbl_d_p[dim] +
+         sd->gbl_base[dim];
+}
+
+// Where my first point is, as seen by my left neighbor, and one past my last
+// point, as seen by my right neighbor: across a periodic boundary the
+// neighbor is a period away
+static void ops_dat_wrapped_range(ops_dat dat, int dim, int *begin, int *end) {
+  sub_block_list sb = OPS_sub_block_list[dat->block->index];
+  sub_dat_list sd = OPS_sub_dat_list[dat->index];
+  int period = ops_dat_period(dat, dim);
+  *begin = sd->decomp_disp[dim] + (sb->coords[dim] == 0 ? period : 0);
+  *end = sd->decomp_disp[dim] + sd->decomp_size[dim] -
+         (sb->coords[dim] == sb->pdims[dim] - 1 ? period : 0);
+}
+
+// A single process spans a periodic dimension, so it is its own neighbor on
+// both sides, and its halos are filled by a local copy instead of messages
+static int ops_halo_self_wrap(sub_block_list sb, int dim) {
+  return sb->pdims[dim] == 1 && sb->id_m[dim] != MPI_PROC_NULL;
+}
+
 int ops_compute_intersections(ops_dat dat, int d_pos, int d_neg,
                               int *iter_range, int dim,
                               int *left_send_depth, int *left_recv_depth,
@@ -82,6 +119,9 @@ int ops_compute_intersections(ops_dat dat, int d_pos, int d_neg,
 
   int ndim = sb->ndim;
 
+  int wrap_begin, wrap_end;
+  ops_dat_wrapped_range(dat, dim, &wrap_begin, &wrap_end);
+
   for (int dim = 0; dim < ndim; dim++) {
     range_intersect[dim] = intersection(
         iter_range[2 * dim] + d_neg, iter_range[2 * dim + 1] + d_pos,
@@ -94,14 +134,13 @@ int ops_compute_intersections(ops_dat dat, int d_pos, int d_neg,
 
   if (d_pos > 0) {
     *left_send_depth =
-        contains(sd->decomp_disp[dim] - 1, &iter_range[2 * dim])
+        contains(wrap_begin - 1, &iter_range[2 * dim])
             ? // if my left neighbor's last point is in the iteration range
             d_pos
             : // then it needs full depth required by the stencil
-            (iter_range[2 * dim + 1] < sd->decomp_disp[dim]
+            (iter_range[2 * dim + 1] < wrap_begin
                  ? // otherwise if range ends somewhere before my range begins
-                 MAX(0,
-                     d_pos - (sd->decomp_disp[dim] - iter_range[2 * dim + 1]))
+                 MAX(0, d_pos - (wrap_begin - iter_range[2 * dim + 1]))
                  :   // the dependency may still reach into my range
                  0); // otherwise 0
 
@@ -134,16 +173,14 @@ int ops_compute_intersections(ops_dat dat, int d_pos, int d_neg,
                  0); // otherwise 0
 
     *right_send_depth =
-        contains((sd->decomp_disp[dim] + sd->decomp_size[dim]),
-                 &iter_range[2 * dim])
+        contains(wrap_end, &iter_range[2 * dim])
             ? // if my neighbor's first point is in the iteration range
             -d_neg
             : // then it needs full depth required by the stencil
-            (iter_range[2 * dim] > (sd->decomp_disp[dim] + sd->decomp_size[dim])
+            (iter_range[2 * dim] > wrap_end
                  ? // otherwise if range starts somewhere after my neighbor's
                  // range begins
-                 MAX(0, -d_neg - (iter_range[2 * dim] - (sd->decomp_disp[dim] +
-                                                         sd->decomp_size[dim])))
+                 MAX(0, -d_neg - (iter_range[2 * dim] - wrap_end))
                  :   // the dependency may still reach into my range
                  0); // otherwise 0
   }
@@ -160,6 +197,95 @@ int ops_compute_intersections(ops_dat dat, int d_pos, int d_neg,
   return 1;
 
 }
+/*
+ * Halos shared on the node (OPS_HALO_SHARED): the halos from neighbors on
+ * the same node are copied straight from their memory instead of being sent.
+ * For each dimension, the packer records which sides have data to move, then
+ * both processes mark themselves ready, the receiver copies once its
+ * neighbor is ready, and neither modifies its data until the other is done.
+ */
+static sub_block *ops_halo_shared_sb[OPS_MAX_DIM];
+static int ops_halo_shared_pending[OPS_MAX_DIM][2]; // towards id_m, id_p
+
+// Kinds of counters shared with the neighbors
+#define OPS_HALO_SHARED_READY 0
+#define OPS_HALO_SHARED_DONE 1
+
+// Marks the exchanges in dimension dim ready or done on this process
+static void ops_halo_shared_signal(int dim, int kind) {
+  sub_block *sb = ops_halo_shared_sb[dim];
+  for (int side = 0; side < 2; side++)
+    if (ops_halo_shared_pending[dim][side])
+      sb->shm_flags[4 * dim + 2 * side + kind]++;
+  MPI_Win_sync(sb->shm_flags_win);
+}
+
+// Waits until the neighbors have marked the exchanges in dimension dim ready
+// or done as many times as this process. Neither can get a whole exchange
+// ahead of the other, so a neighbor whose counter is past this one's has
+// counted an exchange this process did not, i.e. they disagree on which
+// exchanges are pending
+static void ops_halo_shared_wait(int dim, int kind) {
+  sub_block *sb = ops_halo_shared_sb[dim];
+  for (int side = 0; side < 2; side++) {
+    if (!ops_halo_shared_pending[dim][side])
+      continue;
+    int mine = sb->shm_flags[4 * dim + 2 * side + kind];
+    volatile int *theirs = side == 0 ? sb->shm_flags_m[dim] : sb->shm_flags_p[dim];
+    while (theirs[4 * dim + 2 * (1 - side) + kind] < mine) {
+      MPI_Win_sync(sb->shm_flags_win);
+      std::this_thread::yield();
+    }
+    if (theirs[4 * dim + 2 * (1 - side) + kind] != mine) {
+      OPSException ex(OPS_INTERNAL_ERROR);
+      ex << "Error: halo exchanges on the node out of step in dimension " << dim
+         << " with the " << (side == 0 ? "previous" : "next") << " neighbor";
+      throw ex;
+    }
+  }
+  MPI_Win_sync(sb->shm_flags_win);
+}
+
+// Returns 1 if any halos of dimension dim are copied on the node
+static int ops_halo_shared_any(int dim) {
+  return ops_halo_shared_pending[dim][0] || ops_halo_shared_pending[dim][1];
+}
+
+// Copies the halo described by halo from the neighbor's data, laid out as in
+// header, at src_offset to dest_offset in the dat
+static void ops_halo_shared_copy(ops_dat dat, int dest_offset,
+                                 ops_shm_header *header, int src_offset,
+                                 int dim, const ops_int_halo *halo) {
+  sub_dat_list sd = OPS_sub_dat_list[dat->index];
+  const char *src_data = (char *)header + OPS_SHM_HEADER;
+  if (OPS_instance::getOPSInstance()->OPS_soa) {
+    char *dest = dat->data + dest_offset * dat->type_size;
+    const char *src = src_data + src_offset * dat->type_size;
+    size_t dest_stride = sd->prod[dim] * dat->type_size;
+    size_t src_stride = header->prod[dim] * dat->type_size;
+    size_t dest_comp = (size_t)dat->size[0] * dat->size[1] * dat->size[2] * dat->type_size;
+    size_t src_comp = header->prod[OPS_MAX_DIM - 1] * dat->type_size;
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (int i = 0; i < halo->count; i++)
+      for (int d = 0; d < dat->dim; d++)
+        memcpy(dest + i * dest_stride + d * dest_comp,
+               src + i * src_stride + d * src_comp, halo->blocklength);
+  } else {
+    char *dest = dat->data + dest_offset * dat->elem_size;
+    const char *src = src_data + src_offset * dat->elem_size;
+    size_t dest_stride = sd->prod[dim] * dat->elem_size;
+    size_t src_stride = header->prod[dim] * dat->elem_size;
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (int i = 0; i < halo->count; i++)
+      memcpy(dest + i * dest_stride, src + i * src_stride,
+             halo->blocklength * dat->dim);
+  }
+}
+
 void ops_exchange_halo_packer(ops_dat dat, int d_pos, int d_neg,
                               int *iter_range, int dim,
                               int *send_recv_offsets) {
@@ -181,6 +307,11 @@ void ops_exchange_halo_packer(ops_dat dat, int d_pos, int d_neg,
   if (!ops_compute_intersections(dat, d_pos,d_neg, iter_range, dim,
           &left_send_depth, &left_recv_depth, &right_send_depth, &right_recv_depth)) return;
 
+  // neighbors on the node copy the halos themselves
+  int shared_m = sd->shm_win != MPI_WIN_NULL && sb->shm_m[dim] >= 0;
+  int shared_p = sd->shm_win != MPI_WIN_NULL && sb->shm_p[dim] >= 0;
+  ops_halo_shared_sb[dim] = sb;
+
   //
   // negative direction
   //
@@ -196,6 +327,12 @@ void ops_exchange_halo_packer(ops_dat dat, int d_pos, int d_neg,
     if (sd->dirty_dir_recv[2 * MAX_DEPTH * dim + MAX_DEPTH + d] == 1)
       actual_depth_recv = d;
 
+  // when I am my own neighbor, my boundary goes straight into my other halo
+  int self_wrap = ops_halo_self_wrap(sb, dim);
+  if (self_wrap)
+    actual_depth_send = actual_depth_recv =
+        MAX(actual_depth_send, actual_depth_recv);
+
   if (actual_depth_recv > abs(d_m[dim])) {
     OPSException ex(OPS_RUNTIME_CONFIGURATION_ERROR);
     ex << "Error: trying to exchange a " << actual_depth_recv << "-deep halo for " << dat->name << ", but halo is only " << abs(d_m[dim]) << " deep. Please set d_m and d_p accordingly";
@@ -228,6 +365,14 @@ void ops_exchange_halo_packer(ops_dat dat, int d_pos, int d_neg,
                   sd->halos[MAX_DEPTH * dim + actual_depth_send].count * dat->dim;
   int recv_size = sd->halos[MAX_DEPTH * dim + actual_depth_recv].blocklength *
                   sd->halos[MAX_DEPTH * dim + actual_depth_recv].count * dat->dim;
+  if (shared_m) {
+    ops_halo_shared_pending[dim][0] |= actual_depth_send > 0;
+    send_size = 0;
+  }
+  if (shared_p) {
+    ops_halo_shared_pending[dim][1] |= actual_depth_recv > 0;
+    recv_size = 0;
+  }
 
   if (send_recv_offsets[0] + send_size > ops_buffer_send_1_size) {
     if (OPS_instance::getOPSInstance()->OPS_diags > 4)
@@ -245,10 +390,20 @@ void ops_exchange_halo_packer(ops_dat dat, int d_pos, int d_neg,
  }
 
   // Pack data
-  if (actual_depth_send > 0)
+  if (actual_depth_send > 0 && !shared_m)
     ops_pack(dat, i2, ops_buffer_send_1 + send_recv_offsets[0],
              &sd->halos[MAX_DEPTH * dim + actual_depth_send]);
 
+  if (self_wrap) {
+    if (actual_depth_recv > 0)
+      ops_unpack(dat, (prod[dim] / prod[dim - 1] - d_p[dim]) * prod[dim - 1],
+                 ops_buffer_send_1 + send_recv_offsets[0],
+                 &sd->halos[MAX_DEPTH * dim + actual_depth_recv]);
+    for (int d = 0; d <= actual_depth_recv; d++)
+      sd->dirty_dir_recv[2 * MAX_DEPTH * dim + MAX_DEPTH + d] = 0;
+    send_size = recv_size = 0;
+  }
+
   // if (actual_depth_send>0)
   //   ops_printf("%s send neg %d\n",dat->name, actual_depth_send);
 
@@ -275,6 +430,9 @@ void ops_exchange_halo_packer(ops_dat dat, int d_pos, int d_neg,
     if (sd->dirty_dir_recv[2 * MAX_DEPTH * dim + d] == 1)
       actual_depth_recv = d;
 
+  if (self_wrap)
+    actual_depth_send = actual_depth_recv =
+        MAX(actual_depth_send, actual_depth_recv);
 
   if (actual_depth_recv > d_p[dim]) {
     OPSException ex(OPS_RUNTIME_CONFIGURATION_ERROR);
@@ -308,6 +466,14 @@ void ops_exchange_halo_packer(ops_dat dat, int d_pos, int d_neg,
               sd->halos[MAX_DEPTH * dim + actual_depth_send].count * dat->dim;
   recv_size = sd->halos[MAX_DEPTH * dim + actual_depth_recv].blocklength *
               sd->halos[MAX_DEPTH * dim + actual_depth_recv].count * dat->dim;
+  if (shared_p) {
+    ops_halo_shared_pending[dim][1] |= actual_depth_send > 0;
+    send_size = 0;
+  }
+  if (shared_m) {
+    ops_halo_shared_pending[dim][0] |= actual_depth_recv > 0;
+    recv_size = 0;
+  }
 
   if (send_recv_offsets[2] + send_size > ops_buffer_send_2_size) {
     if (OPS_instance::getOPSInstance()->OPS_diags > 4)
@@ -325,10 +491,20 @@ void ops_exchange_halo_packer(ops_dat dat, int d_pos, int d_neg,
  }
 
   // pack data
-  if (actual_depth_send > 0)
+  if (actual_depth_send > 0 && !shared_p)
     ops_pack(dat, i3, ops_buffer_send_2 + send_recv_offsets[2],
              &sd->halos[MAX_DEPTH * dim + actual_depth_send]);
 
+  if (self_wrap) {
+    if (actual_depth_recv > 0)
+      ops_unpack(dat, (-d_m[dim] - actual_depth_recv) * prod[dim - 1],
+                 ops_buffer_send_2 + send_recv_offsets[2],
+                 &sd->halos[MAX_DEPTH * dim + actual_depth_recv]);
+    for (int d = 0; d <= actual_depth_recv; d++)
+      sd->dirty_dir_recv[2 * MAX_DEPTH * dim + d] = 0;
+    send_size = recv_size = 0;
+  }
+
   // if (actual_depth_send>0)
   //   ops_printf("%s send pos %d\n",dat->name, actual_depth_send);
 
@@ -403,6 +579,12 @@ void ops_exchange_halo_packer_given(ops_dat dat, int *depths, int dim,
     actual_depth_recv = 0;
   }
 
+  // when I am my own neighbor, my boundary goes straight into my other halo
+  int self_wrap = ops_halo_self_wrap(sb, dim);
+  if (self_wrap)
+    actual_depth_send = actual_depth_recv =
+        MAX(actual_depth_send, actual_depth_recv);
+
   // set up initial pointers
   int i2 = (-d_m[dim]) * prod[dim - 1];
   // int i4 = (prod[dim]/prod[dim-1] - (d_p[dim])    ) * prod[dim-1];
@@ -445,6 +627,16 @@ void ops_exchange_halo_packer_given(ops_dat dat, int *depths, int dim,
     ops_pack(dat, i2, ops_buffer_send_1 + send_recv_offsets[0],
              &sd->halos[MAX_DEPTH * dim + actual_depth_send]);
 
+  if (self_wrap) {
+    if (actual_depth_recv > 0)
+      ops_unpack(dat, (prod[dim] / prod[dim - 1] - d_p[dim]) * prod[dim - 1],
+                 ops_buffer_send_1 + send_recv_offsets[0],
+                 &sd->halos[MAX_DEPTH * dim + actual_depth_recv]);
+    for (int d = 0; d <= actual_depth_recv; d++)
+      sd->dirty_dir_recv[2 * MAX_DEPTH * dim + MAX_DEPTH + d] = 0;
+    send_size = recv_size = 0;
+  }
+
   // increase offset
   send_recv_offsets[0] += send_size;
   send_recv_offsets[1] += recv_size;
@@ -474,6 +666,9 @@ void ops_exchange_halo_packer_given(ops_dat dat, int *depths, int dim,
   if (sb->id_m[dim] == MPI_PROC_NULL) {
     actual_depth_recv = 0;
   }
+  if (self_wrap)
+    actual_depth_send = actual_depth_recv =
+        MAX(actual_depth_send, actual_depth_recv);
 
   // set up initial pointers
   // int i1 = (-d_m[dim] - actual_depth_recv) * prod[dim-1];
@@ -516,6 +711,16 @@ void ops_exchange_halo_packer_given(ops_dat dat, int *depths, int dim,
     ops_pack(dat, i3, ops_buffer_send_2 + send_recv_offsets[2],
              &sd->halos[MAX_DEPTH * dim + actual_depth_send]);
 
+  if (self_wrap) {
+    if (actual_depth_recv > 0)
+      ops_unpack(dat, (-d_m[dim] - actual_depth_recv) * prod[dim - 1],
+                 ops_buffer_send_2 + send_recv_offsets[2],
+                 &sd->halos[MAX_DEPTH * dim + actual_depth_recv]);
+    for (int d = 0; d <= actual_depth_recv; d++)
+      sd->dirty_dir_recv[2 * MAX_DEPTH * dim + d] = 0;
+    send_size = recv_size = 0;
+  }
+
   // increase offset
   send_recv_offsets[2] += send_size;
   send_recv_offsets[3] += recv_size;
@@ -529,6 +734,7 @@ void ops_exchange_halo_packer_given(ops_dat dat, int *depths, int dim,
 void ops_exchange_halo_unpacker(ops_dat dat, int d_pos, int d_neg,
                                 int *iter_range, int dim,
                                 int *send_recv_offsets) {
+  sub_block_list sb = OPS_sub_block_list[dat->block->index];
   sub_dat_list sd = OPS_sub_dat_list[dat->index];
   int left_recv_depth = 0;
   int right_recv_depth = 0;
@@ -544,6 +750,8 @@ void ops_exchange_halo_unpacker(ops_dat dat, int d_pos, int d_neg,
 
   if (!ops_compute_intersections(dat, d_pos,d_neg, iter_range, dim,
           &left_send_depth, &left_recv_depth, &right_send_depth, &right_recv_depth)) return;
+  int shared_m = sd->shm_win != MPI_WIN_NULL && sb->shm_m[dim] >= 0;
+  int shared_p = sd->shm_win != MPI_WIN_NULL && sb->shm_p[dim] >= 0;
 
   //
   // negative direction
@@ -562,10 +770,15 @@ void ops_exchange_halo_unpacker(ops_dat dat, int d_pos, int d_neg,
   int recv_size = sd->halos[MAX_DEPTH * dim + actual_depth_recv].blocklength *
                   sd->halos[MAX_DEPTH * dim + actual_depth_recv].count * dat->dim;
 
-  // Unpack data
-  if (actual_depth_recv > 0)
+  // Unpack data, or copy it from the neighbor on the node
+  if (actual_depth_recv > 0 && shared_p)
+    ops_halo_shared_copy(dat, i4, sd->shm_p[dim],
+                         sd->shm_p[dim]->owned_begin[dim] * prod[dim - 1], dim,
+                         &sd->halos[MAX_DEPTH * dim + actual_depth_recv]);
+  else if (actual_depth_recv > 0)
     ops_unpack(dat, i4, ops_buffer_recv_1 + send_recv_offsets[1],
                &sd->halos[MAX_DEPTH * dim + actual_depth_recv]);
+  if (shared_p) recv_size = 0;
   // increase offset
   send_recv_offsets[1] += recv_size;
   // clear dirtybits
@@ -589,10 +802,15 @@ void ops_exchange_halo_unpacker(ops_dat dat, int d_pos, int d_neg,
   recv_size = sd->halos[MAX_DEPTH * dim + actual_depth_recv].blocklength *
               sd->halos[MAX_DEPTH * dim + actual_depth_recv].count * dat->dim;
 
-  // Unpack data
-  if (actual_depth_recv > 0)
+  // Unpack data, or copy it from the neighbor on the node
+  if (actual_depth_recv > 0 && shared_m)
+    ops_halo_shared_copy(dat, i1, sd->shm_m[dim],
+                         (sd->shm_m[dim]->owned_end[dim] - actual_depth_recv) * prod[dim - 1],
+                         dim, &sd->halos[MAX_DEPTH * dim + actual_depth_recv]);
+  else if (actual_depth_recv > 0)
     ops_unpack(dat, i1, ops_buffer_recv_2 + send_recv_offsets[3],
                &sd->halos[MAX_DEPTH * dim + actual_depth_recv]);
+  if (shared_m) recv_size = 0;
   // increase offset
   send_recv_offsets[3] += recv_size;
   // clear dirtybits
@@ -679,164 +897,1042 @@ void ops_exchange_halo_unpacker_given(ops_dat dat, int *depths, int dim,
 
 }
 
-void ops_halo_exchanges(ops_arg* args, int nargs, int *range_in) {
-  // double c1,c2,t1,t2;
-  // printf("*************** range[i] %d %d %d %d\n",range[0],range[1],range[2],
-  // range[3]);
-  int send_recv_offsets[4]; //{send_1, recv_1, send_2, recv_2}, for the two
-                            // directions, negative then positive
+// Iteration range of an argument, accounting for multigrid stencils
+static void ops_halo_arg_range(ops_arg *arg, int dat_ndim, int *range_in,
+                               int *range) {
+  for (int d2 = 0; d2 < dat_ndim; d2++) {
+    if (arg->stencil->type ==1) {
+      range[2*d2+0] = range_in[2*d2+0]/arg->stencil->mgrid_stride[d2];
+      range[2*d2+1] = (range_in[2*d2+1]-1)/arg->stencil->mgrid_stride[d2]+1;
+    } else if (arg->stencil->type ==2) {
+      range[2*d2+0] = range_in[2*d2+0]*arg->stencil->mgrid_stride[d2];
+      range[2*d2+1] = range_in[2*d2+1]*arg->stencil->mgrid_stride[d2];
+    } else {
+      range[2*d2+0] = range_in[2*d2+0];
+      range[2*d2+1] = range_in[2*d2+1];
+    }
+  }
+}
+
+// Biggest positive/negative stencil extent of an argument in dimension dim
+static void ops_halo_arg_depths(ops_arg *arg, int dat_ndim, int dim,
+                                int *d_pos, int *d_neg) {
+  *d_pos = 0;
+  *d_neg = 0;
+  for (int p = 0; p < arg->stencil->points; p++) {
+    *d_pos = MAX(*d_pos, arg->stencil->stencil[dat_ndim * p + dim]);
+    *d_neg = MIN(*d_neg, arg->stencil->stencil[dat_ndim * p + dim]);
+  }
+  if (arg->stencil->type == 1) (*d_neg)--;
+}
+
+// Checks if an argument may need a halo exchange in dimension dim
+static int ops_halo_arg_exchanged(ops_arg *arg, int dim) {
+  if (arg->argtype != OPS_ARG_DAT ||
+      (arg->acc == OPS_WRITE || arg->acc == OPS_MAX || arg->acc == OPS_MIN) ||
+      arg->opt == 0)
+    return 0;
+
+  if(dim >= arg->stencil->dims)
+    return 0;
+
+  if ((arg->acc == OPS_READ || arg->acc == OPS_RW || arg->acc == OPS_INC) &&
+      arg->stencil->points == 1 &&
+      arg->stencil->stencil[dim] == 0)
+    return 0;
+
+  ops_dat dat = arg->dat;
+  int dat_ndim = OPS_sub_block_list[dat->block->index]->ndim;
+  if (dat_ndim <= dim || dat->size[dim] <= 1)
+    return 0; // dimension of the sub-block is less than current dim OR has
+              // a size of 1 (edge dat)
+  return 1;
+}
+
+// Packs the halos of all arguments in dimension dim, returns 0 if there is
+// nothing to send or receive in this dimension
+static int ops_halo_exchanges_pack(ops_arg *args, int nargs, int *range_in,
+                                   int dim, int *send_recv_offsets,
+                                   MPI_Comm *comm, int *id_m, int *id_p) {
+  int other_dims = 1;
+  *comm = MPI_COMM_NULL;
+  ops_halo_shared_pending[dim][0] = ops_halo_shared_pending[dim][1] = 0;
+  for (int i = 0; i < nargs; i++) {
+    if (!ops_halo_arg_exchanged(&args[i], dim))
+      continue;
+
+    ops_dat dat = args[i].dat;
+    int dat_ndim = OPS_sub_block_list[dat->block->index]->ndim;
+    *comm = OPS_sub_block_list[dat->block->index]
+               ->comm; // use communicator for this sub-block
+
+    int range[2*OPS_MAX_DIM];
+    ops_halo_arg_range(&args[i], dat_ndim, range_in, range);
+    //check if there is an intersection of dependency range with my full range
+    //in *other* dimensions (i.e. any other dimension d2 ,but the current one dim)
+    for (int d2 = 0; d2 < dat_ndim; d2++) {
+      if (dim != d2)
+        other_dims =
+            other_dims &&
+            (dat->size[d2] == 1 ||
+             intersection(range[2 * d2] - MAX_DEPTH,
+                          range[2 * d2 + 1] + MAX_DEPTH,
+                          OPS_sub_dat_list[dat->index]->decomp_disp[d2],
+                          OPS_sub_dat_list[dat->index]->decomp_disp[d2] +
+                              OPS_sub_dat_list[dat->index]
+                                  ->decomp_size[d2])); // i.e. the
+                                                       // intersection of the
+                                                       // dependency range
+                                                       // with my full range
+    }
+    if (other_dims == 0)
+      break;
+    *id_m = OPS_sub_block_list[dat->block->index]
+               ->id_m[dim]; // neighbor in negative direction
+    *id_p = OPS_sub_block_list[dat->block->index]
+               ->id_p[dim]; // neighbor in positive direction
+    int d_pos = 0, d_neg = 0;
+    ops_halo_arg_depths(&args[i], dat_ndim, dim, &d_pos, &d_neg);
+
+    if (d_pos > 0 || d_neg < 0)
+      ops_exchange_halo_packer(dat, d_pos, d_neg, range, dim,
+                               send_recv_offsets);
+
+  }
+
+  // early exit - if one of the args does not have an intersection in other
+  // dims
+  // then none of the args will have an intersection - as all dats (except
+  // edge dats)
+  // are defined on the whole domain
+  if (other_dims == 0 || *comm == MPI_COMM_NULL)
+    return 0;
+  return 1;
+}
+
+// Unpacks the halos of all arguments in dimension dim
+static void ops_halo_exchanges_unpack(ops_arg *args, int nargs, int *range_in,
+                                      int dim, int *send_recv_offsets) {
+  for (int i = 0; i < nargs; i++) {
+    if (args[i].argtype != OPS_ARG_DAT ||
+        !(args[i].acc == OPS_READ || args[i].acc == OPS_RW) ||
+        args[i].opt == 0)
+      continue;
+    ops_dat dat = args[i].dat;
+    int dat_ndim = OPS_sub_block_list[dat->block->index]->ndim;
+    if (dat_ndim <= dim || dat->size[dim] <= 1)
+      continue;
+
+    int range[2*OPS_MAX_DIM];
+    ops_halo_arg_range(&args[i], dat_ndim, range_in, range);
+
+    int d_pos=0,d_neg=0;
+    ops_halo_arg_depths(&args[i], dat_ndim, dim, &d_pos, &d_neg);
+    if (d_pos > 0 || d_neg < 0)
+      ops_exchange_halo_unpacker(dat, d_pos, d_neg, range, dim,
+                                 send_recv_offsets);
+  }
+}
+
+// Posts the messages of dimension dim, whose packed data starts at offsets
+// begin and ends at offsets end in the send/recv buffers
+static void ops_halo_exchanges_post(int dim, int *begin, int *end,
+                                    MPI_Comm comm, int id_m, int id_p,
+                                    MPI_Request *request) {
+  MPI_Isend(ops_buffer_send_1 + begin[0], end[0] - begin[0], MPI_BYTE,
+            end[0] - begin[0] > 0 ? id_m : MPI_PROC_NULL, dim, comm,
+            &request[0]);
+  MPI_Isend(ops_buffer_send_2 + begin[2], end[2] - begin[2], MPI_BYTE,
+            end[2] - begin[2] > 0 ? id_p : MPI_PROC_NULL,
+            OPS_MAX_DIM + dim, comm, &request[1]);
+  MPI_Irecv(ops_buffer_recv_1 + begin[1], end[1] - begin[1], MPI_BYTE,
+            end[1] - begin[1] > 0 ? id_p : MPI_PROC_NULL, dim, comm,
+            &request[2]);
+  MPI_Irecv(ops_buffer_recv_2 + begin[3], end[3] - begin[3], MPI_BYTE,
+            end[3] - begin[3] > 0 ? id_m : MPI_PROC_NULL,
+            OPS_MAX_DIM + dim, comm, &request[3]);
+}
+
+// Exchanges the halos of all arguments in dimension dim
+static void ops_halo_exchange_dim(ops_arg *args, int nargs, int *range_in,
+                                  int dim) {
+  int send_recv_offsets[4] = {0, 0, 0, 0}; //{send_1, recv_1, send_2, recv_2},
+                                           // for the two directions, negative
+                                           // then positive
+  int zero_offsets[4] = {0, 0, 0, 0};
   MPI_Comm comm = MPI_COMM_NULL;
+  int id_m = -1, id_p = -1;
 
-  for (int dim = 0; dim < OPS_MAX_DIM; dim++) {
-    // ops_timers_core(&c1,&t1);
-    int id_m = -1, id_p = -1;
-    int other_dims = 1;
-    for (int i = 0; i < 4; i++)
-      send_recv_offsets[i] = 0;
-    for (int i = 0; i < nargs; i++) {
-      if (args[i].argtype != OPS_ARG_DAT ||
-          (args[i].acc == OPS_WRITE || args[i].acc == OPS_MAX || args[i].acc == OPS_MIN) ||
-          args[i].opt == 0)
-        continue;
+  if (!ops_halo_exchanges_pack(args, nargs, range_in, dim, send_recv_offsets,
+                               &comm, &id_m, &id_p))
+    return;
 
-      if(dim >= args[i].stencil->dims)
-        continue;
+  MPI_Request request[4];
+  ops_halo_exchanges_post(dim, zero_offsets, send_recv_offsets, comm, id_m,
+                          id_p, request);
+  int shared = ops_halo_shared_any(dim);
+  if (shared) {
+    ops_halo_shared_signal(dim, OPS_HALO_SHARED_READY);
+    ops_halo_shared_wait(dim, OPS_HALO_SHARED_READY);
+  }
 
-      ops_dat dat = args[i].dat;
-      int dat_ndim = OPS_sub_block_list[dat->block->index]->ndim;
-      if (args[i].argtype == OPS_ARG_DAT &&
-          (args[i].acc == OPS_READ || args[i].acc == OPS_RW || args[i].acc == OPS_INC) &&
-          args[i].stencil->points == 1 &&
-          args[i].stencil->stencil[dim] == 0)
-        continue;
+  MPI_Status status[4];
+  MPI_Waitall(2, &request[2], &status[2]);
 
-      if (dat_ndim <= dim || dat->size[dim] <= 1)
-        continue; // dimension of the sub-block is less than current dim OR has
-                  // a size of 1 (edge dat)
-      comm = OPS_sub_block_list[dat->block->index]
-                 ->comm; // use communicator for this sub-block
+  for (int i = 0; i < 4; i++)
+    send_recv_offsets[i] = 0;
+  ops_halo_exchanges_unpack(args, nargs, range_in, dim, send_recv_offsets);
+  if (shared) {
+    ops_halo_shared_signal(dim, OPS_HALO_SHARED_DONE);
+    ops_halo_shared_wait(dim, OPS_HALO_SHARED_DONE);
+  }
 
-      int range[2*OPS_MAX_DIM];
-      for (int d2 = 0; d2 < dat_ndim; d2++) {
-        if (args[i].stencil->type ==1) {
-          range[2*d2+0] = range_in[2*d2+0]/args[i].stencil->mgrid_stride[d2];
-          range[2*d2+1] = (range_in[2*d2+1]-1)/args[i].stencil->mgrid_stride[d2]+1;
-        } else if (args[i].stencil->type ==2) {
-          range[2*d2+0] = range_in[2*d2+0]*args[i].stencil->mgrid_stride[d2];
-          range[2*d2+1] = range_in[2*d2+1]*args[i].stencil->mgrid_stride[d2];
-        } else {
-          range[2*d2+0] = range_in[2*d2+0];
-          range[2*d2+1] = range_in[2*d2+1];
+  MPI_Waitall(2, &request[0], &status[0]);
+}
+
+/*
+ * Aggregated halo exchanges: instead of exchanging one dimension after the
+ * other, the face, edge and corner regions of all dimensions are packed at
+ * once, and a single message is exchanged with each neighbor of the
+ * Cartesian process grid, including the diagonal ones. Each message starts
+ * with the depths packed for each dataset, followed by the packed data, so
+ * the receiver does not have to know in advance what the sender considers
+ * dirty. Faces are exchanged to the depth that is dirty, edges and corners
+ * to the depth required by the stencils whenever one of their faces is
+ * dirty, matching what the dimension by dimension exchange carries over.
+ *
+ * The datasets, depths and message layout of an exchange only depend on the
+ * arguments and the iteration range of the loop, so with OPS_HALO_PLANS they
+ * are computed once and cached in a plan, together with persistent requests
+ * sized for the largest messages. Executing a cached plan then only takes
+ * checking the dirtybits, packing, starting the requests and unpacking.
+ */
+#define OPS_HALO_AGGREGATE_TAG 1000
+
+struct ops_halo_aggregate_dat {
+  ops_dat dat;
+  int req[2 * OPS_MAX_DIM]; // depth required by the stencils, per face
+  int act[2 * OPS_MAX_DIM]; // depth that is dirty, per face
+};
+
+struct ops_halo_plan {
+  std::vector<int> key;    // datasets, stencils and accesses, then range
+  unsigned long hash;
+  sub_block *sb;
+  std::vector<ops_halo_aggregate_dat> dats;
+  std::vector<int> dirs;            // direction of each neighbor
+  int nwrap;                        // messages to myself, at the end of dirs
+  std::vector<size_t> send_offsets; // offset of each message in the buffers
+  std::vector<size_t> recv_offsets;
+  std::vector<MPI_Request> requests; // receives first, then sends
+  int persistent;                    // requests are persistent
+  char *send_buffer;                 // buffers the persistent requests use
+  char *recv_buffer;
+};
+static ops_halo_plan ops_aggregate;                // uncached exchanges
+static std::vector<ops_halo_plan *> ops_halo_plan_cache; // cached plans
+static ops_halo_plan *ops_halo_plan_inflight = NULL;
+
+// Collects the datasets to be exchanged and their depths on each face,
+// returns 0 if the arguments have to be exchanged dimension by dimension
+static int ops_halo_aggregate_collect(ops_halo_plan *plan, ops_arg *args,
+                                      int nargs, int *range_in) {
+  sub_block *sb = NULL;
+  std::vector<ops_halo_aggregate_dat> &dats = plan->dats;
+  dats.clear();
+  for (int i = 0; i < nargs; i++) {
+    if (args[i].argtype == OPS_ARG_DAT && args[i].opt == 1 &&
+        args[i].stencil->type != 0)
+      return 0; // multigrid stencils
+    int exchanged = 0;
+    for (int dim = 0; dim < OPS_MAX_DIM; dim++)
+      exchanged = exchanged || ops_halo_arg_exchanged(&args[i], dim);
+    if (!exchanged)
+      continue;
+
+    ops_dat dat = args[i].dat;
+    if (sb != NULL && sb != OPS_sub_block_list[dat->block->index])
+      return 0;
+    sb = OPS_sub_block_list[dat->block->index];
+
+    unsigned int e = 0;
+    while (e < dats.size() && dats[e].dat != dat)
+      e++;
+    if (e == dats.size()) {
+      ops_halo_aggregate_dat entry;
+      entry.dat = dat;
+      for (int d = 0; d < 2 * OPS_MAX_DIM; d++)
+        entry.req[d] = entry.act[d] = 0;
+      dats.push_back(entry);
+    }
+
+    int range[2 * OPS_MAX_DIM];
+    ops_halo_arg_range(&args[i], sb->ndim, range_in, range);
+    for (int dim = 0; dim < sb->ndim; dim++) {
+      if (!ops_halo_arg_exchanged(&args[i], dim))
+        continue;
+      int d_pos = 0, d_neg = 0;
+      ops_halo_arg_depths(&args[i], sb->ndim, dim, &d_pos, &d_neg);
+      int left_send_depth = 0, left_recv_depth = 0;
+      int right_send_depth = 0, right_recv_depth = 0;
+      if (!ops_compute_intersections(dat, d_pos, d_neg, range, dim,
+                                     &left_send_depth, &left_recv_depth,
+                                     &right_send_depth, &right_recv_depth))
+        continue;
+      if (sb->id_m[dim] != MPI_PROC_NULL)
+        dats[e].req[2 * dim] = MAX(dats[e].req[2 * dim], left_send_depth);
+      if (sb->id_p[dim] != MPI_PROC_NULL)
+        dats[e].req[2 * dim + 1] =
+            MAX(dats[e].req[2 * dim + 1], right_send_depth);
+    }
+  }
+  plan->sb = sb;
+
+  for (unsigned int e = 0; e < dats.size(); e++) {
+    ops_dat dat = dats[e].dat;
+    sub_dat_list sd = OPS_sub_dat_list[dat->index];
+    for (int dim = 0; dim < sb->ndim; dim++) {
+      for (int side = 0; side < 2; side++) {
+        int halo = side == 0 ? -sd->d_im[dim] : sd->d_ip[dim];
+        if (dats[e].req[2 * dim + side] > halo) {
+          OPSException ex(OPS_RUNTIME_CONFIGURATION_ERROR);
+          ex << "Error: trying to exchange a " << dats[e].req[2 * dim + side] << "-deep halo for " << dat->name << ", but halo is only " << halo << " deep. Please set d_m and d_p accordingly";
+          throw ex;
+        }
+        if (dats[e].req[2 * dim + side] > sd->decomp_size[dim]) {
+          OPSException ex(OPS_RUNTIME_CONFIGURATION_ERROR);
+          ex << "Error: overpartitioning! Trying to exchange a " << dats[e].req[2 * dim + side] << "-deep halo for " << dat->name << ", but dataset is only " << sd->decomp_size[dim] << " wide on this process.";
+          throw ex;
         }
       }
-      //check if there is an intersection of dependency range with my full range
-      //in *other* dimensions (i.e. any other dimension d2 ,but the current one dim)
-      for (int d2 = 0; d2 < dat_ndim; d2++) {
-        if (dim != d2)
-          other_dims =
-              other_dims &&
-              (dat->size[d2] == 1 ||
-               intersection(range[2 * d2] - MAX_DEPTH,
-                            range[2 * d2 + 1] + MAX_DEPTH,
-                            OPS_sub_dat_list[dat->index]->decomp_disp[d2],
-                            OPS_sub_dat_list[dat->index]->decomp_disp[d2] +
-                                OPS_sub_dat_list[dat->index]
-                                    ->decomp_size[d2])); // i.e. the
-                                                         // intersection of the
-                                                         // dependency range
-                                                         // with my full range
-      }
-      if (other_dims == 0)
-        break;
-      id_m = OPS_sub_block_list[dat->block->index]
-                 ->id_m[dim]; // neighbor in negative direction
-      id_p = OPS_sub_block_list[dat->block->index]
-                 ->id_p[dim]; // neighbor in positive direction
-      int d_pos = 0, d_neg = 0;
-      for (int p = 0; p < args[i].stencil->points; p++) {
-        d_pos = MAX(d_pos, args[i].stencil->stencil[dat_ndim * p + dim]);
-        d_neg = MIN(d_neg, args[i].stencil->stencil[dat_ndim * p + dim]);
+    }
+  }
+  return 1;
+}
+
+// Decides actual depths based on dirtybits, then clears them
+static void ops_halo_aggregate_dirty(ops_halo_plan *plan) {
+  for (unsigned int e = 0; e < plan->dats.size(); e++) {
+    ops_halo_aggregate_dat &entry = plan->dats[e];
+    sub_dat_list sd = OPS_sub_dat_list[entry.dat->index];
+    for (int dim = 0; dim < plan->sb->ndim; dim++) {
+      for (int side = 0; side < 2; side++) {
+        int *dirty = &sd->dirty_dir_send[2 * MAX_DEPTH * dim + MAX_DEPTH * side];
+        int actual_depth_send = 0;
+        for (int d = 0; d <= entry.req[2 * dim + side]; d++)
+          if (dirty[d] == 1)
+            actual_depth_send = d;
+        for (int d = 0; d <= actual_depth_send; d++)
+          dirty[d] = 0;
+        entry.act[2 * dim + side] = actual_depth_send;
       }
+    }
+  }
+}
+
+// Region of dat next to the faces in direction dir, with the given depth in
+// each dimension: the last owned cells if send is set, the halo otherwise.
+// Returns the number of elements in the region
+static size_t ops_halo_aggregate_box(ops_dat dat, int ndim, const int *dir,
+                                     const int *depth, int send, int *lo,
+                                     int *hi) {
+  sub_dat_list sd = OPS_sub_dat_list[dat->index];
+  size_t elems = 1;
+  for (int d = 0; d < ndim; d++) {
+    int left = -sd->d_im[d];                // first cell not in the MPI halo
+    int right = dat->size[d] - sd->d_ip[d]; // first cell in the MPI halo
+    if (dir[d] == 0) {
+      lo[d] = left;
+      hi[d] = right;
+    } else if (dir[d] < 0) {
+      lo[d] = send ? left : left - depth[d];
+      hi[d] = lo[d] + depth[d];
+    } else {
+      lo[d] = send ? right - depth[d] : right;
+      hi[d] = lo[d] + depth[d];
+    }
+    elems *= hi[d] - lo[d];
+  }
+  return elems;
+}
 
-      if (args[i].stencil->type == 1) d_neg--;
+// Packs or unpacks a region of dat, one 2D plane at a time
+static void ops_halo_aggregate_copy(ops_dat dat, int ndim, const int *lo,
+                                    const int *hi, char *buf, int pack) {
+  size_t *prod = OPS_sub_dat_list[dat->index]->prod;
+  ops_int_halo halo;
+  halo.count = ndim > 1 ? hi[1] - lo[1] : 1;
+  halo.blocklength = (hi[0] - lo[0]) * dat->type_size;
+  halo.stride = dat->size[0] * dat->type_size;
+  size_t plane_size = (size_t)halo.count * (hi[0] - lo[0]) * dat->elem_size;
+
+  int idx[OPS_MAX_DIM];
+  for (int d = 0; d < ndim; d++)
+    idx[d] = lo[d];
+  while (1) {
+    size_t offset = 0;
+    for (int d = 0; d < ndim; d++)
+      offset += idx[d] * prod[d - 1];
+    if (pack)
+      ops_pack(dat, offset, buf, &halo);
+    else
+      ops_unpack(dat, offset, buf, &halo);
+    buf += plane_size;
+
+    int d = 2;
+    while (d < ndim && ++idx[d] == hi[d]) {
+      idx[d] = lo[d];
+      d++;
+    }
+    if (d >= ndim)
+      break;
+  }
+}
 
-      if (d_pos > 0 || d_neg < 0)
-        ops_exchange_halo_packer(dat, d_pos, d_neg, range, dim,
-                                 send_recv_offsets);
+// Depths of dat packed towards direction dir, the required ones if
+// required is set, otherwise the dirty ones. Returns 0 if nothing is sent
+static int ops_halo_aggregate_send_depths(ops_halo_aggregate_dat *entry,
+                                          int ndim, const int *dir,
+                                          int required, int *depth) {
+  int nonzero = 0, dirty = 0;
+  for (int d = 0; d < ndim; d++) {
+    depth[d] = 0;
+    if (dir[d] == 0)
+      continue;
+    int face = 2 * d + (dir[d] > 0);
+    if (entry->req[face] == 0)
+      return 0;
+    depth[d] = entry->req[face];
+    dirty = dirty || entry->act[face] > 0;
+    nonzero++;
+  }
+  if (required)
+    return 1;
+  if (nonzero == 1) { // face
+    for (int d = 0; d < ndim; d++)
+      if (dir[d] != 0)
+        depth[d] = entry->act[2 * d + (dir[d] > 0)];
+  }
+  return dirty;
+}
+
+static void ops_halo_aggregate_direction(int ndim, int n, int *dir) {
+  for (int d = 0; d < ndim; d++, n /= 3)
+    dir[d] = n % 3 - 1;
+}
 
+// Computes the neighbors and the largest size of the messages to each of
+// them, and makes sure the buffers can hold them
+static void ops_halo_aggregate_layout(ops_halo_plan *plan) {
+  sub_block *sb = plan->sb;
+  std::vector<ops_halo_aggregate_dat> &dats = plan->dats;
+  int ndim = sb->ndim;
+  int nneigh = 1;
+  for (int d = 0; d < ndim; d++)
+    nneigh *= 3;
+  size_t header_size = dats.size() * ndim * sizeof(int);
+
+  plan->dirs.clear();
+  plan->nwrap = 0;
+  plan->send_offsets.clear();
+  plan->recv_offsets.clear();
+  size_t send_size = 0, recv_size = 0;
+  // messages to other processes first, then the ones across a periodic
+  // boundary back to myself
+  for (int m = 0; m < 2 * nneigh; m++) {
+    int n = m % nneigh;
+    if (n == nneigh / 2 || sb->id_neigh[n] == MPI_PROC_NULL ||
+        (sb->id_neigh[n] == sb->id_neigh[nneigh / 2]) != (m >= nneigh))
+      continue;
+    plan->nwrap += m >= nneigh;
+    int dir[OPS_MAX_DIM], lo[OPS_MAX_DIM], hi[OPS_MAX_DIM];
+    ops_halo_aggregate_direction(ndim, n, dir);
+    plan->dirs.push_back(n);
+    plan->send_offsets.push_back(send_size);
+    plan->recv_offsets.push_back(recv_size);
+    send_size += header_size;
+    recv_size += header_size;
+    for (unsigned int e = 0; e < dats.size(); e++) {
+      sub_dat_list sd = OPS_sub_dat_list[dats[e].dat->index];
+      int depth[OPS_MAX_DIM];
+      if (ops_halo_aggregate_send_depths(&dats[e], ndim, dir, 1, depth))
+        send_size += ops_halo_aggregate_box(dats[e].dat, ndim, dir, depth, 1,
+                                            lo, hi) * dats[e].dat->elem_size;
+      // at most the full halo may be received
+      for (int d = 0; d < ndim; d++)
+        depth[d] = dir[d] < 0 ? -sd->d_im[d] : sd->d_ip[d];
+      recv_size += ops_halo_aggregate_box(dats[e].dat, ndim, dir, depth, 0,
+                                          lo, hi) * dats[e].dat->elem_size;
     }
-    //  ops_timers_core(&c2,&t2);
-    //  ops_gather_time += t2-t1;
+  }
+  plan->send_offsets.push_back(send_size);
+  plan->recv_offsets.push_back(recv_size);
+}
 
-    // early exit - if one of the args does not have an intersection in other
-    // dims
-    // then none of the args will have an intersection - as all dats (except
-    // edge dats)
-    // are defined on the whole domain
-    if (other_dims == 0 || comm == MPI_COMM_NULL)
+// Makes sure the buffers can hold the messages of a plan
+static void ops_halo_aggregate_buffers(ops_halo_plan *plan) {
+  size_t send_size = plan->send_offsets.back();
+  size_t recv_size = plan->recv_offsets.back();
+  if (send_size > (size_t)ops_buffer_send_1_size) {
+    if (OPS_instance::getOPSInstance()->OPS_diags > 4)
+      printf("Realloc ops_buffer_send_1\n");
+    ops_buffer_send_1 = (char *)OPS_realloc_fast(ops_buffer_send_1, 0,
+                                                 2 * send_size);
+    ops_buffer_send_1_size = 2 * send_size;
+  }
+  if (recv_size > (size_t)ops_buffer_recv_1_size) {
+    if (OPS_instance::getOPSInstance()->OPS_diags > 4)
+      printf("Realloc ops_buffer_recv_1\n");
+    ops_buffer_recv_1 = (char *)OPS_realloc_fast(ops_buffer_recv_1, 0,
+                                                 2 * recv_size);
+    ops_buffer_recv_1_size = 2 * recv_size;
+  }
+}
+
+// Packs the message to the m-th neighbor, returns its size
+static size_t ops_halo_aggregate_pack(ops_halo_plan *plan, int m) {
+  int ndim = plan->sb->ndim;
+  std::vector<ops_halo_aggregate_dat> &dats = plan->dats;
+  int dir[OPS_MAX_DIM], lo[OPS_MAX_DIM], hi[OPS_MAX_DIM];
+  ops_halo_aggregate_direction(ndim, plan->dirs[m], dir);
+  int *header = (int *)(ops_buffer_send_1 + plan->send_offsets[m]);
+  char *buf = ops_buffer_send_1 + plan->send_offsets[m] +
+              dats.size() * ndim * sizeof(int);
+  for (unsigned int e = 0; e < dats.size(); e++) {
+    int *depth = &header[e * ndim];
+    if (!ops_halo_aggregate_send_depths(&dats[e], ndim, dir, 0, depth)) {
+      for (int d = 0; d < ndim; d++)
+        depth[d] = 0;
       continue;
+    }
+    size_t elems = ops_halo_aggregate_box(dats[e].dat, ndim, dir, depth, 1,
+                                          lo, hi);
+    if (elems > 0)
+      ops_halo_aggregate_copy(dats[e].dat, ndim, lo, hi, buf, 1);
+    buf += elems * dats[e].dat->elem_size;
+  }
+  return buf - (ops_buffer_send_1 + plan->send_offsets[m]);
+}
 
-    MPI_Request request[4];
-    MPI_Isend(ops_buffer_send_1, send_recv_offsets[0], MPI_BYTE,
-              send_recv_offsets[0] > 0 ? id_m : MPI_PROC_NULL, dim, comm,
-              &request[0]);
-    MPI_Isend(ops_buffer_send_2, send_recv_offsets[2], MPI_BYTE,
-              send_recv_offsets[2] > 0 ? id_p : MPI_PROC_NULL,
-              OPS_MAX_DIM + dim, comm, &request[1]);
-    MPI_Irecv(ops_buffer_recv_1, send_recv_offsets[1], MPI_BYTE,
-              send_recv_offsets[1] > 0 ? id_p : MPI_PROC_NULL, dim, comm,
-              &request[2]);
-    MPI_Irecv(ops_buffer_recv_2, send_recv_offsets[3], MPI_BYTE,
-              send_recv_offsets[3] > 0 ? id_m : MPI_PROC_NULL,
-              OPS_MAX_DIM + dim, comm, &request[3]);
+// Unpacks a message received from the neighbor in direction n
+static void ops_halo_aggregate_unpack(ops_halo_plan *plan, int n, char *msg) {
+  std::vector<ops_halo_aggregate_dat> &dats = plan->dats;
+  int ndim = plan->sb->ndim;
+  int dir[OPS_MAX_DIM], lo[OPS_MAX_DIM], hi[OPS_MAX_DIM];
+  ops_halo_aggregate_direction(ndim, n, dir);
+  int nonzero = 0;
+  for (int d = 0; d < ndim; d++)
+    nonzero += dir[d] != 0;
+  int *header = (int *)msg;
+  char *buf = msg + dats.size() * ndim * sizeof(int);
+  for (unsigned int e = 0; e < dats.size(); e++) {
+    int *depth = &header[e * ndim];
+    size_t elems = ops_halo_aggregate_box(dats[e].dat, ndim, dir, depth, 0,
+                                          lo, hi);
+    if (elems == 0)
+      continue;
+    ops_halo_aggregate_copy(dats[e].dat, ndim, lo, hi, buf, 0);
+    buf += elems * dats[e].dat->elem_size;
+    // clear dirtybits
+    if (nonzero == 1) {
+      sub_dat_list sd = OPS_sub_dat_list[dats[e].dat->index];
+      for (int d = 0; d < ndim; d++) {
+        if (dir[d] == 0)
+          continue;
+        int *dirty = &sd->dirty_dir_recv[2 * MAX_DEPTH * d +
+                                         (dir[d] > 0 ? MAX_DEPTH : 0)];
+        for (int dd = 0; dd <= depth[d]; dd++)
+          dirty[dd] = 0;
+      }
+    }
+  }
+}
 
-    MPI_Status status[4];
-    MPI_Waitall(2, &request[2], &status[2]);
+// Copies the messages a process sends to itself across periodic boundaries
+// straight into its halos, the direction they arrive from is the opposite
+static void ops_halo_aggregate_wrap(ops_halo_plan *plan) {
+  int nneigh = 1;
+  for (int d = 0; d < plan->sb->ndim; d++)
+    nneigh *= 3;
+  for (int m = plan->dirs.size() - plan->nwrap; m < (int)plan->dirs.size();
+       m++) {
+    ops_halo_aggregate_pack(plan, m);
+    ops_halo_aggregate_unpack(plan, nneigh - 1 - plan->dirs[m],
+                              ops_buffer_send_1 + plan->send_offsets[m]);
+  }
+}
 
-    //  ops_timers_core(&c1,&t1);
-    //  ops_sendrecv_time += t1-t2;
+// Sets up the persistent requests of a plan, the sender's direction is the
+// opposite of the receiver's
+static void ops_halo_plan_requests(ops_halo_plan *plan) {
+  sub_block *sb = plan->sb;
+  int nmsg = plan->dirs.size() - plan->nwrap;
+  int nneigh = 1;
+  for (int d = 0; d < sb->ndim; d++)
+    nneigh *= 3;
+  for (unsigned int i = 0; i < plan->requests.size(); i++)
+    MPI_Request_free(&plan->requests[i]);
+  plan->requests.resize(2 * nmsg);
+  for (int m = 0; m < nmsg; m++) {
+    int n = plan->dirs[m];
+    MPI_Recv_init(ops_buffer_recv_1 + plan->recv_offsets[m],
+                  plan->recv_offsets[m + 1] - plan->recv_offsets[m], MPI_BYTE,
+                  sb->id_neigh[n], OPS_HALO_AGGREGATE_TAG + nneigh - 1 - n,
+                  sb->comm, &plan->requests[m]);
+    MPI_Send_init(ops_buffer_send_1 + plan->send_offsets[m],
+                  plan->send_offsets[m + 1] - plan->send_offsets[m], MPI_BYTE,
+                  sb->id_neigh[n], OPS_HALO_AGGREGATE_TAG + n, sb->comm,
+                  &plan->requests[nmsg + m]);
+  }
+  plan->send_buffer = ops_buffer_send_1;
+  plan->recv_buffer = ops_buffer_recv_1;
+}
 
-    for (int i = 0; i < 4; i++)
-      send_recv_offsets[i] = 0;
+// Finds the cached plan of a loop, creating it if needed. Returns NULL if
+// the arguments have to be exchanged dimension by dimension
+static ops_halo_plan *ops_halo_plan_get(ops_arg *args, int nargs,
+                                        int *range_in) {
+  static std::vector<int> key;
+  key.clear();
+  for (int i = 0; i < nargs; i++) {
+    if (args[i].argtype != OPS_ARG_DAT || args[i].opt == 0)
+      continue;
+    key.push_back(args[i].dat->index);
+    key.push_back(args[i].stencil->index);
+    key.push_back(args[i].acc);
+  }
+  for (int d = 0; d < 2 * OPS_MAX_DIM; d++)
+    key.push_back(range_in[d]);
+  unsigned long hash = 5381;
+  for (unsigned int i = 0; i < key.size(); i++)
+    hash = ((hash << 5) + hash) + key[i];
+
+  for (unsigned int p = 0; p < ops_halo_plan_cache.size(); p++)
+    if (ops_halo_plan_cache[p]->hash == hash &&
+        ops_halo_plan_cache[p]->key == key)
+      return ops_halo_plan_cache[p];
+
+  ops_halo_plan *plan = new ops_halo_plan();
+  if (!ops_halo_aggregate_collect(plan, args, nargs, range_in)) {
+    delete plan;
+    return NULL;
+  }
+  plan->key = key;
+  plan->hash = hash;
+  plan->persistent = 1;
+  plan->send_buffer = NULL;
+  plan->recv_buffer = NULL;
+  if (plan->dats.size() > 0)
+    ops_halo_aggregate_layout(plan);
+  ops_halo_plan_cache.push_back(plan);
+  return plan;
+}
+
+void ops_halo_plans_free() {
+  for (unsigned int p = 0; p < ops_halo_plan_cache.size(); p++) {
+    ops_halo_plan *plan = ops_halo_plan_cache[p];
+    for (unsigned int i = 0; i < plan->requests.size(); i++)
+      MPI_Request_free(&plan->requests[i]);
+    delete plan;
+  }
+  ops_halo_plan_cache.clear();
+}
+
+// Packs and posts the messages to all neighbors, returns 0 if the arguments
+// have to be exchanged dimension by dimension
+static int ops_halo_aggregate_begin(ops_arg *args, int nargs, int *range_in) {
+  ops_halo_plan *plan = NULL;
+  if (OPS_instance::getOPSInstance()->ops_halo_plans) {
+    plan = ops_halo_plan_get(args, nargs, range_in);
+    if (plan == NULL)
+      return 0;
+  } else {
+    plan = &ops_aggregate;
+    plan->persistent = 0;
+    if (!ops_halo_aggregate_collect(plan, args, nargs, range_in))
+      return 0;
+    if (plan->dats.size() > 0)
+      ops_halo_aggregate_layout(plan);
+  }
+  ops_halo_plan_inflight = plan;
+  if (plan->dats.size() == 0 || plan->dirs.size() == 0)
+    return 1;
+
+  ops_halo_aggregate_dirty(plan);
+  ops_halo_aggregate_buffers(plan);
+  int nmsg = plan->dirs.size() - plan->nwrap;
+  if (plan->persistent) {
+    if (plan->send_buffer != ops_buffer_send_1 ||
+        plan->recv_buffer != ops_buffer_recv_1)
+      ops_halo_plan_requests(plan);
+    for (int m = 0; m < nmsg; m++)
+      ops_halo_aggregate_pack(plan, m);
+    if (nmsg > 0)
+      MPI_Startall(2 * nmsg, &plan->requests[0]);
+    ops_halo_aggregate_wrap(plan);
+    return 1;
+  }
+
+  // Post receives, the sender's direction is the opposite of ours
+  sub_block *sb = plan->sb;
+  int nneigh = 1;
+  for (int d = 0; d < sb->ndim; d++)
+    nneigh *= 3;
+  plan->requests.resize(2 * nmsg);
+  for (int m = 0; m < nmsg; m++) {
+    int n = plan->dirs[m];
+    MPI_Irecv(ops_buffer_recv_1 + plan->recv_offsets[m],
+              plan->recv_offsets[m + 1] - plan->recv_offsets[m], MPI_BYTE,
+              sb->id_neigh[n], OPS_HALO_AGGREGATE_TAG + nneigh - 1 - n,
+              sb->comm, &plan->requests[m]);
+  }
+  for (int m = 0; m < nmsg; m++) {
+    int n = plan->dirs[m];
+    size_t send_size = ops_halo_aggregate_pack(plan, m);
+    MPI_Isend(ops_buffer_send_1 + plan->send_offsets[m], send_size, MPI_BYTE,
+              sb->id_neigh[n], OPS_HALO_AGGREGATE_TAG + n, sb->comm,
+              &plan->requests[nmsg + m]);
+  }
+  ops_halo_aggregate_wrap(plan);
+  return 1;
+}
+
+// Returns 1 if the exchange started by ops_halo_aggregate_begin has
+// messages in flight
+static int ops_halo_aggregate_inflight() {
+  return ops_halo_plan_inflight != NULL &&
+         ops_halo_plan_inflight->dats.size() > 0 &&
+         (int)ops_halo_plan_inflight->dirs.size() >
+             ops_halo_plan_inflight->nwrap;
+}
+
+// Unpacks messages as they arrive, then completes the sends
+static void ops_halo_aggregate_end() {
+  ops_halo_plan *plan = ops_halo_plan_inflight;
+  ops_halo_plan_inflight = NULL;
+  if (plan == NULL || plan->dats.size() == 0 ||
+      (int)plan->dirs.size() == plan->nwrap)
+    return;
+  int nmsg = plan->dirs.size() - plan->nwrap;
+
+  for (int i = 0; i < nmsg; i++) {
+    int m;
+    MPI_Status status;
+    MPI_Waitany(nmsg, &plan->requests[0], &m, &status);
+    ops_halo_aggregate_unpack(plan, plan->dirs[m],
+                              ops_buffer_recv_1 + plan->recv_offsets[m]);
+  }
+
+  std::vector<MPI_Status> status(nmsg);
+  MPI_Waitall(nmsg, &plan->requests[nmsg], &status[0]);
+}
+
+void ops_halo_exchanges(ops_arg* args, int nargs, int *range_in) {
+  if (OPS_instance::getOPSInstance()->ops_halo_aggregate &&
+      ops_halo_aggregate_begin(args, nargs, range_in)) {
+    ops_halo_aggregate_end();
+    return;
+  }
+  for (int dim = 0; dim < OPS_MAX_DIM; dim++)
+    ops_halo_exchange_dim(args, nargs, range_in, dim);
+}
+
+/*
+ * Communication thread (OPS_COMM_THREAD): tasks are queued to a thread of
+ * their own, which runs them in order with a single OpenMP thread, so that
+ * the halo exchanges of a loop and the deferred reductions progress while
+ * the other threads run kernels. Tickets count the tasks submitted, a task
+ * is complete once as many tasks as its ticket have completed.
+ */
+struct ops_comm_thread_state {
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::deque<std::function<void()> > tasks;
+  long submitted, completed;
+  bool running, stop;
+  std::exception_ptr error; // first exception thrown by a task
+  int omp_threads;          // OpenMP threads of the main thread before
+};
+static ops_comm_thread_state ops_comm;
+
+static void ops_comm_thread_main() {
+#ifdef _OPENMP
+  omp_set_num_threads(1);
+#endif
+  std::unique_lock<std::mutex> lock(ops_comm.mutex);
+  while (true) {
+    ops_comm.cond.wait(lock, [] { return ops_comm.stop || !ops_comm.tasks.empty(); });
+    if (ops_comm.tasks.empty())
+      return;
+    std::function<void()> task = ops_comm.tasks.front();
+    ops_comm.tasks.pop_front();
+    lock.unlock();
+    std::exception_ptr error;
+    try {
+      task();
+    } catch (...) {
+      error = std::current_exception();
+    }
+    lock.lock();
+    if (error && !ops_comm.error)
+      ops_comm.error = error;
+    ops_comm.completed++;
+    ops_comm.cond.notify_all();
+  }
+}
+
+// Queues a task, starting the thread if needed, and returns its ticket
+static long ops_comm_thread_submit(std::function<void()> task) {
+  std::lock_guard<std::mutex> lock(ops_comm.mutex);
+  if (!ops_comm.running) {
+    ops_comm.stop = false;
+    ops_comm.thread = std::thread(ops_comm_thread_main);
+    ops_comm.running = true;
+#ifdef _OPENMP
+    // the thread takes a core of its own, the others run the kernels
+    ops_comm.omp_threads = omp_get_max_threads();
+    if (ops_comm.omp_threads > 1)
+      omp_set_num_threads(ops_comm.omp_threads - 1);
+#endif
+  }
+  ops_comm.tasks.push_back(task);
+  ops_comm.cond.notify_all();
+  return ++ops_comm.submitted;
+}
+
+// Waits for the task with the given ticket, rethrowing any exception
+static void ops_comm_thread_wait(long ticket) {
+  std::unique_lock<std::mutex> lock(ops_comm.mutex);
+  ops_comm.cond.wait(lock, [ticket] { return ops_comm.completed >= ticket; });
+  if (ops_comm.error) {
+    std::exception_ptr error = ops_comm.error;
+    ops_comm.error = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+void ops_comm_thread_stop() {
+  {
+    std::lock_guard<std::mutex> lock(ops_comm.mutex);
+    if (!ops_comm.running)
+      return;
+    ops_comm.stop = true;
+    ops_comm.cond.notify_all();
+  }
+  ops_comm.thread.join();
+  ops_comm.running = false;
+#ifdef _OPENMP
+  omp_set_num_threads(ops_comm.omp_threads);
+#endif
+}
+
+/*
+ * Overlapped halo exchanges: ops_halo_exchanges_begin packs and posts the
+ * messages of as many dimensions as can be in flight at the same time, and
+ * ops_halo_exchanges_end completes them and exchanges the remaining
+ * dimensions one by one. Halos of a dataset exchanged in more than one
+ * dimension have to be exchanged one dimension after the other, so that
+ * the corners are carried over correctly, therefore a dimension is only
+ * added to the messages in flight if none of its datasets are already
+ * being exchanged in an earlier dimension. With aggregated exchanges, all
+ * dimensions are in flight at the same time.
+ */
+struct ops_halo_exchange_inflight {
+  int ndims;                          // number of dimensions in flight
+  int dims[OPS_MAX_DIM];              // dimensions in flight
+  int offsets[OPS_MAX_DIM + 1][4];    // packed data offsets for each of them
+  int next_dim;                       // first dimension not yet exchanged
+  int aggregated;                     // messages are aggregated over all dims
+  long ticket;                        // exchange on the communication thread
+  MPI_Request requests[4 * OPS_MAX_DIM];
+};
+static ops_halo_exchange_inflight ops_inflight;
+
+// Depth of the region next to each face that depends on halo data
+static void ops_halo_exchanges_depths(ops_arg *args, int nargs,
+                                      int *halo_depths) {
+  for (int d = 0; d < 2 * OPS_MAX_DIM; d++)
+    halo_depths[d] = 0;
+  for (int i = 0; i < nargs; i++) {
+    for (int dim = 0; dim < OPS_MAX_DIM; dim++) {
+      if (!ops_halo_arg_exchanged(&args[i], dim))
+        continue;
+      sub_block_list sb = OPS_sub_block_list[args[i].dat->block->index];
+      int d_pos = 0, d_neg = 0;
+      ops_halo_arg_depths(&args[i], sb->ndim, dim, &d_pos, &d_neg);
+      if (sb->id_m[dim] != MPI_PROC_NULL)
+        halo_depths[2 * dim] = MAX(halo_depths[2 * dim], -d_neg);
+      if (sb->id_p[dim] != MPI_PROC_NULL)
+        halo_depths[2 * dim + 1] = MAX(halo_depths[2 * dim + 1], d_pos);
+    }
+  }
+}
+
+// Runs all of the exchanges on the communication thread
+static int ops_halo_exchanges_thread_begin(ops_arg *args, int nargs,
+                                           int *range_in, int *halo_depths) {
+  int dirty = 0;
+  for (int i = 0; i < nargs; i++) {
+    // Multigrid stencils map to different ranges, exchange those synchronously
+    if (args[i].argtype == OPS_ARG_DAT && args[i].opt == 1 &&
+        args[i].stencil->type != 0) {
+      ops_halo_exchanges(args, nargs, range_in);
+      return 0;
+    }
+    for (int dim = 0; dim < OPS_MAX_DIM; dim++) {
+      if (!ops_halo_arg_exchanged(&args[i], dim))
+        continue;
+      sub_dat_list sd = OPS_sub_dat_list[args[i].dat->index];
+      for (int d = 0; d < 2 * MAX_DEPTH; d++)
+        dirty = dirty || sd->dirty_dir_send[2 * MAX_DEPTH * dim + d] ||
+                         sd->dirty_dir_recv[2 * MAX_DEPTH * dim + d];
+    }
+  }
+  if (!dirty)
+    return 0;
+  ops_halo_exchanges_depths(args, nargs, halo_depths);
+  ops_inflight.ticket = ops_comm_thread_submit(
+      [args, nargs, range_in]() { ops_halo_exchanges(args, nargs, range_in); });
+  return 1;
+}
+
+int ops_halo_exchanges_begin(ops_arg *args, int nargs, int *range_in,
+                             int *halo_depths) {
+  if (OPS_instance::getOPSInstance()->ops_comm_thread)
+    return ops_halo_exchanges_thread_begin(args, nargs, range_in, halo_depths);
+  if (OPS_instance::getOPSInstance()->ops_halo_aggregate &&
+      ops_halo_aggregate_begin(args, nargs, range_in)) {
+    if (!ops_halo_aggregate_inflight()) {
+      ops_halo_aggregate_end();
+      return 0;
+    }
+    ops_inflight.aggregated = 1;
+    ops_halo_exchanges_depths(args, nargs, halo_depths);
+    return 1;
+  }
+
+  // Multigrid stencils map to different ranges, exchange those synchronously
+  for (int i = 0; i < nargs; i++) {
+    if (args[i].argtype == OPS_ARG_DAT && args[i].opt == 1 &&
+        args[i].stencil->type != 0) {
+      ops_halo_exchanges(args, nargs, range_in);
+      return 0;
+    }
+  }
+
+  std::vector<char> dat_inflight(OPS_instance::getOPSInstance()->OPS_dat_index, 0);
+  ops_inflight.ndims = 0;
+  ops_inflight.next_dim = OPS_MAX_DIM;
+  for (int i = 0; i < 4; i++)
+    ops_inflight.offsets[0][i] = 0;
+  MPI_Comm comm[OPS_MAX_DIM];
+  int id_m[OPS_MAX_DIM], id_p[OPS_MAX_DIM];
+
+  for (int dim = 0; dim < OPS_MAX_DIM; dim++) {
+    // Find datasets that are dirty in this dimension
+    int conflict = 0;
+    std::vector<int> dats_dirty;
     for (int i = 0; i < nargs; i++) {
-      if (args[i].argtype != OPS_ARG_DAT ||
-          !(args[i].acc == OPS_READ || args[i].acc == OPS_RW) ||
-          args[i].opt == 0)
+      if (!ops_halo_arg_exchanged(&args[i], dim))
         continue;
       ops_dat dat = args[i].dat;
-      int dat_ndim = OPS_sub_block_list[dat->block->index]->ndim;
-      if (dat_ndim <= dim || dat->size[dim] <= 1)
+      sub_dat_list sd = OPS_sub_dat_list[dat->index];
+      int dirty = 0;
+      for (int d = 0; d < 2 * MAX_DEPTH; d++)
+        dirty = dirty || sd->dirty_dir_send[2 * MAX_DEPTH * dim + d] ||
+                         sd->dirty_dir_recv[2 * MAX_DEPTH * dim + d];
+      if (!dirty)
         continue;
+      if (dat_inflight[dat->index])
+        conflict = 1;
+      dats_dirty.push_back(dat->index);
+    }
+    if (conflict) {
+      ops_inflight.next_dim = dim;
+      break;
+    }
+    for (unsigned int i = 0; i < dats_dirty.size(); i++)
+      dat_inflight[dats_dirty[i]] = 1;
 
-      int range[2*OPS_MAX_DIM];
-      for (int d2 = 0; d2 < dat_ndim; d2++) {
-        if (args[i].stencil->type ==1) {
-          range[2*d2+0] = range_in[2*d2+0]/args[i].stencil->mgrid_stride[d2];
-          range[2*d2+1] = (range_in[2*d2+1]-1)/args[i].stencil->mgrid_stride[d2]+1;
-        } else if (args[i].stencil->type ==2) {
-          range[2*d2+0] = range_in[2*d2+0]*args[i].stencil->mgrid_stride[d2];
-          range[2*d2+1] = range_in[2*d2+1]*args[i].stencil->mgrid_stride[d2];
-        } else {
-          range[2*d2+0] = range_in[2*d2+0];
-          range[2*d2+1] = range_in[2*d2+1];
-        }
-      }
+    int n = ops_inflight.ndims;
+    int send_recv_offsets[4];
+    for (int i = 0; i < 4; i++)
+      send_recv_offsets[i] = ops_inflight.offsets[n][i];
+    if (!ops_halo_exchanges_pack(args, nargs, range_in, dim,
+                                 send_recv_offsets, &comm[n], &id_m[n],
+                                 &id_p[n]))
+      continue;
+    if (send_recv_offsets[0] == ops_inflight.offsets[n][0] &&
+        send_recv_offsets[1] == ops_inflight.offsets[n][1] &&
+        send_recv_offsets[2] == ops_inflight.offsets[n][2] &&
+        send_recv_offsets[3] == ops_inflight.offsets[n][3] &&
+        !ops_halo_shared_any(dim))
+      continue;
+    ops_inflight.dims[n] = dim;
+    for (int i = 0; i < 4; i++)
+      ops_inflight.offsets[n + 1][i] = send_recv_offsets[i];
+    ops_inflight.ndims++;
+  }
 
-      int d_pos=0,d_neg=0;
-      for (int p = 0; p < args[i].stencil->points; p++) {
-        d_pos = MAX(d_pos, args[i].stencil->stencil[dat_ndim * p + dim]);
-        d_neg = MIN(d_neg, args[i].stencil->stencil[dat_ndim * p + dim]);
-      }
-      if (args[i].stencil->type == 1) d_neg--;
-      if (d_pos > 0 || d_neg < 0)
-        ops_exchange_halo_unpacker(dat, d_pos, d_neg, range, dim,
-                                   send_recv_offsets);
-    }
+  // Post messages once all the packing is done, as packing may reallocate
+  // the buffers
+  for (int n = 0; n < ops_inflight.ndims; n++) {
+    ops_halo_exchanges_post(ops_inflight.dims[n], ops_inflight.offsets[n],
+                            ops_inflight.offsets[n + 1], comm[n], id_m[n],
+                            id_p[n], &ops_inflight.requests[4 * n]);
+    if (ops_halo_shared_any(ops_inflight.dims[n]))
+      ops_halo_shared_signal(ops_inflight.dims[n], OPS_HALO_SHARED_READY);
+  }
 
-    MPI_Waitall(2, &request[0], &status[0]);
-    //  ops_timers_core(&c2,&t2);
-    //  ops_scatter_time += t2-t1;
+  if (ops_inflight.ndims == 0 && ops_inflight.next_dim == OPS_MAX_DIM)
+    return 0;
+
+  ops_halo_exchanges_depths(args, nargs, halo_depths);
+  return 1;
+}
+
+void ops_halo_exchanges_end(ops_arg *args, int nargs, int *range_in) {
+  if (ops_inflight.ticket) {
+    long ticket = ops_inflight.ticket;
+    ops_inflight.ticket = 0;
+    ops_comm_thread_wait(ticket);
+    return;
+  }
+  if (ops_inflight.aggregated) {
+    ops_halo_aggregate_end();
+    ops_inflight.aggregated = 0;
+    return;
   }
+
+  MPI_Status status[4 * OPS_MAX_DIM];
+  for (int n = 0; n < ops_inflight.ndims; n++) {
+    if (ops_halo_shared_any(ops_inflight.dims[n]))
+      ops_halo_shared_wait(ops_inflight.dims[n], OPS_HALO_SHARED_READY);
+    MPI_Waitall(2, &ops_inflight.requests[4 * n + 2], &status[4 * n + 2]);
+  }
+
+  for (int n = 0; n < ops_inflight.ndims; n++) {
+    int send_recv_offsets[4];
+    for (int i = 0; i < 4; i++)
+      send_recv_offsets[i] = ops_inflight.offsets[n][i];
+    ops_halo_exchanges_unpack(args, nargs, range_in, ops_inflight.dims[n],
+                              send_recv_offsets);
+  }
+  for (int n = 0; n < ops_inflight.ndims; n++)
+    if (ops_halo_shared_any(ops_inflight.dims[n]))
+      ops_halo_shared_signal(ops_inflight.dims[n], OPS_HALO_SHARED_DONE);
+  for (int n = 0; n < ops_inflight.ndims; n++)
+    if (ops_halo_shared_any(ops_inflight.dims[n]))
+      ops_halo_shared_wait(ops_inflight.dims[n], OPS_HALO_SHARED_DONE);
+
+  for (int n = 0; n < ops_inflight.ndims; n++)
+    MPI_Waitall(2, &ops_inflight.requests[4 * n], &status[4 * n]);
+  ops_inflight.ndims = 0;
+
+  for (int dim = ops_inflight.next_dim; dim < OPS_MAX_DIM; dim++)
+    ops_halo_exchange_dim(args, nargs, range_in, dim);
+  ops_inflight.next_dim = OPS_MAX_DIM;
 }
 
 void ops_halo_exchanges_datlist(ops_dat *dats, int ndats, int *depths) {
@@ -1020,7 +2116,7 @@ ops_reduce_gen(complexf, MPI_C_FLOAT_COMPLEX, complexf(0.0f,0.0f))
     ops_mpi_reduce_##type (&arg, local.data()); \
     memcpy(handle->data, local.data(), handle->size);
 
-void ops_execute_reduction(ops_reduction handle) {
+static void ops_execute_reduction_blocking(ops_reduction handle) {
   if (strcmp(handle->type, "int") == 0 || strcmp(handle->type, "int(4)") == 0 ||
       strcmp(handle->type, "integer(4)") == 0 ||
       strcmp(handle->type, "integer") == 0) {
@@ -1065,6 +2161,179 @@ void ops_execute_reduction(ops_reduction handle) {
 
 }
 
+/*
+ * Deferred reductions: ops_reduction_result_deferred only records where the
+ * result is to be delivered. The pending results are started together when
+ * the next loop is queued, or when one of them is needed: each is combined
+ * across the blocks owned by the process, and they are packed into a single
+ * MPI_Iallreduce per datatype and operation. The result is only waited for
+ * when the handle is waited on, or used in a loop again.
+ */
+struct ops_reduction_batch {
+  MPI_Request request;
+  std::vector<char> send, recv;
+  MPI_Datatype type;
+  MPI_Op op;
+  int pending; // results not yet delivered
+  long ticket; // waited for on the communication thread, or 0
+};
+
+struct ops_reduction_request {
+  ops_reduction handle;
+  char *ptr;                  // where the result goes, may be NULL
+  ops_reduction_batch *batch; // NULL until started
+  size_t offset;              // offset of the result in the batch
+};
+static std::vector<ops_reduction_request> ops_reduction_requests;
+
+// Combines the partial results of the blocks owned by this process
+template <typename T>
+static void ops_reduction_local(ops_reduction handle, char *out) {
+  int n = handle->size / sizeof(T);
+  T *local = (T *)out;
+  memcpy(local, handle->data, handle->size);
+  for (int i = 1; i < OPS_instance::getOPSInstance()->OPS_block_index; i++) {
+    if (!OPS_sub_block_list[i]->owned)
+      continue;
+    T *block = (T *)(handle->data + i * handle->size);
+    for (int d = 0; d < n; d++) {
+      if (handle->acc == OPS_MAX) local[d] = MAX(local[d], block[d]);
+      if (handle->acc == OPS_MIN) local[d] = MIN(local[d], block[d]);
+      if (handle->acc == OPS_INC) local[d] += block[d];
+    }
+  }
+}
+
+static MPI_Datatype ops_reduction_mpi_type(ops_reduction handle) {
+  if (strcmp(handle->type, "double") == 0 ||
+      strcmp(handle->type, "real(8)") == 0 ||
+      strcmp(handle->type, "double precision") == 0)
+    return MPI_DOUBLE;
+  if (strcmp(handle->type, "float") == 0 || strcmp(handle->type, "real") == 0)
+    return MPI_FLOAT;
+  if (strcmp(handle->type, "int") == 0 || strcmp(handle->type, "int(4)") == 0 ||
+      strcmp(handle->type, "integer(4)") == 0 ||
+      strcmp(handle->type, "integer") == 0)
+    return MPI_INT;
+  return MPI_DATATYPE_NULL;
+}
+
+void ops_reduction_defer(ops_reduction handle, char *ptr) {
+  ops_reduction_request request = {handle, ptr, NULL, 0};
+  ops_reduction_requests.push_back(request);
+}
+
+void ops_reductions_start(OPS_instance *instance) {
+  unsigned int r = 0;
+  while (r < ops_reduction_requests.size() && ops_reduction_requests[r].batch != NULL)
+    r++;
+  if (r == ops_reduction_requests.size()) return;
+
+  // Loops contributing to the results may still be queued
+  ops_execute(instance);
+
+  std::vector<ops_reduction_batch *> batches;
+  while (r < ops_reduction_requests.size()) {
+    ops_reduction_request &request = ops_reduction_requests[r];
+    ops_reduction handle = request.handle;
+    if (request.batch != NULL) { r++; continue; }
+    MPI_Datatype type = ops_reduction_mpi_type(handle);
+    MPI_Op op = handle->acc == OPS_INC ? MPI_SUM :
+                handle->acc == OPS_MAX ? MPI_MAX :
+                handle->acc == OPS_MIN ? MPI_MIN : MPI_OP_NULL;
+    if (type == MPI_DATATYPE_NULL || op == MPI_OP_NULL) {
+      // Other types and OPS_WRITE reductions are not batched
+      ops_execute_reduction_blocking(handle);
+      if (request.ptr) memcpy(request.ptr, handle->data, handle->size);
+      ops_reduction_requests.erase(ops_reduction_requests.begin() + r);
+      continue;
+    }
+    ops_reduction_batch *batch = NULL;
+    for (unsigned int b = 0; b < batches.size(); b++)
+      if (batches[b]->type == type && batches[b]->op == op) batch = batches[b];
+    if (batch == NULL) {
+      batch = new ops_reduction_batch();
+      batch->type = type;
+      batch->op = op;
+      batch->pending = 0;
+      batch->ticket = 0;
+      batches.push_back(batch);
+    }
+    request.batch = batch;
+    request.offset = batch->send.size();
+    batch->send.resize(request.offset + handle->size);
+    if (type == MPI_DOUBLE) ops_reduction_local<double>(handle, &batch->send[request.offset]);
+    else if (type == MPI_FLOAT) ops_reduction_local<float>(handle, &batch->send[request.offset]);
+    else ops_reduction_local<int>(handle, &batch->send[request.offset]);
+    batch->pending++;
+    r++;
+  }
+
+  for (unsigned int b = 0; b < batches.size(); b++) {
+    ops_reduction_batch *batch = batches[b];
+    int type_size;
+    MPI_Type_size(batch->type, &type_size);
+    batch->recv.resize(batch->send.size());
+    MPI_Iallreduce(batch->send.data(), batch->recv.data(),
+                   (int)(batch->send.size() / type_size), batch->type,
+                   batch->op, OPS_MPI_GLOBAL, &batch->request);
+    if (instance->ops_comm_thread)
+      batch->ticket = ops_comm_thread_submit(
+          [batch]() { MPI_Wait(&batch->request, MPI_STATUS_IGNORE); });
+  }
+}
+
+// Waits for the reduction of a batch to complete
+static void ops_reduction_batch_wait(ops_reduction_batch *batch) {
+  if (batch->ticket)
+    ops_comm_thread_wait(batch->ticket);
+  else
+    MPI_Wait(&batch->request, MPI_STATUS_IGNORE);
+}
+
+void ops_reduction_wait(ops_reduction handle) {
+  unsigned int r = 0;
+  while (r < ops_reduction_requests.size() && ops_reduction_requests[r].handle != handle)
+    r++;
+  if (r == ops_reduction_requests.size()) return;
+  if (ops_reduction_requests[r].batch == NULL) {
+    ops_reductions_start(handle->instance);
+    r = 0;
+    while (r < ops_reduction_requests.size() && ops_reduction_requests[r].handle != handle)
+      r++;
+    if (r == ops_reduction_requests.size()) return; // delivered while starting
+  }
+  ops_reduction_request request = ops_reduction_requests[r];
+  ops_reduction_requests.erase(ops_reduction_requests.begin() + r);
+  ops_reduction_batch *batch = request.batch;
+  ops_reduction_batch_wait(batch);
+  memcpy(handle->data, &batch->recv[request.offset], handle->size);
+  if (request.ptr) memcpy(request.ptr, handle->data, handle->size);
+  if (--batch->pending == 0) delete batch;
+}
+
+void ops_execute_reduction(ops_reduction handle) {
+  // Reduce together with any deferred results that have not been started
+  for (unsigned int r = 0; r < ops_reduction_requests.size(); r++) {
+    if (ops_reduction_requests[r].batch == NULL) {
+      ops_reduction_defer(handle, NULL);
+      ops_reduction_wait(handle);
+      return;
+    }
+  }
+  ops_execute_reduction_blocking(handle);
+}
+
+void ops_reductions_free() {
+  for (unsigned int r = 0; r < ops_reduction_requests.size(); r++) {
+    ops_reduction_batch *batch = ops_reduction_requests[r].batch;
+    if (batch == NULL) continue;
+    ops_reduction_batch_wait(batch);
+    if (--batch->pending == 0) delete batch;
+  }
+  ops_reduction_requests.clear();
+}
+
 void ops_set_halo_dirtybit(ops_arg *arg) {
   if (arg->opt == 0)
     return;
@@ -1087,12 +2356,16 @@ void ops_set_halo_dirtybit3(ops_arg *arg, int *iter_range) {
   int left_halo_modified[OPS_MAX_DIM] = {0};
   int right_boundary_modified[OPS_MAX_DIM] = {0};
   int right_halo_modified[OPS_MAX_DIM] = {0};
+  // start of my range and end of my range, as seen by my neighbors
+  int wrap_begin[OPS_MAX_DIM] = {0};
+  int wrap_end[OPS_MAX_DIM] = {0};
 
   int range_intersect[OPS_MAX_DIM] = {0};
 
   int ndim = sb->ndim;
 
   for (int dim = 0; dim < ndim; dim++) {
+    ops_dat_wrapped_range(dat, dim, &wrap_begin[dim], &wrap_end[dim]);
     range_intersect[dim] = intersection(
         iter_range[2 * dim], iter_range[2 * dim + 1], sd->decomp_disp[dim],
         (sd->decomp_disp[dim] + sd->decomp_size[dim])); // i.e. the intersection
@@ -1107,8 +2380,8 @@ void ops_set_halo_dirtybit3(ops_arg *arg, int *iter_range) {
                                                // boundary
     right_halo_modified[dim] =
         intersection(iter_range[2 * dim], iter_range[2 * dim + 1],
-                     (sd->decomp_disp[dim] + sd->decomp_size[dim]),
-                     (sd->decomp_disp[dim] + sd->decomp_size[dim]) + MAX_DEPTH -
+                     wrap_end[dim],
+                     wrap_end[dim] + MAX_DEPTH -
                          1); // i.e. the intersection of the execution range
                              // with the my right neighbour's boundary
     right_boundary_modified[dim] = intersection(
@@ -1117,7 +2390,7 @@ void ops_set_halo_dirtybit3(ops_arg *arg, int *iter_range) {
         (sd->decomp_disp[dim] + sd->decomp_size[dim]));
     left_halo_modified[dim] = intersection(
         iter_range[2 * dim], iter_range[2 * dim + 1],
-        sd->decomp_disp[dim] - MAX_DEPTH + 1, sd->decomp_disp[dim]);
+        wrap_begin[dim] - MAX_DEPTH + 1, wrap_begin[dim]);
   }
 
   sd->dirtybit = 1;
@@ -1140,8 +2413,8 @@ void ops_set_halo_dirtybit3(ops_arg *arg, int *iter_range) {
     }
     if (left_halo_modified[dim] > 0 && other_dims) {
       int beg =
-          iter_range[2 * dim] >= sd->decomp_disp[dim] - MAX_DEPTH + 1
-              ? iter_range[2 * dim] - (sd->decomp_disp[dim] - MAX_DEPTH + 1)
+          iter_range[2 * dim] >= wrap_begin[dim] - MAX_DEPTH + 1
+              ? iter_range[2 * dim] - (wrap_begin[dim] - MAX_DEPTH + 1)
               : 0;
       for (int d2 = beg; d2 < beg + left_halo_modified[dim]; d2++) {
         sd->dirty_dir_recv[2 * MAX_DEPTH * dim + MAX_DEPTH - d2 - 1] = 1;
@@ -1160,10 +2433,8 @@ void ops_set_halo_dirtybit3(ops_arg *arg, int *iter_range) {
       }
     }
     if (right_halo_modified[dim] > 0 && other_dims) {
-      int beg = 1 + (iter_range[2 * dim] >=
-                             (sd->decomp_disp[dim] + sd->decomp_size[dim])
-                         ? iter_range[2 * dim] -
-                               (sd->decomp_disp[dim] + sd->decomp_size[dim])
+      int beg = 1 + (iter_range[2 * dim] >= wrap_end[dim]
+                         ? iter_range[2 * dim] - wrap_end[dim]
                          : 0);
       for (int d2 = beg; d2 < beg + right_halo_modified[dim]; d2++) {
         sd->dirty_dir_recv[2 * MAX_DEPTH * dim + MAX_DEPTH + d2] = 1;
@@ -1172,6 +2443,156 @@ void ops_set_halo_dirtybit3(ops_arg *arg, int *iter_range) {
   }
 }
 
+// A fragment of an inter-block halo, in the index space of the local dataset
+struct ops_halo_group_fragment {
+  ops_dat dat;
+  int halo;      // position of the halo in the group
+  size_t offset; // byte offset of the fragment in the send or receive buffer
+  int ranges[OPS_MAX_DIM * 2];
+  int step[OPS_MAX_DIM];
+  int buf_strides[OPS_MAX_DIM];
+};
+
+// Cached transfer of one halo group: the fragments of each neighbour, the
+// buffers they are packed into and persistent requests on those buffers
+struct ops_halo_group_plan {
+  std::vector<ops_halo_group_fragment> send; // grouped by send neighbour
+  std::vector<ops_halo_group_fragment> recv; // in the order of the halos
+  std::vector<int> send_first;      // first fragment of each neighbour, and end
+  std::vector<size_t> recv_offsets; // offset of each message in the buffer
+  char *send_buffer;
+  char *recv_buffer;
+  std::vector<MPI_Request> requests; // receives first, then sends
+};
+static std::vector<ops_halo_group_plan *> ops_halo_group_plans;
+
+// Computes the ranges of fragment f of a halo in the source (from) or
+// target dataset, returns its size in bytes
+static size_t ops_halo_group_fragment_init(ops_halo_group_fragment *frag,
+                                           ops_mpi_halo *halo, int f,
+                                           int from) {
+  ops_dat dat = from ? halo->halo->from : halo->halo->to;
+  int *dir = from ? halo->halo->from_dir : halo->halo->to_dir;
+  int *base = from ? halo->local_from_base : halo->local_to_base;
+  int *iter_size = &halo->local_iter_size[f * OPS_MAX_DIM];
+  sub_dat *sd = OPS_sub_dat_list[dat->index];
+  size_t size = dat->elem_size;
+  frag->dat = dat;
+  for (int i = 0; i < OPS_MAX_DIM; i++) {
+    // Need to account for intra-block halo padding
+    if (dir[i] > 0) {
+      frag->ranges[2 * i] = base[f * OPS_MAX_DIM + i] - sd->d_im[i];
+      frag->ranges[2 * i + 1] =
+          frag->ranges[2 * i] + iter_size[abs(dir[i]) - 1];
+      frag->step[i] = 1;
+    } else {
+      frag->ranges[2 * i + 1] = base[f * OPS_MAX_DIM + i] - 1 - sd->d_im[i];
+      frag->ranges[2 * i] =
+          frag->ranges[2 * i + 1] + iter_size[abs(dir[i]) - 1];
+      frag->step[i] = -1;
+    }
+    frag->buf_strides[i] = 1;
+    for (int j = 0; j != abs(dir[i]) - 1; j++)
+      frag->buf_strides[i] *= iter_size[j];
+    size *= iter_size[i];
+  }
+  return size;
+}
+
+// Collects the fragments of the halos in a group by neighbour, so that the
+// message of each neighbour is contiguous in the buffer
+static void ops_halo_group_fragments(ops_mpi_halo_group *mpi_group, int from,
+                                     std::vector<ops_halo_group_fragment> &frags,
+                                     std::vector<int> &first,
+                                     char **buffer) {
+  int nneigh = from ? mpi_group->num_neighbors_send
+                    : mpi_group->num_neighbors_recv;
+  int *neighbors = from ? mpi_group->neighbors_send : mpi_group->neighbors_recv;
+  size_t offset = 0;
+  first.push_back(0);
+  for (int n = 0; n < nneigh; n++) {
+    for (int h = 0; h < mpi_group->nhalos; h++) {
+      ops_mpi_halo *halo = mpi_group->mpi_halos[h];
+      int f_beg = from ? 0 : halo->nproc_from;
+      int f_end = from ? halo->nproc_from : halo->nproc_from + halo->nproc_to;
+      for (int f = f_beg; f < f_end; f++) {
+        if (halo->proclist[f] != neighbors[n])
+          continue;
+        ops_halo_group_fragment frag;
+        frag.halo = h;
+        frag.offset = offset;
+        offset += ops_halo_group_fragment_init(&frag, halo, f, from);
+        frags.push_back(frag);
+      }
+    }
+    first.push_back(frags.size());
+  }
+  *buffer = OPS_realloc_fast(NULL, 0, MAX(offset, (size_t)1));
+}
+
+static ops_halo_group_plan *ops_halo_group_plan_get(ops_halo_group group) {
+  ops_mpi_halo_group *mpi_group = &OPS_mpi_halo_group_list[group->index];
+  if (ops_halo_group_plans.size() <= (size_t)group->index)
+    ops_halo_group_plans.resize(group->index + 1, NULL);
+  ops_halo_group_plan *plan = ops_halo_group_plans[group->index];
+  if (plan != NULL)
+    return plan;
+
+  plan = new ops_halo_group_plan;
+  std::vector<int> recv_first;
+  ops_halo_group_fragments(mpi_group, 0, plan->recv, recv_first,
+                           &plan->recv_buffer);
+  for (unsigned int n = 0; n + 1 < recv_first.size(); n++)
+    plan->recv_offsets.push_back(plan->recv[recv_first[n]].offset);
+  // halos may overlap, so they are unpacked in the order they were declared
+  std::stable_sort(plan->recv.begin(), plan->recv.end(),
+                   [](const ops_halo_group_fragment &a,
+                      const ops_halo_group_fragment &b) {
+                     return a.halo < b.halo;
+                   });
+  ops_halo_group_fragments(mpi_group, 1, plan->send, plan->send_first,
+                           &plan->send_buffer);
+  int nrecv = mpi_group->num_neighbors_recv;
+  int nsend = mpi_group->num_neighbors_send;
+  plan->requests.resize(nrecv + nsend);
+  for (int n = 0; n < nrecv; n++)
+    MPI_Recv_init(plan->recv_buffer + plan->recv_offsets[n],
+                  mpi_group->recv_sizes[n], MPI_BYTE,
+                  mpi_group->neighbors_recv[n], 100 + mpi_group->index,
+                  OPS_MPI_GLOBAL, &plan->requests[n]);
+  for (int n = 0; n < nsend; n++)
+    MPI_Send_init(plan->send_buffer + plan->send[plan->send_first[n]].offset,
+                  mpi_group->send_sizes[n], MPI_BYTE,
+                  mpi_group->neighbors_send[n], 100 + mpi_group->index,
+                  OPS_MPI_GLOBAL, &plan->requests[nrecv + n]);
+  ops_halo_group_plans[group->index] = plan;
+  return plan;
+}
+
+static void ops_halo_group_buffer_free(OPS_instance *instance, char **buffer) {
+  if (instance->OPS_hybrid_gpu && instance->OPS_gpu_direct)
+    ops_device_free(instance, (void **)buffer);
+  else if (instance->OPS_hybrid_gpu)
+    ops_device_freehost(instance, (void **)buffer);
+  else
+    ops_free(*buffer);
+}
+
+void ops_halo_group_plans_free() {
+  OPS_instance *instance = OPS_instance::getOPSInstance();
+  for (unsigned int p = 0; p < ops_halo_group_plans.size(); p++) {
+    ops_halo_group_plan *plan = ops_halo_group_plans[p];
+    if (plan == NULL)
+      continue;
+    for (unsigned int i = 0; i < plan->requests.size(); i++)
+      MPI_Request_free(&plan->requests[i]);
+    ops_halo_group_buffer_free(instance, &plan->send_buffer);
+    ops_halo_group_buffer_free(instance, &plan->recv_buffer);
+    delete plan;
+  }
+  ops_halo_group_plans.clear();
+}
+
 void ops_halo_transfer(ops_halo_group group) {
   ops_execute(group->instance);
   ops_mpi_halo_group *mpi_group = &OPS_mpi_halo_group_list[group->index];
@@ -1180,133 +2601,46 @@ void ops_halo_transfer(ops_halo_group group) {
 
   double c, t1, t2;
   ops_timers_core(&c, &t1);
-  // Reset offset counters
-  mpi_neigh_size[0] = 0;
-  for (int i = 1; i < mpi_group->num_neighbors_send; i++)
-    mpi_neigh_size[i] = mpi_neigh_size[i - 1] + mpi_group->send_sizes[i - 1];
-
-  // Loop over all the halos we own in the group
-  for (int h = 0; h < mpi_group->nhalos; h++) {
-    ops_mpi_halo *halo = mpi_group->mpi_halos[h];
-    sub_dat *sd = OPS_sub_dat_list[halo->halo->from->index];
-
-    // Loop over all the send fragments and pack into buffer
-    for (int f = 0; f < halo->nproc_from; f++) {
-      int ranges[OPS_MAX_DIM * 2];
-      int step[OPS_MAX_DIM];
-      int buf_strides[OPS_MAX_DIM];
-      int fragment_size = halo->halo->from->elem_size;
-      for (int i = 0; i < OPS_MAX_DIM; i++) {
-        if (halo->halo->from_dir[i] > 0) {
-          ranges[2 * i] =
-              halo->local_from_base[f * OPS_MAX_DIM + i] -
-              sd->d_im[i]; // Need to account for intra-block halo padding
-          ranges[2 * i + 1] =
-              ranges[2 * i] +
-              halo->local_iter_size[f * OPS_MAX_DIM +
-                                    abs(halo->halo->from_dir[i]) - 1];
-          step[i] = 1;
-        } else {
-          ranges[2 * i + 1] =
-              halo->local_from_base[f * OPS_MAX_DIM + i] - 1 - sd->d_im[i];
-          ranges[2 * i] =
-              ranges[2 * i + 1] +
-              halo->local_iter_size[f * OPS_MAX_DIM +
-                                    abs(halo->halo->from_dir[i]) - 1];
-          step[i] = -1;
-        }
-        buf_strides[i] = 1;
-        for (int j = 0; j != abs(halo->halo->from_dir[i]) - 1; j++)
-          buf_strides[i] *= halo->local_iter_size[f * OPS_MAX_DIM + j];
-        fragment_size *= halo->local_iter_size[f * OPS_MAX_DIM + i];
-      }
-      int process = halo->proclist[f];
-      int proc_grp_idx = 0;
-      while (process != mpi_group->neighbors_send[proc_grp_idx])
-        proc_grp_idx++;
-      ops_halo_copy_tobuf(ops_buffer_send_1, mpi_neigh_size[proc_grp_idx],
-                          halo->halo->from, ranges[0], ranges[1], ranges[2],
-                          ranges[3], ranges[4], ranges[5], step[0], step[1],
-                          step[2], buf_strides[0], buf_strides[1],
-                          buf_strides[2]);
-      mpi_neigh_size[proc_grp_idx] += fragment_size;
+  ops_halo_group_plan *plan = ops_halo_group_plan_get(group);
+  int nrecv = mpi_group->num_neighbors_recv;
+  int nsend = mpi_group->num_neighbors_send;
+
+  // Receives are posted first, each send as soon as its message is packed
+  if (nrecv > 0)
+    MPI_Startall(nrecv, &plan->requests[0]);
+  for (int n = 0; n < nsend; n++) {
+    for (int f = plan->send_first[n]; f < plan->send_first[n + 1]; f++) {
+      ops_halo_group_fragment *frag = &plan->send[f];
+      ops_halo_copy_tobuf(plan->send_buffer, frag->offset, frag->dat,
+                          frag->ranges[0], frag->ranges[1], frag->ranges[2],
+                          frag->ranges[3], frag->ranges[4], frag->ranges[5],
+                          frag->step[0], frag->step[1], frag->step[2],
+                          frag->buf_strides[0], frag->buf_strides[1],
+                          frag->buf_strides[2]);
     }
+    MPI_Start(&plan->requests[nrecv + n]);
   }
 
-  mpi_neigh_size[0] = 0;
-  for (int i = 1; i < mpi_group->num_neighbors_send; i++)
-    mpi_neigh_size[i] = mpi_neigh_size[i - 1] + mpi_group->send_sizes[i - 1];
-  for (int i = 0; i < mpi_group->num_neighbors_send; i++)
-    MPI_Isend(&ops_buffer_send_1[mpi_neigh_size[i]], mpi_group->send_sizes[i],
-              MPI_BYTE, mpi_group->neighbors_send[i], 100 + mpi_group->index,
-              OPS_MPI_GLOBAL, &mpi_group->requests[i]);
-
-  mpi_neigh_size[0] = 0;
-  for (int i = 1; i < mpi_group->num_neighbors_recv; i++)
-    mpi_neigh_size[i] = mpi_neigh_size[i - 1] + mpi_group->recv_sizes[i - 1];
-  for (int i = 0; i < mpi_group->num_neighbors_recv; i++)
-    MPI_Irecv(&ops_buffer_recv_1[mpi_neigh_size[i]], mpi_group->recv_sizes[i],
-              MPI_BYTE, mpi_group->neighbors_recv[i], 100 + mpi_group->index,
-              OPS_MPI_GLOBAL,
-              &mpi_group->requests[mpi_group->num_neighbors_send + i]);
-
-  MPI_Waitall(mpi_group->num_neighbors_recv,
-              &mpi_group->requests[mpi_group->num_neighbors_send],
-              &mpi_group->statuses[mpi_group->num_neighbors_send]);
-
-  // Loop over all the halos we own in the group
-  for (int h = 0; h < mpi_group->nhalos; h++) {
-    ops_mpi_halo *halo = mpi_group->mpi_halos[h];
-    sub_dat *sd = OPS_sub_dat_list[halo->halo->to->index];
-
-    // Loop over all the recv fragments and pack into buffer
-    for (int f = halo->nproc_from; f < halo->nproc_from + halo->nproc_to; f++) {
-      int ranges[OPS_MAX_DIM * 2];
-      int step[OPS_MAX_DIM];
-      int buf_strides[OPS_MAX_DIM];
-      int fragment_size = halo->halo->to->elem_size;
-      for (int i = 0; i < OPS_MAX_DIM; i++) {
-        if (halo->halo->to_dir[i] > 0) {
-          ranges[2 * i] =
-              halo->local_to_base[f * OPS_MAX_DIM + i] - sd->d_im[i];
-          ranges[2 * i + 1] =
-              ranges[2 * i] +
-              halo->local_iter_size[f * OPS_MAX_DIM +
-                                    abs(halo->halo->to_dir[i]) - 1];
-          step[i] = 1;
-        } else {
-          ranges[2 * i + 1] =
-              halo->local_to_base[f * OPS_MAX_DIM + i] - 1 - sd->d_im[i];
-          ranges[2 * i] = ranges[2 * i + 1] +
-                          halo->local_iter_size[f * OPS_MAX_DIM +
-                                                abs(halo->halo->to_dir[i]) - 1];
-          step[i] = -1;
-        }
-        buf_strides[i] = 1;
-        for (int j = 0; j != abs(halo->halo->to_dir[i]) - 1; j++)
-          buf_strides[i] *= halo->local_iter_size[f * OPS_MAX_DIM + j];
-        fragment_size *= halo->local_iter_size[f * OPS_MAX_DIM + i];
-      }
-      int process = halo->proclist[f];
-      int proc_grp_idx = 0;
-      while (process != mpi_group->neighbors_recv[proc_grp_idx])
-        proc_grp_idx++;
-      ops_halo_copy_frombuf(halo->halo->to, ops_buffer_recv_1,
-                            mpi_neigh_size[proc_grp_idx], ranges[0], ranges[1],
-                            ranges[2], ranges[3], ranges[4], ranges[5], step[0],
-                            step[1], step[2], buf_strides[0], buf_strides[1],
-                            buf_strides[2]);
-      mpi_neigh_size[proc_grp_idx] += fragment_size;
-    }
+  if (nrecv > 0)
+    MPI_Waitall(nrecv, &plan->requests[0], MPI_STATUSES_IGNORE);
+  for (unsigned int f = 0; f < plan->recv.size(); f++) {
+    ops_halo_group_fragment *frag = &plan->recv[f];
+    ops_halo_copy_frombuf(frag->dat, plan->recv_buffer, frag->offset,
+                          frag->ranges[0], frag->ranges[1], frag->ranges[2],
+                          frag->ranges[3], frag->ranges[4], frag->ranges[5],
+                          frag->step[0], frag->step[1], frag->step[2],
+                          frag->buf_strides[0], frag->buf_strides[1],
+                          frag->buf_strides[2]);
   }
-  MPI_Waitall(mpi_group->num_neighbors_send, &mpi_group->requests[0],
-              &mpi_group->statuses[0]);
+  if (nsend > 0)
+    MPI_Waitall(nsend, &plan->requests[nrecv], MPI_STATUSES_IGNORE);
 
   ops_timers_core(&c, &t2);
   group->instance->ops_user_halo_exchanges_time += t2 - t1;
 }
 
 void ops_force_halo_exchange(ops_dat dat, ops_stencil stencil) {
+  ops_execute(dat->block->instance);
   ops_arg arg = ops_arg_dat(dat, dat->dim, stencil, dat->type, OPS_READ);
   sub_dat_list sd = OPS_sub_dat_list[dat->index];
   int range[2*OPS_MAX_DIM];
@@ -601,14 +601,13 @@ void ops_dat_fetch_data_slab_memspace(ops_dat dat, int part, char *data, int *ra
       prod *= target->size[d];
     }
     ops_kernel_descriptor *desc = ops_dat_deep_copy_core(target, dat, range);
-    strcpy(desc->name, "ops_internal_copy_device\0");
+    desc->name = ops_kernel_name_intern(dat->block->instance, "ops_internal_copy_device");
     desc->isdevice = 1;
     desc->func = ops_internal_copy_device;
     ops_internal_copy_device(desc);
     target->data_d = NULL;
     ops_free(target);
-    ops_free(desc->args);
-    ops_free(desc);
+    ops_kernel_descriptor_free(desc);
   } 
 
 }
@@ -642,14 +641,13 @@ void ops_dat_set_data_slab_memspace(ops_dat dat, int part, char *data, int *rang
       prod *= target->size[d];
     }
     ops_kernel_descriptor *desc = ops_dat_deep_copy_core(target, dat, range);
-    strcpy(desc->name, "ops_internal_copy_device_reverse\0");
+    desc->name = ops_kernel_name_intern(dat->block->instance, "ops_internal_copy_device_reverse");
     desc->isdevice = 1;
     desc->func = ops_internal_copy_device;
     ops_internal_copy_device(desc);
     target->data_d = NULL;
     ops_free(target);
-    ops_free(desc->args);
-    ops_free(desc);
+    ops_kernel_descriptor_free(desc);
     dat->dirty_hd = 2;
   }
 
@@ -682,14 +680,13 @@ void ops_dat_fetch_data_memspace(ops_dat dat, int part, char *data, ops_memspace
     target->base_offset = 0;
     for (int d = 0; d < OPS_MAX_DIM; d++) target->size[d] = size[d];
     ops_kernel_descriptor *desc = ops_dat_deep_copy_core(target, dat, range);
-    strcpy(desc->name, "ops_internal_copy_device\0");
+    desc->name = ops_kernel_name_intern(dat->block->instance, "ops_internal_copy_device");
     desc->isdevice = 1;
     desc->func = ops_internal_copy_device;
     ops_internal_copy_device(desc);
     target->data_d = NULL;
     ops_free(target);
-    ops_free(desc->args);
-    ops_free(desc);
+    ops_kernel_descriptor_free(desc);
   } 
 }
 
@@ -717,14 +714,13 @@ void ops_dat_set_data_memspace(ops_dat dat, int part, char *data, ops_memspace m
     target->base_offset = 0;
     for (int d = 0; d < OPS_MAX_DIM; d++) target->size[d] = size[d];
     ops_kernel_descriptor *desc = ops_dat_deep_copy_core(target, dat, range);
-    strcpy(desc->name, "ops_internal_copy_device_reverse\0");
+    desc->name = ops_kernel_name_intern(dat->block->instance, "ops_internal_copy_device_reverse");
     desc->isdevice = 1;
     desc->func = ops_internal_copy_device;
     ops_internal_copy_device(desc);
     target->data_d = NULL;
     ops_free(target);
-    ops_free(desc->args);
-    ops_free(desc);
+    ops_kernel_descriptor_free(desc);
     dat->dirty_hd = 2;
   } 
 }
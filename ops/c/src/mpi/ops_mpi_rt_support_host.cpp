@@ -99,6 +99,25 @@ void ops_halo_copy_tobuf(char *dest, int dest_offset, ops_dat src, int rx_s,
                          int x_step, int y_step, int z_step, int buf_strides_x,
                          int buf_strides_y, int buf_strides_z) {
   int OPS_soa = OPS_instance::getOPSInstance()->OPS_soa;
+  if (!OPS_soa && x_step == 1 && buf_strides_x == 1) {
+    // rows are contiguous in both the dataset and the buffer; SoA datasets
+    // and halos reversed or rotated along x take the general path below
+    size_t row = (size_t)(rx_e - rx_s) * src->elem_size;
+#ifdef _OPENMP
+#pragma omp parallel for OMP_COLLAPSE(2)
+#endif
+    for (int k = MIN(rz_s,rz_e+1); k < MAX(rz_s+1,rz_e); k ++) {
+      for (int j = MIN(ry_s,ry_e+1); j < MAX(ry_s+1,ry_e); j ++) {
+        memcpy(dest + dest_offset +
+                   ((k - rz_s) * z_step * buf_strides_z +
+                    (j - ry_s) * y_step * buf_strides_y) * src->elem_size,
+               src->data + (k * src->size[0] * src->size[1] + j * src->size[0] + rx_s) *
+                   src->elem_size,
+               row);
+      }
+    }
+    return;
+  }
 #ifdef _OPENMP
 #pragma omp parallel for OMP_COLLAPSE(3)
 #endif
@@ -128,6 +147,24 @@ void ops_halo_copy_frombuf(ops_dat dest, char *src, int src_offset, int rx_s,
                            int buf_strides_x, int buf_strides_y,
                            int buf_strides_z) {
   int OPS_soa = OPS_instance::getOPSInstance()->OPS_soa;
+  if (!OPS_soa && x_step == 1 && buf_strides_x == 1) {
+    // rows are contiguous in both the dataset and the buffer
+    size_t row = (size_t)(rx_e - rx_s) * dest->elem_size;
+#ifdef _OPENMP
+#pragma omp parallel for OMP_COLLAPSE(2)
+#endif
+    for (int k = MIN(rz_s,rz_e+1); k < MAX(rz_s+1,rz_e); k ++) {
+      for (int j = MIN(ry_s,ry_e+1); j < MAX(ry_s+1,ry_e); j ++) {
+        memcpy(dest->data + (k * dest->size[0] * dest->size[1] + j * dest->size[0] + rx_s) *
+                   dest->elem_size,
+               src + src_offset +
+                   ((k - rz_s) * z_step * buf_strides_z +
+                    (j - ry_s) * y_step * buf_strides_y) * dest->elem_size,
+               row);
+      }
+    }
+    return;
+  }
 #ifdef _OPENMP
 #pragma omp parallel for OMP_COLLAPSE(3)
 #endif